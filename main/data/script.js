@@ -29,6 +29,8 @@ document.addEventListener("DOMContentLoaded", () => {
     modalConfirm: document.getElementById("modal-confirm"),
     modalCancel: document.getElementById("modal-cancel"),
     modalClose: document.getElementById("modal-close"),
+    consoleOutput: document.getElementById("console-output"),
+    consoleToggle: document.getElementById("console-toggle"),
   }
 
   // State
@@ -42,6 +44,9 @@ document.addEventListener("DOMContentLoaded", () => {
     MAX_RECONNECT_ATTEMPTS: 30,
     REFRESH_INTERVAL: 5000, // 5 seconds
     THROTTLE_INTERVAL: 2000, // 2 seconds
+    consoleOffset: 0, // next byte of device serial output to ask for
+    consolePaused: false,
+    CONSOLE_MAX_CHARS: 65536, // kept in the page
   }
 
   // Initialize
@@ -68,8 +73,14 @@ document.addEventListener("DOMContentLoaded", () => {
         // window.location.href = "/logout"
       })
     })
+    elements.consoleToggle.addEventListener("click", () => {
+      state.consolePaused = !state.consolePaused
+      elements.consoleToggle.textContent = state.consolePaused ? "Resume" : "Pause"
+    })
+
     // Initial data fetch
     fetchDeviceInfo()
+    pollConsole()
 
     // Set up auto-refresh (throttled)
     state.infoRefreshInterval = setInterval(() => {
@@ -80,6 +91,38 @@ document.addEventListener("DOMContentLoaded", () => {
     }, state.REFRESH_INTERVAL)
   }
 
+  // Serial output, long polled from the device: each reply says where the next one starts
+  function pollConsole() {
+    if (state.consolePaused || state.updateInProgress) {
+      setTimeout(pollConsole, 1000)
+      return
+    }
+    fetch(`/api/console?from=${state.consoleOffset}&wait=1000`, { headers: { "Cache-Control": "no-cache" } })
+      .then((response) => {
+        if (!response.ok) throw new Error("console " + response.status)
+        const lost = Number(response.headers.get("X-Console-Lost") || 0)
+        state.consoleOffset = response.headers.get("X-Console-Next") || state.consoleOffset
+        return response.text().then((text) => (lost ? `\n... ${lost} bytes missed ...\n` : "") + text)
+      })
+      .then((text) => {
+        if (text) appendConsole(text)
+        setTimeout(pollConsole, 100)
+      })
+      .catch((error) => {
+        console.error("Error fetching console:", error)
+        setTimeout(pollConsole, 3000)
+      })
+  }
+
+  function appendConsole(text) {
+    const out = elements.consoleOutput
+    const atBottom = out.scrollTop + out.clientHeight >= out.scrollHeight - 4
+    let all = out.textContent + text
+    if (all.length > state.CONSOLE_MAX_CHARS) all = all.slice(all.length - state.CONSOLE_MAX_CHARS)
+    out.textContent = all
+    if (atBottom) out.scrollTop = out.scrollHeight
+  }
+
   function fetchDeviceInfo() {
     // Prevent excessive requests
     if (Date.now() - state.lastInfoUpdate < state.THROTTLE_INTERVAL) return
@@ -1,29 +1,34 @@
+#undef  FMS_LOG_TAG
+#define FMS_LOG_TAG CLI     // module of the FMS_LOG_* calls in this file
 
 // cli command function
-void handle_wifi_command(const std::vector<String>& args) {
+void handle_wifi_command(const fms_cli_args& args) {
   if (args.size() != 2) {
     fms_cli.respond("wifi", "Usage: wifi <ssid> <password>", false);
     return;
   }
   String ssid = args[0];
   String password = args[1];
-  // Save to preferences
-  fms_nvs_storage.begin("fms_config", false);
-  fms_nvs_storage.putString("ssid", ssid);
-  fms_nvs_storage.putString("pass", password);
-  fms_nvs_storage.end();
+  // Save to the settings blob
+  fms_config_lock();
+  strncpy(fms_cfg.wifi_ssid, ssid.c_str(), sizeof(fms_cfg.wifi_ssid) - 1);
+  fms_cfg.wifi_ssid[sizeof(fms_cfg.wifi_ssid) - 1] = '\0';
+  strncpy(fms_cfg.wifi_pass, password.c_str(), sizeof(fms_cfg.wifi_pass) - 1);
+  fms_cfg.wifi_pass[sizeof(fms_cfg.wifi_pass) - 1] = '\0';
+  fms_config_save();
+  fms_config_unlock();
 
   fms_cli.respond("wifi", "WiFi settings updated. SSID: " + ssid);
 }
 
-void handle_restart_command(const std::vector<String>& args) {
+void handle_restart_command(const fms_cli_args& args) {
   fms_cli.respond("restart", "Restarting system...");
   delay(1000);
   ESP.restart();
 }
 
 // Alternative WiFi scan implementation that uses even less memory
-void handle_wifi_scan_safe_command(const std::vector<String>& args) {
+void handle_wifi_scan_safe_command(const fms_cli_args& args) {
   const int MAX_NETWORKS = 5;
   // Start scan
   fms_cli.respond("wifiscan_safe", "Scanning for networks...");
@@ -69,6 +74,7 @@ void handle_wifi_scan_safe_command(const std::vector<String>& args) {
     // Give the system time to process
     delay(10);
     yield();
+    if (fms_cli.cancelled()) break;
   }
 
   // Free the memory used by the scan
@@ -78,7 +84,7 @@ void handle_wifi_scan_safe_command(const std::vector<String>& args) {
   fms_cli.respond("wifiscan_safe", "Scan complete");
 }
 
-void handle_wifi_connect_command(const std::vector<String>& args) {
+void handle_wifi_connect_command(const fms_cli_args& args) {
   if (args.size() != 2) {
     fms_cli.respond("wifi_connect", "Usage: wifi_connect <ssid> <password>", false);
     return;
@@ -99,13 +105,23 @@ void handle_wifi_connect_command(const std::vector<String>& args) {
 
   WiFi.begin(ssid.c_str(), password.c_str());
 
-  // Wait for connection with timeout
+  // Wait for connection with timeout, Ctrl-C gives up
   unsigned long startTime = millis();
+  unsigned long lastReport = startTime;
   while (WiFi.status() != WL_CONNECTED && millis() - startTime < WIFI_TIMEOUT) {
-    delay(500);
-    Serial.print(".");
+    if (fms_cli.cancelled()) {
+      WiFi.disconnect();
+      fms_cli.respond("wifi_connect", "Cancelled", false);
+      return;
+    }
+    vTaskDelay(pdMS_TO_TICKS(100));
+    if (millis() - lastReport >= 2000) {
+      lastReport = millis();
+      char step[32];
+      snprintf(step, sizeof(step), "waiting %lu s", (lastReport - startTime) / 1000);
+      fms_cli.progress("wifi_connect", step);
+    }
   }
-  Serial.println();
 
   // Check connection result
   if (WiFi.status() == WL_CONNECTED) {
@@ -147,7 +163,7 @@ void handle_wifi_connect_command(const std::vector<String>& args) {
   }
 }
 
-void handle_wifi_read_command(const std::vector<String>& args) {
+void handle_wifi_read_command(const fms_cli_args& args) {
   if (WiFi.status() == WL_CONNECTED) {
     // Use individual prints instead of building a large string
     Serial.print("{");
@@ -167,7 +183,7 @@ void handle_wifi_read_command(const std::vector<String>& args) {
 }
 
 // Test command to run a series of tests
-void handle_test_command(const std::vector<String>& args) {
+void handle_test_command(const fms_cli_args& args) {
   fms_cli.respond("test", "Running fms_cli tests...");
 
   // Test help command
@@ -192,14 +208,12 @@ void handle_test_command(const std::vector<String>& args) {
 }
 
 // WiFi connection test command
-void handle_wifi_test_command(const std::vector<String>& args) {
+void handle_wifi_test_command(const fms_cli_args& args) {
   fms_cli.respond("wifi_test", "Running WiFi connection tests...");
 
   // Get stored WiFi credentials
-  fms_nvs_storage.begin("fms_config", true);  // Read-only mode
-  String ssid = fms_nvs_storage.getString("ssid", "");
-  String password = fms_nvs_storage.getString("pass", "");
-  fms_nvs_storage.end();
+  String ssid = fms_cfg.wifi_ssid;
+  String password = fms_cfg.wifi_pass;
 
   if (ssid.length() == 0 || password.length() == 0) {
     fms_cli.respond("wifi_test", "No WiFi credentials stored. Use 'wifi <ssid> <password>' first.", false);
@@ -266,64 +280,69 @@ void handle_wifi_test_command(const std::vector<String>& args) {
 }
 
 // Device Id Change Command
-void handle_device_id_change_command(const std::vector<String>& args) {
+void handle_device_id_change_command(const fms_cli_args& args) {
   if (args.size() != 1) {
     fms_cli.respond("device", "Usage: UUID <id> ", false);
     return;
   }
   String uuid = args[0];
-  // Save to preferences
-  fms_nvs_storage.begin("fms_config", false);
-  fms_nvs_storage.putString("uuid", uuid);
-  fms_nvs_storage.end();
+  // Save to the settings blob
+  fms_config_lock();
+  strncpy(fms_cfg.uuid, uuid.c_str(), sizeof(fms_cfg.uuid) - 1);
+  fms_cfg.uuid[sizeof(fms_cfg.uuid) - 1] = '\0';
+  fms_config_save();
+  fms_config_unlock();
   fms_cli.respond("UUID", "UUID  updated. UUID: " + uuid);
 }
 
-void handle_protocol_command(const std::vector<String>& args) {
+void handle_protocol_command(const fms_cli_args& args) {
   if (args.size() != 1) {
-    fms_cli.respond("protocol", "Usage: protocol <redstar|tatsuno>", false);
+    fms_cli.respond("protocol", "Usage: protocol <tatsuno|gilbarco|redstar|haungyang>", false);
     return;
   }
   String protocol = args[0];
-  if (protocol == "redstar") {
-    #define USE_RESTAR
-    //fms_set_protocol_config("redstar");
-    vTaskDelay(pdMS_TO_TICKS(1000)); // Allow time for changes to take effect
-    ESP.restart();
-    // Set Redstar protocol
-    fms_cli.respond("protocol", "Protocol set to Redstar");
-    // Add any additional setup for Redstar here
-  } else if (protocol == "tatsuno") {
-    #define USE_TATSUNO
-    //fms_set_protocol_config("tatsuno");
-    vTaskDelay(pdMS_TO_TICKS(1000)); // Allow time for changes to take effect
-    ESP.restart();
-    // Set Tatsuno protocol
-    fms_cli.respond("protocol", "Protocol set to Tatsuno");
-    // Add any additional setup for Tatsuno here
-  } else {
+  if (fms_protocol_find(protocol.c_str()) == NULL) {
     fms_cli.respond("protocol", "Unknown protocol: " + protocol, false);
+    return;
   }
+  // the driver is picked from NVS at boot
+  dcfg.pt = protocol;
+  fms_set_protocol_config(dcfg);
+  fms_cli.respond("protocol", "Protocol set to " + protocol + ", restarting");
+  vTaskDelay(pdMS_TO_TICKS(1000)); // Allow time for changes to take effect
+  ESP.restart();
+}
+
+// serial output capture for the web console, any task; writes are copies into a fixed ring
+void fms_capture_write(const char* data, size_t len) {
+  portENTER_CRITICAL(&serial_capture_mux);
+  serial_capture.write(data, len);
+  portEXIT_CRITICAL(&serial_capture_mux);
+}
+
+size_t fms_capture_read(uint64_t from, char* out, size_t cap, uint64_t* next, uint64_t* lost) {
+  portENTER_CRITICAL(&serial_capture_mux);
+  size_t n = serial_capture.read(from, out, cap, next, lost);
+  portEXIT_CRITICAL(&serial_capture_mux);
+  return n;
+}
+
+uint64_t fms_capture_head() {
+  portENTER_CRITICAL(&serial_capture_mux);
+  uint64_t head = serial_capture.head();
+  portEXIT_CRITICAL(&serial_capture_mux);
+  return head;
 }
 
 // Custom print function that captures output for the web interface
 size_t custom_print(const uint8_t* buffer, size_t size) {
-  if (testModeActive) {
-    // Add to buffer
-    for (size_t i = 0; i < size; i++) {
-      serialOutputBuffer += (char)buffer[i];
-    }
-    // Trim buffer if it gets too large
-    if (serialOutputBuffer.length() > MAX_BUFFER_SIZE) {
-      serialOutputBuffer = serialOutputBuffer.substring(serialOutputBuffer.length() - MAX_BUFFER_SIZE);
-    }
-  }
+  fms_capture_write((const char*)buffer, size);
   // Pass through to original Serial
   return Serial.write(buffer, size);
 }
 
 // Protocol config command
-void handle_protocol_config_command(const std::vector<String>& args) {
+void handle_protocol_config_command(const fms_cli_args& args) {
   if (args.size() < 11) {
     fms_cli.respond("protocol_config", "Usage: protocol_config <protocol> <device_id> <nozzle_count> <pump_id1> ... <pump_id8>", false);
     return;
@@ -331,7 +350,7 @@ void handle_protocol_config_command(const std::vector<String>& args) {
 
   String protocol = args[0];
   // Validate protocol 
-  if (protocol != "tatsuno" && protocol != "gilbarco" && protocol != "redstar" && protocol != "haungyang") {
+  if (fms_protocol_find(protocol.c_str()) == NULL) {
     fms_cli.respond("protocol_config", "Invalid protocol. Must be tatsuno, gilbarco, redstar, or haungyang", false);
     return;
   }
@@ -365,8 +384,6 @@ void handle_protocol_config_command(const std::vector<String>& args) {
   memcpy(dcfg.pumpids, pumpids, sizeof(pumpids));
 
   fms_set_protocol_config(dcfg);
-  config_eeprom_writeInt(92,111111); /* test mode pin */
-
   
   fms_cli.respond("protocol_config", 
     "Protocol configuration saved:\n"
@@ -375,7 +392,7 @@ void handle_protocol_config_command(const std::vector<String>& args) {
     "Nozzle count: " + String(noz), true);
 }
 
-void handle_mqtt_command(const std::vector<String>& args) {
+void handle_mqtt_command(const fms_cli_args& args) {
 
 if (args.size() != 2) {
     fms_cli.respond("mqtt_config", "Usage: mqtt_config <host> <port>", false);
@@ -387,100 +404,104 @@ if (args.size() != 2) {
   String host = args[0];
   String port = args[1];
 
-    // Save to preferences
-  fms_nvs_storage.begin("fms_config", false);
-  fms_nvs_storage.putString("host", host);
-  fms_nvs_storage.putString("port", port);
-  fms_nvs_storage.end();
+    // Save to the settings blob
+  fms_config_lock();
+  strncpy(fms_cfg.mqtt_host, host.c_str(), sizeof(fms_cfg.mqtt_host) - 1);
+  fms_cfg.mqtt_host[sizeof(fms_cfg.mqtt_host) - 1] = '\0';
+  fms_cfg.mqtt_port = (uint16_t)port.toInt();
+  fms_config_save();
+  fms_config_unlock();
 
   fms_cli.respond("mqtt_config", "config successfully saved", true);
 }
 
 
-void config_writeStringToEEPROM(int address, String data) {  // to store wifi ssid and pass in EEprom
-  int data_length = data.length();
-  for (int i = 0; i < data_length; i++) {
-    EEPROM.write(address + i, data[i]);
-    EEPROM.commit();
-  }
-  EEPROM.write(address + data_length, '\0');
-  EEPROM.commit();
-  Serial.println("EEPROM write complete");
-}
-
-
-void config_eeprom_writeInt(int add, long data) {
-  byte byte0 = (data >> 24) & 0xff;
-  byte byte1 = (data >> 16) & 0xff;
-  byte byte2 = (data >> 8) & 0xff;
-  byte byte3 = data & 0xff;
-
-  EEPROM.write(add, byte0);
-  EEPROM.write(add + 1, byte1);
-  EEPROM.write(add + 2, byte2);
-  EEPROM.write(add + 3, byte3);
-  EEPROM.commit();
-}
-
-
-void handle_nozzle_command(const std::vector<String>& args) {
+void handle_nozzle_command(const fms_cli_args& args) {
   if (args.size() < 16) {
     fms_cli.respond("nozzle_config", "Usage: nozzle_config <> <>", false);
     return;
   }
 
-  String nozzle_1_fuel_type  = args[0];
-  int nozzle_1_fuel_price    = args[1].toInt();
-
-  String nozzle_2_fuel_type  = args[2];
-  int nozzle_2_fuel_price    = args[3].toInt();
-
-  String nozzle_3_fuel_type  = args[4];
-  int nozzle_3_fuel_price    = args[5].toInt();
-
-  String nozzle_4_fuel_type  = args[6];
-  int nozzle_4_fuel_price    = args[7].toInt();
-
-  String nozzle_5_fuel_type  = args[8];
-  int nozzle_5_fuel_price    = args[9].toInt();
-
-  String nozzle_6_fuel_type  = args[10];
-  int nozzle_6_fuel_price    = args[11].toInt();
-
-  String nozzle_7_fuel_type  = args[12];
-  int nozzle_7_fuel_price    = args[13].toInt();
-
-  String nozzle_8_fuel_type  = args[14];
-  int nozzle_8_fuel_price    = args[15].toInt();
+  // prices go to the settings blob, the engine starts from them after a restart
+  fms_config_lock();
+  for (int i = 0; i < FMS_CONFIG_NOZZLES; i++) {
+    fms_unit_price_t p;
+    const String& text = args[2 * i + 1];
+    if (fms_unit_price_t::parse(text.c_str(), text.length(), &p) && p.raw >= 0 && p.raw <= 0xFFFFFFFFLL) {
+      fms_cfg.prices[i] = (uint32_t)p.raw;
+    }
+  }
+  fms_config_save();
+  fms_config_unlock();
 
-/* for touch controller eeprom storage */
-  config_writeStringToEEPROM(200, nozzle_1_fuel_type);
-  config_writeStringToEEPROM(230, nozzle_2_fuel_type);
-  config_writeStringToEEPROM(260, nozzle_3_fuel_type);
-  config_writeStringToEEPROM(290, nozzle_4_fuel_type);
-  config_writeStringToEEPROM(330, nozzle_5_fuel_type);
-  config_writeStringToEEPROM(360, nozzle_6_fuel_type);
-  config_writeStringToEEPROM(390, nozzle_7_fuel_type);
-  config_writeStringToEEPROM(420, nozzle_8_fuel_type);
 
-  config_eeprom_writeInt(114, 2900);
-  config_eeprom_writeInt(118, 3000);
-  config_eeprom_writeInt(122, 2700);
-  config_eeprom_writeInt(81, 3300);
-  config_eeprom_writeInt(85, 0);
-  config_eeprom_writeInt(132, 0);
-  config_eeprom_writeInt(138, 0);
-  config_eeprom_writeInt(144, 0);
+  fms_cli.respond("nozzle_config" ,"fuel" + String(args[0]) , true);
+}
 
 
-  fms_cli.respond("nozzle_config" ,"fuel" + String(nozzle_1_fuel_type) , true);
+// Settings commands config_apply can run, with their exact argument count
+struct fms_config_step_t {
+  const char* name;
+  uint8_t     argc;
+  void        (*handler)(const fms_cli_args& args);
+};
+
+static const fms_config_step_t config_steps[] = {
+  {"wifi",            2,  handle_wifi_command},
+  {"mqtt_config",     2,  handle_mqtt_command},
+  {"uuid_change",     1,  handle_device_id_change_command},
+  {"protocol_config", 11, handle_protocol_config_command},
+  {"noz_config",      16, handle_nozzle_command},
+  {"live_rate",       1,  handle_live_rate_command},
+  {"payload_format",  1,  handle_payload_format_command},
+};
+
+// Whole device profile in one request: config_apply <command> <args> [<command> <args>]...
+//   config_apply wifi "Station 5" secret mqtt_config 10.0.0.2 1883 noz_config 92 2500 ...
+// The steps run in order, each answering as it would alone; the first that
+// fails stops the rest. Settings that are read at boot need a restart after.
+void handle_config_apply_command(const fms_cli_args& args) {
+  size_t i = 0;
+  int steps = 0;
+  char msg[64];
+  while (i < args.size()) {
+    const fms_config_step_t* step = NULL;
+    for (size_t k = 0; k < sizeof(config_steps) / sizeof(config_steps[0]); k++) {
+      if (args[i] == config_steps[k].name) step = &config_steps[k];
+    }
+    if (step == NULL) {
+      snprintf(msg, sizeof(msg), "step %d: '%s' is not a settings command", steps + 1, args[i].c_str());
+      fms_cli.respond("config_apply", msg, false);
+      return;
+    }
+    if (args.size() - i - 1 < step->argc) {
+      snprintf(msg, sizeof(msg), "step %d: %s needs %u arguments", steps + 1, step->name, (unsigned)step->argc);
+      fms_cli.respond("config_apply", msg, false);
+      return;
+    }
+    step->handler(fms_cli_args(&args[i + 1], step->argc));
+    if (fms_cli.failed()) {
+      snprintf(msg, sizeof(msg), "stopped at step %d (%s)", steps + 1, step->name);
+      fms_cli.respond("config_apply", msg, false);
+      return;
+    }
+    i += 1 + step->argc;
+    steps++;
+  }
+  snprintf(msg, sizeof(msg), "%d steps applied", steps);
+  fms_cli.respond("config_apply", msg);
 }
 
-
+// Runs the lines the serial receive callback queued, so a slow command
+// (wifi_connect, wifiscan_safe, restart) holds up this task only
 static void cli_task(void* arg) {
-  BaseType_t rc;
-  // cli command
   while (1) {
-    vTaskDelay(pdMS_TO_TICKS(100));
+    fms_cli.run_pending();
   }
 }
+
+// Started with the CLI, not with the other tasks: wifi is set up from here
+bool fms_cli_task_begin() {
+  BaseType_t cli_rc;
+  return create_task(cli_task, "cli", FMS_CLI_TASK_STACK_SIZE, 1, &hcliTask, cli_rc);
+}
@@ -0,0 +1,67 @@
+/*
+  * fms_hmi.ino
+  * touch display on uart2, other tasks only set the wanted icon / text state,
+  * the uart2 task writes the changes in one burst while the dispenser link is quiet
+*/
+#undef  FMS_LOG_TAG
+#define FMS_LOG_TAG SYS     // module of the FMS_LOG_* calls in this file
+
+#ifdef USE_TOUCH
+
+fms_hmi_writer fms_hmi;
+portMUX_TYPE   hmi_mux          = portMUX_INITIALIZER_UNLOCKED;
+int8_t         hmi_wifi_icon    = -1;
+int8_t         hmi_cloud_icon   = -1;
+uint32_t       hmi_last_ms      = 0;
+
+void fms_hmi_begin() {
+  hmi_wifi_icon  = fms_hmi.add_icon(HMI_VP_WIFI_ICON);
+  hmi_cloud_icon = fms_hmi.add_icon(HMI_VP_CLOUD_ICON);
+}
+
+// safe from any task, no uart traffic unless the value changed
+void fms_hmi_set_icon(int8_t slot, uint16_t value) {
+  portENTER_CRITICAL(&hmi_mux);
+  fms_hmi.set_icon(slot, value);
+  portEXIT_CRITICAL(&hmi_mux);
+}
+
+void fms_hmi_set_text(int8_t slot, const char* text) {
+  portENTER_CRITICAL(&hmi_mux);
+  fms_hmi.set_text(slot, text);
+  portEXIT_CRITICAL(&hmi_mux);
+}
+
+// uart2 task only, at most one write per HMI_TICK_MS and never while a dispenser reply is due
+void fms_hmi_tick(bool link_busy) {
+  static uint8_t buf[FMS_HMI_FLUSH_MAX];
+  uint32_t now = millis();
+  if (!fms_hmi.pending() || now - hmi_last_ms < HMI_TICK_MS) return;
+  if (link_busy) {
+    fms_hmi.note_deferred();
+    return;
+  }
+  portENTER_CRITICAL(&hmi_mux);
+  size_t n = fms_hmi.flush(buf, sizeof(buf));
+  portEXIT_CRITICAL(&hmi_mux);
+  if (n) fms_uart2_serial.write(buf, n);
+  hmi_last_ms = now;
+}
+
+void handle_hmi_stats_command(const fms_cli_args& args) {
+  if (args.size() > 0 && args[0] == "resend") {
+    portENTER_CRITICAL(&hmi_mux);
+    fms_hmi.invalidate();
+    portEXIT_CRITICAL(&hmi_mux);
+  }
+  const fms_hmi_stats_t& st = fms_hmi.stats();
+  char part[192];
+  snprintf(part, sizeof(part),
+           "\"command\":\"hmi_stats\",\"sets\":%lu,\"suppressed\":%lu,\"flushes\":%lu,\"frames\":%lu,\"bytes\":%lu,\"deferred\":%lu",
+           st.sets, st.suppressed, st.flushes, st.frames, st.bytes, st.deferred);
+  fms_cli.begin_json_response();
+  fms_cli.add_json_response_part(part);
+  fms_cli.end_json_response();
+}
+
+#endif
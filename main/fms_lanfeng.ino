@@ -0,0 +1,143 @@
+/*
+  * fms_lanfeng.ino
+  * lanfeng modbus dispenser (ModbusMaster node on uart2)
+  * the whole register map sits in one 37 register window (0x02BC - 0x02E0),
+  * the poller reads it with one function 03 transaction per scan
+*/
+#undef  FMS_LOG_TAG
+#define FMS_LOG_TAG PROTO   // module of the FMS_LOG_* calls in this file
+
+#ifdef USE_LANFENG
+
+static const fms_modbus_reg_t lanfeng_reg_table[] = {
+  { "totalizer_liter",  TOTALIZER_LITER_ADDR,  2, REG_TOTALIZER_LITER  },
+  { "totalizer_amount", TOTALIZER_AMOUNT_ADDR, 2, REG_TOTALIZER_AMOUNT },
+  { "live_data",        LIVE_DATA_ADDR,        2, REG_LIVE_DATA        },
+  { "live_price",       LIVE_PRICE_ADDR,       2, REG_LIVE_PRICE       },
+  { "sell_liter",       SELL_LITER_ADDR,       2, REG_SELL_LITER       },
+  { "price",            PRICE_ADDR,            2, REG_PRICE            },
+  { "pump_state",       PUMP_STATE_ADDR,       1, REG_PUMP_STATE       },
+  { "noz_handle",       NOZ_HANDLE_ADDR,       1, REG_NOZ_HANDLE       },
+};
+const uint8_t lanfeng_reg_count = sizeof(lanfeng_reg_table) / sizeof(lanfeng_reg_table[0]);
+
+fms_modbus_poller lanfeng_poller;
+uint32_t          lanfeng_status_mask = 0;   // handle + pump state
+uint32_t          lanfeng_live_mask   = 0;   // status + live data + totalizers
+
+void lanfeng_pre_transmission() {
+  digitalWrite(MAX485_RE_NEG, 1);
+  digitalWrite(MAX485_DE, 1);
+}
+
+void lanfeng_post_transmission() {
+  digitalWrite(MAX485_RE_NEG, 0);
+  digitalWrite(MAX485_DE, 0);
+}
+
+static bool lanfeng_read_registers(uint8_t slave, uint16_t start, uint16_t qty, uint16_t* out, void* ctx) {
+  node.begin(slave, fms_uart2_serial);  // only switches the slave id
+  uint8_t rc = node.readHoldingRegisters(start, qty);
+  if (rc != node.ku8MBSuccess) {
+    FMS_LOG_DEBUG("[LANFENG] read 0x%04X x%d from %d failed, rc = 0x%02X", start, qty, slave, rc);
+    return false;
+  }
+  for (uint16_t i = 0; i < qty; i++) {
+    out[i] = node.getResponseBuffer(i);
+  }
+  return true;
+}
+
+static uint32_t lanfeng_clock_us() {
+  return micros();
+}
+
+bool fms_lanfeng_begin() {
+  pinMode(MAX485_DE, OUTPUT);
+  pinMode(MAX485_RE_NEG, OUTPUT);
+  lanfeng_post_transmission();
+  node.begin(NOZ_ID, fms_uart2_serial);
+  node.preTransmission(lanfeng_pre_transmission);
+  node.postTransmission(lanfeng_post_transmission);
+  if (!lanfeng_poller.begin(lanfeng_reg_table, lanfeng_reg_count, lanfeng_read_registers, nullptr, lanfeng_clock_us)) {
+    FMS_LOG_ERROR("[LANFENG] register table rejected");
+    return false;
+  }
+  lanfeng_status_mask = lanfeng_poller.mask_of(NOZ_HANDLE_ADDR) | lanfeng_poller.mask_of(PUMP_STATE_ADDR);
+  lanfeng_live_mask   = lanfeng_status_mask | lanfeng_poller.mask_of(LIVE_DATA_ADDR) | lanfeng_poller.mask_of(LIVE_PRICE_ADDR)
+                      | lanfeng_poller.mask_of(TOTALIZER_LITER_ADDR) | lanfeng_poller.mask_of(TOTALIZER_AMOUNT_ADDR);
+  fms_modbus_block_t blocks[FMS_MODBUS_MAX_BLOCKS];
+  uint8_t n = lanfeng_poller.plan(FMS_MODBUS_ALL, blocks, FMS_MODBUS_MAX_BLOCKS);
+  FMS_LOG_INFO("[LANFENG] %d registers in %d transaction(s) per full scan", lanfeng_reg_count, n);
+  return true;
+}
+
+// scheduled poll of one nozzle, status only while idle
+bool fms_lanfeng_poll(uint8_t noz, fms_poll_kind_t kind) {
+  uint32_t mask = (kind == POLL_LIVE) ? lanfeng_live_mask : lanfeng_status_mask;
+  if (!lanfeng_poller.scan(fms_nozzles.pump_id(noz), mask, reg_data, NUM_REG)) {
+    return false;
+  }
+  fms_lanfeng_update_nozzle(noz, kind == POLL_LIVE);
+  return true;
+}
+
+// release the pump after the local server approved the sale
+bool fms_lanfeng_approve(uint8_t slave) {
+  node.begin(slave, fms_uart2_serial);
+  uint8_t rc = node.writeSingleRegister(PUMP_STATE_ADDR, PUMP_STATE_APPROVE);
+  if (rc != node.ku8MBSuccess) {
+    FMS_LOG_ERROR("[LANFENG] approve pump %d failed, rc = 0x%02X", slave, rc);
+    return false;
+  }
+  return true;
+}
+
+// register words to engine fixed-point counts
+static uint32_t lanfeng_volume_raw(uint32_t reg) {
+  return (uint32_t)fms_volume_t::from_scaled(reg, LANFENG_VOLUME_DECIMALS).raw;
+}
+
+static uint32_t lanfeng_money_raw(uint32_t reg) {
+  return (uint32_t)fms_money_t::from_scaled(reg, LANFENG_MONEY_DECIMALS).raw;
+}
+
+// turn a fresh register scan into engine events (same task as the engine)
+void fms_lanfeng_update_nozzle(uint8_t noz, bool live) {
+  fms_noz_event_t ev = { 0, noz, 0, 0 };
+  ev.type = reg_data[REG_NOZ_HANDLE] ? NOZ_EV_HANDLE_UP : NOZ_EV_HANDLE_DOWN;
+  fms_nozzle_dispatch(ev);
+  if (reg_data[REG_PUMP_STATE]) {  // the sale is closed by hanging up the nozzle
+    ev.type = NOZ_EV_PUMP_RUNNING;
+    fms_nozzle_dispatch(ev);
+  }
+  if (!live) {
+    return;  // live and totalizer slots were not part of this scan
+  }
+  ev.type = NOZ_EV_TOTALIZER;
+  ev.a = lanfeng_volume_raw(reg_data[REG_TOTALIZER_LITER]);
+  ev.b = lanfeng_money_raw(reg_data[REG_TOTALIZER_AMOUNT]);
+  fms_nozzle_dispatch(ev);
+  if (fms_nozzles.state(noz) >= NOZ_APPROVED) {
+    ev.type = NOZ_EV_LIVE;
+    ev.a = lanfeng_volume_raw(reg_data[REG_LIVE_DATA]);
+    ev.b = lanfeng_money_raw(reg_data[REG_LIVE_PRICE]);
+    fms_nozzle_dispatch(ev);
+  }
+}
+
+void handle_modbus_stats_command(const fms_cli_args& args) {
+  const fms_modbus_stats_t& st = lanfeng_poller.stats();
+  if (args.size() == 1 && args[0] == "reset") {
+    lanfeng_poller.reset_stats();
+    fms_cli.respond("modbus_stats", "Statistics cleared");
+    return;
+  }
+  uint32_t avg = st.scans ? (uint32_t)(st.total_scan_us / st.scans) : 0;
+  Serial.printf("{\"scans\":%lu,\"errors\":%lu,\"transactions\":%lu,\"registers\":%lu,"
+                "\"blocks\":%u,\"last_us\":%lu,\"avg_us\":%lu,\"min_us\":%lu,\"max_us\":%lu}\n",
+                st.scans, st.errors, st.transactions, st.registers, st.last_blocks,
+                st.last_scan_us, avg, st.scans ? st.min_scan_us : 0, st.max_scan_us);
+}
+
+#endif  // USE_LANFENG
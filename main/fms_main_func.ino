@@ -1,18 +1,146 @@
+#undef  FMS_LOG_TAG
+#define FMS_LOG_TAG SYS     // module of the FMS_LOG_* calls in this file
 
-void fms_boot_count(bool bootsave) {
-  if (!bootsave) {
+/*
+ * boot phases: fms_boot_mark stamps the time since power on (esp_timer) at the end
+ * of each setup step and at the first pump poll, boot_stats shows them
+ */
+#define BOOT_PHASE_MAX  16
+
+struct fms_boot_phase_t {
+  const char* name;
+  uint32_t    us;
+};
+fms_boot_phase_t boot_phases[BOOT_PHASE_MAX];
+uint8_t          boot_phase_count = 0;
+portMUX_TYPE     boot_phase_mux   = portMUX_INITIALIZER_UNLOCKED;
+
+void fms_boot_mark(const char* name) {
+  uint32_t us = (uint32_t)esp_timer_get_time();
+  portENTER_CRITICAL(&boot_phase_mux);  // the first poll is marked from the uart2 task
+  if (boot_phase_count < BOOT_PHASE_MAX) boot_phases[boot_phase_count++] = { name, us };
+  portEXIT_CRITICAL(&boot_phase_mux);
+}
+
+// log_level [module|all level]: show or set the runtime level per module (src/_fms_debug.h)
+void handle_log_level_command(const fms_cli_args& args) {
+  if (args.size() == 1) {
+    fms_cli.respond("log_level", "Usage: log_level [<module>|all <none|error|warn|info|debug|verbose>]", false);
     return;
   }
+  if (args.size() == 2) {
+    int level = fmsLogLevelFind(args[1].c_str());
+    if (level < 0) {
+      fms_cli.respond("log_level", "unknown level", false);
+      return;
+    }
+    if (args[0] == "all") {
+      fmsSetLogLevel((FMSLogLevel)level);
+    } else {
+      int tag = fmsLogTagFind(args[0].c_str());
+      if (tag < 0) {
+        fms_cli.respond("log_level", "unknown module", false);
+        return;
+      }
+      fmsSetTagLevel((FMSLogTag)tag, (FMSLogLevel)level);
+    }
+  }
+  static const uint8_t ceilings[FMS_TAG_COUNT] = FMS_LOG_CEILINGS;
+  char part[96];
+  fms_cli.begin_json_response();
+  fms_cli.add_json_response_part("\"command\":\"log_level\",\"modules\":[");
+  for (uint8_t i = 0; i < FMS_TAG_COUNT; i++) {
+    snprintf(part, sizeof(part), "%s{\"module\":\"%s\",\"level\":\"%s\",\"built_in\":\"%s\"}", i ? "," : "",
+             fmsLogTagName(i), fmsLogLevelName(fmsLogTagLevel[i]), fmsLogLevelName(ceilings[i]));
+    fms_cli.add_json_response_part(part);
+  }
+  fms_cli.add_json_response_part("]");
+  fms_cli.end_json_response();
+}
 
-  if (!fms_nvs_storage.begin("fms_config", false)) {
-    FMS_LOG_ERROR("[fms_main_func.ino:13] Failed to initialize NVS storage");
-    return;
+void handle_boot_stats_command(const fms_cli_args& args) {
+  char part[96];
+  fms_cli.begin_json_response();
+  snprintf(part, sizeof(part), "\"command\":\"boot_stats\",\"bootcount\":%lu,\"phases\":[", sysCfg.bootcount);
+  fms_cli.add_json_response_part(part);
+  uint32_t prev = 0;
+  for (uint8_t i = 0; i < boot_phase_count; i++) {
+    snprintf(part, sizeof(part), "%s{\"phase\":\"%s\",\"at_ms\":%lu.%03lu,\"took_ms\":%lu.%03lu}", i ? "," : "",
+             boot_phases[i].name, boot_phases[i].us / 1000, boot_phases[i].us % 1000,
+             (boot_phases[i].us - prev) / 1000, (boot_phases[i].us - prev) % 1000);
+    fms_cli.add_json_response_part(part);
+    prev = boot_phases[i].us;
   }
-  sysCfg.bootcount = fms_nvs_storage.getUInt("bootcount", 0) + 1;
-  app_cpu = xPortGetCoreID();
-  FMS_LOG_INFO("[fms_main_func.ino:19] CPU %d: Boot count: %lu", app_cpu, sysCfg.bootcount);
-  fms_nvs_storage.putUInt("bootcount", sysCfg.bootcount);
-  fms_nvs_storage.end();  // Close NVS storage
+  fms_cli.add_json_response_part("]");
+  fms_cli.end_json_response();
+}
+
+// settings blob from the keys older firmware kept one by one, read in the open session
+static void fms_config_migrate() {
+  fms_config_defaults(&fms_cfg);
+  strncpy(fms_cfg.wifi_ssid, fms_nvs_storage.getString("ssid").c_str(), sizeof(fms_cfg.wifi_ssid) - 1);
+  strncpy(fms_cfg.wifi_pass, fms_nvs_storage.getString("pass").c_str(), sizeof(fms_cfg.wifi_pass) - 1);
+  strncpy(fms_cfg.mqtt_host, fms_nvs_storage.getString("host").c_str(), sizeof(fms_cfg.mqtt_host) - 1);
+  fms_cfg.mqtt_port = (uint16_t)fms_nvs_storage.getString("port").toInt();
+  strncpy(fms_cfg.uuid, fms_nvs_storage.getString("uuid", fms_cfg.uuid).c_str(), sizeof(fms_cfg.uuid) - 1);
+  strncpy(fms_cfg.protocol, fms_nvs_storage.getString("protocol").c_str(), sizeof(fms_cfg.protocol) - 1);
+  fms_cfg.devn    = fms_nvs_storage.getUChar("devn", 1);
+  fms_cfg.noz     = fms_nvs_storage.getUChar("noz", 1);
+  fms_cfg.live_ms = fms_nvs_storage.getUShort("live_ms", 0);
+  fms_cfg.payload = fms_nvs_storage.getUChar("payload", PAYLOAD_TEXT);
+  char key[12];
+  for (int i = 0; i < FMS_CONFIG_NOZZLES; i++) {
+    snprintf(key, sizeof(key), "pumpid%d", i + 1);
+    fms_cfg.pumpids[i] = fms_nvs_storage.getUChar(key, 0);
+  }
+}
+
+// fms_cfg writers (cli_task, mqtt_task) hold this across the change and fms_config_save,
+// so a save never encodes a half written field and NVS sessions do not overlap
+void fms_config_lock() {
+  if (fms_cfg_mutex) xSemaphoreTake(fms_cfg_mutex, portMAX_DELAY);
+}
+
+void fms_config_unlock() {
+  if (fms_cfg_mutex) xSemaphoreGive(fms_cfg_mutex);
+}
+
+// fms_cfg to NVS with fms_config_lock held (the old keys are left for a downgrade);
+// the copy goes first, so a save cut short leaves one of the two blobs whole
+bool fms_config_save() {
+  uint8_t blob[FMS_CONFIG_BLOB_MAX];
+  size_t len = fms_config_encode(fms_cfg, blob, sizeof(blob));
+  if (!fms_nvs_storage.begin("fms_config", false)) return false;
+  bool ok = fms_nvs_storage.putBytes(CONFIG_BLOB_KEY_B, blob, len) == len &&
+            fms_nvs_storage.putBytes(CONFIG_BLOB_KEY, blob, len) == len;
+  fms_nvs_storage.end();
+  if (!ok) FMS_LOG_ERROR("[CONFIG] save failed");
+  if (ok) fms_cfg_dirty = false;  // a deferred change went out with it
+  return ok;
+}
+
+// fms_config_lock held: save from sd_task instead (fms_config_service), for writers on
+// the network path; every change within CONFIG_SAVE_DELAY_MS of the first is one NVS save
+void fms_config_save_later() {
+  if (!fms_cfg_dirty) fms_cfg_dirty_ms = millis();
+  fms_cfg_dirty = true;
+}
+
+// sd_task, writes the settings marked by fms_config_save_later once the delay has passed
+void fms_config_service() {
+  if (!fms_cfg_dirty || millis() - fms_cfg_dirty_ms < CONFIG_SAVE_DELAY_MS) return;
+  fms_config_lock();
+  if (fms_cfg_dirty && !fms_config_save()) fms_cfg_dirty_ms = millis();  // try again after the delay
+  fms_config_unlock();
+}
+
+// one settings blob from the open session: 1 good, 0 no such key, -1 there but unreadable
+static int fms_config_read_blob(const char* key, fms_config_t* out) {
+  uint8_t blob[FMS_CONFIG_BLOB_MAX];
+  size_t len = fms_nvs_storage.getBytesLength(key);
+  if (len == 0) return 0;
+  if (len > sizeof(blob) || fms_nvs_storage.getBytes(key, blob, len) != len) return -1;
+  return fms_config_decode(blob, len, out) ? 1 : -1;
 }
 
 void log_chip_info() {
@@ -24,7 +152,10 @@ void log_chip_info() {
 
 bool fms_initialize_uart2(int baudrate) {
   if (fms_uart2_begin(use_serial1, baudrate)) {
-    //fms_uart2_serial.onReceive(fm_rx_irq_interrupt);  // uart interrupt function
+#ifndef USE_LANFENG  // modbus master reads the port itself
+    fms_uart2_serial.setRxTimeout(UART2_RX_TIMEOUT_SYMBOLS);
+    fms_uart2_serial.onReceive(fms_uart2_on_receive, true);  // called once per frame (rx idle)
+#endif
     FMS_LOG_INFO("[FMSUART2] UART2.. DONE");
     return true;
   } else {
@@ -62,6 +193,14 @@ void log_debug_info() {
 #endif
 }
 
+// fmsLog records from here on, this task formats and prints them (src/_fms_log_ring.h)
+static void log_task(void* arg) {
+  fmsLogDeferredBegin(xTaskGetCurrentTaskHandle());
+  while (1) {
+    fmsLogDrain(LOG_DRAIN_MS);
+  }
+}
+
 void fms_pin_mode(int pin, int mode) { // pin out declare
   pinMode(pin, mode);
 }
@@ -86,24 +225,15 @@ void init_status_leds() {
  
 
 void fms_set_protocol_config(DisConfig& cfg) {
-  if (!fms_nvs_storage.begin("fms_config", false)) {
-    FMS_LOG_ERROR("[Protocol Config] Failed to initialize NVS storage");
-    return;
-  }
-
-  // Save configuration to NVS storage
-  bool success = true;
-  success &= fms_nvs_storage.putString("protocol", cfg.pt);
-  success &= fms_nvs_storage.putUChar("devn", cfg.devn);
-  success &= fms_nvs_storage.putUChar("noz", cfg.noz);
-
-  // Save pump IDs
-  char key[12];
-  for (int i = 0; i < 8; i++) {
-    snprintf(key, sizeof(key), "pumpid%d", i + 1);
-    success &= fms_nvs_storage.putUChar(key, cfg.pumpids[i]);
-  }
-  if (success) {
+  fms_config_lock();
+  strncpy(fms_cfg.protocol, cfg.pt.c_str(), sizeof(fms_cfg.protocol) - 1);
+  fms_cfg.protocol[sizeof(fms_cfg.protocol) - 1] = '\0';
+  fms_cfg.devn = cfg.devn;
+  fms_cfg.noz  = cfg.noz;
+  memcpy(fms_cfg.pumpids, cfg.pumpids, sizeof(fms_cfg.pumpids));
+  bool saved = fms_config_save();
+  fms_config_unlock();
+  if (saved) {
     FMS_LOG_INFO("[Protocol Config] %s configuration saved successfully", cfg.pt.c_str());
     Serial.printf(
       "Protocol: %s, Device ID: %d, Nozzle count: %d\n"
@@ -115,42 +245,68 @@ void fms_set_protocol_config(DisConfig& cfg) {
     
     // Update system configuration
     sysCfg.protocol = cfg.pt;
-
-      EEPROM.write(109, cfg.devn);  // device id
-      EEPROM.commit();
-      EEPROM.write(110, cfg.noz);  // nozzle count
-      EEPROM.commit();
-      EEPROM.write(101, cfg.pumpids[0]);  // pump id 1
-      EEPROM.commit();
-      EEPROM.write(102, cfg.pumpids[1]);  // pump id 2
-      EEPROM.commit();
-      EEPROM.write(103, cfg.pumpids[2]);  // pump id 3
-      EEPROM.commit();
-      EEPROM.write(104, cfg.pumpids[3]);  // pump id 4
-      EEPROM.commit();
-      EEPROM.write(105, cfg.pumpids[4]);  // pump id 5
-      EEPROM.commit();
-      EEPROM.write(106, cfg.pumpids[5]);  // pump id 6
-      EEPROM.commit();
-      EEPROM.write(107, cfg.pumpids[6]);  // pump id 7
-      EEPROM.commit();
-      EEPROM.write(108, cfg.pumpids[7]);  // pump id 8
-      EEPROM.commit();
-    FMS_LOG_INFO("[Protocol Config] Configuration values saved to EEPROM");
   } else {
     FMS_LOG_ERROR("[Protocol Config] Failed to save some configuration values");
   }
-  fms_nvs_storage.end();
 }
 
+// per device topics end with the device number (devn)
+void fms_set_device_topics(uint8_t devn) {
+  snprintf(approv_topic, sizeof(approv_topic), "detpos/local_server/%d", devn);
+  snprintf(pplive, sizeof(pplive), "detpos/device/livedata/%d", devn);
+  snprintf(ppfinal, sizeof(ppfinal), "detpos/device/Final/%d", devn);
+  snprintf(pumpreqbuf, sizeof(pumpreqbuf), "%s%d", permitTopic, devn);
+}
+
+// one NVS session at boot: boot count and the settings blob (migrated once from the old keys)
 void fms_load_config() {
+  app_cpu = xPortGetCoreID();
+  fms_cfg_mutex = xSemaphoreCreateMutex();
   if (!fms_nvs_storage.begin("fms_config", false)) {
     FMS_LOG_ERROR("[fms_main_func:205] Failed to initialize NVS storage");
-    return;
+    fms_config_defaults(&fms_cfg);
+  } else {
+    sysCfg.bootcount = fms_nvs_storage.getUInt("bootcount", 0) + 1;
+    fms_nvs_storage.putUInt("bootcount", sysCfg.bootcount);
+
+    uint8_t blob[FMS_CONFIG_BLOB_MAX];
+    size_t len;
+    int a = fms_config_read_blob(CONFIG_BLOB_KEY, &fms_cfg);
+    if (a < 0) {
+      FMS_LOG_ERROR("[CONFIG] settings blob \"%s\" is corrupt", CONFIG_BLOB_KEY);
+    }
+    if (a < 1) {
+      int b = fms_config_read_blob(CONFIG_BLOB_KEY_B, &fms_cfg);
+      if (b > 0) {
+        len = fms_config_encode(fms_cfg, blob, sizeof(blob));  // repair the main blob from the copy
+        fms_nvs_storage.putBytes(CONFIG_BLOB_KEY, blob, len);
+        FMS_LOG_WARNING("[CONFIG] settings restored from \"%s\"", CONFIG_BLOB_KEY_B);
+      } else if (a < 0 || b < 0) {
+        // both copies unreadable: start from the old keys but keep the bad blobs for a look
+        FMS_LOG_ERROR("[CONFIG] no good settings blob, falling back to the old keys");
+        fms_config_migrate();
+      } else {
+        fms_config_migrate();
+        len = fms_config_encode(fms_cfg, blob, sizeof(blob));
+        fms_nvs_storage.putBytes(CONFIG_BLOB_KEY_B, blob, len);
+        fms_nvs_storage.putBytes(CONFIG_BLOB_KEY, blob, len);
+        FMS_LOG_INFO("[CONFIG] settings moved to one blob (%d bytes)", len);
+      }
+    }
+    fms_nvs_storage.end();
   }
-  deviceName = fms_nvs_storage.getString("uuid", "ultm_25505v01_");
+  FMS_LOG_INFO("[fms_main_func.ino:19] CPU %d: Boot count: %lu", app_cpu, sysCfg.bootcount);
+
+  deviceName = fms_cfg.uuid;
   FMS_LOG_INFO("[fms_main_func:209] Device UUID: %s", deviceName.c_str());
-  fms_nvs_storage.end();  // Close NVS storage
+  // dispenser config
+  dcfg.pt      = fms_cfg.protocol;
+  dcfg.devn    = fms_cfg.devn;
+  dcfg.noz     = fms_cfg.noz;
+  dcfg.live_ms = fms_cfg.live_ms ? fms_cfg.live_ms : LIVE_PUBLISH_MIN_MS;
+  dcfg.payload = fms_cfg.payload;
+  memcpy(dcfg.pumpids, fms_cfg.pumpids, sizeof(dcfg.pumpids));
+  fms_set_device_topics(dcfg.devn);
 }
 
 
@@ -1,63 +1,99 @@
-//#define FMS_MQTT_DEBUG
+#undef  FMS_LOG_TAG
+#define FMS_LOG_TAG MQTT    // module of the FMS_LOG_* calls in this file, "log_level mqtt debug" on the cli
 
 //#undef USE_TATSUNO /* change note fix this */
-#ifdef FMS_MQTT_DEBUG
-  #define FMS_MQTT_LOG_DEBUG(format, ...) Serial.print("[fms_mqtt.ino][DEBUG] "); Serial.printf(format, ##__VA_ARGS__); Serial.println()
-  #define FMS_MQTT_LOG_ERROR(format, ...) Serial.print("[fms_mqtt.ino][ERROR] "); Serial.printf(format, ##__VA_ARGS__); Serial.println()
-#else
-  #define FMS_MQTT_LOG_DEBUG(format, ...)
-  #define FMS_MQTT_LOG_ERROR(format, ...)
-#endif
 
 
 char fms_nmf_tp_prefix[64];
 static const unsigned long BLINK_INTERVAL = 500; // 1 second blink interval
 static bool mqtt_connected = false;
 static bool led_state = false;
-static unsigned long previous_millis = 0;
 
+fms_conn_manager mqtt_conn;
+Ticker           mqtt_led_ticker;
+
+// mqtt_led_ticker callback: green led blinks while the broker is not connected
 void fms_mqtt_led_update() {
     if (!mqtt_connected) {
-        unsigned long current_millis = millis();
-        if (current_millis - previous_millis >= BLINK_INTERVAL) {
-            previous_millis = current_millis;
-            led_state = !led_state;
-            gpio_set_level(LED_GREEN, led_state);
-        }
+        led_state = !led_state;
+        gpio_set_level(LED_GREEN, led_state);
     }
 }
 
 void fms_mqtt_set_connected(bool connected) {
     mqtt_connected = connected;
     if (connected) {
-        gpio_set_level(LED_GREEN, 1); // LED off when connected
+        gpio_set_level(LED_GREEN, 0); // LED on when connected
     }
 }
 
+// any task: broker link state as last seen by mqtt_task
+bool fms_mqtt_up() {
+  return mqtt_conn.up();
+}
+
+fms_topic_router fms_mqtt_router;
+char             fms_sub_value_topics[fms_sub_topics_value_count][48];  // fms_sub_topics prefix + fms_sub_topics_value
+
+void fms_mqtt_on_reload(const char* topic, const uint8_t* payload, size_t length, void* ctx) {
+  FMS_LOG_DEBUG("[MQTT] reload request %.*s", (int)length, (const char*)payload);
+}
+
+// topic -> handler table, after fms_load_config (device topics depend on devn)
+void fms_mqtt_routes_begin() {
+  fms_mqtt_router.clear();
+  fms_mqtt_router.add(approv_topic, fms_nozzle_on_approve);
+  fms_mqtt_router.add(preset_topic, fms_nozzle_on_preset);
+  fms_mqtt_router.add(price_change_topic, fms_nozzle_on_price);
+  fms_mqtt_router.add(reload_topic, fms_mqtt_on_reload);
 
+  // short names under the subscribed prefix, eg. detpos/local_server/# + preset
+  size_t prefix_len = strlen(fms_sub_topics[0]);
+  if (prefix_len > 0 && fms_sub_topics[0][prefix_len - 1] == '#') prefix_len--;
+  for (uint8_t i = 0; i < fms_sub_topics_value_count; i++) {
+    snprintf(fms_sub_value_topics[i], sizeof(fms_sub_value_topics[i]), "%.*s%s", (int)prefix_len, fms_sub_topics[0], fms_sub_topics_value[i]);
+    const char* value = fms_sub_topics_value[i];
+    fms_topic_handler_fn handler = strcmp(value, "preset") == 0 ? fms_nozzle_on_preset
+                                 : strcmp(value, "price") == 0  ? fms_nozzle_on_price
+                                 : NULL;
+    if (handler) fms_mqtt_router.add(fms_sub_value_topics[i], handler);
+  }
+  FMS_LOG_DEBUG("[MQTT] %d routes, %d trie nodes", fms_mqtt_router.route_count(), fms_mqtt_router.node_count());
+}
+
+// payload stays in the client buffer, handlers get pointer + length
 void fms_mqtt_callback(char* topic, byte* payload, unsigned int length) {
-  Serial.print("fms_mqtt.ino:13:Message arrived [");
-  Serial.print(topic);
-  Serial.print("] ");
-  String message = "";
-  for (int j = 0; j < length; j++) message += (char)payload[j];
-
-  #if USE_PROTOCOL == TATSUNO
-   /* your main code here */
-  #endif
- #if USE_PROTOCOL == TOUCH
-  /* your main code here */
-  #endif
+  if (!fms_mqtt_router.route(topic, payload, length)) {
+    FMS_LOG_DEBUG("[MQTT] unrouted %s", topic);
+  }
+}
+
+void handle_mqtt_routes_command(const fms_cli_args& args) {
+  if (args.size() > 0 && args[0] == "reset") {
+    fms_mqtt_router.reset_stats();
+  }
+  fms_cli.begin_json_response();
+  char part[96];
+  snprintf(part, sizeof(part), "\"command\":\"mqtt_routes\",\"unrouted\":%lu,\"nodes\":%u,\"routes\":[",
+           fms_mqtt_router.unrouted(), fms_mqtt_router.node_count());
+  fms_cli.add_json_response_part(part);
+  for (uint8_t i = 0; i < fms_mqtt_router.route_count(); i++) {
+    snprintf(part, sizeof(part), "%s{\"topic\":\"%s\",\"hits\":%lu}", i ? "," : "", fms_mqtt_router.pattern(i), fms_mqtt_router.hits(i));
+    fms_cli.add_json_response_part(part);
+  }
+  fms_cli.add_json_response_part("]");
+  fms_cli.end_json_response();
 }
 
 void fms_subsbribe_topics() {
   for (uint8_t i = 0; i < fms_sub_topics_count; i++) {
-    FMS_MQTT_LOG_DEBUG("Subscribing to topic: %s", fms_sub_topics[i]);
+    FMS_LOG_DEBUG("[MQTT] Subscribing to topic: %s", fms_sub_topics[i]);
     fms_mqtt_client.subscribe(fms_sub_topics[i]);
   }
 }
 
-void fms_mqtt_reconnect() {
+// one connect attempt, bounded by MQTT_CONNECT_TIMEOUT_MS (tcp) and MQTT_SOCKET_TIMEOUT_S (connack)
+static bool fms_mqtt_connect_attempt() {
   // for check client connection online or offline
   String willTopicStr = String("device/") + deviceName + "/status";
   const char* willTopic = willTopicStr.c_str();
@@ -65,76 +101,105 @@ void fms_mqtt_reconnect() {
   bool willRetain = true;
   uint8_t willQos = 1;
 
-  if (!fms_mqtt_client.connected()) {
-    gpio_set_level(LED_GREEN, 0);
-    vTaskDelay(pdMS_TO_TICKS(100));
-    gpio_set_level(LED_GREEN, 1);
-    vTaskDelay(pdMS_TO_TICKS(100));
-
-    FMS_MQTT_LOG_DEBUG("MQTT initialized, connecting to %s:%d...", MQTT_SERVER, 1883);
-    String clientId = String(deviceName) + String(random(0xffff), HEX);
-    if (fms_mqtt_client.connect(clientId.c_str(), sysCfg.mqtt_user, sysCfg.mqtt_password, willTopic, willQos, willRetain, willMessage)) {
-      FMS_MQTT_LOG_DEBUG("Connected to MQTT server");
-      fms_mqtt_client.publish(willTopic, "online", true);
-      gpio_set_level(LED_GREEN, 0); // turn on green LED when connected
+  FMS_LOG_DEBUG("[MQTT] MQTT initialized, connecting to %s:%d...", MQTT_SERVER, 1883);
+  String clientId = String(deviceName) + String(random(0xffff), HEX);
+  if (!fms_mqtt_client.connect(clientId.c_str(), sysCfg.mqtt_user, sysCfg.mqtt_password, willTopic, willQos, willRetain, willMessage)) {
+    FMS_LOG_ERROR("[MQTT] Failed to connect to MQTT server , rc = %d next try in %lu ms", fms_mqtt_client.state(), mqtt_conn.backoff());
+    return false;
+  }
+  FMS_LOG_DEBUG("[MQTT] Connected to MQTT server");
+  fms_mqtt_client.publish(willTopic, "online", true);
  #if USE_PROTOCOL == TOUCH
-      fms_mqtt_client.subscribe("detpos/#");
+  fms_mqtt_client.subscribe("detpos/#");
 #else
-      fms_subsbribe_topics();
+  fms_subsbribe_topics();
 #endif
-      /* old feature use below style */
-      // Uncomment the following lines to subscribe to additional topics
-      // fms_mqtt_client.subscribe("detpos/#");
-      // fms_mqtt_client.subscribe("detpos/local_server/#");
-      // fms_mqtt_client.subscribe("detpos/local_server/price");
-      // fms_mqtt_client.subscribe("detpos/local_server/preset");
-      // Add additional topic subscriptions if necessary
-    } else {
-      FMS_MQTT_LOG_ERROR("Failed to connect to MQTT server , rc = %d try again in 5 second", fms_mqtt_client.state());
-      vTaskDelay(pdMS_TO_TICKS(5000));
-    }
+  /* old feature use below style */
+  // Uncomment the following lines to subscribe to additional topics
+  // fms_mqtt_client.subscribe("detpos/#");
+  // fms_mqtt_client.subscribe("detpos/local_server/#");
+  // fms_mqtt_client.subscribe("detpos/local_server/price");
+  // fms_mqtt_client.subscribe("detpos/local_server/preset");
+  // Add additional topic subscriptions if necessary
+  return true;
+}
+
+static void fms_mqtt_on_link(bool up) {
+  fms_mqtt_set_connected(up);
+  #ifdef USE_TOUCH
+  fms_hmi_set_icon(hmi_cloud_icon, up ? HMI_ICON_SHOW : HMI_ICON_HIDE);
+  #endif
+  if (up) {
+    if (hsdCardTask) xTaskNotifyGive(hsdCardTask);  // outbox backlog can drain
+    if (huart2Task) xTaskNotifyGive(huart2Task);    // coalesced live samples can go out
   }
 }
 
-unsigned long previous_Millis   = 0;
-const long interval             = 1000; // Interval for sending messages
-bool ledState_                  = false;
+// wifi events run in the event task, mqtt_task looks at WiFi.status() when woken
+static void fms_mqtt_on_wifi_event(arduino_event_id_t event) {
+  if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP || event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED) {
+    if (hmqttTask) xTaskNotifyGive(hmqttTask);
+  }
+}
+
+void handle_mqtt_stats_command(const fms_cli_args& args) {
+  uint32_t now = millis();
+  if (args.size() > 0 && args[0] == "reset") {
+    mqtt_conn.reset_stats(now);
+  }
+  const fms_conn_stats_t& st = mqtt_conn.stats();
+  uint32_t next = mqtt_conn.wait(now);
+  char part[320];
+  snprintf(part, sizeof(part),
+           "\"command\":\"mqtt_stats\",\"state\":\"%s\",\"attempts\":%lu,\"failures\":%lu,\"connects\":%lu,"
+           "\"drops\":%lu,\"backoff_ms\":%lu,\"next_attempt_ms\":%ld,\"down_for_ms\":%lu,\"last_reconnect_ms\":%lu,"
+           "\"max_reconnect_ms\":%lu,\"down_total_ms\":%lu",
+           fms_conn_manager::state_name(mqtt_conn.state()), st.attempts, st.failures, st.connects, st.drops,
+           mqtt_conn.backoff(), next == UINT32_MAX ? -1L : (long)next, mqtt_conn.down_for(now),
+           st.last_reconnect_ms, st.max_reconnect_ms, mqtt_conn.down_total(now));
+  fms_cli.begin_json_response();
+  fms_cli.add_json_response_part(part);
+  fms_cli.end_json_response();
+}
 
 static void mqtt_task(void* arg) {
     BaseType_t rc;
-    fms_nvs_storage.begin("fms_config", false);
-    String host = fms_nvs_storage.getString("host");
-    String port = fms_nvs_storage.getString("port");
-    if(host.length() == 0 || port.length() == 0) {
+    const char* host = fms_cfg.mqtt_host;
+    uint16_t port = fms_cfg.mqtt_port;
+    if(host[0] == '\0' || port == 0) {
       gpio_set_level(LED_YELLOW, LOW);
       vTaskDelay(pdMS_TO_TICKS(500));
       FMS_LOG_ERROR("[fms_mqtt.ino:79] [DEBUG MQTT] mqtt .. credential .. value is empty");
-      fms_nvs_storage.end();
     }
 
-  fms_nvs_storage.end();
-  FMS_LOG_DEBUG("HOST : %s , PORT : %s", host, port);
-  fms_mqtt_client.setServer(host.c_str(), atoi(port.c_str()));
+  FMS_LOG_DEBUG("HOST : %s , PORT : %d", host, port);
+  fms_mqtt_client.setServer(host, port);
+  fms_mqtt_routes_begin();
   fms_mqtt_client.setCallback(fms_mqtt_callback);
+  fms_mqtt_client.setSocketTimeout(MQTT_SOCKET_TIMEOUT_S);
+  wf_client.setConnectionTimeout(MQTT_CONNECT_TIMEOUT_MS);
+  mqtt_conn.begin(MQTT_BACKOFF_MIN_MS, MQTT_BACKOFF_MAX_MS, esp_random(), millis());
+  WiFi.onEvent(fms_mqtt_on_wifi_event);
+  mqtt_led_ticker.attach_ms(BLINK_INTERVAL, fms_mqtt_led_update);
   while (mqttTask) {
-    unsigned long currentMillis = millis();
-    fms_mqtt_client.loop();
-    if (!fms_mqtt_client.connected()) {
-      #ifdef USE_TOUCH
-      cloud_icon_check = false; // set cloud icon check to false
-      fms_uart2_serial.write(Hide_cloud_icon, 8); // send hide cloud icon command to touch
-      #endif
-      fms_mqtt_reconnect();
-    } else {
-      FMS_MQTT_LOG_DEBUG("Connected to MQTT server");
-      #ifdef USE_TOUCH
-      if(cloud_icon_check) {
-        fms_uart2_serial.write(Show_cloud_icon, 8); // send show cloud icon command to touch
-        fms_uart2_serial.write(Show_cloud_icon, 8); // send show cloud icon command to touch
-        cloud_icon_check = true; // set cloud icon check to true
-      } 
-      #endif
+    uint32_t wait_ms = MQTT_LOOP_MS;
+    bool was_up = mqtt_conn.up();
+    mqtt_conn.set_network(WiFi.status() == WL_CONNECTED, millis());
+    if (mqtt_conn.up() && !fms_mqtt_client.connected()) mqtt_conn.lost(millis());
+    if (was_up && !mqtt_conn.up()) fms_mqtt_on_link(false);
+    if (mqtt_conn.up()) {
+      fms_mqtt_client.loop();
+      fms_mqtt_flush_pub_queue();  // permit / Final from the outbox, other queued messages
+    } else if (mqtt_conn.due(millis(), &wait_ms)) {
+      bool ok = fms_mqtt_connect_attempt();
+      mqtt_conn.attempt_done(ok, millis());
+      if (ok) {
+        fms_mqtt_on_link(true);
+        fms_mqtt_flush_pub_queue();
+      }
+      wait_ms = ok ? 0 : mqtt_conn.wait(millis());
     }
-    vTaskDelay(pdMS_TO_TICKS(100));
+    if (wait_ms > MQTT_LOOP_MS) wait_ms = MQTT_LOOP_MS;  // client.loop keeps the session alive
+    ulTaskNotifyTake(pdTRUE, wait_ms ? pdMS_TO_TICKS(wait_ms) : 0);  // publishes and wifi events wake it early
   }
 }
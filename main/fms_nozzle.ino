@@ -0,0 +1,420 @@
+/*
+  * fms_nozzle.ino
+  * dispense engine glue, the engine is owned by the uart2 task
+  * mqtt callback and other tasks post fms_noz_event_t through noz_event_queue,
+  * permit / Final messages are logged by the SD outbox first (fms_outbox_post, fms_sd.ino),
+  * everything reaches the broker through mqtt_pub_queue (drained by mqtt_task)
+  * live data is coalesced per nozzle by fms_live and published at most every dcfg.live_ms
+  * a permit / Final that does not fit the outbox yet stays pending and is retried every
+  * uart2 pass (fms_nozzle_send_pending), the nozzle only moves on once it is queued;
+  * the last live sample of a sale is retried the same way until mqtt_pub_queue takes it
+*/
+#undef  FMS_LOG_TAG
+#define FMS_LOG_TAG NOZZLE  // module of the FMS_LOG_* calls in this file
+
+#define NOZ_EVENT_QUEUE_LEN   16
+#define MQTT_PUB_QUEUE_LEN    16
+
+fms_nozzle_engine  fms_nozzles;
+fms_live_publisher fms_live;
+fms_payload_format_t fms_payload_fmt = PAYLOAD_TEXT;  // permit / live / Final encoding, dcfg.payload
+fms_latency        fms_lat;                            // sale stage latency histograms
+QueueHandle_t     noz_event_queue   = NULL;
+QueueHandle_t     mqtt_pub_queue    = NULL;
+uint32_t          noz_event_drops   = 0;
+uint32_t          mqtt_pub_drops    = 0;
+static uint8_t    noz_permit_pending = 0;  // bit per nozzle, lifted and permit not queued yet
+static uint8_t    noz_final_pending  = 0;  // bit per nozzle, final and Final not queued yet
+static uint8_t    noz_live_last      = 0;  // bit per nozzle, last live sample of the sale not queued yet
+
+// topic and flags of a queue slot, the payload is encoded in place by the caller
+void fms_pub_msg_init(fms_pub_msg_t* m, const char* topic, bool retain) {
+  strncpy(m->topic, topic, sizeof(m->topic) - 1);
+  m->topic[sizeof(m->topic) - 1] = '\0';
+  m->len = 0;
+  m->retain = retain;
+  m->outbox_end = 0;
+}
+
+// queue a message for mqtt_task, never blocks the caller
+bool fms_mqtt_publish_msg(const fms_pub_msg_t* m) {
+  if (!mqtt_pub_queue) return false;
+  if (xQueueSend(mqtt_pub_queue, m, 0) != pdTRUE) {
+    mqtt_pub_drops++;
+    return false;
+  }
+  if (hmqttTask) xTaskNotifyGive(hmqttTask);
+  return true;
+}
+
+bool fms_mqtt_publish_queued(const char* topic, const char* msg, bool retain) {
+  fms_pub_msg_t m;
+  fms_pub_msg_init(&m, topic, retain);
+  m.len = strnlen(msg, sizeof(m.payload));
+  memcpy(m.payload, msg, m.len);
+  return fms_mqtt_publish_msg(&m);
+}
+
+// a permit / Final reached the broker: stamp its sale (pump id from the payload, any format)
+static void fms_nozzle_on_published(const fms_pub_msg_t* m) {
+  bool permit = strcmp(m->topic, pumpreqbuf) == 0;
+  if (!permit && strcmp(m->topic, ppfinal) != 0) return;
+  fms_payload_t p;
+  if (!fms_payload_decode(m->payload, m->len, &p)) return;
+  int noz = fms_nozzle_index(p.pump);
+  if (noz >= 0) fms_lat.mark(noz, permit ? LAT_PERMIT_PUB : LAT_FINAL_PUB, millis());
+}
+
+// called from mqtt_task only
+void fms_mqtt_flush_pub_queue() {
+  fms_pub_msg_t m;
+  uint32_t outbox_end = 0;
+  while (fms_mqtt_client.connected() && xQueuePeek(mqtt_pub_queue, &m, 0) == pdTRUE) {
+    if (!fms_mqtt_client.publish(m.topic, m.payload, m.len, m.retain)) {
+      break;  // keep it for the next round
+    }
+    xQueueReceive(mqtt_pub_queue, &m, 0);
+    fms_nozzle_on_published(&m);
+    if (m.outbox_end) outbox_end = m.outbox_end;
+  }
+  if (outbox_end) fms_outbox_on_published(outbox_end);
+}
+
+// safe from any task
+bool fms_nozzle_post(uint8_t type, uint8_t noz, uint32_t a, uint32_t b) {
+  if (!noz_event_queue) return false;
+  fms_noz_event_t ev = { type, noz, a, b };
+  if (xQueueSend(noz_event_queue, &ev, 0) != pdTRUE) {
+    noz_event_drops++;
+    return false;
+  }
+  if (huart2Task) xTaskNotifyGive(huart2Task);  // wake the owner before its next poll deadline
+  return true;
+}
+
+// pump id (as used in mqtt payloads) to engine index, -1 if unknown
+int fms_nozzle_index(uint8_t pumpId) {
+  for (uint8_t i = 0; i < fms_nozzles.count(); i++) {
+    if (fms_nozzles.pump_id(i) == pumpId) return i;
+  }
+  return -1;
+}
+
+static void fms_nozzle_release_pump(uint8_t noz) {
+#ifdef USE_LANFENG
+  fms_lanfeng_approve(fms_nozzles.pump_id(noz));
+#endif
+}
+
+// permit / live / Final of a nozzle in the configured format (_fms_payload.h), eg. text
+//   permit 01permit
+//   live   01L10.000P30000                  (<pump>L<liters>P<amount>)
+//   Final  01S3000L10.000P30000T12345.678   (<pump>S<price>L<liters>P<amount>T<totalizer liters>)
+size_t fms_nozzle_payload(uint8_t noz, uint8_t kind, uint8_t* out, size_t cap) {
+  fms_payload_t p = {};
+  p.kind = kind;
+  p.pump = fms_nozzles.pump_id(noz);
+  if (kind == PAYLOAD_LIVE) {
+    p.volume = fms_volume_t::from_raw(fms_live.volume(noz));
+    p.amount = fms_money_t::from_raw(fms_live.amount(noz));
+  } else if (kind == PAYLOAD_FINAL) {
+    p.price  = fms_nozzles.price(noz);
+    p.volume = fms_nozzles.sale_volume(noz);
+    p.amount = fms_nozzles.sale_amount(noz);
+    p.total  = fms_nozzles.total_volume(noz);
+  }
+  size_t n = fms_payload_encode(fms_payload_fmt, p, out, cap);
+  if (n == 0 && fms_payload_fmt != PAYLOAD_TEXT) n = fms_payload_encode(PAYLOAD_TEXT, p, out, cap);  // out of binary range
+  return n;
+}
+
+// encoded straight into the queue slot
+static bool fms_live_publish(uint8_t noz, bool forced) {
+  fms_pub_msg_t m;
+  fms_pub_msg_init(&m, pplive, false);
+  m.len = fms_nozzle_payload(noz, PAYLOAD_LIVE, m.payload, sizeof(m.payload));
+  if (!fms_mqtt_publish_msg(&m)) return false;  // stays pending, retried next tick
+  fms_live.sent(noz, millis(), forced);
+  return true;
+}
+
+// publish the live samples that are due, call from the owner (uart2) task,
+// returns ms until the next one is due; while the broker is down samples keep
+// coalescing and the latest goes out on reconnect (mqtt_task wakes this task)
+uint32_t fms_live_tick() {
+  uint32_t wait_ms;
+  int8_t noz;
+  if (!fms_mqtt_up()) return UINT32_MAX;
+  while ((noz = fms_live.next(millis(), &wait_ms)) >= 0) {
+    if (!fms_live_publish(noz, false)) return LIVE_RETRY_MS;  // mqtt_pub_queue full
+  }
+  return wait_ms;
+}
+
+// closed sale into the SD ledger (no-op without a card)
+static void fms_nozzle_keep_sale(uint8_t noz) {
+  fms_ledger_rec_t r = {};
+  r.ts     = fms_ledger_now();
+  r.pump   = fms_nozzles.pump_id(noz);
+  r.price  = fms_nozzles.price(noz);
+  r.volume = fms_nozzles.sale_volume(noz);
+  r.amount = fms_nozzles.sale_amount(noz);
+  r.total  = fms_nozzles.total_volume(noz);
+  fms_ledger_post(&r);
+}
+
+static void fms_nozzle_on_transition(uint8_t noz, fms_noz_state_t from, fms_noz_state_t to, void* ctx) {
+  uint8_t pid = fms_nozzles.pump_id(noz);
+  FMS_LOG_DEBUG("[NOZZLE] %d: %s -> %s", pid, fms_nozzle_engine::state_name(from), fms_nozzle_engine::state_name(to));
+
+  switch (to) {
+    case NOZ_LIFTED:
+      fms_lat.mark(noz, LAT_LIFT, millis());
+      noz_permit_pending |= (1U << noz);  // sent by fms_nozzle_send_pending once this dispatch returns
+      break;
+    case NOZ_APPROVED:
+      fms_nozzle_release_pump(noz);
+      fms_lat.mark(noz, LAT_PUMP_APPROVED, millis());
+      break;
+    case NOZ_FUELLING:
+      fms_lat.mark(noz, LAT_FIRST_LIVE, millis());
+      break;
+    case NOZ_IDLE:
+      noz_permit_pending &= ~(1U << noz);  // hung up before the permit was queued
+      fms_live.forget(noz);  // next sale starts from a fresh sample
+      break;
+    case NOZ_FINAL:
+      fms_lat.mark(noz, LAT_SALE_END, millis());
+      // the last live sample is queued ahead of the Final whatever the interval, and kept until it is
+      fms_live.update(noz, (uint32_t)fms_nozzles.live_volume(noz).raw, (uint32_t)fms_nozzles.live_amount(noz).raw);
+      if (fms_live.pending(noz)) noz_live_last |= (1U << noz);
+      fms_nozzle_keep_sale(noz);
+      noz_final_pending |= (1U << noz);  // sale values stay put until FINAL_SENT
+      break;
+    default:
+      break;
+  }
+}
+
+bool fms_nozzle_begin() {
+  noz_event_queue = xQueueCreate(NOZ_EVENT_QUEUE_LEN, sizeof(fms_noz_event_t));
+  mqtt_pub_queue  = xQueueCreate(MQTT_PUB_QUEUE_LEN, sizeof(fms_pub_msg_t));
+  if (!noz_event_queue || !mqtt_pub_queue) {
+    FMS_LOG_ERROR("[NOZZLE] queue create failed");
+    return false;
+  }
+  uint8_t count = (dcfg.noz > 0 && dcfg.noz <= FMS_MAX_NOZZLES) ? dcfg.noz : 1;
+  if (!fms_nozzles.begin(count, dcfg.pumpids, fms_nozzle_on_transition)) {
+    FMS_LOG_ERROR("[NOZZLE] engine init failed");
+    return false;
+  }
+  for (uint8_t i = 0; i < count; i++) {  // last known prices until the server / dispenser sends new ones
+    if (fms_cfg.prices[i]) fms_nozzles.dispatch({ NOZ_EV_PRICE, i, fms_cfg.prices[i], 0 });
+  }
+  if (dcfg.live_ms == 0) dcfg.live_ms = LIVE_PUBLISH_MIN_MS;
+  fms_payload_fmt = dcfg.payload < PAYLOAD_FORMAT_COUNT ? (fms_payload_format_t)dcfg.payload : PAYLOAD_TEXT;
+  fms_live.begin(count, dcfg.live_ms);
+  fms_lat.begin(count);
+  FMS_LOG_INFO("[NOZZLE] %d nozzle(s), %d bytes per nozzle, live every %d ms, %s payloads", count,
+               fms_nozzle_engine::bytes_per_nozzle(), dcfg.live_ms, fms_payload_format_name(fms_payload_fmt));
+  return true;
+}
+
+// every engine event goes through here (uart2 task), accepted live samples feed fms_live
+bool fms_nozzle_dispatch(const fms_noz_event_t& ev) {
+  if (!fms_nozzles.dispatch(ev)) return false;
+  if (ev.type == NOZ_EV_LIVE) fms_live.update(ev.noz, ev.a, ev.b);
+  return true;
+}
+
+// queue the pending permit / last live / Final messages, call from the owner (uart2) task outside
+// dispatch, returns ms until the next try (UINT32_MAX with nothing left over); a Final waits until
+// the last live sample of its sale is queued, so the backend never sees live data after the Final
+uint32_t fms_nozzle_send_pending() {
+  fms_pub_msg_t m;
+  for (uint8_t noz = 0; noz < fms_nozzles.count(); noz++) {
+    uint8_t bit = 1U << noz;
+    if ((noz_live_last & bit) && (!fms_live.pending(noz) || fms_live_publish(noz, true))) {
+      noz_live_last &= ~bit;
+    }
+    if (noz_permit_pending & bit) {
+      fms_pub_msg_init(&m, pumpreqbuf, false);
+      m.len = fms_nozzle_payload(noz, PAYLOAD_PERMIT, m.payload, sizeof(m.payload));
+      if (!fms_outbox_post(&m)) continue;  // outbox full, next pass
+      noz_permit_pending &= ~bit;
+      fms_nozzle_dispatch({ NOZ_EV_PERMIT_SENT, noz, 0, 0 });
+    }
+    if ((noz_final_pending & bit) && !(noz_live_last & bit)) {  // mqtt_pub_queue full, sample first
+      fms_pub_msg_init(&m, ppfinal, false);
+      m.len = fms_nozzle_payload(noz, PAYLOAD_FINAL, m.payload, sizeof(m.payload));
+      if (!fms_outbox_post(&m)) continue;
+      noz_final_pending &= ~bit;
+      fms_nozzle_dispatch({ NOZ_EV_FINAL_SENT, noz, 0, 0 });
+    }
+  }
+  return (noz_permit_pending | noz_final_pending | noz_live_last) ? NOZ_SEND_RETRY_MS : UINT32_MAX;
+}
+
+// drain posted events, call from the owner (uart2) task
+void fms_nozzle_process_events() {
+  fms_noz_event_t ev;
+  while (xQueueReceive(noz_event_queue, &ev, 0) == pdTRUE) {
+    fms_nozzle_dispatch(ev);
+  }
+  fms_nozzle_send_pending();  // permit / Final of the transitions just made
+}
+
+// mqtt payloads start with the two digit pump id, eg. 01appro , 01L10.5 (liters) , 01P5000 (amount) , 013000 (price)
+// returns the engine index and leaves text / kind past the id, -1 if the pump is not ours
+static int fms_nozzle_parse_payload(const uint8_t* payload, size_t length, const char** text, size_t* text_len, uint8_t* kind) {
+  if (length < 2 || !isdigit(payload[0]) || !isdigit(payload[1])) return -1;
+  int noz = fms_nozzle_index((payload[0] - '0') * 10 + (payload[1] - '0'));
+  if (noz < 0) return -1;
+  *text = (const char*)payload + 2;
+  *text_len = length - 2;
+  *kind = (*text_len > 0 && isalpha((*text)[0])) ? (*text)[0] : 0;
+  if (*kind) {
+    (*text)++;
+    (*text_len)--;
+  }
+  return noz;
+}
+
+// topic router handlers (fms_mqtt_routes_begin), run in mqtt_task
+void fms_nozzle_on_approve(const char* topic, const uint8_t* payload, size_t length, void* ctx) {
+  const char* text;
+  size_t text_len;
+  uint8_t kind;
+  int noz = fms_nozzle_parse_payload(payload, length, &text, &text_len, &kind);
+  if (noz < 0) return;
+  fms_lat.mark(noz, LAT_APPROVAL_RX, millis());
+  fms_nozzle_post(NOZ_EV_APPROVED, noz, 0, 0);
+}
+
+void fms_nozzle_on_preset(const char* topic, const uint8_t* payload, size_t length, void* ctx) {
+  const char* text;
+  size_t text_len;
+  uint8_t kind;
+  int noz = fms_nozzle_parse_payload(payload, length, &text, &text_len, &kind);
+  if (noz < 0) return;
+  if (kind == 'L') {
+    fms_volume_t v;
+    if (fms_volume_t::parse(text, text_len, &v) && v.raw > 0 && v.raw <= 0xFFFFFFFFLL) {
+      fms_nozzle_post(NOZ_EV_PRESET, noz, (uint32_t)v.raw, 'L');
+    }
+  } else {
+    fms_money_t m;
+    if (fms_money_t::parse(text, text_len, &m) && m.raw > 0 && m.raw <= 0xFFFFFFFFLL) {
+      fms_nozzle_post(NOZ_EV_PRESET, noz, (uint32_t)m.raw, 'P');
+    }
+  }
+}
+
+void fms_nozzle_on_price(const char* topic, const uint8_t* payload, size_t length, void* ctx) {
+  const char* text;
+  size_t text_len;
+  uint8_t kind;
+  int noz = fms_nozzle_parse_payload(payload, length, &text, &text_len, &kind);
+  if (noz < 0) return;
+  fms_unit_price_t p;
+  if (fms_unit_price_t::parse(text, text_len, &p) && p.raw > 0 && p.raw <= 0xFFFFFFFFLL) {
+    fms_nozzle_post(NOZ_EV_PRICE, noz, (uint32_t)p.raw, 0);
+    fms_config_lock();  // cli_task may be saving settings too
+    if (fms_cfg.prices[noz] != (uint32_t)p.raw) {  // the engine starts from it after a restart
+      fms_cfg.prices[noz] = (uint32_t)p.raw;
+      fms_config_save_later();  // sd_task writes NVS, a burst of prices is one save
+    }
+    fms_config_unlock();
+  }
+}
+
+// live_stats [reset] , published / suppressed live samples per nozzle
+void handle_live_stats_command(const fms_cli_args& args) {
+  if (args.size() > 0 && args[0] == "reset") {
+    fms_live.reset_stats();
+  }
+  const fms_live_stats_t& st = fms_live.stats();
+  char part[192];
+  snprintf(part, sizeof(part),
+           "\"command\":\"live_stats\",\"interval_ms\":%lu,\"samples\":%lu,\"published\":%lu,\"forced\":%lu,"
+           "\"unchanged\":%lu,\"coalesced\":%lu,\"nozzles\":[",
+           fms_live.interval(), st.samples, st.published, st.forced, st.unchanged, st.coalesced);
+  fms_cli.begin_json_response();
+  fms_cli.add_json_response_part(part);
+  for (uint8_t i = 0; i < fms_nozzles.count(); i++) {
+    snprintf(part, sizeof(part), "%s{\"pump\":%d,\"published\":%lu,\"suppressed\":%lu}",
+             i ? "," : "", fms_nozzles.pump_id(i), fms_live.published(i), fms_live.suppressed(i));
+    fms_cli.add_json_response_part(part);
+  }
+  fms_cli.add_json_response_part("]");
+  fms_cli.end_json_response();
+}
+
+// live_rate <ms> , minimum time between two live publishes of one nozzle, kept in the settings blob
+void handle_live_rate_command(const fms_cli_args& args) {
+  long ms = args[0].toInt();
+  if (ms < LIVE_PUBLISH_MIN_MS_FLOOR || ms > 60000) {
+    fms_cli.respond("live_rate", "Usage: live_rate <" + String(LIVE_PUBLISH_MIN_MS_FLOOR) + "..60000 ms>", false);
+    return;
+  }
+  dcfg.live_ms = (uint16_t)ms;
+  fms_live.set_interval(dcfg.live_ms);
+  fms_config_lock();
+  fms_cfg.live_ms = dcfg.live_ms;
+  fms_config_save();
+  fms_config_unlock();
+  fms_cli.respond("live_rate", "Live data every " + String(dcfg.live_ms) + " ms per nozzle");
+}
+
+// payload_format <text|binary> , encoding of permit / live / Final, kept in the settings blob
+void handle_payload_format_command(const fms_cli_args& args) {
+  fms_payload_format_t fmt;
+  if (!fms_payload_format_parse(args[0].c_str(), &fmt)) {
+    fms_cli.respond("payload_format", "Usage: payload_format <text|binary>", false);
+    return;
+  }
+  dcfg.payload = fmt;
+  fms_payload_fmt = fmt;  // next message already uses it
+  fms_config_lock();
+  fms_cfg.payload = dcfg.payload;
+  fms_config_save();
+  fms_config_unlock();
+  fms_cli.respond("payload_format", String("Payload format set to ") + fms_payload_format_name(fmt));
+}
+
+// per nozzle latency spans, emit gets the json in parts (cli response or /api/info)
+void fms_latency_write_json(void (*emit)(const char* part, void* ctx), void* ctx, bool buckets) {
+  char part[192];
+  size_t n = 0;
+  n += snprintf(part + n, sizeof(part) - n, "{\"bounds_ms\":[");
+  for (uint8_t b = 0; b + 1 < FMS_LAT_BUCKETS; b++) {
+    n += snprintf(part + n, sizeof(part) - n, "%s%lu", b ? "," : "", (unsigned long)fms_latency::bound(b));
+  }
+  snprintf(part + n, sizeof(part) - n, "],\"nozzles\":[");
+  emit(part, ctx);
+  for (uint8_t i = 0; i < fms_lat.count(); i++) {
+    snprintf(part, sizeof(part), "%s{\"pump\":%d", i ? "," : "", fms_nozzles.pump_id(i));
+    emit(part, ctx);
+    for (uint8_t s = 0; s < LAT_SPAN_COUNT; s++) {
+      n = snprintf(part, sizeof(part), ",\"%s\":", fms_latency::span_name((fms_lat_span_t)s));
+      if (fms_lat.span_json(i, (fms_lat_span_t)s, buckets, part + n, sizeof(part) - n)) emit(part, ctx);
+    }
+    emit("}", ctx);
+  }
+  emit("]}", ctx);
+}
+
+static void fms_latency_emit_cli(const char* part, void* ctx) {
+  fms_cli.add_json_response_part(part);
+}
+
+// latency [reset] , permit -> approval -> pump start -> Final spans per nozzle
+void handle_latency_command(const fms_cli_args& args) {
+  if (args.size() > 0 && args[0] == "reset") {
+    fms_lat.reset();
+  }
+  fms_cli.begin_json_response();
+  fms_cli.add_json_response_part("\"command\":\"latency\",\"latency\":");
+  fms_latency_write_json(fms_latency_emit_cli, NULL, true);
+  fms_cli.end_json_response();
+}
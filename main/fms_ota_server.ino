@@ -11,6 +11,8 @@ ota server
     description : lite_version ota 
     v 0.1 ota server
 */
+#undef  FMS_LOG_TAG
+#define FMS_LOG_TAG WEB     // module of the FMS_LOG_* calls in this file
 
 /* version 2 ota */
 #define USE_V1_OTA_SERVER
@@ -21,6 +23,10 @@ ota server
 #define HTTP_UPLOAD_BUFLEN 4096         // Increased from default 1460
 #define WDT_TIMEOUT_S 30
 
+static void fms_info_emit_string(const char* part, void* ctx) {
+  *(String*)ctx += part;
+}
+
 void fms_info_response() {            // mini version show in ota page
   JsonBuilder json;
   json.addString("deviceName",        deviceName);
@@ -36,6 +42,9 @@ void fms_info_response() {            // mini version show in ota page
   json.addString("status",            updateStatus);
   json.addInt("progress",             otaProgress);
   json.addBool("otaInProgress",       otaInProgress);
+  String latency;
+  fms_latency_write_json(fms_info_emit_string, &latency, false);
+  json.addRaw("latency",             latency);      // per nozzle sale spans, buckets on the cli "latency"
  
   //json.addLong("flashChipSize", ESP.getFlashChipSize());
   cachedInfoResponse = json.toString();
@@ -77,6 +86,88 @@ void handleLogout() {
   server.send(200, "text/plain", "Logged out successfully!");
 }
 
+// GET /api/ledger?id=N | ?day=today|yesterday|YYYY-MM-DD | ?from_id=&to_id= | ?from=&to= (utc s), [&pump=P]
+// streamed in chunks, records are read a few at a time while the response goes out
+void handleLedger() {
+  if (!isAuthenticated) {
+    server.send(401, "text/plain", "Login required");
+    return;
+  }
+  if (!fms_ledger_ready()) {
+    server.send(503, "text/plain", "Ledger not running (no SD card)");
+    return;
+  }
+  fms_ledger_query_t q;
+  memset(&q, 0, sizeof(q));
+  if (server.hasArg("id")) {
+    q.from_id = q.to_id = server.arg("id").toInt();
+  }
+  if (server.hasArg("from_id")) q.from_id = server.arg("from_id").toInt();
+  if (server.hasArg("to_id"))   q.to_id   = server.arg("to_id").toInt();
+  if (server.hasArg("from"))    q.from_ts = server.arg("from").toInt();
+  if (server.hasArg("to"))      q.to_ts   = server.arg("to").toInt();
+  if (server.hasArg("pump"))    q.pump    = server.arg("pump").toInt();
+  if (server.hasArg("day") && !fms_ledger_day_range(server.arg("day").c_str(), &q.from_ts, &q.to_ts)) {
+    server.send(400, "text/plain", "Bad day (today, yesterday or YYYY-MM-DD, clock must be synced for the first two)");
+    return;
+  }
+
+  server.sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "application/json", "");
+
+  char chunk[1024];
+  size_t len = snprintf(chunk, sizeof(chunk), "{\"records\":[");
+  fms_ledger_rec_t recs[4];
+  uint32_t count = 0;
+  fms_ledger_query_begin(&q);
+  while (!q.done) {
+    size_t n = fms_ledger_query_next(&q, recs, 4);
+    for (size_t i = 0; i < n; i++) {
+      if (sizeof(chunk) - len < 192) {
+        server.sendContent(chunk, len);
+        len = 0;
+      }
+      if (count++) chunk[len++] = ',';
+      len += fms_ledger_rec_json(&recs[i], chunk + len, sizeof(chunk) - len);
+    }
+  }
+  len += snprintf(chunk + len, sizeof(chunk) - len, "],\"count\":%lu}", count);
+  server.sendContent(chunk, len);
+  server.sendContent("");  // last chunk
+}
+
+// GET /api/console?from=<offset>[&wait=<ms>]: serial output after byte offset `from`
+// (0 = all still held). With nothing new it waits up to `wait` ms (long poll). The reply
+// is the raw text, X-Console-Next is the offset to ask for next, X-Console-Lost the bytes
+// overwritten before they were read
+void handleConsole() {
+  if (!isAuthenticated) {
+    server.send(401, "text/plain", "Login required");
+    return;
+  }
+  uint64_t from = server.hasArg("from") ? strtoull(server.arg("from").c_str(), NULL, 10) : 0;
+  uint32_t wait = server.hasArg("wait") ? server.arg("wait").toInt() : 0;
+  if (wait > CONSOLE_WAIT_MAX_MS) wait = CONSOLE_WAIT_MAX_MS;
+  for (uint32_t waited = 0; waited < wait && fms_capture_head() == from; waited += CONSOLE_POLL_MS) {
+    vTaskDelay(pdMS_TO_TICKS(CONSOLE_POLL_MS));
+  }
+
+  static char chunk[CONSOLE_CHUNK];  // web server task only
+  uint64_t next, lost;
+  size_t len = fms_capture_read(from, chunk, sizeof(chunk), &next, &lost);
+  char num[24];
+  snprintf(num, sizeof(num), "%llu", (unsigned long long)next);
+  server.sendHeader("X-Console-Next", num);
+  snprintf(num, sizeof(num), "%llu", (unsigned long long)lost);
+  server.sendHeader("X-Console-Lost", num);
+  server.sendHeader("Access-Control-Expose-Headers", "X-Console-Next, X-Console-Lost");
+  server.sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");
+  server.setContentLength(len);
+  server.send(200, "text/plain", "");
+  if (len) server.sendContent(chunk, len);
+}
+
 void fms_set_ota_server() {
   FMS_LOG_INFO("[fms_ota_server.ino:75] ota server created");
   server.enableCORS(true);
@@ -97,6 +188,8 @@ void fms_set_ota_server() {
     server.sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");
     server.send(200, "application/json", cachedInfoResponse);
   });
+  server.on("/api/ledger", HTTP_GET, handleLedger);
+  server.on("/api/console", HTTP_GET, handleConsole);
   server.on("/logout", handleLogout);  // logout ota server
   server.on(
     "/api/update", HTTP_POST, []() {
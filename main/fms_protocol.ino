@@ -0,0 +1,130 @@
+/*
+  * fms_protocol.ino
+  * dispenser protocol on uart2, driver chosen at boot from NVS "protocol" (dcfg.pt)
+  * frames come from uart2_rx_ring (fms_uart2_drain_rx), the driver is fed in place
+  * and its events go straight to the dispense engine, both run in the uart2 task
+*/
+#undef  FMS_LOG_TAG
+#define FMS_LOG_TAG PROTO   // module of the FMS_LOG_* calls in this file
+
+#ifndef USE_LANFENG
+
+const fms_protocol_ops_t* fms_protocol      = NULL;
+uint8_t                   proto_ack_seq     = 0;
+uint8_t                   proto_poll_next   = 0;   // engine index of the next pump to poll
+uint32_t                  proto_poll_ms     = 0;
+bool                      proto_waiting     = false; // poll sent, reply not seen yet
+
+static void proto_dispatch(uint8_t type, uint8_t noz, uint32_t a, uint32_t b) {
+  fms_noz_event_t ev = { type, noz, a, b };
+  fms_nozzle_dispatch(ev);
+}
+
+// driver events -> engine events, same mapping for every brand
+static void proto_on_event(const fms_proto_event_t& ev, void* ctx) {
+  if (ev.type == PROTO_EV_NAK) {
+    proto_waiting = false;
+    FMS_LOG_WARNING("[PROTOCOL] nak");
+    return;
+  }
+  if (ev.type != PROTO_EV_POLL && ev.type != PROTO_EV_SELECT) proto_waiting = false;  // dispenser answered
+  if (ev.type < PROTO_EV_NOZZLE_UP) return;  // link level, nothing for the engine
+
+  // every data frame from the dispenser is acked, sequence bit alternates
+  uint8_t ack[FMS_PROTO_MAX_FRAME];
+  size_t n = fms_protocol->ack_frame(proto_ack_seq, ack);
+  if (n) {
+    fms_uart2_serial.write(ack, n);
+    proto_ack_seq ^= 1;
+  }
+
+  int noz = fms_nozzle_index(ev.pump);
+  if (noz < 0) {
+    if (ev.type == PROTO_EV_TEXT) FMS_LOG_DEBUG("[PROTOCOL] %d bytes unmapped", ev.text_len);
+    return;
+  }
+  switch (ev.type) {
+    case PROTO_EV_NOZZLE_UP:
+      proto_dispatch(NOZ_EV_HANDLE_UP, noz, 0, 0);
+      break;
+    case PROTO_EV_NOZZLE_DOWN:
+      proto_dispatch(NOZ_EV_HANDLE_DOWN, noz, 0, 0);
+      break;
+    case PROTO_EV_LIVE:
+      proto_dispatch(NOZ_EV_LIVE, noz, (uint32_t)ev.volume.raw, (uint32_t)ev.amount.raw);
+      break;
+    case PROTO_EV_FINAL:
+      proto_dispatch(NOZ_EV_PRICE, noz, (uint32_t)ev.price.raw, 0);
+      proto_dispatch(NOZ_EV_LIVE, noz, (uint32_t)ev.volume.raw, (uint32_t)ev.amount.raw);
+      proto_dispatch(NOZ_EV_TOTALIZER, noz, (uint32_t)ev.total.raw, (uint32_t)fms_nozzles.total_amount(noz).raw);
+      proto_dispatch(NOZ_EV_PUMP_STOPPED, noz, 0, 0);
+      break;
+    default:
+      FMS_LOG_DEBUG("[PROTOCOL] pump %d text %.*s", ev.pump, ev.text_len, (const char*)ev.text);
+      break;
+  }
+}
+
+// pick the driver named in dcfg.pt, unknown names fall back to FMS_DEFAULT_PROTOCOL
+bool fms_protocol_begin() {
+  fms_protocol = fms_protocol_find(dcfg.pt.c_str());
+  if (fms_protocol == NULL) {
+    FMS_LOG_WARNING("[PROTOCOL] unknown protocol '%s', using %s", dcfg.pt.c_str(), FMS_DEFAULT_PROTOCOL);
+    fms_protocol = fms_protocol_find(FMS_DEFAULT_PROTOCOL);
+  }
+  if (fms_protocol == NULL) return false;
+  fms_protocol->begin(proto_on_event, NULL);
+  FMS_LOG_INFO("[PROTOCOL] %s driver", fms_protocol->name);
+  return true;
+}
+
+// one frame from the rx ring, may hold several or only part of a protocol frame
+void fms_protocol_feed(const uint8_t* data, size_t len) {
+  if (fms_protocol == NULL) return;
+  fms_protocol->feed(data, len);
+  fms_protocol->idle();  // rx timeout ended the burst
+}
+
+// poll the configured pumps round robin, returns ms until the next poll
+uint32_t fms_protocol_poll() {
+  uint32_t now = millis();
+  uint32_t elapsed = now - proto_poll_ms;
+  if (fms_protocol == NULL || fms_nozzles.count() == 0) return PROTOCOL_POLL_MS;
+  if (elapsed < PROTOCOL_POLL_MS) return PROTOCOL_POLL_MS - elapsed;
+  uint8_t frame[FMS_PROTO_MAX_FRAME];
+  size_t n = fms_protocol->poll_frame(fms_nozzles.pump_id(proto_poll_next), frame);
+  if (n) {
+    fms_uart2_serial.write(frame, n);
+    proto_waiting = true;
+  }
+  proto_poll_next = (proto_poll_next + 1) % fms_nozzles.count();
+  proto_poll_ms = now;
+  return PROTOCOL_POLL_MS;
+}
+
+// a poll is out and its reply is still due, other writes on uart2 must wait
+bool fms_protocol_busy() {
+  if (proto_waiting && millis() - proto_poll_ms >= PROTOCOL_REPLY_TIMEOUT_MS) proto_waiting = false;
+  return proto_waiting;
+}
+
+void handle_protocol_stats_command(const fms_cli_args& args) {
+  if (fms_protocol == NULL) {
+    fms_cli.respond("protocol_stats", "No protocol driver running", false);
+    return;
+  }
+  if (args.size() > 0 && args[0] == "reset") {
+    fms_protocol->reset_stats();
+  }
+  const fms_proto_stats_t& st = fms_protocol->stats();
+  char part[224];
+  snprintf(part, sizeof(part),
+           "\"command\":\"protocol_stats\",\"protocol\":\"%s\",\"bytes\":%lu,\"frames\":%lu,\"events\":%lu,"
+           "\"check_errors\":%lu,\"overflows\":%lu,\"resyncs\":%lu",
+           fms_protocol->name, st.bytes, st.frames, st.events, st.check_errors, st.overflows, st.resyncs);
+  fms_cli.begin_json_response();
+  fms_cli.add_json_response_part(part);
+  fms_cli.end_json_response();
+}
+
+#endif
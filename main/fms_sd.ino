@@ -3,6 +3,8 @@
   *  Created on: 2020. 12. 10.
   *  author : thet htar khaing
 */
+#undef  FMS_LOG_TAG
+#define FMS_LOG_TAG SD      // module of the FMS_LOG_* calls in this file
 
 /* upgrade in version 2 */
 /* not included in version 1 */
@@ -39,16 +41,12 @@ void fms_sd_dir(fs::FS& fs, const char* dirname, uint8_t levels) {
   File file = root.openNextFile();
   while (file) {
     if (file.isDirectory()) {
-      FMS_LOG_INFO("  DIR : ");
-      FMS_LOG_INFO(String(file.name()).c_str());
+      FMS_LOG_INFO("  DIR : %s", file.name());
       if (levels) {
         fms_sd_dir(fs, file.name(), levels - 1);
       }
     } else {
-      FMS_LOG_INFO("  FILE: ");
-      FMS_LOG_INFO(String(file.name()).c_str());
-      FMS_LOG_INFO("  SIZE: ");
-      FMS_LOG_INFO(String(file.size()).c_str());
+      FMS_LOG_INFO("  FILE: %s  SIZE: %lu", file.name(), (unsigned long)file.size());
     }
     file = root.openNextFile();
   }
@@ -56,25 +54,576 @@ void fms_sd_dir(fs::FS& fs, const char* dirname, uint8_t levels) {
 
 void fms_config_load_sd_test() {
   fms_sd_init();
-  fms_sd_dir(SD, "/", 0);
+#if SHOW_DEBUG_SD_TEST_LOG
+  if (FMS_LOG_ON(FMS_LOG_DEBUG)) fms_sd_dir(SD, "/", 0);  // a full listing is slow on a busy card
+#endif
   //return true;
 }
 
-bool write_data_sd(char* input) {
-  //to write code to save data to sd.
-  //step 1. simple write
-  //step 2. encrypt and write
-  //setp 3. sd formarting (clicommand)
+/*
+ * outbox: Final / permit go to an append-only record log on SD before they are
+ * published (src/_fms_outbox.h). The nozzle engine posts them to outbox_in_queue,
+ * sd_task owns the card: it appends, hands logged records to mqtt_pub_queue while
+ * the broker is up and there is room, and moves the durable cursor once mqtt_task
+ * reports them published (fms_outbox_on_published).
+ */
+#define OUTBOX_IN_QUEUE_LEN   16
+#define OUTBOX_FLAG_RETAIN    0x01
+
+fms_outbox        fms_outbox_log;
+File              outbox_file;
+QueueHandle_t     outbox_in_queue   = NULL;
+volatile uint32_t outbox_acked      = 0;   // log end of the last record mqtt_task published
+uint32_t          outbox_drops      = 0;
+uint32_t          outbox_faults     = 0;   // records the card refused OUTBOX_APPEND_RETRIES times in a row
+static fms_pub_msg_t outbox_spill;         // record the card refused, held in RAM until it is logged
+static uint8_t    outbox_spill_tries = 0;  // 0 when the spill slot is empty
 
+static bool outbox_io_append(const uint8_t* data, size_t len, void* ctx) {
+  outbox_file.seek(outbox_file.size());
+  size_t n = outbox_file.write(data, len);
+  outbox_file.flush();  // on the card before the engine moves on
+  return n == len;
+}
+
+// short of the end of the file means the card failed, -1 so the engine retries instead of skipping
+static int outbox_io_read(uint32_t offset, uint8_t* out, size_t len, void* ctx) {
+  uint32_t size = outbox_file.size();
+  if (offset >= size) return 0;
+  if (len > size - offset) len = size - offset;
+  if (!outbox_file.seek(offset)) return -1;
+  int n = outbox_file.read(out, len);
+  return n == (int)len ? n : -1;
+}
+
+static uint32_t outbox_io_size(void* ctx) {
+  return outbox_file.size();
+}
+
+static bool outbox_io_reset(void* ctx) {
+  outbox_file.close();
+  outbox_file = SD.open(OUTBOX_FILE, "w+");
+  return (bool)outbox_file;
+}
 
+// cursor file: cursor + crc32 of it, a torn write reads as "no cursor" (resend, never lose)
+static bool outbox_io_save_cursor(uint32_t cursor, void* ctx) {
+  uint32_t rec[2] = { cursor, fms_outbox::crc32((const uint8_t*)&cursor, sizeof(cursor)) };
+  File f = SD.open(OUTBOX_CURSOR_FILE, FILE_WRITE);
+  if (!f) return false;
+  size_t n = f.write((const uint8_t*)rec, sizeof(rec));
+  f.close();
+  return n == sizeof(rec);
+}
+
+static bool outbox_io_load_cursor(uint32_t* cursor, void* ctx) {
+  uint32_t rec[2];
+  File f = SD.open(OUTBOX_CURSOR_FILE, FILE_READ);
+  if (!f) return false;
+  int n = f.read((uint8_t*)rec, sizeof(rec));
+  f.close();
+  if (n != sizeof(rec) || fms_outbox::crc32((const uint8_t*)&rec[0], sizeof(rec[0])) != rec[1]) return false;
+  *cursor = rec[0];
   return true;
 }
 
-static void sd_task(void* arg) {
-  BaseType_t rc;
+// needs the card mounted (fms_run_sd_test), without it Final / permit are published directly
+bool fms_outbox_begin() {
+  if (!mqtt_pub_queue) return false;  // fms_nozzle_begin first
+  if (SD.cardType() == CARD_NONE) {
+    FMS_LOG_WARNING("[OUTBOX] no SD card, publishing without store and forward");
+    return false;
+  }
+  outbox_in_queue = xQueueCreate(OUTBOX_IN_QUEUE_LEN, sizeof(fms_pub_msg_t));
+  outbox_file = SD.open(OUTBOX_FILE, "a+");
+  if (!outbox_in_queue || !outbox_file) {
+    FMS_LOG_ERROR("[OUTBOX] open %s failed", OUTBOX_FILE);
+    return false;
+  }
+  static const fms_outbox_io_t io = {
+    outbox_io_append, outbox_io_read, outbox_io_size, outbox_io_reset,
+    outbox_io_save_cursor, outbox_io_load_cursor, NULL
+  };
+  fms_outbox_log.begin(io, OUTBOX_COMPACT_BYTES);
+  FMS_LOG_INFO("[OUTBOX] %lu bytes logged, %lu not yet published", fms_outbox_log.size(), fms_outbox_log.backlog_bytes());
+  return true;
+}
+
+// any task, waits at most OUTBOX_POST_WAIT_MS for room; false means not queued and the
+// caller keeps the record (fms_nozzle_send_pending); published directly when there is no outbox
+bool fms_outbox_post(const fms_pub_msg_t* m) {
+  if (!outbox_in_queue) return fms_mqtt_publish_msg(m);
+  if (xQueueSend(outbox_in_queue, m, pdMS_TO_TICKS(OUTBOX_POST_WAIT_MS)) != pdTRUE) {
+    outbox_drops++;  // refused, not lost
+    return false;
+  }
+  if (hsdCardTask) xTaskNotifyGive(hsdCardTask);
+  return true;
+}
+
+// mqtt_task, records handed out by sd_task went to the broker up to log offset end
+void fms_outbox_on_published(uint32_t end) {
+  outbox_acked = end;
+  if (hsdCardTask) xTaskNotifyGive(hsdCardTask);  // commit and refill right away
+}
+
+static bool outbox_append_msg(const fms_pub_msg_t* m) {
+  return fms_outbox_log.append(m->topic, m->payload, m->len, m->retain ? OUTBOX_FLAG_RETAIN : 0);
+}
+
+// sd_task only; a record the card refused stays in the spill slot and is retried first,
+// nothing queued behind it is taken meanwhile, so posters see a full queue and hold theirs
+static void fms_outbox_service() {
+  fms_pub_msg_t m;
+  if (outbox_spill_tries) {
+    if (outbox_append_msg(&outbox_spill)) {
+      FMS_LOG_INFO("[OUTBOX] %s logged after %d tries", outbox_spill.topic, outbox_spill_tries + 1);
+      outbox_spill_tries = 0;
+    } else if (outbox_spill_tries < UINT8_MAX && ++outbox_spill_tries == OUTBOX_APPEND_RETRIES) {
+      outbox_faults++;
+      FMS_LOG_ERROR("[OUTBOX] SD keeps refusing %s, reopening %s", outbox_spill.topic, OUTBOX_FILE);
+      outbox_file.close();
+      outbox_file = SD.open(OUTBOX_FILE, "a+");
+    }
+  }
+  while (!outbox_spill_tries && xQueueReceive(outbox_in_queue, &m, 0) == pdTRUE) {
+    if (!outbox_append_msg(&m)) {
+      FMS_LOG_ERROR("[OUTBOX] SD write failed, holding %s", m.topic);
+      outbox_spill = m;
+      outbox_spill_tries = 1;
+    }
+  }
+
+  fms_outbox_log.commit(outbox_acked);
+  if (fms_outbox_log.size() == 0) outbox_acked = 0;  // log started over, nothing is in flight
+
+  // hand out as much as mqtt_pub_queue takes, keeping room for direct messages
+  bool fed = false;
+  fms_outbox_rec_t rec;
+  while (fms_mqtt_up() && uxQueueSpacesAvailable(mqtt_pub_queue) > OUTBOX_QUEUE_RESERVE &&
+         fms_outbox_log.read_next(&rec)) {
+    memcpy(m.topic, rec.topic, sizeof(m.topic));
+    memcpy(m.payload, rec.payload, rec.payload_len);
+    m.len = rec.payload_len;
+    m.retain = (rec.flags & OUTBOX_FLAG_RETAIN) != 0;
+    m.outbox_end = rec.end;
+    xQueueSend(mqtt_pub_queue, &m, 0);
+    fed = true;
+  }
+  if (fed && hmqttTask) xTaskNotifyGive(hmqttTask);
+}
+
+void handle_outbox_stats_command(const fms_cli_args& args) {
+  if (!outbox_in_queue) {
+    fms_cli.respond("outbox_stats", "Outbox not running (no SD card)", false);
+    return;
+  }
+  if (args.size() > 0 && args[0] == "reset") {
+    fms_outbox_log.reset_stats();
+    outbox_drops = 0;
+    outbox_faults = 0;
+  }
+  const fms_outbox_stats_t& st = fms_outbox_log.stats();
+  char part[384];
+  snprintf(part, sizeof(part),
+           "\"command\":\"outbox_stats\",\"size\":%lu,\"cursor\":%lu,\"backlog_bytes\":%lu,\"in_flight_bytes\":%lu,"
+           "\"appended\":%lu,\"append_errors\":%lu,\"read\":%lu,\"commits\":%lu,\"skipped_bytes\":%lu,"
+           "\"read_errors\":%lu,\"compactions\":%lu,\"drops\":%lu,\"faults\":%lu,\"spill\":%s",
+           fms_outbox_log.size(), fms_outbox_log.cursor(), fms_outbox_log.backlog_bytes(),
+           fms_outbox_log.read_pos() - fms_outbox_log.cursor(), st.appended, st.append_errors, st.read,
+           st.commits, st.skipped_bytes, st.read_errors, st.compactions, outbox_drops, outbox_faults,
+           outbox_spill_tries ? "true" : "false");
+  fms_cli.begin_json_response();
+  fms_cli.add_json_response_part(part);
+  fms_cli.end_json_response();
+}
+
+/*
+ * ledger: every Final is also kept in a local sales ledger (src/_fms_ledger.h),
+ * one segment file per day under LEDGER_DIR with a sparse index, so sales can be
+ * looked up by id or time on the device (ledger command, /api/ledger). The nozzle
+ * engine posts records to ledger_in_queue and sd_task appends them; queries run
+ * on the cli / web server task, ledger_mutex keeps them off a half done append.
+ */
+#define LEDGER_IN_QUEUE_LEN   8
+
+fms_ledger        fms_sales;
+QueueHandle_t     ledger_in_queue   = NULL;
+SemaphoreHandle_t ledger_mutex      = NULL;
+uint32_t          ledger_drops      = 0;   // sales not queued, the queue stayed full for LEDGER_POST_WAIT_MS
+uint32_t          ledger_faults     = 0;   // sales the card refused LEDGER_APPEND_RETRIES times in a row
+static fms_ledger_rec_t ledger_spill;      // sale the card refused, held in RAM until it is kept
+static uint8_t    ledger_spill_tries = 0;  // 0 when the spill slot is empty
+File              ledger_rd;                // last file a query read, reopened when the path changes
+char              ledger_rd_path[FMS_LEDGER_PATH_MAX];
+
+static void ledger_rd_close() {
+  if (ledger_rd) ledger_rd.close();
+  ledger_rd_path[0] = '\0';
+}
+
+static bool ledger_io_append(const char* path, const uint8_t* data, size_t len, void* ctx) {
+  if (strcmp(path, ledger_rd_path) == 0) ledger_rd_close();  // its size would be stale
+  File f = SD.open(path, FILE_APPEND);
+  if (!f) return false;
+  size_t n = f.write(data, len);
+  f.close();
+  return n == len;
+}
+
+static size_t ledger_io_read(const char* path, uint32_t offset, uint8_t* out, size_t len, void* ctx) {
+  if (strcmp(path, ledger_rd_path) != 0) {
+    ledger_rd_close();
+    if (!SD.exists(path)) return 0;
+    ledger_rd = SD.open(path, FILE_READ);
+    if (!ledger_rd) return 0;
+    strncpy(ledger_rd_path, path, sizeof(ledger_rd_path) - 1);
+  }
+  if (!ledger_rd.seek(offset)) return 0;
+  int n = ledger_rd.read(out, len);
+  return n > 0 ? (size_t)n : 0;
+}
+
+static uint32_t ledger_io_size(const char* path, void* ctx) {
+  if (!SD.exists(path)) return 0;
+  File f = SD.open(path, FILE_READ);
+  uint32_t n = f ? f.size() : 0;
+  f.close();
+  return n;
+}
+
+static bool ledger_io_truncate(const char* path, uint32_t size, void* ctx) {
+  if (strcmp(path, ledger_rd_path) == 0) ledger_rd_close();
+  return truncate((String(SD_MOUNT_POINT) + path).c_str(), size) == 0;
+}
+
+// needs the card mounted, without it sales are only published
+bool fms_ledger_begin() {
+  if (SD.cardType() == CARD_NONE) {
+    FMS_LOG_WARNING("[LEDGER] no SD card, sales are not kept on the device");
+    return false;
+  }
+  configTime(GMT_OFFSET_SEC, DAYLIGHT_OFFSET_SEC, NTP_SERVER);  // sale time stamps, synced once wifi is up
+  if (!SD.exists(LEDGER_DIR)) SD.mkdir(LEDGER_DIR);
+  ledger_in_queue = xQueueCreate(LEDGER_IN_QUEUE_LEN, sizeof(fms_ledger_rec_t));
+  ledger_mutex = xSemaphoreCreateMutex();
+  if (!ledger_in_queue || !ledger_mutex) return false;
+  static const fms_ledger_io_t io = {
+    ledger_io_append, ledger_io_read, ledger_io_size, ledger_io_truncate, NULL
+  };
+  fms_sales.begin(io, LEDGER_DIR, GMT_OFFSET_SEC + DAYLIGHT_OFFSET_SEC);
+  FMS_LOG_INFO("[LEDGER] %lu sale(s) in %lu day segment(s)", fms_sales.last_id(), fms_sales.segments());
+  return true;
+}
+
+// utc seconds, 0 until sntp has set the clock (the ledger keeps the last stamp then)
+uint32_t fms_ledger_now() {
+  time_t now = time(NULL);
+  return now < (time_t)LEDGER_MIN_EPOCH ? 0 : (uint32_t)now;
+}
+
+// any task, waits at most LEDGER_POST_WAIT_MS for room; a sale that still does not fit is
+// counted and logged (ledger drops), it was published all the same
+bool fms_ledger_post(const fms_ledger_rec_t* rec) {
+  if (!ledger_in_queue) return false;
+  if (xQueueSend(ledger_in_queue, rec, pdMS_TO_TICKS(LEDGER_POST_WAIT_MS)) != pdTRUE) {
+    ledger_drops++;
+    FMS_LOG_ERROR("[LEDGER] queue full, pump %d sale not kept (%lu dropped)", rec->pump, ledger_drops);
+    return false;
+  }
+  if (hsdCardTask) xTaskNotifyGive(hsdCardTask);
+  return true;
+}
+
+static bool ledger_append_locked(fms_ledger_rec_t* rec) {
+  xSemaphoreTake(ledger_mutex, portMAX_DELAY);
+  bool ok = fms_sales.append(rec);
+  xSemaphoreGive(ledger_mutex);
+  return ok;
+}
+
+// sd_task only; a sale the card refused stays in the spill slot and is retried first, in
+// order, nothing queued behind it is taken meanwhile (the outbox spill slot works the same)
+static void fms_ledger_service() {
+  fms_ledger_rec_t rec;
+  if (ledger_spill_tries) {
+    if (ledger_append_locked(&ledger_spill)) {
+      FMS_LOG_INFO("[LEDGER] pump %d sale kept after %d tries", ledger_spill.pump, ledger_spill_tries + 1);
+      ledger_spill_tries = 0;
+    } else if (ledger_spill_tries < UINT8_MAX && ++ledger_spill_tries == LEDGER_APPEND_RETRIES) {
+      ledger_faults++;
+      FMS_LOG_ERROR("[LEDGER] SD keeps refusing pump %d sale, still holding it", ledger_spill.pump);
+    }
+  }
+  while (!ledger_spill_tries && xQueueReceive(ledger_in_queue, &rec, 0) == pdTRUE) {
+    if (!ledger_append_locked(&rec)) {
+      FMS_LOG_ERROR("[LEDGER] SD write failed, holding pump %d sale", rec.pump);
+      ledger_spill = rec;
+      ledger_spill_tries = 1;
+    }
+  }
+}
+
+// cli / web server side, one bounded scan per call under the lock
+size_t fms_ledger_query_next(fms_ledger_query_t* q, fms_ledger_rec_t* out, size_t max) {
+  xSemaphoreTake(ledger_mutex, portMAX_DELAY);
+  size_t n = fms_sales.query_next(q, out, max);
+  xSemaphoreGive(ledger_mutex);
+  return n;
+}
+
+void fms_ledger_query_begin(fms_ledger_query_t* q) {
+  xSemaphoreTake(ledger_mutex, portMAX_DELAY);
+  fms_sales.query_begin(q);
+  xSemaphoreGive(ledger_mutex);
+}
+
+bool fms_ledger_ready() {
+  return ledger_in_queue != NULL;
+}
+
+size_t fms_ledger_rec_json(const fms_ledger_rec_t* rec, char* out, size_t cap) {
+  return fms_sales.rec_json(*rec, out, cap);
+}
+
+// today / yesterday / YYYY-MM-DD to [from, to) of that local day
+bool fms_ledger_day_range(const char* arg, uint32_t* from, uint32_t* to) {
+  uint32_t day;
+  if (strcmp(arg, "today") == 0 || strcmp(arg, "yesterday") == 0) {
+    uint32_t now = fms_ledger_now();
+    if (now == 0) return false;
+    day = fms_sales.day_of(now) - (arg[0] == 'y' ? 1 : 0);
+  } else if (!fms_ledger::parse_date(arg, &day)) {
+    return false;
+  }
+  *from = fms_sales.day_start(day);
+  *to = fms_sales.day_start(day + 1);
+  return true;
+}
+
+// ledger                        status
+// ledger id <n>                 one sale
+// ledger day <date> [pump]      sales of a day (today, yesterday, YYYY-MM-DD)
+void handle_ledger_command(const fms_cli_args& args) {
+  if (!ledger_in_queue) {
+    fms_cli.respond("ledger", "Ledger not running (no SD card)", false);
+    return;
+  }
+  char part[352];
+  if (args.size() == 0) {
+    const fms_ledger_stats_t& st = fms_sales.stats();
+    snprintf(part, sizeof(part),
+             "\"command\":\"ledger\",\"last_id\":%lu,\"last_ts\":%lu,\"segments\":%lu,\"clock_synced\":%s,"
+             "\"appended\":%lu,\"append_errors\":%lu,\"queries\":%lu,\"scanned\":%lu,\"bad_records\":%lu,"
+             "\"index_rebuilds\":%lu,\"drops\":%lu,\"faults\":%lu,\"spill\":%s",
+             fms_sales.last_id(), fms_sales.last_ts(), fms_sales.segments(), fms_ledger_now() ? "true" : "false",
+             st.appended, st.append_errors, st.queries, st.scanned, st.bad_records, st.index_rebuilds, ledger_drops,
+             ledger_faults, ledger_spill_tries ? "true" : "false");
+    fms_cli.begin_json_response();
+    fms_cli.add_json_response_part(part);
+    fms_cli.end_json_response();
+    return;
+  }
+
+  fms_ledger_query_t q;
+  memset(&q, 0, sizeof(q));
+  if (args[0] == "id" && args.size() == 2 && args[1].toInt() > 0) {
+    q.from_id = q.to_id = (uint32_t)args[1].toInt();
+  } else if (args[0] == "day" && args.size() >= 2 && fms_ledger_day_range(args[1].c_str(), &q.from_ts, &q.to_ts)) {
+    if (args.size() == 3) q.pump = (uint8_t)args[2].toInt();
+  } else {
+    fms_cli.respond("ledger", "Usage: ledger [id <n> | day <today|yesterday|YYYY-MM-DD> [pump]]", false);
+    return;
+  }
+
+  fms_cli.begin_json_response();
+  fms_cli.add_json_response_part("\"command\":\"ledger\",\"records\":[");
+  fms_ledger_rec_t recs[8];
+  uint32_t count = 0;
+  fms_ledger_query_begin(&q);
+  while (!q.done && count < LEDGER_CLI_MAX_RECORDS) {
+    size_t n = fms_ledger_query_next(&q, recs, min((size_t)8, (size_t)(LEDGER_CLI_MAX_RECORDS - count)));
+    for (size_t i = 0; i < n; i++) {
+      part[0] = count++ ? ',' : ' ';
+      if (fms_sales.rec_json(recs[i], part + 1, sizeof(part) - 1)) fms_cli.add_json_response_part(part);
+    }
+  }
+  if (q.done) {
+    snprintf(part, sizeof(part), "],\"count\":%lu,\"more\":false", count);
+  } else {
+    snprintf(part, sizeof(part), "],\"count\":%lu,\"more\":true,\"next_id\":%lu", count, q.seg_first + q.rec);
+  }
+  fms_cli.add_json_response_part(part);
+  fms_cli.end_json_response();
+}
+
+/*
+ * sd log: fmsLog copies lines into a double buffer (src/_fms_debug.h), sd_log_task
+ * takes the filled half and writes it to LOG_SD_FILE in whole LOG_SD_BLOCK blocks at
+ * block aligned offsets. The unfilled last block stays in sd_log_block and is written
+ * in place (same offset) until it is full, so the log on the card is at most
+ * LOG_SD_FLUSH_MS behind and no write straddles a block.
+ */
+File     sd_log_file;
+char     sd_log_block[LOG_SD_BLOCK];
+size_t   sd_log_block_len   = 0;
+uint32_t sd_log_block_off   = 0;      // file offset of sd_log_block
+uint32_t sd_log_day         = 0;      // local day the file was started, 0 = clock not synced then
+uint32_t sd_log_write_errors = 0;
+uint32_t sd_log_rotations   = 0;
+
+static uint32_t fms_sd_log_today() {
+  uint32_t now = fms_ledger_now();
+  return now ? (uint32_t)((now + GMT_OFFSET_SEC + DAYLIGHT_OFFSET_SEC) / 86400) : 0;
+}
+
+// open (or continue) the log, picking up its partial last block
+static bool fms_sd_log_open() {
+  const char* path = fmsGetLogFilePath();
+  sd_log_file = SD.open(path, SD.exists(path) ? "r+" : "w+");
+  if (!sd_log_file) return false;
+  uint32_t size = sd_log_file.size();
+  sd_log_block_off = size - size % LOG_SD_BLOCK;
+  sd_log_block_len = size % LOG_SD_BLOCK;
+  if (sd_log_block_len) {
+    sd_log_file.seek(sd_log_block_off);
+    sd_log_file.read((uint8_t*)sd_log_block, sd_log_block_len);
+  }
+  time_t written = size ? sd_log_file.getLastWrite() : 0;
+  sd_log_day = written >= (time_t)LEDGER_MIN_EPOCH
+                 ? (uint32_t)((written + GMT_OFFSET_SEC + DAYLIGHT_OFFSET_SEC) / 86400) : fms_sd_log_today();
+  return true;
+}
+
+static bool fms_sd_log_put_block() {
+  if (!sd_log_file.seek(sd_log_block_off) ||
+      sd_log_file.write((const uint8_t*)sd_log_block, sd_log_block_len) != sd_log_block_len) {
+    sd_log_write_errors++;
+    return false;
+  }
+  return true;
+}
+
+// current file to /logs/fms-YYYYMMDD-N.log, start a new one
+static void fms_sd_log_rotate() {
+  if (sd_log_block_len) fms_sd_log_put_block();
+  sd_log_file.close();
+  int y;
+  unsigned m, d;
+  fms_ledger::date_of_day(sd_log_day, &y, &m, &d);
+  char name[40];
+  int n = 0;
+  for (; n < LOG_SD_MAX_ROTATED; n++) {
+    snprintf(name, sizeof(name), "%s/fms-%04d%02u%02u-%d.log", LOG_SD_DIR, y, m, d, n);
+    if (!SD.exists(name)) break;
+  }
+  if (n == LOG_SD_MAX_ROTATED) {  // every name of the day is taken, replace the oldest file
+    int oldest = 0;
+    time_t oldest_ts = 0;
+    for (int i = 0; i < LOG_SD_MAX_ROTATED; i++) {
+      snprintf(name, sizeof(name), "%s/fms-%04d%02u%02u-%d.log", LOG_SD_DIR, y, m, d, i);
+      File f = SD.open(name, FILE_READ);
+      time_t ts = f ? f.getLastWrite() : 0;
+      f.close();
+      if (i == 0 || ts < oldest_ts) {
+        oldest = i;
+        oldest_ts = ts;
+      }
+    }
+    snprintf(name, sizeof(name), "%s/fms-%04d%02u%02u-%d.log", LOG_SD_DIR, y, m, d, oldest);
+    FMS_LOG_ERROR("[SDLOG] %d rotated logs for the day, replacing %s", LOG_SD_MAX_ROTATED, name);
+    SD.remove(name);
+  }
+  if (!SD.rename(fmsGetLogFilePath(), name)) {
+    FMS_LOG_ERROR("[SDLOG] rename to %s failed, starting the log over", name);
+    SD.remove(fmsGetLogFilePath());  // never keep appending past LOG_SD_MAX_BYTES
+    sd_log_write_errors++;
+  }
+  sd_log_rotations++;
+  if (!fms_sd_log_open()) sd_log_write_errors++;
+}
+
+static void fms_sd_log_write(const char* data, size_t len) {
+  uint32_t today = fms_sd_log_today();
+  if (sd_log_day == 0) {
+    sd_log_day = today;  // first clock sync since the file was started
+  } else if (today && today != sd_log_day) {
+    fms_sd_log_rotate();
+  }
+  if (sd_log_block_off + sd_log_block_len + len > LOG_SD_MAX_BYTES) fms_sd_log_rotate();
+  if (!sd_log_file) {
+    sd_log_write_errors++;
+    return;
+  }
+
+  while (len) {
+    size_t n = min(len, LOG_SD_BLOCK - sd_log_block_len);
+    memcpy(sd_log_block + sd_log_block_len, data, n);
+    sd_log_block_len += n;
+    data += n;
+    len -= n;
+    if (sd_log_block_len == LOG_SD_BLOCK) {
+      fms_sd_log_put_block();
+      sd_log_block_off += LOG_SD_BLOCK;
+      sd_log_block_len = 0;
+    }
+  }
+  if (sd_log_block_len) fms_sd_log_put_block();  // rewritten in place until full
+  sd_log_file.flush();
+}
+
+static void sd_log_task(void* arg) {
+  fmsLogSinkAttach(xTaskGetCurrentTaskHandle());
   while (1) {
+    const char* data;
+    size_t len = fmsLogSinkTake(&data, LOG_SD_FLUSH_MS);
+    if (len) fms_sd_log_write(data, len);
+    fmsLogSinkRelease();
+  }
+}
 
-    vTaskDelay(pdMS_TO_TICKS(100));
+// needs the card mounted, fmsLog starts copying once sd_log_task runs
+bool fms_sd_log_begin() {
+  if (SD.cardType() == CARD_NONE) return false;
+  if (!SD.exists(LOG_SD_DIR)) SD.mkdir(LOG_SD_DIR);
+  fmsSetLogFilePath(LOG_SD_FILE);
+  if (!fms_sd_log_open()) {
+    FMS_LOG_ERROR("[SDLOG] open %s failed", LOG_SD_FILE);
+    return false;
+  }
+  fmsEnableSDLogging(true);
+  return true;
+}
+
+void handle_log_stats_command(const fms_cli_args& args) {
+  if (args.size() > 0 && args[0] == "reset") {
+    fmsLogSinkResetStats();
+    fmsLogRingResetStats();
+    sd_log_write_errors = 0;
+    sd_log_rotations = 0;
+  }
+  FMSLogSinkStats st;
+  fmsLogSinkGetStats(&st);
+  FMSLogRingStats rs;
+  fmsLogRingGetStats(&rs);
+  char part[320];
+  snprintf(part, sizeof(part),
+           "\"command\":\"log_stats\",\"sd\":%s,\"file\":\"%s\",\"file_bytes\":%lu,\"records\":%lu,\"bytes\":%lu,"
+           "\"drops\":%lu,\"write_errors\":%lu,\"rotations\":%lu,"
+           "\"ring\":{\"deferred\":%s,\"pushed\":%lu,\"drops\":%lu,\"pending\":%lu,\"high_water\":%lu}",
+           sd_log_file ? "true" : "false", fmsGetLogFilePath(), sd_log_block_off + sd_log_block_len, st.records,
+           st.bytes, st.drops, sd_log_write_errors, sd_log_rotations, hlogTask ? "true" : "false",
+           (unsigned long)rs.pushed, (unsigned long)rs.drops, (unsigned long)rs.pending, (unsigned long)rs.high_water);
+  fms_cli.begin_json_response();
+  fms_cli.add_json_response_part(part);
+  fms_cli.end_json_response();
+}
 
+static void sd_task(void* arg) {
+  while (1) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(OUTBOX_IDLE_MS));  // posts and publishes wake it early
+    if (outbox_in_queue) fms_outbox_service();
+    if (ledger_in_queue) fms_ledger_service();
+    fms_config_service();  // price updates from mqtt_task, saved off the network path
   }
 }
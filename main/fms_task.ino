@@ -1,3 +1,5 @@
+#undef  FMS_LOG_TAG
+#define FMS_LOG_TAG SYS     // module of the FMS_LOG_* calls in this file
 
 
 bool create_task(TaskFunction_t task_func, const char* name, uint32_t stack_size, UBaseType_t priority, TaskHandle_t* handle, BaseType_t& rc) {
@@ -21,13 +23,14 @@ bool create_task(TaskFunction_t task_func, const char* name, uint32_t stack_size
 }
 
 bool fms_task_create() {
-  BaseType_t sd_rc, wifi_rc, mqtt_rc, cli_rc, uart2_rc, webserver_rc;
+  BaseType_t log_rc, sd_rc, sdlog_rc, wifi_rc, mqtt_rc, uart2_rc, webserver_rc;
 
-  if (!create_task(sd_task, "sdcard", 3000, 2, &hsdCardTask, sd_rc)) return false;
+  if (LOG_DEFERRED && !create_task(log_task, "log", 3072, 1, &hlogTask, log_rc)) return false;
+  if (!create_task(sd_task, "sdcard", 4096, 2, &hsdCardTask, sd_rc)) return false;
+  if (sd_log_file && !create_task(sd_log_task, "sdlog", 3072, 1, &hsdLogTask, sdlog_rc)) return false;
   if (!create_task(wifi_task, "wifi", 3000, 3, &hwifiTask, wifi_rc)) return false;
   if (!create_task(mqtt_task, "mqtt", 3000, 3, &hmqttTask, mqtt_rc)) return false;
   if (!create_task(fms_uart2_task, "uart2", 3000, 1, &huart2Task, uart2_rc)) return false;
-  if (!create_task(cli_task, "cli", 3000, 1, &hcliTask, cli_rc)) return false;
   if (!create_task(web_server_task, "webserver", 4096, 4, &hwebServerTask, webserver_rc)) return false;
 
   return true;
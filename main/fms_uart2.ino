@@ -1,3 +1,5 @@
+#undef  FMS_LOG_TAG
+#define FMS_LOG_TAG PROTO   // module of the FMS_LOG_* calls in this file
 bool fms_uart2_begin(bool flag, int baudrate) {
   if (flag) {
     fms_uart2_serial.begin(baudrate, SERIAL_8N1, RXD2, TXD2);  // RXD2 and TXD2 are the GPIO pins for RX and TX
@@ -10,53 +12,137 @@ bool fms_uart2_begin(bool flag, int baudrate) {
   }
 }
 
-void fm_rx_irq_interrupt() {  // interrupt RS485/RS232 function
-  uint8_t Buffer[30];
-  int bytes_received = 0;
-  uint16_t size = fms_uart2_serial.available();  // serial.available
-  FMS_LOG_DEBUG("Got bytes on serial : %d\n", size);
-  while (fms_uart2_serial.available() && bytes_received < sizeof(Buffer)) {
-    yield();
-    Buffer[bytes_received] = fms_uart2_serial.read();
-    bytes_received++;
+#ifndef USE_LANFENG
+// rx frames, filled from the uart rx event and drained by the uart2 task
+fms_frame_ring<UART2_RX_RING_SIZE, UART2_RX_MAX_FRAMES> uart2_rx_ring;
+
+// uart rx event (rx timeout = end of frame), copies the frame straight into the ring
+void fms_uart2_on_receive() {
+  size_t n = fms_uart2_serial.available();
+  if (n == 0) return;
+  uint8_t* dst = uart2_rx_ring.reserve(n);
+  if (dst == NULL) {
+    while (n--) fms_uart2_serial.read();  // no room, drop the frame (counted in stats)
+    return;
   }
-  if(bytes_received > 0) {
-    FMS_LOG_DEBUG("\n uart2 data process \n\r");
-    FMS_LOG_DEBUG("uart2 data : %s\n\r", Buffer);
-    FMS_LOG_DEBUG("uart2 data length : %d\n\r", bytes_received);
+  uart2_rx_ring.commit(fms_uart2_serial.read(dst, n));
+  if (huart2Task) xTaskNotifyGive(huart2Task);
+}
+
+// hand every pending frame to the decoder in place
+void fms_uart2_drain_rx() {
+  const uint8_t* data;
+  size_t len;
+  while (uart2_rx_ring.peek(&data, &len)) {
     UART_RECEIVE_STATE = true;
-    fms_uart2_decode(Buffer, bytes_received);  // decode uart2 data main function
+    fms_uart2_decode(data, len);
+    uart2_rx_ring.release();
   }
- 
 }
 
-void fms_uart2_decode(uint8_t* data, uint32_t len) {
-  
-  // Print the raw byte data for debugging
-  Serial.print("[FMSUART2] Received Data: ");
-  for (int i = 0; i < len; i++) {
-    Serial.print(data[i], HEX);  // Print each byte in hex format
-    Serial.print(" ");
+void handle_uart2_stats_command(const fms_cli_args& args) {
+  if (args.size() > 0 && args[0] == "reset") {
+    uart2_rx_ring.reset_stats();
   }
-  Serial.println();
+  const fms_ring_stats_t& st = uart2_rx_ring.stats();
+  char part[192];
+  snprintf(part, sizeof(part),
+           "\"command\":\"uart2_stats\",\"ring\":%u,\"slots\":%u,\"pending\":%u,\"frames\":%lu,\"bytes\":%lu,"
+           "\"overflows\":%lu,\"dropped_bytes\":%lu,\"high_water\":%lu,\"max_frame\":%u",
+           (unsigned)uart2_rx_ring.capacity(), (unsigned)uart2_rx_ring.frame_slots(), (unsigned)uart2_rx_ring.frames_pending(),
+           st.frames, st.bytes, st.overflows, st.dropped_bytes, st.high_water, st.max_frame);
+  fms_cli.begin_json_response();
+  fms_cli.add_json_response_part(part);
+  fms_cli.end_json_response();
+}
+#endif
 
-  // Example of how to process the data, depending on your protocol
-  // FMS_LOG_DEBUG("[FMSUART2] Received : %s\n\r", data); // If data is string
-  // Or process the data byte by byte
+void fms_uart2_decode(const uint8_t* data, size_t len) {
+#ifndef USE_LANFENG
+  fms_protocol_feed(data, len);
+#endif
+}
+
+#ifdef USE_LANFENG
+fms_poll_scheduler poll_scheduler;
 
+// poll every nozzle whose deadline has passed (one round at most), returns ms until the next deadline
+uint32_t fms_uart2_poll_nozzles() {
+  uint32_t wait_ms = POLL_IDLE_MS;
+  for (uint8_t round = 0; round < fms_nozzles.count(); round++) {
+    uint32_t now = millis();
+    for (uint8_t i = 0; i < fms_nozzles.count(); i++) {
+      poll_scheduler.set_active(i, fms_nozzles.state(i) != NOZ_IDLE, now);  // lifted .. final
+    }
+    int8_t noz = poll_scheduler.next(now, &wait_ms);
+    if (noz < 0) break;
+    fms_lanfeng_poll(noz, poll_scheduler.kind(noz));
+    poll_scheduler.done(noz, millis());
+    fms_nozzle_process_events();
+  }
+  return wait_ms;
 }
 
+void handle_poll_stats_command(const fms_cli_args& args) {
+  fms_cli.begin_json_response();
+  fms_cli.add_json_response_part("\"command\":\"poll_stats\",\"nozzles\":[");
+  for (uint8_t i = 0; i < fms_nozzles.count(); i++) {
+    char part[128];
+    uint32_t mhz = poll_scheduler.rate_mhz(i);
+    snprintf(part, sizeof(part), "%s{\"pump\":%d,\"mode\":\"%s\",\"interval_ms\":%u,\"rate_hz\":%lu.%03lu,\"polls\":%lu,\"overruns\":%lu}",
+             i ? "," : "", fms_nozzles.pump_id(i), poll_scheduler.active(i) ? "live" : "status",
+             poll_scheduler.interval(i), mhz / 1000, mhz % 1000, poll_scheduler.polls(i), poll_scheduler.overruns(i));
+    fms_cli.add_json_response_part(part);
+  }
+  fms_cli.add_json_response_part("]");
+  fms_cli.end_json_response();
+}
+#endif
+
 void fms_uart2_task(void* arg) {
   BaseType_t rc;
+  uint32_t wait_ms = 100;
+  bool first_poll = true;
+#ifdef USE_LANFENG
+  fms_initialize_uart2(LANFENG_BAUDRATE);
+  fms_lanfeng_begin();
+  poll_scheduler.begin(fms_nozzles.count(), POLL_IDLE_MS, POLL_ACTIVE_MS, millis());
+#else
+  fms_initialize_uart2(UART2_BAUDRATE);
+  fms_protocol_begin();  // driver named in NVS "protocol"
+#endif
   while (1) {
+        fms_nozzle_process_events();
+        #ifdef USE_LANFENG
+        wait_ms = fms_uart2_poll_nozzles();  // per nozzle deadlines, fast while lifted / fuelling
+        #ifdef USE_TOUCH
+        fms_hmi_tick(false);  // modbus transactions are done, bus is free
+        #endif
+        #endif
        
-        #if USE_PROTOCOL == TATSUNO
-           /* user tatsuno protocol*/
+        #ifndef USE_LANFENG
+        fms_uart2_drain_rx();  // frames posted by fms_uart2_on_receive
+        #ifdef USE_TOUCH
+        fms_hmi_tick(fms_protocol_busy());  // between a reply and the next poll
+        #endif
+        wait_ms = fms_protocol_poll();  // replies arrive through the rx ring
+        #ifdef USE_TOUCH
+        if (fms_hmi.pending() && wait_ms > HMI_TICK_MS) wait_ms = HMI_TICK_MS;
+        #endif
         #endif
         #if USE_PROTOCOL == TOUCH     
            /* user touch prootocol */
         #endif
+        uint32_t live_ms = fms_live_tick();  // coalesced live data, due samples only
+        if (live_ms < wait_ms) wait_ms = live_ms;
+        uint32_t send_ms = fms_nozzle_send_pending();  // permit / Final the outbox had no room for
+        if (send_ms < wait_ms) wait_ms = send_ms;
+        if (first_poll) {
+          fms_boot_mark("first_poll");
+          first_poll = false;
+        }
 
-   vTaskDelay(pdMS_TO_TICKS(100));
+   // sleep until the next deadline, an event is posted or a frame arrives
+   ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms) ? pdMS_TO_TICKS(wait_ms) : 1);
   }
 }
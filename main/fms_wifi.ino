@@ -1,21 +1,19 @@
+#undef  FMS_LOG_TAG
+#define FMS_LOG_TAG WIFI    // module of the FMS_LOG_* calls in this file
 bool initialize_fms_wifi(bool flag) {
   if (flag) {
-    // get ssid and password from nvs storage
-    // using preference library
-    fms_nvs_storage.begin("fms_config", false);
-    String ssid_str = fms_nvs_storage.getString("ssid");
-    String pass_str = fms_nvs_storage.getString("pass");
+    // ssid and password from the settings loaded at boot (fms_cfg)
+    String ssid_str = fms_cfg.wifi_ssid;
+    String pass_str = fms_cfg.wifi_pass;
     
     if(ssid_str.length() == 0 || pass_str.length() == 0) {
       gpio_set_level(LED_YELLOW, LOW);
       vTaskDelay(pdMS_TO_TICKS(500));
       FMS_LOG_ERROR("[fms_wifi.ino:11] [DEBUG WiFi] wifi .. credential .. value is empty");
-      fms_nvs_storage.end();
       return false;
     }
 
-    fms_nvs_storage.end();
-    FMS_LOG_DEBUG("SSID : %s , PASS : %s", ssid_str, pass_str);
+    FMS_LOG_DEBUG("SSID : %s , PASS : %s", ssid_str.c_str(), pass_str.c_str());
     strncpy(sysCfg.wifi_ssid, ssid_str.c_str(), sizeof(sysCfg.wifi_ssid) - 1);
     strncpy(sysCfg.wifi_password, pass_str.c_str(), sizeof(sysCfg.wifi_password) - 1);
     if (sysCfg.wifi_ssid == " " || sysCfg.wifi_password == " ") {
@@ -53,16 +51,12 @@ static void wifi_task(void *arg) {
       vTaskDelay(pdMS_TO_TICKS(100));
 
       #ifdef USE_TOUCH
-      fms_uart2_serial.write(Hide_cloud_icon, 8); // send hide cloud icon command to touch
-      vTaskDelay(pdMS_TO_TICKS(250)); // wait for 250 milliseconds
-      fms_uart2_serial.write(Show_cloud_icon, 8); // send show cloud icon command to touch
-      vTaskDelay(pdMS_TO_TICKS(250)); // wait for 250 milliseconds
+      fms_hmi_set_icon(hmi_wifi_icon, HMI_ICON_HIDE);  // sent by the uart2 task only if it changed
+      fms_hmi_set_icon(hmi_cloud_icon, HMI_ICON_HIDE);
       #endif
     } else {
       #ifdef USE_TOUCH
-        fms_uart2_serial.write(Show_wifi_icon, 8);
-        fms_uart2_serial.write(Show_wifi_icon, 8);
-        Icon_fun();  // icon function
+      fms_hmi_set_icon(hmi_wifi_icon, HMI_ICON_SHOW);
       #endif
       // FMS_LOG_INFO("[fms_wifi.ino:59] Connected to WiFi, IP: %s", WiFi.localIP().toString().c_str());
       gpio_set_level(LED_YELLOW, LOW);
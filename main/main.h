@@ -21,6 +21,7 @@
 #include <SD.h>
 #include <FS.h>
 #include <SPI.h>
+#include <unistd.h>                                   // truncate() for the ledger's torn tails
 // ota server
 #include <ESPmDNS.h>
 #include <WebServer.h>
@@ -28,7 +29,6 @@
 
 #include <esp_task_wdt.h>
 #include <esp_ota_ops.h> 
-#include <EEPROM.h>
 #include <MFRC522.h>
 
 Ticker ticker;
@@ -53,11 +53,44 @@ Ticker ticker;
 #define MQTT_LWT_OFFLINE "offline"              // mqtt last will topic offline
 #define MQTT_LWT_ONLINE "online"                // mqtt last will topic online
 #define mqttTask true
+#define MQTT_BACKOFF_MIN_MS         500                 // first retry after a failed connect
+#define MQTT_BACKOFF_MAX_MS         30000               // backoff cap, each wait is jittered in [b/2, b]
+#define MQTT_CONNECT_TIMEOUT_MS     2000                // tcp connect limit of one attempt
+#define MQTT_SOCKET_TIMEOUT_S       2                   // connack / read limit of one attempt
+#define MQTT_LOOP_MS                100                 // longest mqtt_task sleep, keeps client.loop() going
 #define WEB_SERVER_PORT 80                          // web server port
 
 // SD configuration 
 #define SD_CARD_CS_PIN 5                            // sd card chip select pin
 #define SD_CARD_CONFIG_FILE_NAME "fms_config.txt"   // sd card file name change it to your file name
+#define OUTBOX_FILE                 "/outbox.log"     // Final / permit record log (store and forward)
+#define OUTBOX_CURSOR_FILE          "/outbox.cur"     // durable read cursor of the log
+#define OUTBOX_COMPACT_BYTES        (64 * 1024)       // start the log over once it is drained and this big
+#define OUTBOX_QUEUE_RESERVE        4                 // mqtt_pub_queue slots the drain leaves to direct messages
+#define OUTBOX_IDLE_MS              100               // sd task wake up period with nothing posted
+#define OUTBOX_POST_WAIT_MS         5                 // longest a permit / Final post waits for outbox_in_queue room
+#define OUTBOX_APPEND_RETRIES       10                // failed SD appends of one record before it counts as a fault
+#define SD_MOUNT_POINT              "/sd"             // SD.begin() default, posix paths for truncate()
+#define LEDGER_DIR                  "/ledger"         // sales ledger segments (src/_fms_ledger.h)
+#define LEDGER_MIN_EPOCH            1704067200UL      // 2024-01-01, earlier clock reads are "not synced yet"
+#define LEDGER_CLI_MAX_RECORDS      50                // ledger day on the cli, the rest through /api/ledger
+#define LEDGER_POST_WAIT_MS         5                 // longest a sale post waits for ledger_in_queue room
+#define LEDGER_APPEND_RETRIES       10                // failed SD appends of one sale before it counts as a fault
+#define CONFIG_BLOB_KEY             "cfg"             // NVS "fms_config" key of the settings blob (src/_fms_config.h)
+#define CONFIG_BLOB_KEY_B           "cfg_b"           // copy written before it, read when the main blob is corrupt
+#define CONFIG_SAVE_DELAY_MS        2000              // deferred settings saves (price updates) are coalesced this long
+#define LOG_SD_DIR                  "/logs"
+#define LOG_SD_FILE                 "/logs/fms.log"   // fmsLog sink, rotated to /logs/fms-YYYYMMDD-N.log
+#define LOG_SD_MAX_BYTES            (1024 * 1024)     // rotate at this size, and at local midnight
+#define LOG_SD_MAX_ROTATED          1000              // rotated files per day (N), the oldest is replaced past it
+#define LOG_SD_FLUSH_MS             1000              // longest a logged line waits in RAM
+#define LOG_SD_BLOCK                512               // card writes start on block boundaries
+#define FMS_LOG_CEIL_DEFAULT        FMS_LOG_DEBUG     // log calls above this are compiled out, per module: FMS_LOG_CEIL_MQTT ...
+#define LOG_DEFERRED                1                 // fmsLog only records, log_task formats and prints
+#define LOG_DRAIN_MS                20                // longest a record waits in the ring
+#define CONSOLE_CHUNK               2048              // most bytes of serial capture per /api/console reply
+#define CONSOLE_WAIT_MAX_MS         1000              // longest /api/console long poll, the web server is single client
+#define CONSOLE_POLL_MS             50                // long poll check period
 
 // Time configuration
 #define NTP_SERVER "pool.ntp.org"                   // ntp server
@@ -67,13 +100,38 @@ Ticker ticker;
 #define fms_cli_serial Serial                       // cli serial port
 #define fms_uart2_serial Serial1                    // uart2 serial port
 
+#define UART2_BAUDRATE              9600              // dispenser link (non modbus protocols)
+#define UART2_RX_RING_SIZE          1024              // rx frame ring bytes, check uart2_stats high_water
+#define UART2_RX_MAX_FRAMES         16                // frames queued before the uart2 task runs
+#define UART2_RX_TIMEOUT_SYMBOLS    3                 // idle symbols that end a frame
+
+#define FMS_DEFAULT_PROTOCOL        "tatsuno"         // driver used when NVS "protocol" is empty or unknown
+#define PROTOCOL_POLL_MS            50                // poll period, pumps are polled round robin
+#define PROTOCOL_REPLY_TIMEOUT_MS   30                // longest a poll holds the line for its reply
+// touch display (USE_TOUCH), variable addresses of the HMI project
+#define HMI_VP_WIFI_ICON            0x1000
+#define HMI_VP_CLOUD_ICON           0x1001
+#define HMI_ICON_HIDE               0
+#define HMI_ICON_SHOW               1
+#define HMI_TICK_MS                 100               // at most one display write per tick
+
 #define LED_BUILTIN                 2
 #define chip_report_printf          log_printf  
 // lanfeng modbus
 #define MAX485_DE 15
 #define MAX485_RE_NEG 15
+//#define USE_LANFENG                               // lanfeng modbus dispenser on uart2
+#define LANFENG_BAUDRATE            9600
+#define LANFENG_VOLUME_DECIMALS     3                 // register volume unit 0.001 liter
+#define LANFENG_MONEY_DECIMALS      0                 // register amount unit
+#define POLL_IDLE_MS                300               // status poll period of an idle nozzle
+#define POLL_ACTIVE_MS              80                // live data poll period while lifted / fuelling
 ModbusMaster node;
 #define PUMP_REQUEST_TIMEOUT_MS     10000             // 10 seconds timeout for pump request  
+#define LIVE_PUBLISH_MIN_MS         500               // default live data interval per nozzle (NVS "live_ms", live_rate)
+#define LIVE_PUBLISH_MIN_MS_FLOOR   50                // fastest live_rate accepts
+#define LIVE_RETRY_MS               20                // mqtt_pub_queue was full, try the live sample again
+#define NOZ_SEND_RETRY_MS           20                // outbox was full, try the pending permit / Final again
 
 // multiplexer
 // additional information datasheet : https://www.lcsc.com/datasheet/lcsc_datasheet_2004021806_HGSEMI-74HC4052M-TR_C507179.pdf
@@ -95,9 +153,6 @@ ModbusMaster node;
 #define LED_YELLOW                  GPIO_NUM_33
 // uartReceive state
 bool UART_RECEIVE_STATE             = true;
-// nozzle config
-#define MAX_NOZZLES                 2 // change your noz count
-bool pump_approve[MAX_NOZZLES]      = {false};
 
 /* OTA  configuration  parameter */
 bool          otaInProgress         = false;
@@ -117,8 +172,6 @@ bool isAuthenticated                = false;    // optional ota password
 bool use_uart_command               = true;
 bool use_serial1                    = true;
 int app_cpu                         = 0;
-bool testModeActive                 = false;
-const size_t MAX_BUFFER_SIZE        = 4096; 
 const unsigned long WIFI_TIMEOUT    = 20000;  
 unsigned long currentMillis         = 0;
 unsigned long ota_previousMillis    = 0;
@@ -127,7 +180,6 @@ const int LED_TWO                   = 2;
 bool wifi_start_event               = true;
 Preferences                         preferences;
 WebServer                           server(WEB_SERVER_PORT);
-String                              serialOutputBuffer;
 uart_t*                             fms_cli_uart;
 Preferences                         fms_nvs_storage;
 WiFiClient                          wf_client;
@@ -137,9 +189,6 @@ WiFiClient                          http_client;
 
 
 // mqtt config
-bool permitMessageSent             = false; // for sent permit message time
-bool finalMessageSent              = false; // for sent final message time= 
-bool presetMessageGet              = false; // for preset message get from mqtt broker
 // mqtt topic
 const char* fms_sub_topics[] = { // subscribe topic 
   "detpos/local_server/#"
@@ -158,16 +207,6 @@ const uint8_t fms_sub_topics_count = sizeof(fms_sub_topics)/sizeof(fms_sub_topic
 const uint8_t fms_sub_topics_value_count = sizeof(fms_sub_topics_value)/sizeof(fms_sub_topics_value[0]);
 // end mqtt config
 
-uint32_t s_liter[2];
-uint32_t l_liter[2];
-uint32_t t_amount[2];
-uint32_t t_liter[2];
-float s_liter_float;
-float t_liter_float;
-float t_amount_float;
-float liveLiterPrice;
-
-
 // int devicenum = 1;
 int pumpid1;
 int pumpid2;
@@ -191,24 +230,36 @@ const uint16_t TOTALIZER_LITER_ADDR   = 0x02BC;
 const uint16_t TOTALIZER_AMOUNT_ADDR  = 0x02C0;
 const uint16_t LIVE_PRICE_ADDR        = 0x02C8;
 const uint8_t  NOZ_ID                 = 01;
+const uint16_t PUMP_STATE_APPROVE     = 0x0001;    // written to PUMP_STATE_ADDR to release the pump
+// decoded register slots in reg_data
+enum {
+  REG_TOTALIZER_LITER = 0,
+  REG_TOTALIZER_AMOUNT,
+  REG_LIVE_DATA,
+  REG_LIVE_PRICE,
+  REG_SELL_LITER,
+  REG_PRICE,
+  REG_PUMP_STATE,
+  REG_NOZ_HANDLE
+};
 // end modbus address
 
 // from old 
-char approv_topic[22]               = "detpos/local_server/1";
+char approv_topic[32]               = "detpos/local_server/1";
 char preset_topic[28]               = "detpos/local_server/preset";  // return from local server
 // char reload_topic[29]            = "detpos/local_server/reload/1";  // return from local server
 char price_change_topic[26]         = "detpos/local_server/price";  // return from local server
 char device_Id_topic[40]            = "detpos/local_server/initial1/det/0A0000";  // return from local server
 //char pricechange[26]                = "detpos/local_server/price"; /* change note fix this*/
-char pplive[25]                     = "detpos/device/livedata/1";
-char ppfinal[22]                    = "detpos/device/Final/1";
+char pplive[32]                     = "detpos/device/livedata/1";
+char ppfinal[32]                    = "detpos/device/Final/1";
 char whreqbuf[20]                   = "detpos/device/whreq";
 char pricereqbuf[25]                = "detpos/device/pricereq/1";
 char activebuf[23]                  = "detpos/device/active/1";
 char devicebuf[2]                   = "1";
 char Reset_topic[17]                = "detpos/hmi/reset";
 const char permitTopic[23]          = "detpos/device/permit/";
-char pumpreqbuf[23]                 = "detpos/device/permit/1";   
+char pumpreqbuf[32]                 = "detpos/device/permit/1";
 char pumprequest[23];
 char payload[10]; // for permit message                
 // old topic for old version
@@ -221,8 +272,19 @@ struct DisConfig{
   uint8_t  devn;            // device number
   uint8_t  noz;             // nozzle number
   uint8_t pumpids[8];       // pump ids
+  uint16_t live_ms;         // min ms between live publishes of one nozzle
+  uint8_t  payload;         // permit / live / Final encoding, fms_payload_format_t
 }dcfg;
 
+/* one mqtt message, slot of mqtt_pub_queue and of the SD outbox queue */
+struct fms_pub_msg_t {
+  char     topic[32];
+  uint8_t  payload[96];     // text or binary (src/_fms_payload.h), not NUL terminated
+  uint8_t  len;
+  bool     retain;
+  uint32_t outbox_end;      // outbox log offset to commit once published, 0 if not from the outbox
+};
+
 
 struct SYSCFG {
   unsigned long bootcount;
@@ -255,6 +317,8 @@ static TaskHandle_t heventTask;
 static TaskHandle_t hwifiTask;
 static TaskHandle_t hmqttTask;
 static TaskHandle_t hsdCardTask;
+static TaskHandle_t hsdLogTask;
+static TaskHandle_t hlogTask;
 static TaskHandle_t hwebServerTask;
 static TaskHandle_t hspiTask;
 static TaskHandle_t hcliTask;
@@ -11,14 +11,37 @@ String deviceName            = "ultm_25505v01_";  /* device ID (for)  change her
 #include "src/_fms_cli.h"
 #include "src/_fms_debug.h"
 #include "src/_fms_json_helper.h"
+#include "src/_fms_fixed.h"
+#include "src/_fms_modbus_poller.h"
+#include "src/_fms_nozzle.h"
+#include "src/_fms_poll_scheduler.h"
+#include "src/_fms_ringbuf.h"
+#include "src/_fms_protocol.h"
+#include "src/_fms_hmi.h"
+#include "src/_fms_topic_router.h"
+#include "src/_fms_outbox.h"
+#include "src/_fms_live.h"
+#include "src/_fms_conn.h"
+#include "src/_fms_payload.h"
+#include "src/_fms_latency.h"
+#include "src/_fms_ledger.h"
+#include "src/_fms_config.h"
+#include "src/_fms_capture.h"
 #include <src/_fms_filemanager.h>        /* test features */
 
 
 #define USE_CLI
 fms_cli fms_cli(fms_cli_serial, CLI_PASSWORD);      // Use "admin" as the default password change your admin pass here
+fms_config_t fms_cfg;                               // settings, loaded once at boot (fms_load_config)
+SemaphoreHandle_t fms_cfg_mutex = NULL;             // fms_config_lock, writers of fms_cfg
+volatile bool fms_cfg_dirty = false;                // fms_config_save_later, sd_task saves it
+uint32_t fms_cfg_dirty_ms = 0;                      // when it was first marked
+fms_capture  serial_capture;                        // last serial output for /api/console (serial_capture_mux)
+portMUX_TYPE serial_capture_mux = portMUX_INITIALIZER_UNLOCKED;
 
 
 void setup() {
+  fmsLogSetMirror(fms_capture_write);       // log lines to the web console from the first one
 
 #ifdef USE_CLI
   fms_cli.begin(115200);  // Initialize the CLI with a baud rate of 115200
@@ -33,17 +56,52 @@ void setup() {
   fms_cli.register_command("protocol_config","Set Protocol Config",       handle_protocol_config_command, 11, 11);
   fms_cli.register_command("mqtt_config"   ,"Configure Mqtt settings",     handle_mqtt_command,2,2);
   fms_cli.register_command("noz_config", "Configure Nozzle settings",   handle_nozzle_command, 16, 16);
+  fms_cli.register_command("config_apply", "Apply a device profile: config_apply <command> <args> ...", handle_config_apply_command, 2, FMS_CLI_MAX_ARGS - 1);
+  fms_cli.register_command("mqtt_stats",   "Show mqtt connection attempts and downtime", handle_mqtt_stats_command, 0, 1);
+  fms_cli.register_command("mqtt_routes", "Show mqtt topic routes and hits", handle_mqtt_routes_command, 0, 1);
+  fms_cli.register_command("live_stats",   "Show live data publishes sent and suppressed", handle_live_stats_command, 0, 1);
+  fms_cli.register_command("live_rate",    "Set min ms between live publishes per nozzle", handle_live_rate_command, 1, 1);
+  fms_cli.register_command("payload_format", "Set permit / live / Final encoding (text|binary)", handle_payload_format_command, 1, 1);
+  fms_cli.register_command("latency",      "Show permit / approval / pump start latency per nozzle", handle_latency_command, 0, 1);
+  fms_cli.register_command("ledger",       "Look up sales on SD: ledger [id <n> | day <date> [pump]]", handle_ledger_command, 0, 3);
+  fms_cli.register_command("log_level",    "Show or set log level per module: log_level [<module>|all <level>]", handle_log_level_command, 0, 2);
+  fms_cli.register_command("log_stats",    "Show log ring and SD log counters", handle_log_stats_command, 0, 1);
+  fms_cli.register_command("boot_stats",   "Show boot phase timing",        handle_boot_stats_command);
+  fms_cli.register_command("outbox_stats", "Show SD outbox backlog and counters", handle_outbox_stats_command, 0, 1);
+#ifndef USE_LANFENG
+  fms_cli.register_command("uart2_stats",  "Show uart2 rx ring counters", handle_uart2_stats_command, 0, 1);
+  fms_cli.register_command("protocol_stats", "Show protocol decoder counters", handle_protocol_stats_command, 0, 1);
 #endif
-  /* fms_uart2_serial.onReceive(fm_rx_irq_interrupt)*/
-  fms_run_sd_test();                        // demo test fix this load configure data from sd card
+#ifdef USE_TOUCH
+  fms_cli.register_command("hmi_stats",    "Show display write counters",  handle_hmi_stats_command, 0, 1);
+#endif
+#ifdef USE_LANFENG
+  fms_cli.register_command("modbus_stats", "Show modbus scan timing",   handle_modbus_stats_command, 0, 1);
+  fms_cli.register_command("poll_stats",   "Show poll rate per nozzle",  handle_poll_stats_command);
+#endif
+  fms_cli_task_begin();                     // commands run in cli_task, the receive callback only queues lines
+#endif
+  fms_boot_mark("cli");
+  fms_run_sd_test();                        // mount the SD card and LittleFS
+  fms_boot_mark("storage");
   fmsEnableSerialLogging(true);             // show serial logging data on Serial Monitor
-  fms_boot_count(true);                     // boot count
-  fms_load_config();                        // load config from nvs storage (preference storage)
+  fms_load_config();                        // boot count and settings, one NVS read into fms_cfg
+  fms_boot_mark("config");
+  fms_nozzle_begin();                       // dispense engine (needs dcfg)
+  fms_outbox_begin();                       // Final / permit store and forward on SD (needs the card and the engine queues)
+  fms_ledger_begin();                       // sales ledger on SD, starts sntp for its time stamps
+  fms_sd_log_begin();                       // fmsLog copy to /logs on SD, written by sd_log_task
+#ifdef USE_TOUCH
+  fms_hmi_begin();                          // display icons, written by the uart2 task
+#endif
+  fms_boot_mark("engine");
  
 
 /* task create */
   if (fms_initialize_wifi()) {             // wifi is connected create all task s
+    fms_boot_mark("wifi");
     fms_task_create();
+    fms_boot_mark("tasks");
   }
 
 
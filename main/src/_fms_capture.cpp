@@ -0,0 +1,59 @@
+/*
+ * FMS Capture - serial output kept in a fixed circular buffer
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#include "_fms_capture.h"
+#include <string.h>
+
+#define CAPTURE_MASK    (FMS_CAPTURE_SIZE - 1)
+
+fms_capture::fms_capture() : _head(0) {
+    memset(_buf, 0, sizeof(_buf));
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+void fms_capture::write(const void* data, size_t len) {
+    const char* p = (const char*)data;
+    if (len > FMS_CAPTURE_SIZE) {       // only the tail survives anyway
+        _head += len - FMS_CAPTURE_SIZE;
+        p += len - FMS_CAPTURE_SIZE;
+        len = FMS_CAPTURE_SIZE;
+    }
+    size_t at = (size_t)(_head & CAPTURE_MASK);
+    size_t first = FMS_CAPTURE_SIZE - at < len ? FMS_CAPTURE_SIZE - at : len;
+    memcpy(_buf + at, p, first);
+    memcpy(_buf, p + first, len - first);
+    _head += len;
+    _stats.written = _head;
+    _stats.writes++;
+}
+
+size_t fms_capture::read(uint64_t from, char* out, size_t cap, uint64_t* next, uint64_t* lost) {
+    *lost = 0;
+    uint64_t lo = oldest();
+    if (from > _head) {
+        from = lo;                      // an offset from before a reboot: all that is held
+    } else if (from < lo) {
+        *lost = lo - from;
+        _stats.lost += *lost;
+        from = lo;
+    }
+    size_t len = (size_t)(_head - from) < cap ? (size_t)(_head - from) : cap;
+    size_t at = (size_t)(from & CAPTURE_MASK);
+    size_t first = FMS_CAPTURE_SIZE - at < len ? FMS_CAPTURE_SIZE - at : len;
+    memcpy(out, _buf + at, first);
+    memcpy(out + first, _buf, len - first);
+    *next = from + len;
+    _stats.reads++;
+    return len;
+}
+
+void fms_capture::reset_stats() {
+    uint64_t written = _stats.written;
+    memset(&_stats, 0, sizeof(_stats));
+    _stats.written = written;
+}
@@ -0,0 +1,56 @@
+/*
+ * FMS Capture - serial output kept in a fixed circular buffer
+ *
+ * Every byte written gets the next offset of a 64 bit counter that only goes
+ * up, the buffer holds the last FMS_CAPTURE_SIZE of them. A reader keeps the
+ * offset it got to and asks for what came after; if the writer has lapped it
+ * in the meantime the read starts at the oldest byte still held and says how
+ * many were lost. Writes never allocate or move old data.
+ *
+ * Not locked: the firmware serialises writers and readers around it.
+ *
+ * Plain C++, no Arduino dependency, so it builds on the host as well.
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#ifndef _FMS_CAPTURE_H_
+#define _FMS_CAPTURE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FMS_CAPTURE_SIZE    8192    // power of two, 4-16 KB
+
+struct fms_capture_stats_t {
+    uint64_t written;               // == head()
+    uint32_t writes;
+    uint32_t reads;
+    uint64_t lost;                  // bytes readers asked for after they were overwritten
+};
+
+class fms_capture {
+public:
+    fms_capture();
+
+    void     write(const void* data, size_t len);
+
+    // Copies bytes from offset `from` on, at most cap. *next is the offset to
+    // ask for next time, *lost the bytes skipped because they were overwritten.
+    size_t   read(uint64_t from, char* out, size_t cap, uint64_t* next, uint64_t* lost);
+
+    uint64_t head() const   { return _head; }      // offset of the next byte written
+    uint64_t oldest() const { return _head > FMS_CAPTURE_SIZE ? _head - FMS_CAPTURE_SIZE : 0; }
+
+    const fms_capture_stats_t& stats() const { return _stats; }
+    void     reset_stats();
+
+private:
+    char                 _buf[FMS_CAPTURE_SIZE];
+    uint64_t             _head;
+    fms_capture_stats_t  _stats;
+};
+
+#endif // _FMS_CAPTURE_H_
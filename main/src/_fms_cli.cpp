@@ -17,12 +17,26 @@
 // Constructor
 fms_cli::fms_cli(HardwareSerial& serial, const char* password) 
     : _serial(serial), 
-      _buffer(""),
+      _len(0),
+      _overlong(false),
+      _lines(nullptr),
+      _busy(false),
+      _cancel(false),
+      _dropped(0),
+      _tooLong(0),
+      _droppedReported(0),
+      _tooLongReported(0),
+      _machine(false),
+      _failed(false),
+      _reqId(-1),
       _password(password ? password : ""),
       _prompt("FMS> "),
       _authenticated(password ? false : true),
       _authRequired(password ? true : false),
-      _echoEnabled(true) {
+      _echoEnabled(true),
+      _commandCount(0),
+      _json(json_sink, this) {
+    _buffer[0] = '\0';
 }
 
 // Initialize CLI
@@ -35,6 +49,12 @@ bool fms_cli::begin(unsigned long baudRate) {
     if (!_serial) {
         return false;
     }
+
+    // Lines go from the receive callback to the CLI task through this queue
+    _lines = xQueueCreate(FMS_CLI_QUEUE_DEPTH, sizeof(_run));
+    if (!_lines) {
+        return false;
+    }
     
     // Set up interrupt handler
     _serial.onReceive([this]() {
@@ -59,17 +79,23 @@ bool fms_cli::begin(unsigned long baudRate) {
 }
 
 // Register a command
-void fms_cli::register_command(const String& name, const String& description, 
+void fms_cli::register_command(const char* name, const char* description,
                             CommandCallback callback, uint8_t minArgs, uint8_t maxArgs) {
-    cli_command_t cmd = {
-        .name = name,
-        .description = description,
-        .callback = callback,
-        .minArgs = minArgs,
-        .maxArgs = maxArgs
-    };
-    
-    _commands[name] = cmd;
+    int id = _table.find(name);
+    if (id < 0) {
+        if (_commandCount == FMS_CLI_MAX_COMMANDS) {
+            _serial.printf("[CLI] command table full, '%s' not registered\n", name);
+            return;
+        }
+        id = _commandCount++;
+        _table.add(name, (uint16_t)id);
+    }
+    cli_command_t& cmd = _commands[id];
+    cmd.name = name;
+    cmd.description = description;
+    cmd.callback = callback;
+    cmd.minArgs = minArgs;
+    cmd.maxArgs = maxArgs;
 }
 
 // Process incoming data
@@ -80,138 +106,183 @@ void fms_cli::process_input() {
         
         // Handle backspace
         if (c == '\b' || c == 127) {
-            if (_buffer.length() > 0) {
-                _buffer.remove(_buffer.length() - 1);
+            if (_len > 0) {
+                _len--;
                 if (_echoEnabled) {
                     _serial.print("\b \b"); // Erase character on terminal
                 }
             }
             continue;
         }
+
+        // Ctrl-C: stop the running command, drop the line being typed
+        if (c == 3) {
+            _cancel = true;
+            _len = 0;
+            _overlong = false;
+            if (!_machine) {
+                _serial.println("^C");
+                if (!_busy) _serial.print(_prompt);
+            }
+            continue;
+        }
         
         // Echo character if enabled
-        if (_echoEnabled && c >= 32 && c < 127) {
+        if (_echoEnabled && !_machine && c >= 32 && c < 127) {
             _serial.write(c);
         }
         
         // Process on newline
         if (c == '\n' || c == '\r') {
-            if (_buffer.length() > 0) {
-                _serial.println();
-                
-                String command;
-                std::vector<String> args;
-                
-                parse_command(_buffer, command, args);
-                
-                // Handle login if authentication required
-                if (_authRequired && !_authenticated) {
-                    if (command == "login" && args.size() == 1) {
-                        _authenticated = authenticate(args[0]);
-                        if (_authenticated) {
-                            respond("login", "Login successful", true);
-                            //_serial.println("Login successful");
-                        } else {
-                            respond("login", "Invalid password", false);
-                            //_serial.println("Invalid password");
-                        }
-                    } else {
-                        _serial.println("Please login with 'login <password>'");
-                    }
-                } else {
-                    execute_command(command, args);
+            if (_overlong) {
+                // The CLI task reports it, the mark wakes it when idle
+                _tooLong++;
+                _buffer[0] = FMS_CLI_REJECT_MARK;
+                _buffer[1] = '\0';
+                xQueueSend(_lines, _buffer, 0);
+                _overlong = false;
+                _len = 0;
+            } else if (_len > 0) {
+                // The CLI task runs it and prints the prompt after
+                if (!_machine) _serial.println();
+                _buffer[_len] = '\0';
+                if (xQueueSend(_lines, _buffer, 0) != pdTRUE) {
+                    _dropped++;                 // reported once the running line is done
                 }
-                
-                _buffer = "";
-                _serial.print(_prompt);
-            } else if (c == '\r' && _serial.peek() != '\n') {
+                _len = 0;
+            } else if (c == '\r' && !_machine && _serial.peek() != '\n') {
                 // Just a carriage return without newline
                 _serial.println();
-                _serial.print(_prompt);
+                if (!_busy) _serial.print(_prompt);
             }
         } else if (c >= 32) {
             // Add printable characters to buffer
-            _buffer += c;
+            if (_len < FMS_CLI_LINE_MAX) _buffer[_len++] = c;
+            else _overlong = true;
         }
     }
 }
 
-// Parse command line into command and arguments
-void fms_cli::parse_command(const String& cmdLine, String& command, std::vector<String>& args) {
-    String trimmed = cmdLine;
-    trimmed.trim();
-    
-    int idx = 0;
-    int lastIdx = 0;
-    bool inQuotes = false;
-    
-    // Extract command (first word)
-    idx = trimmed.indexOf(' ');
-    if (idx == -1) {
-        command = trimmed;
+// A line the receive callback refused, written by the CLI task so it never
+// lands inside another request's output
+void fms_cli::reject_line(const char* result) {
+    if (!_machine) _json.raw("\r\n");
+    _json.begin_object();
+    if (_machine) {
+        _json.field_raw("id", "null");
+        _json.field_bool("done", true);
+        _json.field_bool("success", false);
+        _json.field("result", result);
+    } else {
+        _json.field("command", "cli");
+        _json.field("result", result);
+        _json.field_bool("success", false);
+    }
+    _json.end_object();
+    _json.raw("\r\n");
+    _json.flush();
+}
+
+// The callback only counts refused lines, one reject line each goes out here
+void fms_cli::report_rejected() {
+    while (_tooLongReported != _tooLong) {
+        _tooLongReported++;
+        reject_line("Line too long");
+    }
+    while (_droppedReported != _dropped) {
+        _droppedReported++;
+        reject_line("Busy, line dropped");
+    }
+}
+
+// Run the next queued line, then report the lines refused meanwhile
+bool fms_cli::run_pending(TickType_t wait) {
+    if (!_lines || xQueueReceive(_lines, _run, wait) != pdTRUE) {
+        return false;
+    }
+    if (_run[0] != FMS_CLI_REJECT_MARK) {
+        _cancel = false;
+        _busy = true;
+        run_line(_run, strlen(_run));
+        _busy = false;
+    }
+    report_rejected();
+    if (!_machine) _serial.print(_prompt);
+    return true;
+}
+
+// Split the line into command and arguments (in place) and run it. In machine
+// mode the line is a JSON request and every output line carries its id, the
+// last one {"id":..,"done":true,"success":..} (commands run one at a time, in
+// the order received, so the host can send the next requests without waiting)
+void fms_cli::run_line(char* line, size_t len) {
+    fms_cli_arg tokens[FMS_CLI_MAX_ARGS];
+    bool overflow;
+    _failed = false;
+    if (!_machine) {
+        size_t n = fms_cli_tokenize(line, len, tokens, FMS_CLI_MAX_ARGS, &overflow);
+        if (n > 0) dispatch(tokens, n, overflow);
         return;
     }
-    
-    command = trimmed.substring(0, idx);
-    lastIdx = idx + 1;
-    
-    // Extract arguments
-    while (lastIdx < trimmed.length()) {
-        // Skip spaces
-        while (lastIdx < trimmed.length() && trimmed[lastIdx] == ' ') {
-            lastIdx++;
-        }
-        
-        if (lastIdx >= trimmed.length()) {
-            break;
-        }
-        
-        // Check for quoted argument
-        if (trimmed[lastIdx] == '"') {
-            inQuotes = true;
-            lastIdx++; // Skip opening quote
-            idx = trimmed.indexOf('"', lastIdx);
-            
-            if (idx == -1) {
-                // No closing quote, take rest of string
-                args.push_back(trimmed.substring(lastIdx));
-                break;
+
+    size_t n = fms_cli_parse_request(line, len, &_reqId, tokens, FMS_CLI_MAX_ARGS, &overflow);
+    if (n == 0) {
+        respond("", "Bad request", false);
+    } else {
+        dispatch(tokens, n, overflow);
+    }
+    _json.begin_object();
+    put_id();                           // also after "machine off"
+    _json.field_bool("done", true);
+    _json.field_bool("success", !_failed);
+    _json.end_object();
+    _json.raw("\r\n");
+    _json.flush();
+    _reqId = -1;
+}
+
+void fms_cli::dispatch(const fms_cli_arg* tokens, size_t n, bool overflow) {
+    const char* command = tokens[0].s;
+    fms_cli_args args(tokens + 1, n - 1);
+
+    // Handle login if authentication required
+    if (_authRequired && !_authenticated) {
+        if (strcmp(command, "login") == 0 && args.size() == 1) {
+            _authenticated = authenticate(args[0].c_str());
+            if (_authenticated) {
+                respond("login", "Login successful", true);
+            } else {
+                respond("login", "Invalid password", false);
             }
-            
-            args.push_back(trimmed.substring(lastIdx, idx));
-            lastIdx = idx + 1;
-            inQuotes = false;
+        } else if (_machine) {
+            respond(command, "Login required", false);
         } else {
-            // Regular argument
-            idx = trimmed.indexOf(' ', lastIdx);
-            
-            if (idx == -1) {
-                // Last argument
-                args.push_back(trimmed.substring(lastIdx));
-                break;
-            }
-            
-            args.push_back(trimmed.substring(lastIdx, idx));
-            lastIdx = idx + 1;
+            _serial.println("Please login with 'login <password>'");
         }
+        return;
+    }
+    if (overflow) {
+        respond(command, "Too many arguments", false);
+        return;
     }
+    execute_command(command, args);
 }
 
 // Handle authentication
-bool fms_cli::authenticate(const String& password) {
-    return password == _password;
+bool fms_cli::authenticate(const char* password) {
+    return _password == password;
 }
 
 // Execute command
-void fms_cli::execute_command(const String& command, const std::vector<String>& args) {
-    auto it = _commands.find(command);
+void fms_cli::execute_command(const char* command, const fms_cli_args& args) {
+    int id = _table.find(command);
     
-    if (it == _commands.end()) {
+    if (id < 0) {
         respond(command, "Command not found", false);
         return;
     }
     
-    const cli_command_t& cmd = it->second;
+    const cli_command_t& cmd = _commands[id];
     
     // Check argument count
     if (args.size() < cmd.minArgs) {
@@ -228,74 +299,45 @@ void fms_cli::execute_command(const String& command, const std::vector<String>&
     cmd.callback(args);
 }
 
-// Escape JSON string values
-String fms_cli::escape_json(const String& input) {
-    String output;
-    output.reserve(input.length() + 10); // Reserve some extra space for potential escapes
-    
-    for (unsigned int i = 0; i < input.length(); i++) {
-        char c = input[i];
-        switch (c) {
-            case '"': output += "\\\""; break;
-            case '\\': output += "\\\\"; break;
-            case '\b': output += "\\b"; break;
-            case '\f': output += "\\f"; break;
-            case '\n': output += "\\n"; break;
-            case '\r': output += "\\r"; break;
-            case '\t': output += "\\t"; break;
-            default:
-                if (c < 32) {
-                    // For control characters, use \uXXXX format
-                    char hex[7];
-                    snprintf(hex, sizeof(hex), "\\u%04x", c);
-                    output += hex;
-                } else {
-                    output += c;
-                }
-        }
-    }
-    
-    return output;
+void fms_cli::json_sink(void* ctx, const char* data, size_t len) {
+    static_cast<fms_cli*>(ctx)->_serial.write((const uint8_t*)data, len);
 }
 
-// Format a JSON string manually
-String fms_cli::format_json(const std::map<String, String>& fields) {
-    String json = "{";
-    bool first = true;
-    
-    for (const auto& field : fields) {
-        if (!first) {
-            json += ",";
-        }
-        first = false;
-        
-        json += "\"" + field.first + "\":";
-        
-        // Check if value is a boolean or number
-        if (field.second == "true" || field.second == "false" || 
-            field.second == "null" || 
-            (field.second.length() > 0 && 
-             ((field.second[0] >= '0' && field.second[0] <= '9') || 
-              field.second[0] == '-'))) {
-            json += field.second;
-        } else {
-            json += "\"" + escape_json(field.second) + "\"";
-        }
-    }
-    
-    json += "}";
-    return json;
+// Opens an output line, with the request id in machine mode
+void fms_cli::begin_line() {
+    _json.begin_object();
+    if (_machine) put_id();
+}
+
+void fms_cli::put_id() {
+    if (_reqId >= 0) _json.field("id", _reqId);
+    else _json.field_raw("id", "null");
 }
 
 // Print response in JSON format
+void fms_cli::respond(const char* command, const char* result, bool success) {
+    if (!success) _failed = true;
+    begin_line();
+    _json.field("command", command);
+    _json.field("result", result);
+    _json.field_bool("success", success);
+    _json.end_object();
+    _json.raw("\r\n");
+    _json.flush();
+}
+
+// Intermediate step of a long running command, the final respond() follows
+void fms_cli::progress(const char* command, const char* message) {
+    begin_line();
+    _json.field("command", command);
+    _json.field("progress", message);
+    _json.end_object();
+    _json.raw("\r\n");
+    _json.flush();
+}
+
 void fms_cli::respond(const String& command, const String& result, bool success) {
-    std::map<String, String> fields;
-    fields["command"] = command;
-    fields["result"] = result;
-    fields["success"] = success ? "true" : "false";
-    
-    String response = format_json(fields);
-    _serial.println(response);
+    respond(command.c_str(), result.c_str(), success);
 }
 
 // Print help
@@ -304,8 +346,9 @@ void fms_cli::print_help() {
     _serial.println("| Command          | Description      |");
     _serial.println("+------------------+------------------+");
     
-    for (const auto& cmd : _commands) {
-        _serial.printf("| %-16s | %-16s |\n", cmd.second.name.c_str(), cmd.second.description.c_str());
+    for (size_t i = 0; i < _table.count(); i++) {
+        const cli_command_t& cmd = _commands[_table.id_at(i)];
+        _serial.printf("| %-16s | %-16s |\n", cmd.name, cmd.description);
     }
     
     _serial.println("+------------------+------------------+");
@@ -329,15 +372,20 @@ void fms_cli::set_echo(bool enabled) {
     _echoEnabled = enabled;
 }
 
+// Switch between typed commands and JSON-lines requests
+void fms_cli::set_machine(bool on) {
+    _machine = on;
+}
+
 // Register built-in commands
 void fms_cli::register_built_in_commands() {
     // Help command
-    register_command("help", "Show available commands", [this](const std::vector<String>&) {
+    register_command("help", "Show available commands", [this](const fms_cli_args&) {
         this->print_help();
     });
     
     // Echo command
-    register_command("echo", "Toggle command echo", [this](const std::vector<String>& args) {
+    register_command("echo", "Toggle command echo", [this](const fms_cli_args& args) {
         if (args.size() > 0) {
             if (args[0] == "on") {
                 this->set_echo(true);
@@ -354,8 +402,27 @@ void fms_cli::register_built_in_commands() {
         }
     }, 0, 1);
     
+    // Machine mode: JSON requests with ids, no echo or prompt
+    register_command("machine", "JSON-lines requests with ids: machine <on|off>", [this](const fms_cli_args& args) {
+        if (args[0] == "on") {
+            char part[96];
+            snprintf(part, sizeof(part),
+                     "\"command\":\"machine\",\"result\":\"on\",\"window\":%d,\"line_max\":%d,\"success\":true",
+                     FMS_CLI_QUEUE_DEPTH, FMS_CLI_LINE_MAX);
+            this->begin_json_response();
+            this->add_json_response_part(part);
+            this->end_json_response();
+            this->set_machine(true);
+        } else if (args[0] == "off") {
+            this->respond("machine", "off");
+            this->set_machine(false);
+        } else {
+            this->respond("machine", "Invalid argument. Use 'on' or 'off'", false);
+        }
+    }, 1, 1);
+    
     // Exit/logout command
-    register_command("logout", "Logout from CLI", [this](const std::vector<String>&) {
+    register_command("logout", "Logout from CLI", [this](const fms_cli_args&) {
         if (_authRequired) {
             _authenticated = false;
             this->respond("logout", "Logged out");
@@ -366,39 +433,53 @@ void fms_cli::register_built_in_commands() {
     });
 }
 
-// Begin a JSON response (prints the opening bracket)
+// Begin a JSON response (prints the opening bracket, and the id in machine mode)
 void fms_cli::begin_json_response() {
-    _serial.print("{");
+    if (!_machine) {
+        _json.raw("{");
+    } else if (_reqId >= 0) {
+        char head[32];  // {"id": + up to 19 digits + , + NUL
+        snprintf(head, sizeof(head), "{\"id\":%ld,", _reqId);
+        _json.raw(head);
+    } else {
+        _json.raw("{\"id\":null,");
+    }
 }
 
 // Add a part to the JSON response
-void fms_cli::add_json_response_part(const String& part) {
-    _serial.print(part);
+void fms_cli::add_json_response_part(const char* part) {
+    _json.raw(part);
     yield(); // Allow the system to process other tasks
 }
 
+void fms_cli::add_json_response_part(const String& part) {
+    add_json_response_part(part.c_str());
+}
+
 // End the JSON response (prints the closing bracket)
 void fms_cli::end_json_response() {
-    _serial.println("}");
+    _json.raw("}\r\n");
+    _json.flush();
 }
 
 // Execute a command directly (for testing)
-bool fms_cli::execute_test_command(const String& commandLine) {
-    String command;
-    std::vector<String> args;
-    
-    parse_command(commandLine, command, args);
-    
-    if (command.length() == 0) {
+bool fms_cli::execute_test_command(const char* commandLine) {
+    char line[FMS_CLI_LINE_MAX + 1];
+    size_t len = strlen(commandLine);
+    if (len > FMS_CLI_LINE_MAX) len = FMS_CLI_LINE_MAX;
+    memcpy(line, commandLine, len);
+    line[len] = '\0';
+
+    fms_cli_arg tokens[FMS_CLI_MAX_ARGS];
+    bool overflow;
+    size_t n = fms_cli_tokenize(line, len, tokens, FMS_CLI_MAX_ARGS, &overflow);
+    if (n == 0) {
         return false;
     }
-    
-    auto it = _commands.find(command);
-    if (it == _commands.end()) {
-        respond(command, "Command not found", false);
+    if (_table.find(tokens[0].s) < 0) {
+        respond(tokens[0].s, "Command not found", false);
         return false;
     }
-    
-    execute_command(command, args);
+    execute_command(tokens[0].s, fms_cli_args(tokens + 1, n - 1));
     return true;
 }
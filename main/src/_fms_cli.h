@@ -18,20 +18,20 @@
 
 #include <Arduino.h>
 #include <functional>
-#include <vector>
-#include <map>
-#include <string>
+#include "_fms_cli_core.h"
 
 // Increase the stack size for the CLI task
 #define FMS_CLI_TASK_STACK_SIZE 8192
+#define FMS_CLI_QUEUE_DEPTH     4       // finished lines waiting for the CLI task, more are dropped
+#define FMS_CLI_REJECT_MARK     '\x01'  // queued in place of a refused line, never starts a typed one
 
-// CLI Command callback function type
-typedef std::function<void(const std::vector<String>&)> CommandCallback;
+// CLI Command callback function type, args point into the line being run
+typedef std::function<void(const fms_cli_args&)> CommandCallback;
 
-// Command structure
+// Command structure, name and description are kept by pointer (literals)
 struct cli_command_t {
-    String name;
-    String description;
+    const char* name;
+    const char* description;
     CommandCallback callback;
     uint8_t minArgs;
     uint8_t maxArgs;
@@ -45,18 +45,25 @@ public:
     bool begin(unsigned long baudRate = 115200);
     
     // Register a command
-    void register_command(const String& name, const String& description, 
+    void register_command(const char* name, const char* description,
                          CommandCallback callback, uint8_t minArgs = 0, uint8_t maxArgs = 255);
     
-    // Process incoming data
+    // Process incoming data (serial receive callback): echo, line editing and
+    // queueing finished lines, never runs a command
     void process_input();
+
+    // Run the next queued line, waiting up to `wait` for one (call from the CLI task)
+    bool run_pending(TickType_t wait = portMAX_DELAY);
+
+    // Long running commands: report a step, and stop when Ctrl-C was typed
+    void progress(const char* command, const char* message);
+    bool cancelled() const { return _cancel; }
+    uint32_t dropped() const { return _dropped; }
     
     // Print response in JSON format
+    void respond(const char* command, const char* result, bool success = true);
     void respond(const String& command, const String& result, bool success = true);
     
-    // Format a JSON string manually
-    String format_json(const std::map<String, String>& fields);
-    
     // Print help
     void print_help();
     
@@ -69,38 +76,71 @@ public:
     // Enable/disable echo
     void set_echo(bool enabled);
 
+    // Machine mode: one JSON request per line, {"id":N,"cmd":"name","args":[...]},
+    // answered by lines carrying "id" and closed by {"id":N,"done":true,...}.
+    // No echo or prompt; up to FMS_CLI_QUEUE_DEPTH requests may be in flight.
+    void set_machine(bool on);
+    bool machine() const { return _machine; }
+
+    // A respond(.., false) since the current line started
+    bool failed() const { return _failed; }
+
     // Send a large response in chunks to avoid memory issues
     void begin_json_response();
+    void add_json_response_part(const char* part);
     void add_json_response_part(const String& part);
     void end_json_response();
     
     // Execute a command directly (for testing)
-    bool execute_test_command(const String& commandLine);
+    bool execute_test_command(const char* commandLine);
 
 private:
     HardwareSerial& _serial;
-    String _buffer;
+    char _buffer[FMS_CLI_LINE_MAX + 1];
+    size_t _len;
+    bool _overlong;                     // input passed FMS_CLI_LINE_MAX, dropped up to the newline
+    char _run[FMS_CLI_LINE_MAX + 1];    // the line the CLI task is running
+    QueueHandle_t _lines;
+    volatile bool _busy;
+    volatile bool _cancel;
+    volatile uint32_t _dropped;         // lines refused with the queue full (receive callback)
+    volatile uint32_t _tooLong;         // lines refused as too long (receive callback)
+    uint32_t _droppedReported;          // of those, already reported by the CLI task
+    uint32_t _tooLongReported;
+    volatile bool _machine;
+    bool _failed;
+    long _reqId;                        // id of the request being run, -1 if none
     String _password;
     String _prompt;
     bool _authenticated;
     bool _authRequired;
     bool _echoEnabled;
-    std::map<String, cli_command_t> _commands;
+    cli_command_t _commands[FMS_CLI_MAX_COMMANDS];    // registration order, _table has them by name
+    uint16_t _commandCount;
+    fms_cli_table _table;
+    fms_json_writer _json;
     
-    // Parse command line into command and arguments
-    void parse_command(const String& cmdLine, String& command, std::vector<String>& args);
+    // Split the line in place and run it (CLI task)
+    void run_line(char* line, size_t len);
     
     // Handle authentication
-    bool authenticate(const String& password);
+    bool authenticate(const char* password);
+    
+    // Login check, then execute_command
+    void dispatch(const fms_cli_arg* tokens, size_t n, bool overflow);
     
     // Execute command
-    void execute_command(const String& command, const std::vector<String>& args);
+    void execute_command(const char* command, const fms_cli_args& args);
+
+    void begin_line();
+    void put_id();
+    void reject_line(const char* result);
+    void report_rejected();
     
     // Register built-in commands
     void register_built_in_commands();
-    
-    // Escape JSON string values
-    String escape_json(const String& input);
+
+    static void json_sink(void* ctx, const char* data, size_t len);
 };
 
 #endif // _FMS_CLI_H_
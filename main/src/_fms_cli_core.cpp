@@ -0,0 +1,318 @@
+/*
+ * FMS CLI Core - tokenizer, command table and JSON writer of the CLI
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#include "_fms_cli_core.h"
+#include <stdio.h>
+
+static inline bool is_space(char c) { return c == ' ' || c == '\t'; }
+
+size_t fms_cli_tokenize(char* line, size_t len, fms_cli_arg* out, size_t max, bool* overflow) {
+    size_t n = 0;
+    size_t i = 0;
+    *overflow = false;
+    while (i < len) {
+        while (i < len && is_space(line[i])) i++;
+        if (i >= len) break;
+        if (n == max) {
+            *overflow = true;
+            break;
+        }
+        size_t start;
+        if (line[i] == '"') {
+            start = ++i;
+            while (i < len && line[i] != '"') i++;
+        } else {
+            start = i;
+            while (i < len && !is_space(line[i])) i++;
+        }
+        out[n].s = line + start;
+        out[n].len = (uint16_t)(i - start);
+        n++;
+        if (i < len) line[i++] = '\0';      // the separator or closing quote
+    }
+    line[len] = '\0';                       // the caller keeps room for it
+    return n;
+}
+
+// ---- JSON request -----------------------------------------------------------
+
+struct req_parser {
+    char*  p;
+    char*  end;
+
+    void skip_ws() {
+        while (p < end && (*p == ' ' || *p == '\t')) p++;
+    }
+
+    bool expect(char c) {
+        skip_ws();
+        if (p < end && *p == c) {
+            p++;
+            return true;
+        }
+        return false;
+    }
+
+    static int hex(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    // "...": unescaped in place, the closing quote becomes '\0'
+    bool string(fms_cli_arg* tok) {
+        skip_ws();
+        if (p >= end || *p != '"') return false;
+        char* w = ++p;
+        tok->s = w;
+        while (p < end && *p != '"') {
+            char c = *p++;
+            if (c != '\\') {
+                *w++ = c;
+                continue;
+            }
+            if (p >= end) return false;
+            c = *p++;
+            switch (c) {
+                case 'b': *w++ = '\b'; break;
+                case 'f': *w++ = '\f'; break;
+                case 'n': *w++ = '\n'; break;
+                case 'r': *w++ = '\r'; break;
+                case 't': *w++ = '\t'; break;
+                case 'u': {
+                    if (end - p < 4) return false;
+                    int cp = 0;
+                    for (int i = 0; i < 4; i++) {
+                        int h = hex(*p++);
+                        if (h < 0) return false;
+                        cp = cp << 4 | h;
+                    }
+                    // 6 characters in, at most 3 bytes of UTF-8 out
+                    if (cp == 0 || (cp >= 0xD800 && cp <= 0xDFFF)) {
+                        *w++ = '?';                 // args are C strings; surrogate pairs are not joined
+                    } else if (cp < 0x80) {
+                        *w++ = (char)cp;
+                    } else if (cp < 0x800) {
+                        *w++ = (char)(0xC0 | cp >> 6);
+                        *w++ = (char)(0x80 | (cp & 0x3F));
+                    } else {
+                        *w++ = (char)(0xE0 | cp >> 12);
+                        *w++ = (char)(0x80 | (cp >> 6 & 0x3F));
+                        *w++ = (char)(0x80 | (cp & 0x3F));
+                    }
+                    break;
+                }
+                default: *w++ = c; break;           // " \ /
+            }
+        }
+        if (p >= end) return false;
+        p++;
+        *w = '\0';
+        tok->len = (uint16_t)(w - tok->s);
+        return true;
+    }
+
+    // number, true, false or null: the text up to the next delimiter
+    bool bare(fms_cli_arg* tok) {
+        skip_ws();
+        char* start = p;
+        while (p < end && *p != ',' && *p != ']' && *p != '}' && *p != ' ' && *p != '\t') {
+            char c = *p;
+            if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '-' || c == '+' || c == '.' || c == 'E')) {
+                return false;
+            }
+            p++;
+        }
+        if (p == start) return false;
+        tok->s = start;
+        tok->len = (uint16_t)(p - start);
+        return true;
+    }
+
+    bool value(fms_cli_arg* tok) {
+        skip_ws();
+        if (p < end && *p == '"') return string(tok);
+        return bare(tok);
+    }
+};
+
+size_t fms_cli_parse_request(char* line, size_t len, long* id, fms_cli_arg* out, size_t max, bool* overflow) {
+    req_parser r = {line, line + len};
+    size_t n = 1;                           // out[0] is kept for cmd
+    bool has_cmd = false;
+    *id = -1;
+    *overflow = false;
+    if (max < 1 || !r.expect('{')) return 0;
+    if (r.expect('}')) return 0;
+    do {
+        fms_cli_arg key;
+        if (!r.string(&key) || !r.expect(':')) return 0;
+        if (strcmp(key.s, "args") == 0) {
+            if (!r.expect('[')) return 0;
+            if (r.expect(']')) continue;
+            do {
+                fms_cli_arg v;
+                if (!r.value(&v)) return 0;
+                if (n < max) out[n++] = v;
+                else *overflow = true;
+            } while (r.expect(','));
+            if (!r.expect(']')) return 0;
+        } else {
+            fms_cli_arg v;
+            if (!r.value(&v)) return 0;
+            if (strcmp(key.s, "cmd") == 0) {
+                out[0] = v;
+                has_cmd = true;
+            } else if (strcmp(key.s, "id") == 0) {
+                char* stop;
+                char keep = v.s[v.len];
+                ((char*)v.s)[v.len] = '\0';
+                *id = strtol(v.s, &stop, 10);
+                ((char*)v.s)[v.len] = keep;
+                if (stop != v.s + v.len || *id < 0) return 0;
+            }
+        }
+    } while (r.expect(','));
+    if (!r.expect('}')) return 0;
+    r.skip_ws();
+    if (r.p != r.end || !has_cmd) return 0;
+    // bare values end at their delimiter, cut them only now that it has been read
+    for (size_t i = 0; i < n; i++) ((char*)out[i].s)[out[i].len] = '\0';
+    return n;
+}
+
+// ---- command table ------------------------------------------------------------
+
+size_t fms_cli_table::lower_bound(const char* name) const {
+    size_t lo = 0, hi = _n;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (strcmp(_e[mid].name, name) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+bool fms_cli_table::add(const char* name, uint16_t id) {
+    size_t at = lower_bound(name);
+    if (at < _n && strcmp(_e[at].name, name) == 0) {
+        _e[at].id = id;
+        return true;
+    }
+    if (_n == FMS_CLI_MAX_COMMANDS) return false;
+    memmove(&_e[at + 1], &_e[at], (_n - at) * sizeof(entry_t));
+    _e[at].name = name;
+    _e[at].id = id;
+    _n++;
+    return true;
+}
+
+int fms_cli_table::find(const char* name) const {
+    size_t at = lower_bound(name);
+    if (at < _n && strcmp(_e[at].name, name) == 0) return _e[at].id;
+    return -1;
+}
+
+fms_json_writer::fms_json_writer(fms_json_sink_t sink, void* ctx)
+    : _sink(sink), _ctx(ctx), _len(0), _depth(0), _first(0) {
+}
+
+void fms_json_writer::put(char c) {
+    if (_len == sizeof(_buf)) flush();
+    _buf[_len++] = c;
+}
+
+void fms_json_writer::put_escaped(const char* s) {
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        switch (c) {
+            case '"':  put('\\'); put('"'); break;
+            case '\\': put('\\'); put('\\'); break;
+            case '\b': put('\\'); put('b'); break;
+            case '\f': put('\\'); put('f'); break;
+            case '\n': put('\\'); put('n'); break;
+            case '\r': put('\\'); put('r'); break;
+            case '\t': put('\\'); put('t'); break;
+            default:
+                if (c < 32) {
+                    char hex[7];
+                    snprintf(hex, sizeof(hex), "\\u%04x", c);
+                    raw(hex, 6);
+                } else {
+                    put((char)c);
+                }
+        }
+    }
+}
+
+void fms_json_writer::key(const char* k) {
+    uint32_t bit = 1UL << _depth;
+    if (_first & bit) _first &= ~bit;
+    else put(',');
+    put('"');
+    put_escaped(k);
+    put('"');
+    put(':');
+}
+
+void fms_json_writer::begin_object() {
+    put('{');
+    if (_depth < 31) _depth++;
+    _first |= 1UL << _depth;
+}
+
+void fms_json_writer::end_object() {
+    _first &= ~(1UL << _depth);
+    if (_depth) _depth--;
+    put('}');
+}
+
+void fms_json_writer::field(const char* k, const char* value) {
+    key(k);
+    put('"');
+    put_escaped(value);
+    put('"');
+}
+
+void fms_json_writer::field(const char* k, long value) {
+    char num[24];
+    int n = snprintf(num, sizeof(num), "%ld", value);
+    key(k);
+    raw(num, (size_t)n);
+}
+
+void fms_json_writer::field_bool(const char* k, bool value) {
+    key(k);
+    raw(value ? "true" : "false");
+}
+
+void fms_json_writer::field_raw(const char* k, const char* json) {
+    key(k);
+    raw(json);
+}
+
+void fms_json_writer::raw(const char* text) {
+    raw(text, strlen(text));
+}
+
+void fms_json_writer::raw(const char* text, size_t len) {
+    while (len) {
+        if (_len == sizeof(_buf)) flush();
+        size_t n = sizeof(_buf) - _len < len ? sizeof(_buf) - _len : len;
+        memcpy(_buf + _len, text, n);
+        _len += n;
+        text += n;
+        len -= n;
+    }
+}
+
+void fms_json_writer::flush() {
+    if (_len) _sink(_ctx, _buf, _len);
+    _len = 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * FMS CLI Core - tokenizer, command table and JSON writer of the CLI
+ *
+ * The line is split in place: separators and closing quotes become '\0' and
+ * every token is a pointer / length into the line, so an argument is a C
+ * string without a copy. "a quoted arg" keeps its spaces, a quote that is not
+ * closed runs to the end of the line. Commands live in a flat table sorted by
+ * name (binary search), responses are written through fms_json_writer, which
+ * escapes as it goes and hands the sink whole buffers. Nothing here allocates.
+ *
+ * Machine mode takes one JSON request per line instead,
+ *   {"id":12,"cmd":"mqtt_config","args":["10.0.0.2",1883]}
+ * parsed in place the same way: string escapes are undone where they are,
+ * numbers and booleans are taken as their text, and the result is the same
+ * token list as the plain line "mqtt_config 10.0.0.2 1883".
+ *
+ * Plain C++, no Arduino dependency, so it builds on the host as well.
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#ifndef _FMS_CLI_CORE_H_
+#define _FMS_CLI_CORE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef ARDUINO
+#include <WString.h>
+#endif
+
+#define FMS_CLI_LINE_MAX        512     // longest command line, longer input is ignored up to the newline (a config_apply profile is ~400)
+#define FMS_CLI_MAX_ARGS        48      // command + arguments
+#define FMS_CLI_MAX_COMMANDS    64
+#define FMS_JSON_WRITER_BUF     64
+
+// One token of the line, '\0' terminated in place
+struct fms_cli_arg {
+    const char* s;
+    uint16_t    len;
+
+    const char* c_str() const  { return s; }
+    size_t      length() const { return len; }
+    long        toInt() const  { return atol(s); }
+    float       toFloat() const { return (float)atof(s); }
+    bool operator==(const char* o) const { return strcmp(s, o) == 0; }
+    bool operator!=(const char* o) const { return strcmp(s, o) != 0; }
+#ifdef ARDUINO
+    operator String() const    { return String(s); }     // allocates, for handlers that keep a copy
+#endif
+};
+
+// Arguments of one command (the tokens after the name)
+class fms_cli_args {
+public:
+    fms_cli_args(const fms_cli_arg* v, size_t n) : _v(v), _n(n) {}
+    size_t size() const  { return _n; }
+    bool   empty() const { return _n == 0; }
+    const fms_cli_arg& operator[](size_t i) const { return _v[i]; }
+    const fms_cli_arg* begin() const { return _v; }
+    const fms_cli_arg* end() const   { return _v + _n; }
+
+private:
+    const fms_cli_arg* _v;
+    size_t             _n;
+};
+
+// Splits line[0..len) in place, returns the token count (0 for a blank line).
+// *overflow is set when there were more than max tokens (the rest is not split).
+size_t fms_cli_tokenize(char* line, size_t len, fms_cli_arg* out, size_t max, bool* overflow);
+
+// Splits one JSON request in place: out[0] is "cmd", then the "args" values.
+// *id is the request id, -1 when there is none (ids are >= 0). Other keys with
+// scalar values are skipped. Returns 0 when the line is not such a request.
+size_t fms_cli_parse_request(char* line, size_t len, long* id, fms_cli_arg* out, size_t max, bool* overflow);
+
+// Name -> id, sorted by name; names are kept by pointer (literals)
+class fms_cli_table {
+public:
+    fms_cli_table() : _n(0) {}
+
+    bool        add(const char* name, uint16_t id);      // replaces the id of a known name, false when full
+    int         find(const char* name) const;            // id, -1 if unknown
+    size_t      count() const { return _n; }
+    const char* name_at(size_t i) const { return _e[i].name; }
+    uint16_t    id_at(size_t i) const { return _e[i].id; }
+
+private:
+    struct entry_t {
+        const char* name;
+        uint16_t    id;
+    };
+    entry_t _e[FMS_CLI_MAX_COMMANDS];
+    size_t  _n;
+
+    size_t lower_bound(const char* name) const;
+};
+
+// Streaming JSON out: commas and escaping handled, output in FMS_JSON_WRITER_BUF pieces
+typedef void (*fms_json_sink_t)(void* ctx, const char* data, size_t len);
+
+class fms_json_writer {
+public:
+    fms_json_writer(fms_json_sink_t sink, void* ctx);
+
+    void begin_object();
+    void end_object();
+    void field(const char* key, const char* value);      // quoted, escaped
+    void field(const char* key, long value);
+    void field_bool(const char* key, bool value);
+    void field_raw(const char* key, const char* json);   // value is already JSON
+    void raw(const char* text);                          // as is, for prebuilt parts
+    void raw(const char* text, size_t len);
+    void flush();
+
+private:
+    fms_json_sink_t _sink;
+    void*           _ctx;
+    char            _buf[FMS_JSON_WRITER_BUF];
+    size_t          _len;
+    uint8_t         _depth;
+    uint32_t        _first;     // bit per depth: no member written yet
+
+    void put(char c);
+    void put_escaped(const char* s);
+    void key(const char* k);
+};
+
+#endif // _FMS_CLI_CORE_H_
@@ -0,0 +1,54 @@
+/*
+ * FMS Config - device settings as one versioned, crc protected blob
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#include "_fms_config.h"
+#include "_fms_outbox.h"
+#include <string.h>
+
+void fms_config_defaults(fms_config_t* cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    strcpy(cfg->uuid, "ultm_25505v01_");
+    cfg->devn = 1;
+    cfg->noz = 1;
+}
+
+size_t fms_config_encode(const fms_config_t& cfg, uint8_t* out, size_t cap) {
+    const size_t body = sizeof(fms_config_t);
+    if (cap < FMS_CONFIG_BLOB_MAX) return 0;
+    out[0] = (uint8_t)FMS_CONFIG_MAGIC;
+    out[1] = (uint8_t)(FMS_CONFIG_MAGIC >> 8);
+    out[2] = FMS_CONFIG_VERSION;
+    out[3] = 0;
+    out[4] = (uint8_t)body;
+    out[5] = (uint8_t)(body >> 8);
+    memcpy(out + FMS_CONFIG_HEADER, &cfg, body);
+    size_t n = FMS_CONFIG_HEADER + body;
+    uint32_t crc = fms_outbox::crc32(out, n);
+    for (int i = 0; i < 4; i++) out[n++] = (uint8_t)(crc >> (8 * i));
+    return n;
+}
+
+bool fms_config_decode(const uint8_t* in, size_t len, fms_config_t* out) {
+    if (len < FMS_CONFIG_HEADER + 4) return false;
+    if ((in[0] | (in[1] << 8)) != FMS_CONFIG_MAGIC || in[2] == 0 || in[2] > FMS_CONFIG_VERSION) return false;
+    size_t body = (size_t)(in[4] | (in[5] << 8));
+    if (len != FMS_CONFIG_HEADER + body + 4) return false;
+    size_t n = FMS_CONFIG_HEADER + body;
+    uint32_t crc = (uint32_t)in[n] | ((uint32_t)in[n + 1] << 8) | ((uint32_t)in[n + 2] << 16) | ((uint32_t)in[n + 3] << 24);
+    if (fms_outbox::crc32(in, n) != crc) return false;
+
+    fms_config_defaults(out);
+    memcpy(out, in + FMS_CONFIG_HEADER, body < sizeof(fms_config_t) ? body : sizeof(fms_config_t));
+    // strings always end inside their field, whatever was stored
+    out->wifi_ssid[sizeof(out->wifi_ssid) - 1] = '\0';
+    out->wifi_pass[sizeof(out->wifi_pass) - 1] = '\0';
+    out->mqtt_host[sizeof(out->mqtt_host) - 1] = '\0';
+    out->uuid[sizeof(out->uuid) - 1] = '\0';
+    out->protocol[sizeof(out->protocol) - 1] = '\0';
+    return true;
+}
@@ -0,0 +1,54 @@
+/*
+ * FMS Config - device settings as one versioned, crc protected blob
+ *
+ * Everything the device needs at boot (wifi, mqtt, uuid, protocol, pump ids,
+ * nozzle prices, live / payload settings) lives in fms_config_t and is kept
+ * in NVS as a single blob, read once into RAM:
+ *
+ *   0  magic u16 "FC"   2 version u8   3 reserved   4 body length u16
+ *   6  body (fms_config_t as laid out by the firmware)
+ *   6 + length  crc32 (LE) of everything before it
+ *
+ * Fields are only ever appended, and a blob written by an older firmware
+ * (shorter body) decodes with defaults for the fields it does not have.
+ *
+ * Plain C++, no Arduino dependency, so it builds on the host as well.
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#ifndef _FMS_CONFIG_H_
+#define _FMS_CONFIG_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FMS_CONFIG_MAGIC        0x4346      // "FC"
+#define FMS_CONFIG_VERSION      1
+#define FMS_CONFIG_HEADER       6
+#define FMS_CONFIG_BLOB_MAX     (FMS_CONFIG_HEADER + sizeof(fms_config_t) + 4)
+#define FMS_CONFIG_NOZZLES      8
+
+struct fms_config_t {
+    // version 1
+    char     wifi_ssid[33];
+    char     wifi_pass[65];
+    char     mqtt_host[33];
+    uint16_t mqtt_port;
+    char     uuid[33];
+    char     protocol[16];
+    uint8_t  devn;
+    uint8_t  noz;
+    uint8_t  pumpids[FMS_CONFIG_NOZZLES];
+    uint32_t prices[FMS_CONFIG_NOZZLES];    // unit price per nozzle, fms_unit_price_t raw, 0 = not set
+    uint16_t live_ms;                       // 0 = firmware default
+    uint8_t  payload;                       // fms_payload_format_t
+};
+
+void   fms_config_defaults(fms_config_t* cfg);
+size_t fms_config_encode(const fms_config_t& cfg, uint8_t* out, size_t cap);   // blob length, 0 if cap is short
+bool   fms_config_decode(const uint8_t* in, size_t len, fms_config_t* out);   // false on bad magic / crc / newer version
+
+#endif // _FMS_CONFIG_H_
@@ -0,0 +1,113 @@
+/*
+ * FMS Connection Manager - reconnect scheduling with jittered backoff
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#include "_fms_conn.h"
+#include <string.h>
+
+fms_conn_manager::fms_conn_manager()
+    : _state(CONN_NO_NETWORK),
+      _minMs(1000),
+      _maxMs(1000),
+      _backoff(1000),
+      _nextAt(0),
+      _downSince(0),
+      _rng(1) {
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+void fms_conn_manager::begin(uint32_t minMs, uint32_t maxMs, uint32_t seed, uint32_t now) {
+    _minMs = minMs ? minMs : 1;
+    _maxMs = maxMs < _minMs ? _minMs : maxMs;
+    _backoff = _minMs;
+    _rng = seed ? seed : 1;
+    _state = CONN_NO_NETWORK;
+    _nextAt = now;
+    _downSince = now;
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+void fms_conn_manager::reset_stats(uint32_t now) {
+    memset(&_stats, 0, sizeof(_stats));
+    if (_state != CONN_CONNECTED) _downSince = now;
+}
+
+const char* fms_conn_manager::state_name(fms_conn_state_t st) {
+    switch (st) {
+        case CONN_NO_NETWORK: return "no_network";
+        case CONN_BACKOFF:    return "backoff";
+        case CONN_CONNECTING: return "connecting";
+        case CONN_CONNECTED:  return "connected";
+    }
+    return "?";
+}
+
+// xorshift32, only has to spread devices apart
+uint32_t fms_conn_manager::jitter(uint32_t span) {
+    _rng ^= _rng << 13;
+    _rng ^= _rng >> 17;
+    _rng ^= _rng << 5;
+    return span ? _rng % (span + 1) : 0;
+}
+
+void fms_conn_manager::set_network(bool up, uint32_t now) {
+    if (!up) {
+        if (_state == CONN_CONNECTED) lost(now);
+        _state = CONN_NO_NETWORK;
+        return;
+    }
+    if (_state == CONN_NO_NETWORK) {
+        _state = CONN_BACKOFF;   // network is back: try at once, from the shortest backoff
+        _backoff = _minMs;
+        _nextAt = now;
+    }
+}
+
+uint32_t fms_conn_manager::wait(uint32_t now) const {
+    if (_state != CONN_BACKOFF) return UINT32_MAX;
+    int32_t left = (int32_t)(_nextAt - now);
+    return left > 0 ? (uint32_t)left : 0;
+}
+
+bool fms_conn_manager::due(uint32_t now, uint32_t* waitMs) {
+    uint32_t w = wait(now);
+    if (_state == CONN_BACKOFF && w == 0) {
+        _state = CONN_CONNECTING;
+        _stats.attempts++;
+        if (waitMs) *waitMs = 0;
+        return true;
+    }
+    if (waitMs) *waitMs = w;
+    return false;
+}
+
+void fms_conn_manager::attempt_done(bool ok, uint32_t now) {
+    if (_state != CONN_CONNECTING) return;
+    if (ok) {
+        uint32_t outage = now - _downSince;
+        _stats.connects++;
+        _stats.last_reconnect_ms = outage;
+        if (outage > _stats.max_reconnect_ms) _stats.max_reconnect_ms = outage;
+        _stats.down_ms += outage;
+        _backoff = _minMs;
+        _state = CONN_CONNECTED;
+        return;
+    }
+    _stats.failures++;
+    _nextAt = now + _backoff / 2 + jitter(_backoff - _backoff / 2);
+    _backoff = _backoff > _maxMs / 2 ? _maxMs : _backoff * 2;
+    _state = CONN_BACKOFF;
+}
+
+void fms_conn_manager::lost(uint32_t now) {
+    if (_state != CONN_CONNECTED) return;
+    _stats.drops++;
+    _downSince = now;
+    _backoff = _minMs;
+    _nextAt = now;          // first retry right away, backoff from there
+    _state = CONN_BACKOFF;
+}
@@ -0,0 +1,91 @@
+/*
+ * FMS Connection Manager - reconnect scheduling with jittered backoff
+ *
+ * Decides when the owner should try to (re)connect a link, it never blocks
+ * and never touches the network itself. Failed attempts double the backoff
+ * up to a cap, each wait is picked at random in [backoff/2, backoff] so a
+ * station of devices does not hammer the broker in step. The network coming
+ * back (Wi-Fi got an address) makes an attempt due at once.
+ *
+ *   no network -> backoff -> connecting -> connected
+ *                    ^___ failed ___|          |___ lost -> backoff
+ *
+ * Every outage is timed: connect attempts, time to reconnect and total time
+ * spent disconnected are kept as counters.
+ *
+ * Plain C++, no Arduino dependency, so it builds on the host as well.
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#ifndef _FMS_CONN_H_
+#define _FMS_CONN_H_
+
+#include <stdint.h>
+
+enum fms_conn_state_t : uint8_t {
+    CONN_NO_NETWORK = 0,    // nothing to connect over
+    CONN_BACKOFF,           // waiting for the next attempt
+    CONN_CONNECTING,        // attempt handed to the owner
+    CONN_CONNECTED
+};
+
+struct fms_conn_stats_t {
+    uint32_t attempts;
+    uint32_t failures;
+    uint32_t connects;
+    uint32_t drops;             // connected -> lost
+    uint32_t last_reconnect_ms; // length of the last outage
+    uint32_t max_reconnect_ms;
+    uint32_t down_ms;           // closed outages, see down_total()
+};
+
+class fms_conn_manager {
+public:
+    fms_conn_manager();
+
+    // The link starts down, the outage runs from now
+    void begin(uint32_t minMs, uint32_t maxMs, uint32_t seed, uint32_t now);
+
+    // Network (Wi-Fi) state, call as often as convenient
+    void set_network(bool up, uint32_t now);
+
+    // True when an attempt should be made now (state becomes connecting),
+    // otherwise the time until the next one (UINT32_MAX without network)
+    bool due(uint32_t now, uint32_t* waitMs);
+
+    // Result of the attempt started after due()
+    void attempt_done(bool ok, uint32_t now);
+
+    // An established link went down
+    void lost(uint32_t now);
+
+    fms_conn_state_t state() const   { return _state; }
+    bool             up() const      { return _state == CONN_CONNECTED; }
+    uint32_t         backoff() const { return _backoff; }
+    uint32_t         wait(uint32_t now) const;
+    uint32_t         down_for(uint32_t now) const { return _state == CONN_CONNECTED ? 0 : now - _downSince; }
+    uint32_t         down_total(uint32_t now) const { return _stats.down_ms + down_for(now); }
+
+    const fms_conn_stats_t& stats() const { return _stats; }
+    void reset_stats(uint32_t now);
+
+    static const char* state_name(fms_conn_state_t st);
+
+private:
+    fms_conn_state_t _state;
+    uint32_t _minMs;
+    uint32_t _maxMs;
+    uint32_t _backoff;
+    uint32_t _nextAt;
+    uint32_t _downSince;
+    uint32_t _rng;
+
+    fms_conn_stats_t _stats;
+
+    uint32_t jitter(uint32_t span);
+};
+
+#endif // _FMS_CONN_H_
@@ -6,14 +6,31 @@
  */
 
 #include "_fms_debug.h"
+#include "_fms_log_ring.h"
 #include <Arduino.h>
 #include <stdarg.h>
 
 static FMSLogLevel currentLogLevel = FMS_LOG_INFO;
+uint8_t fmsLogTagLevel[FMS_TAG_COUNT] = {
+    FMS_LOG_INFO, FMS_LOG_INFO, FMS_LOG_INFO, FMS_LOG_INFO, FMS_LOG_INFO, FMS_LOG_INFO, FMS_LOG_INFO, FMS_LOG_INFO
+};
+static const char* const tagNames[FMS_TAG_COUNT] = { "sys", "wifi", "mqtt", "sd", "nozzle", "proto", "web", "cli" };
+static const char* const levelNames[] = { "none", "error", "warn", "info", "debug", "verbose", "task" };
 static bool logToSerial = true;
 static bool logToSD = false;
 static String logFilePath = "/logs/fms.log";
-extern int s_uart_debug_nr= 0;
+int s_uart_debug_nr = 0;
+
+static char            sinkBuf[2][FMS_LOG_SD_BUF_SIZE];
+static size_t          sinkLen[2];
+static uint8_t         sinkActive = 0;        // fmsLog appends here, the other half is the writer's
+static TaskHandle_t    sinkWriter = NULL;
+static FMSLogSinkStats sinkStats;
+static portMUX_TYPE    sinkMux = portMUX_INITIALIZER_UNLOCKED;
+
+static fms_log_ring    logRing;
+static TaskHandle_t    logDrainTask = NULL;   // set: fmsLog only records, this task prints
+static FMSLogMirror    logMirror = NULL;
 
 int log_printfv(const char *format, va_list arg) {
   static char loc_buf[64];
@@ -50,34 +67,56 @@ int log_printfv(const char *format, va_list arg) {
   return len;
 }
 
-void fmsLog(FMSLogLevel level, const char* format, ...) {
-    if (level > currentLogLevel) {
-        return;
+static const char* fmsLogLevelStr(uint8_t level) {
+    switch (level) {
+        case FMS_LOG_ERROR:   return "ERROR";
+        case FMS_LOG_WARNING: return "WARN";
+        case FMS_LOG_INFO:    return "INFO";
+        case FMS_LOG_DEBUG:   return "DEBUG";
+        case FMS_LOG_VERBOSE: return "VERB";
+        case FMS_LOG_TASK:    return "TASK";
+        default:              return "NONE";
     }
-    
-    // Get current time
-    char timeStr[20];
-    unsigned long ms = millis();
+}
+
+static void fmsLogPrefix(char* prefix, size_t cap, uint8_t level, unsigned long ms) {
     unsigned long seconds = ms / 1000;
     unsigned long minutes = seconds / 60;
     unsigned long hours = minutes / 60;
-    
-    snprintf(timeStr, sizeof(timeStr), "%02lu:%02lu:%02lu.%03lu", 
-             hours, minutes % 60, seconds % 60, ms % 1000);
-    
-    // Get level string
-    const char* levelStr;
-    switch (level) {
-        case FMS_LOG_ERROR:   levelStr = "ERROR"; break;
-        case FMS_LOG_WARNING: levelStr = "WARN"; break;
-        case FMS_LOG_INFO:    levelStr = "INFO"; break;
-        case FMS_LOG_DEBUG:   levelStr = "DEBUG"; break;
-        case FMS_LOG_VERBOSE: levelStr = "VERB"; break;
-        case FMS_LOG_TASK:    levelStr = "TASK"; break;
-        default:              levelStr = "NONE"; break;
+    snprintf(prefix, cap, "[%02lu:%02lu:%02lu.%03lu] [%s] ",
+             hours, minutes % 60, seconds % 60, ms % 1000, fmsLogLevelStr(level));
+}
+
+// Copy one finished line into the active half, the writer task does the card
+static void fmsLogSinkPut(const char* line, size_t n) {
+    portENTER_CRITICAL(&sinkMux);
+    uint8_t a = sinkActive;
+    if (sinkLen[a] + n <= FMS_LOG_SD_BUF_SIZE) {
+        memcpy(sinkBuf[a] + sinkLen[a], line, n);
+        sinkLen[a] += n;
+        sinkStats.records++;
+        sinkStats.bytes += n;
+    } else {
+        sinkStats.drops++;  // writer is behind (slow or missing card)
     }
+    bool wake = sinkLen[a] >= FMS_LOG_SD_BUF_SIZE / 2;
+    portEXIT_CRITICAL(&sinkMux);
+    if (wake) xTaskNotifyGive(sinkWriter);
+}
+
+void fmsLog(FMSLogLevel level, const char* format, ...) {
+    // Deferred: time stamp, format pointer and raw arguments only, formatted by the drain task
+    if (logDrainTask) {
+        va_list args;
+        va_start(args, format);
+        bool ok = logRing.push(millis(), level, format, args);
+        va_end(args);
+        if (ok && logRing.pending() == FMS_LOG_RING_SLOTS / 2) xTaskNotifyGive(logDrainTask);
+        return;
+    }
+
     char prefix[64];
-    snprintf(prefix, sizeof(prefix), "[%s] [%s] ", timeStr, levelStr);
+    fmsLogPrefix(prefix, sizeof(prefix), level, millis());
     if (logToSerial) {
         log_printf("%s", prefix);
         va_list args;
@@ -87,11 +126,126 @@ void fmsLog(FMSLogLevel level, const char* format, ...) {
         log_printf("\n");
     }
     
-    // Log to SD card
-    
+    // Log to SD card and the serial mirror, copies only, the card is the writer task's
+    bool toSink = logToSD && sinkWriter;
+    bool toMirror = logToSerial && logMirror;
+    if (toSink || toMirror) {
+        char line[FMS_LOG_SD_LINE_MAX];
+        size_t n = strlen(prefix);
+        if (n > sizeof(line) - 2) n = sizeof(line) - 2;
+        memcpy(line, prefix, n);
+        va_list args;
+        va_start(args, format);
+        int m = vsnprintf(line + n, sizeof(line) - n - 1, format, args);
+        va_end(args);
+        if (m > 0) n += ((size_t)m < sizeof(line) - n - 1) ? (size_t)m : sizeof(line) - n - 2;
+        line[n++] = '\n';
+        if (toMirror) logMirror(line, n);
+        if (toSink) fmsLogSinkPut(line, n);
+    }
+}
+
+void fmsLogSetMirror(FMSLogMirror mirror) {
+    logMirror = mirror;
+}
+
+void fmsLogDeferredBegin(TaskHandle_t drain) {
+    logDrainTask = drain;
+}
+
+size_t fmsLogDrain(uint32_t waitMs) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs));
+    size_t count = 0;
+    fms_log_rec_t rec;
+    while (logRing.pop(&rec)) {
+        char line[FMS_LOG_DEFER_LINE_MAX];
+        fmsLogPrefix(line, sizeof(line), rec.level, rec.ts_ms);
+        size_t n = strlen(line);
+        n += fms_log_ring::format(rec, line + n, sizeof(line) - n - 1);
+        line[n++] = '\n';
+        if (logToSerial) {
+            log_printf("%.*s", (int)n, line);
+            if (logMirror) logMirror(line, n);
+        }
+        if (logToSD && sinkWriter) {
+            if (n > FMS_LOG_SD_LINE_MAX) { n = FMS_LOG_SD_LINE_MAX; line[n - 1] = '\n'; }
+            fmsLogSinkPut(line, n);
+        }
+        count++;
+    }
+    return count;
+}
+
+void fmsLogRingGetStats(FMSLogRingStats* out) {
+    out->pushed = logRing.pushed();
+    out->drops = logRing.drops();
+    out->pending = logRing.pending();
+    out->high_water = logRing.high_water();
+}
+
+void fmsLogRingResetStats() {
+    logRing.reset_stats();
+}
+
+void fmsLogSinkAttach(TaskHandle_t writer) {
+    sinkWriter = writer;
+}
+
+size_t fmsLogSinkTake(const char** data, uint32_t waitMs) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs));
+    portENTER_CRITICAL(&sinkMux);
+    uint8_t full = sinkActive;
+    sinkActive ^= 1;  // released (empty) by the last fmsLogSinkRelease
+    portEXIT_CRITICAL(&sinkMux);
+    *data = sinkBuf[full];
+    return sinkLen[full];
+}
+
+void fmsLogSinkRelease() {
+    sinkLen[sinkActive ^ 1] = 0;  // only the writer swaps, producers never touch this half
+}
+
+void fmsLogSinkGetStats(FMSLogSinkStats* out) {
+    portENTER_CRITICAL(&sinkMux);
+    *out = sinkStats;
+    portEXIT_CRITICAL(&sinkMux);
+}
+
+void fmsLogSinkResetStats() {
+    portENTER_CRITICAL(&sinkMux);
+    memset(&sinkStats, 0, sizeof(sinkStats));
+    portEXIT_CRITICAL(&sinkMux);
 }
 void fmsSetLogLevel(FMSLogLevel level) {
     currentLogLevel = level;
+    for (int i = 0; i < FMS_TAG_COUNT; i++) fmsLogTagLevel[i] = level;
+}
+
+void fmsSetTagLevel(FMSLogTag tag, FMSLogLevel level) {
+    if (tag < FMS_TAG_COUNT) fmsLogTagLevel[tag] = level;
+}
+
+const char* fmsLogTagName(uint8_t tag) {
+    return tag < FMS_TAG_COUNT ? tagNames[tag] : "?";
+}
+
+int fmsLogTagFind(const char* name) {
+    for (int i = 0; i < FMS_TAG_COUNT; i++) {
+        if (strcasecmp(name, tagNames[i]) == 0) return i;
+    }
+    return -1;
+}
+
+const char* fmsLogLevelName(uint8_t level) {
+    return level < sizeof(levelNames) / sizeof(levelNames[0]) ? levelNames[level] : "?";
+}
+
+int fmsLogLevelFind(const char* name) {
+    for (size_t i = 0; i < sizeof(levelNames) / sizeof(levelNames[0]); i++) {
+        if (strcasecmp(name, levelNames[i]) == 0) return (int)i;
+    }
+    if (strcasecmp(name, "warning") == 0) return FMS_LOG_WARNING;
+    return -1;
 }
 
 FMSLogLevel fmsGetLogLevel() {
@@ -109,3 +263,7 @@ void fmsSetLogFilePath(const char* path) {
     logFilePath = path;
 }
 
+const char* fmsGetLogFilePath() {
+    return logFilePath.c_str();
+}
+
@@ -22,18 +22,143 @@ enum FMSLogLevel {
     FMS_LOG_VERBOSE,
     FMS_LOG_TASK
 };
-void fmsLog(FMSLogLevel level, const char* format, ...);
-#define FMS_LOG_ERROR(format, ...)    fmsLog(FMS_LOG_ERROR, format, ##__VA_ARGS__)
-#define FMS_LOG_WARNING(format, ...)  fmsLog(FMS_LOG_WARNING, format, ##__VA_ARGS__)
-#define FMS_LOG_INFO(format, ...)     fmsLog(FMS_LOG_INFO, format, ##__VA_ARGS__)
-#define FMS_LOG_DEBUG(format, ...)    fmsLog(FMS_LOG_DEBUG, format, ##__VA_ARGS__)
-#define FMS_LOG_VERBOSE(format, ...)  fmsLog(FMS_LOG_VERBOSE, format, ##__VA_ARGS__)
-#define FMS_LOG_TASK(format, ...)     fmsLog(FMS_LOG_TASK, format, ##__VA_ARGS__)
-
-void fmsSetLogLevel(FMSLogLevel level);
+/**
+ * @brief Module tags
+ *
+ * Every FMS_LOG_* call belongs to the module named by FMS_LOG_TAG where it is
+ * written (a source file sets it at the top, SYS otherwise). A call is kept
+ * only if its level is within the module's compile time ceiling
+ * (FMS_LOG_CEIL_<TAG>, set before this header to override the default), so a
+ * disabled call and its argument evaluation are compiled out. The kept calls
+ * check the module's runtime level (fmsSetTagLevel, cli "log_level") before
+ * the arguments are evaluated, so an off call costs one compare.
+ */
+enum FMSLogTag {
+    FMS_TAG_SYS = 0,
+    FMS_TAG_WIFI,
+    FMS_TAG_MQTT,
+    FMS_TAG_SD,
+    FMS_TAG_NOZZLE,
+    FMS_TAG_PROTO,
+    FMS_TAG_WEB,
+    FMS_TAG_CLI,
+    FMS_TAG_COUNT
+};
+
+#ifndef FMS_LOG_CEIL_DEFAULT
+#define FMS_LOG_CEIL_DEFAULT  FMS_LOG_TASK
+#endif
+#ifndef FMS_LOG_CEIL_SYS
+#define FMS_LOG_CEIL_SYS      FMS_LOG_CEIL_DEFAULT
+#endif
+#ifndef FMS_LOG_CEIL_WIFI
+#define FMS_LOG_CEIL_WIFI     FMS_LOG_CEIL_DEFAULT
+#endif
+#ifndef FMS_LOG_CEIL_MQTT
+#define FMS_LOG_CEIL_MQTT     FMS_LOG_CEIL_DEFAULT
+#endif
+#ifndef FMS_LOG_CEIL_SD
+#define FMS_LOG_CEIL_SD       FMS_LOG_CEIL_DEFAULT
+#endif
+#ifndef FMS_LOG_CEIL_NOZZLE
+#define FMS_LOG_CEIL_NOZZLE   FMS_LOG_CEIL_DEFAULT
+#endif
+#ifndef FMS_LOG_CEIL_PROTO
+#define FMS_LOG_CEIL_PROTO    FMS_LOG_CEIL_DEFAULT
+#endif
+#ifndef FMS_LOG_CEIL_WEB
+#define FMS_LOG_CEIL_WEB      FMS_LOG_CEIL_DEFAULT
+#endif
+#ifndef FMS_LOG_CEIL_CLI
+#define FMS_LOG_CEIL_CLI      FMS_LOG_CEIL_DEFAULT
+#endif
+#define FMS_LOG_CEILINGS      { FMS_LOG_CEIL_SYS, FMS_LOG_CEIL_WIFI, FMS_LOG_CEIL_MQTT, FMS_LOG_CEIL_SD, \
+                                FMS_LOG_CEIL_NOZZLE, FMS_LOG_CEIL_PROTO, FMS_LOG_CEIL_WEB, FMS_LOG_CEIL_CLI }
+
+#ifndef FMS_LOG_TAG
+#define FMS_LOG_TAG SYS
+#endif
+
+extern uint8_t fmsLogTagLevel[FMS_TAG_COUNT];
+
+void fmsLog(FMSLogLevel level, const char* format, ...);   // no level check, the macros do it
+
+#define FMS_LOG_ON_(tag, level)       ((level) <= FMS_LOG_CEIL_##tag && (level) <= fmsLogTagLevel[FMS_TAG_##tag])
+#define FMS_LOG_ON_AT(tag, level)     FMS_LOG_ON_(tag, level)
+#define FMS_LOG_ON(level)             FMS_LOG_ON_AT(FMS_LOG_TAG, level)    // guard for work done only to log
+#define FMS_LOG_AT(tag, level, format, ...) do { \
+        if (FMS_LOG_ON_AT(tag, level)) fmsLog(level, format, ##__VA_ARGS__); \
+    } while (0)
+
+#define FMS_LOG_ERROR(format, ...)    FMS_LOG_AT(FMS_LOG_TAG, FMS_LOG_ERROR, format, ##__VA_ARGS__)
+#define FMS_LOG_WARNING(format, ...)  FMS_LOG_AT(FMS_LOG_TAG, FMS_LOG_WARNING, format, ##__VA_ARGS__)
+#define FMS_LOG_INFO(format, ...)     FMS_LOG_AT(FMS_LOG_TAG, FMS_LOG_INFO, format, ##__VA_ARGS__)
+#define FMS_LOG_DEBUG(format, ...)    FMS_LOG_AT(FMS_LOG_TAG, FMS_LOG_DEBUG, format, ##__VA_ARGS__)
+#define FMS_LOG_VERBOSE(format, ...)  FMS_LOG_AT(FMS_LOG_TAG, FMS_LOG_VERBOSE, format, ##__VA_ARGS__)
+#define FMS_LOG_TASK(format, ...)     FMS_LOG_AT(FMS_LOG_TAG, FMS_LOG_TASK, format, ##__VA_ARGS__)
+
+void fmsSetLogLevel(FMSLogLevel level);                  // every module
 FMSLogLevel fmsGetLogLevel();
+void fmsSetTagLevel(FMSLogTag tag, FMSLogLevel level);
+const char* fmsLogTagName(uint8_t tag);
+int  fmsLogTagFind(const char* name);                    // -1 if unknown
+const char* fmsLogLevelName(uint8_t level);
+int  fmsLogLevelFind(const char* name);                  // -1 if unknown
 void fmsEnableSerialLogging(bool enable);
+
+// Gets a copy of every line logged to Serial (prefix + message + '\n'), from the caller or the drain task
+typedef void (*FMSLogMirror)(const char* line, size_t len);
+void fmsLogSetMirror(FMSLogMirror mirror);
 void fmsEnableSDLogging(bool enable);
 void fmsSetLogFilePath(const char* path);
+const char* fmsGetLogFilePath();
+
+/**
+ * @brief SD log sink
+ *
+ * With SD logging on, fmsLog only formats the line and copies it into the
+ * active half of a double buffer; it never waits for the card. A writer task
+ * (fmsLogSinkAttach) swaps the halves with fmsLogSinkTake, writes the full
+ * one out and hands it back with fmsLogSinkRelease. A line that does not fit
+ * in the active half is dropped and counted.
+ */
+#define FMS_LOG_SD_BUF_SIZE   4096     // per half, a multiple of 512
+#define FMS_LOG_SD_LINE_MAX   192      // longer lines are cut
+
+struct FMSLogSinkStats {
+    uint32_t records;
+    uint32_t bytes;
+    uint32_t drops;
+};
+
+void   fmsLogSinkAttach(TaskHandle_t writer);                 // woken when a half is half full
+size_t fmsLogSinkTake(const char** data, uint32_t waitMs);   // writer: wait, swap, the filled half
+void   fmsLogSinkRelease();                                  // writer: done with the taken half
+void   fmsLogSinkGetStats(FMSLogSinkStats* out);
+void   fmsLogSinkResetStats();
+
+/**
+ * @brief Deferred formatting
+ *
+ * Once a drain task is named (fmsLogDeferredBegin), fmsLog no longer formats
+ * or prints: it stores the time stamp, level, format pointer and raw arguments
+ * in a lock free ring (src/_fms_log_ring.h) and returns. The drain task calls
+ * fmsLogDrain in a loop, which formats the records and sends them to Serial and
+ * the SD sink. Before that (setup) fmsLog prints directly as it always has.
+ * Format strings must be literals, %s arguments are copied.
+ */
+#define FMS_LOG_DEFER_LINE_MAX  256     // formatted by the drain task, longer lines are cut
+
+struct FMSLogRingStats {
+    uint32_t pushed;
+    uint32_t drops;                     // ring full, the drain task is behind
+    uint32_t pending;
+    uint32_t high_water;
+};
+
+void   fmsLogDeferredBegin(TaskHandle_t drain);   // woken when the ring is half full
+size_t fmsLogDrain(uint32_t waitMs);              // drain task: wait, print what is queued, records printed
+void   fmsLogRingGetStats(FMSLogRingStats* out);
+void   fmsLogRingResetStats();
 #endif /* FMS_DEBUG_H */
 
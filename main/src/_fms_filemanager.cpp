@@ -456,31 +456,3 @@ void FMS_FileManager::handleFileDownload() {
   
   file.close();
 }
-
-String FMS_FileManager::getContentType(const String& filename) {
-  if (filename.endsWith(".html")) return "text/html";
-  else if (filename.endsWith(".css")) return "text/css";
-  else if (filename.endsWith(".js")) return "application/javascript";
-  else if (filename.endsWith(".json")) return "application/json";
-  else if (filename.endsWith(".png")) return "image/png";
-  else if (filename.endsWith(".jpg")) return "image/jpeg";
-  else if (filename.endsWith(".gif")) return "image/gif";
-  else if (filename.endsWith(".ico")) return "image/x-icon";
-  else if (filename.endsWith(".xml")) return "text/xml";
-  else if (filename.endsWith(".pdf")) return "application/pdf";
-  else if (filename.endsWith(".zip")) return "application/zip";
-  else if (filename.endsWith(".gz")) return "application/x-gzip";
-  else if (filename.endsWith(".txt")) return "text/plain";
-  return "application/octet-stream";
-}
-
-String FMS_FileManager::formatBytes(size_t bytes) {
-  if (bytes < 1024) {
-    return String(bytes) + " B";
-  } else if (bytes < (1024 * 1024)) {
-    return String(bytes / 1024.0, 2) + " KB";
-  } else if (bytes < (1024 * 1024 * 1024)) {
-    return String(bytes / 1024.0 / 1024.0, 2) + " MB";
-  }
-  return String(bytes / 1024.0 / 1024.0 / 1024.0, 2) + " GB";
-}
\ No newline at end of file
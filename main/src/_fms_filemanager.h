@@ -43,6 +43,10 @@ public:
   
   // Check and repair file system if needed
   bool checkFileSystem();
+
+  // Helper methods (_fms_filemanager_fmt.cpp)
+  static String getContentType(const String& filename);
+  static String formatBytes(size_t bytes);
   
 private:
   // Configuration
@@ -56,10 +60,6 @@ private:
   void handleFileDelete();
   void handleFileDownload();
   void handleNotFound();
-  
-  // Helper methods
-  String getContentType(const String& filename);
-  String formatBytes(size_t bytes);
 };
 
 #endif // FMS_FILEMANAGER_H
\ No newline at end of file
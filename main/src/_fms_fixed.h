@@ -0,0 +1,176 @@
+/*
+ * FMS Fixed - integer fixed-point volume / money / unit price
+ *
+ * Values are int64 counts of 10^-decimals units, so sums never drift and
+ * printing never goes through float. liters x price -> amount is overflow
+ * checked and rounds half away from zero.
+ *
+ * Plain C++, header only, builds on the host as well.
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#ifndef _FMS_FIXED_H_
+#define _FMS_FIXED_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FMS_VOLUME_DECIMALS   3     // 0.001 liter
+#define FMS_MONEY_DECIMALS    0     // whole currency units
+#define FMS_PRICE_DECIMALS    0     // whole currency units per liter
+
+constexpr int64_t fms_pow10(uint8_t n) {
+    return n == 0 ? 1 : 10 * fms_pow10(n - 1);
+}
+
+// Unsigned integer to decimal, no terminator, returns the digit count
+inline size_t fms_fmt_u64(char* out, uint64_t v) {
+    static const char pairs[201] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    char tmp[20];
+    char* p = tmp + sizeof(tmp);
+    while (v >= 100) {
+        unsigned i = (unsigned)(v % 100) * 2;
+        v /= 100;
+        *--p = pairs[i + 1];
+        *--p = pairs[i];
+    }
+    if (v >= 10) {
+        unsigned i = (unsigned)v * 2;
+        *--p = pairs[i + 1];
+        *--p = pairs[i];
+    } else {
+        *--p = (char)('0' + v);
+    }
+    size_t n = (size_t)(tmp + sizeof(tmp) - p);
+    for (size_t k = 0; k < n; k++) out[k] = p[k];
+    return n;
+}
+
+template <typename Tag, uint8_t Decimals>
+struct fms_fixed {
+    static constexpr uint8_t decimals = Decimals;
+    static constexpr int64_t scale = fms_pow10(Decimals);
+
+    int64_t raw;
+
+    static constexpr fms_fixed from_raw(int64_t r) { return fms_fixed{ r }; }
+    static constexpr fms_fixed from_units(int64_t u) { return fms_fixed{ u * scale }; }
+
+    // Rescale a value that carries a different number of decimals (e.g. a dispenser register)
+    static constexpr fms_fixed from_scaled(int64_t v, uint8_t dec) {
+        return dec == Decimals ? fms_fixed{ v }
+             : dec < Decimals ? fms_fixed{ v * fms_pow10(Decimals - dec) }
+             : fms_fixed{ round_div(v, fms_pow10(dec - Decimals)) };
+    }
+
+    // Parse "123", "12.5", "-0.250"; extra decimals are rounded, false on junk or overflow
+    static bool parse(const char* s, size_t len, fms_fixed* out) {
+        size_t i = 0;
+        bool neg = false;
+        if (i < len && (s[i] == '-' || s[i] == '+')) neg = (s[i++] == '-');
+        int64_t v = 0;
+        uint8_t frac = 0;
+        bool dot = false, any = false, roundUp = false;
+        for (; i < len; i++) {
+            char c = s[i];
+            if (c == '.' && !dot) { dot = true; continue; }
+            if (c < '0' || c > '9') return false;
+            any = true;
+            if (dot && frac >= Decimals) {
+                if (frac == Decimals) roundUp = (c >= '5');  // first dropped digit decides
+                frac++;
+                continue;
+            }
+            if (__builtin_mul_overflow(v, (int64_t)10, &v) || __builtin_add_overflow(v, (int64_t)(c - '0'), &v)) return false;
+            if (dot) frac++;
+        }
+        if (!any) return false;
+        for (uint8_t k = frac; k < Decimals; k++) {
+            if (__builtin_mul_overflow(v, (int64_t)10, &v)) return false;
+        }
+        if (roundUp) v++;
+        out->raw = neg ? -v : v;
+        return true;
+    }
+
+    // Decimal text straight into out (no terminator), returns length; out needs 22 bytes
+    size_t format(char* out) const {
+        size_t n = 0;
+        uint64_t mag = raw < 0 ? (uint64_t)0 - (uint64_t)raw : (uint64_t)raw;
+        if (raw < 0) out[n++] = '-';
+        n += fms_fmt_u64(out + n, mag / (uint64_t)scale);
+        if (Decimals > 0) {
+            out[n++] = '.';
+            uint64_t f = mag % (uint64_t)scale;
+            for (int k = Decimals - 1; k >= 0; k--) {
+                out[n + k] = (char)('0' + f % 10);
+                f /= 10;
+            }
+            n += Decimals;
+        }
+        return n;
+    }
+
+    // Same as format() with a terminating NUL when it fits
+    size_t format(char* out, size_t cap) const {
+        char tmp[24];
+        size_t n = format(tmp);
+        if (n + 1 > cap) return 0;
+        for (size_t k = 0; k < n; k++) out[k] = tmp[k];
+        out[n] = '\0';
+        return n;
+    }
+
+    constexpr fms_fixed operator+(fms_fixed o) const { return fms_fixed{ raw + o.raw }; }
+    constexpr fms_fixed operator-(fms_fixed o) const { return fms_fixed{ raw - o.raw }; }
+    fms_fixed& operator+=(fms_fixed o) { raw += o.raw; return *this; }
+    fms_fixed& operator-=(fms_fixed o) { raw -= o.raw; return *this; }
+    constexpr bool operator==(fms_fixed o) const { return raw == o.raw; }
+    constexpr bool operator!=(fms_fixed o) const { return raw != o.raw; }
+    constexpr bool operator<(fms_fixed o) const { return raw < o.raw; }
+    constexpr bool operator>(fms_fixed o) const { return raw > o.raw; }
+    constexpr bool operator<=(fms_fixed o) const { return raw <= o.raw; }
+    constexpr bool operator>=(fms_fixed o) const { return raw >= o.raw; }
+
+    static constexpr int64_t round_div(int64_t n, int64_t d) {
+        return n >= 0 ? (n + d / 2) / d : -((-n + d / 2) / d);
+    }
+};
+
+struct fms_volume_tag {};
+struct fms_money_tag {};
+struct fms_price_tag {};
+
+typedef fms_fixed<fms_volume_tag, FMS_VOLUME_DECIMALS> fms_volume_t;
+typedef fms_fixed<fms_money_tag, FMS_MONEY_DECIMALS>   fms_money_t;
+typedef fms_fixed<fms_price_tag, FMS_PRICE_DECIMALS>   fms_unit_price_t;
+
+// amount = volume x unit price, false (out untouched) on overflow
+inline bool fms_amount_of(fms_volume_t volume, fms_unit_price_t price, fms_money_t* out) {
+    constexpr int64_t num = fms_money_t::scale;
+    constexpr int64_t den = fms_volume_t::scale * fms_unit_price_t::scale;
+    int64_t p;
+    if (__builtin_mul_overflow(volume.raw, price.raw, &p)) return false;
+    if (num > 1 && __builtin_mul_overflow(p, num, &p)) return false;
+    out->raw = fms_money_t::round_div(p, den);
+    return true;
+}
+
+// volume bought for an amount at a unit price (money preset), false on zero price / overflow
+inline bool fms_volume_for(fms_money_t amount, fms_unit_price_t price, fms_volume_t* out) {
+    if (price.raw <= 0) return false;
+    constexpr int64_t num = fms_volume_t::scale * fms_unit_price_t::scale;
+    constexpr int64_t den = fms_money_t::scale;
+    int64_t p;
+    if (__builtin_mul_overflow(amount.raw, num, &p)) return false;
+    out->raw = fms_volume_t::round_div(p, den * price.raw);
+    return true;
+}
+
+#endif // _FMS_FIXED_H_
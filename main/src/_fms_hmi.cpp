@@ -0,0 +1,162 @@
+/*
+ * FMS HMI - state diffed writer for the touch display on uart2
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#include "_fms_hmi.h"
+#include <string.h>
+
+fms_hmi_writer::fms_hmi_writer()
+    : _iconCount(0),
+      _textCount(0),
+      _iconDirty(0),
+      _textDirty(0),
+      _iconForce(0),
+      _textForce(0) {
+    memset(_iconOrder, 0, sizeof(_iconOrder));
+    memset(_iconVp, 0, sizeof(_iconVp));
+    memset(_iconWant, 0, sizeof(_iconWant));
+    memset(_iconSent, 0, sizeof(_iconSent));
+    memset(_textVp, 0, sizeof(_textVp));
+    memset(_textWant, 0, sizeof(_textWant));
+    memset(_textSent, 0, sizeof(_textSent));
+    reset_stats();
+}
+
+void fms_hmi_writer::reset_stats() {
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+int8_t fms_hmi_writer::add_icon(uint16_t vp) {
+    if (_iconCount >= FMS_HMI_MAX_ICONS) {
+        return -1;
+    }
+    uint8_t slot = _iconCount++;
+    _iconVp[slot] = vp;
+    _iconForce |= (1U << slot);  // the display state is unknown until the first write
+
+    // keep _iconOrder sorted by vp so neighbours merge into one frame
+    uint8_t k = slot;
+    while (k > 0 && _iconVp[_iconOrder[k - 1]] > vp) {
+        _iconOrder[k] = _iconOrder[k - 1];
+        k--;
+    }
+    _iconOrder[k] = slot;
+    return slot;
+}
+
+int8_t fms_hmi_writer::add_text(uint16_t vp) {
+    if (_textCount >= FMS_HMI_MAX_TEXTS) {
+        return -1;
+    }
+    uint8_t slot = _textCount++;
+    _textVp[slot] = vp;
+    _textForce |= (1U << slot);
+    return slot;
+}
+
+bool fms_hmi_writer::set_icon(int8_t slot, uint16_t value) {
+    if (slot < 0 || slot >= _iconCount) {
+        return false;
+    }
+    _stats.sets++;
+    if (_iconWant[slot] == value) {
+        _stats.suppressed++;
+        return false;
+    }
+    _iconWant[slot] = value;
+    if (value != _iconSent[slot]) _iconDirty |= (1U << slot);
+    else                          _iconDirty &= ~(1U << slot);  // changed back before it went out
+    return true;
+}
+
+bool fms_hmi_writer::set_text(int8_t slot, const char* text) {
+    if (slot < 0 || slot >= _textCount || text == NULL) {
+        return false;
+    }
+    _stats.sets++;
+    if (strncmp(_textWant[slot], text, FMS_HMI_TEXT_LEN - 1) == 0) {
+        _stats.suppressed++;
+        return false;
+    }
+    strncpy(_textWant[slot], text, FMS_HMI_TEXT_LEN - 1);
+    _textWant[slot][FMS_HMI_TEXT_LEN - 1] = '\0';
+    if (strcmp(_textWant[slot], _textSent[slot]) != 0) _textDirty |= (1U << slot);
+    else                                               _textDirty &= ~(1U << slot);
+    return true;
+}
+
+void fms_hmi_writer::invalidate() {
+    _iconForce = (uint8_t)((1U << _iconCount) - 1);
+    _textForce = (uint8_t)((1U << _textCount) - 1);
+}
+
+size_t fms_hmi_writer::put_header(uint8_t* out, uint16_t vp, uint8_t dataLen) {
+    out[0] = 0x5A;
+    out[1] = 0xA5;
+    out[2] = (uint8_t)(3 + dataLen);
+    out[3] = FMS_HMI_CMD_WRITE;
+    out[4] = (uint8_t)(vp >> 8);
+    out[5] = (uint8_t)vp;
+    return 6;
+}
+
+size_t fms_hmi_writer::flush(uint8_t* out, size_t cap) {
+    size_t n = 0;
+    uint8_t frames = 0;
+    const uint8_t iconPending = _iconDirty | _iconForce;
+
+    // icons, runs of consecutive vp in one frame
+    for (uint8_t k = 0; k < _iconCount;) {
+        uint8_t slot = _iconOrder[k];
+        if (!(iconPending & (1U << slot))) {
+            k++;
+            continue;
+        }
+        uint8_t run = 1;
+        while (k + run < _iconCount) {
+            uint8_t next = _iconOrder[k + run];
+            if (!(iconPending & (1U << next)) || _iconVp[next] != _iconVp[_iconOrder[k + run - 1]] + 1) break;
+            run++;
+        }
+        if (n + 6 + run * 2 > cap) break;
+        n += put_header(out + n, _iconVp[slot], run * 2);
+        for (uint8_t r = 0; r < run; r++) {
+            uint8_t s = _iconOrder[k + r];
+            out[n++] = (uint8_t)(_iconWant[s] >> 8);
+            out[n++] = (uint8_t)_iconWant[s];
+            _iconSent[s] = _iconWant[s];
+            _iconDirty &= ~(1U << s);
+            _iconForce &= ~(1U << s);
+        }
+        frames++;
+        k += run;
+    }
+
+    // texts, terminated with FF FF
+    const uint8_t textPending = _textDirty | _textForce;
+    for (uint8_t slot = 0; slot < _textCount; slot++) {
+        if (!(textPending & (1U << slot))) continue;
+        size_t len = strlen(_textWant[slot]);
+        if (n + 6 + len + 2 > cap) break;
+        n += put_header(out + n, _textVp[slot], (uint8_t)(len + 2));
+        memcpy(out + n, _textWant[slot], len);
+        n += len;
+        out[n++] = 0xFF;
+        out[n++] = 0xFF;
+        memcpy(_textSent[slot], _textWant[slot], len + 1);
+        _textDirty &= ~(1U << slot);
+        _textForce &= ~(1U << slot);
+        frames++;
+    }
+
+    if (n) {
+        _stats.flushes++;
+        _stats.frames += frames;
+        _stats.bytes += n;
+    }
+    return n;
+}
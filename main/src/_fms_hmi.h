@@ -0,0 +1,87 @@
+/*
+ * FMS HMI - state diffed writer for the touch display on uart2
+ *
+ * Callers set what the display should show (icon values, short texts); the
+ * writer remembers what was last sent and flush() emits only the slots that
+ * changed, all of them in one buffer so the port sees one write per tick.
+ * Icons on consecutive VP addresses go out as a single variable write.
+ *
+ *   frame: 5A A5 len 82 vpH vpL data..   (len = bytes after len)
+ *
+ * Not thread safe, the caller serializes set_* and flush().
+ *
+ * Plain C++, no Arduino dependency, so it builds on the host as well.
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#ifndef _FMS_HMI_H_
+#define _FMS_HMI_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FMS_HMI_MAX_ICONS   8
+#define FMS_HMI_MAX_TEXTS   4
+#define FMS_HMI_TEXT_LEN    24      // text slot size, the display pads the rest
+#define FMS_HMI_CMD_WRITE   0x82
+#define FMS_HMI_FLUSH_MAX   (FMS_HMI_MAX_ICONS * 8 + FMS_HMI_MAX_TEXTS * (8 + FMS_HMI_TEXT_LEN))  // worst case flush()
+
+struct fms_hmi_stats_t {
+    uint32_t sets;          // set_icon / set_text calls
+    uint32_t suppressed;    // calls that matched the pending state
+    uint32_t flushes;       // flush() calls that wrote something
+    uint32_t frames;
+    uint32_t bytes;
+    uint32_t deferred;      // flushes skipped because the link was busy
+};
+
+class fms_hmi_writer {
+public:
+    fms_hmi_writer();
+
+    // Register display variables, returns the slot or -1 when full
+    int8_t add_icon(uint16_t vp);
+    int8_t add_text(uint16_t vp);
+
+    // Desired state, true if this differs from what is pending
+    bool set_icon(int8_t slot, uint16_t value);
+    bool set_text(int8_t slot, const char* text);
+
+    bool   pending() const { return (_iconDirty | _textDirty | _iconForce | _textForce) != 0; }
+
+    // Frames for every changed slot into out, returns the length; slots that
+    // do not fit stay pending for the next flush
+    size_t flush(uint8_t* out, size_t cap);
+
+    // Display restarted: resend everything on the next flush
+    void invalidate();
+
+    void note_deferred() { _stats.deferred++; }
+
+    const fms_hmi_stats_t& stats() const { return _stats; }
+    void reset_stats();
+
+private:
+    uint8_t  _iconCount;
+    uint8_t  _textCount;
+    uint8_t  _iconDirty;                        // bit per icon slot, want != sent
+    uint8_t  _textDirty;                        // bit per text slot, want != sent
+    uint8_t  _iconForce;                        // resend even if unchanged
+    uint8_t  _textForce;
+    uint8_t  _iconOrder[FMS_HMI_MAX_ICONS];     // slots by ascending vp
+    uint16_t _iconVp[FMS_HMI_MAX_ICONS];
+    uint16_t _iconWant[FMS_HMI_MAX_ICONS];
+    uint16_t _iconSent[FMS_HMI_MAX_ICONS];
+    uint16_t _textVp[FMS_HMI_MAX_TEXTS];
+    char     _textWant[FMS_HMI_MAX_TEXTS][FMS_HMI_TEXT_LEN];
+    char     _textSent[FMS_HMI_MAX_TEXTS][FMS_HMI_TEXT_LEN];
+
+    fms_hmi_stats_t _stats;
+
+    size_t put_header(uint8_t* out, uint16_t vp, uint8_t dataLen);
+};
+
+#endif // _FMS_HMI_H_
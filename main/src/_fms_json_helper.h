@@ -68,6 +68,18 @@ public:
     firstItem = false;
   }
 
+  // Add an already encoded JSON value (object / array)
+  void addRaw(const char* key, const String& value) {
+    if (!firstItem) {
+      json += ",";
+    }
+    json += "\"";
+    json += key;
+    json += "\":";
+    json += value;
+    firstItem = false;
+  }
+
   // Get the final JSON string
   String toString() {
     return json + "}";
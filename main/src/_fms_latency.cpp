@@ -0,0 +1,110 @@
+/*
+ * FMS Latency - per nozzle sale stage timestamps and latency histograms
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#include "_fms_latency.h"
+#include <stdio.h>
+#include <string.h>
+
+static const uint32_t bucket_bounds[FMS_LAT_BUCKETS] = {
+    10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 30000, UINT32_MAX
+};
+
+struct lat_span_def_t {
+    const char* name;
+    uint8_t     from;
+    uint8_t     to;
+};
+
+static const lat_span_def_t span_defs[LAT_SPAN_COUNT] = {
+    { "permit",    LAT_LIFT,          LAT_PERMIT_PUB    },
+    { "server",    LAT_PERMIT_PUB,    LAT_APPROVAL_RX   },
+    { "approve",   LAT_APPROVAL_RX,   LAT_PUMP_APPROVED },
+    { "dispenser", LAT_PUMP_APPROVED, LAT_FIRST_LIVE    },
+    { "flow",      LAT_LIFT,          LAT_FIRST_LIVE    },
+    { "final",     LAT_SALE_END,      LAT_FINAL_PUB     },
+};
+
+fms_latency::fms_latency() : _count(0) {
+    reset();
+}
+
+bool fms_latency::begin(uint8_t count) {
+    if (count == 0 || count > FMS_LAT_MAX_NOZZLES) return false;
+    _count = count;
+    return true;
+}
+
+void fms_latency::reset() {
+    memset(_stamp, 0, sizeof(_stamp));
+    memset(_hist, 0, sizeof(_hist));
+}
+
+uint32_t fms_latency::bound(uint8_t bucket) {
+    return bucket < FMS_LAT_BUCKETS ? bucket_bounds[bucket] : UINT32_MAX;
+}
+
+const char* fms_latency::span_name(fms_lat_span_t span) {
+    return span < LAT_SPAN_COUNT ? span_defs[span].name : "?";
+}
+
+void fms_latency::mark(uint8_t noz, fms_lat_stage_t stage, uint32_t now) {
+    if (noz >= _count || stage >= LAT_STAGE_COUNT) return;
+    uint32_t* st = _stamp[noz];
+    if (stage == LAT_LIFT) {
+        memset(st, 0, sizeof(_stamp[noz]));  // new sale
+    } else if (st[stage]) {
+        return;                              // first stamp of the sale wins
+    }
+    st[stage] = now ? now : 1;
+
+    for (uint8_t s = 0; s < LAT_SPAN_COUNT; s++) {
+        if (span_defs[s].to != stage || st[span_defs[s].from] == 0) continue;
+        uint32_t ms = st[stage] - st[span_defs[s].from];
+        fms_lat_hist_t& h = _hist[noz][s];
+        uint8_t b = 0;
+        while (ms > bucket_bounds[b]) b++;
+        h.buckets[b]++;
+        h.count++;
+        h.sum_ms += ms;
+        if (ms > h.max_ms) h.max_ms = ms;
+    }
+}
+
+uint32_t fms_latency::percentile(uint8_t noz, fms_lat_span_t span, uint8_t pct) const {
+    const fms_lat_hist_t& h = _hist[noz][span];
+    if (h.count == 0) return 0;
+    uint32_t rank = (h.count * (uint32_t)pct + 99) / 100;
+    uint32_t seen = 0;
+    for (uint8_t b = 0; b < FMS_LAT_BUCKETS; b++) {
+        seen += h.buckets[b];
+        if (seen >= rank) return bucket_bounds[b] < h.max_ms ? bucket_bounds[b] : h.max_ms;
+    }
+    return h.max_ms;
+}
+
+size_t fms_latency::span_json(uint8_t noz, fms_lat_span_t span, bool buckets, char* out, size_t cap) const {
+    const fms_lat_hist_t& h = _hist[noz][span];
+    int n = snprintf(out, cap, "{\"n\":%lu,\"avg\":%lu,\"max\":%lu,\"p50\":%lu,\"p90\":%lu",
+                     (unsigned long)h.count, (unsigned long)(h.count ? h.sum_ms / h.count : 0), (unsigned long)h.max_ms,
+                     (unsigned long)percentile(noz, span, 50), (unsigned long)percentile(noz, span, 90));
+    if (n < 0 || (size_t)n >= cap) return 0;
+    size_t len = (size_t)n;
+    if (buckets) {
+        for (uint8_t b = 0; b < FMS_LAT_BUCKETS; b++) {
+            n = snprintf(out + len, cap - len, "%s%lu", b ? "," : ",\"buckets\":[", (unsigned long)h.buckets[b]);
+            if (n < 0 || (size_t)n >= cap - len) return 0;
+            len += (size_t)n;
+        }
+        if (len + 1 >= cap) return 0;
+        out[len++] = ']';
+    }
+    if (len + 1 >= cap) return 0;
+    out[len++] = '}';
+    out[len] = '\0';
+    return len;
+}
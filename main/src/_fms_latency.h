@@ -0,0 +1,94 @@
+/*
+ * FMS Latency - per nozzle sale stage timestamps and latency histograms
+ *
+ * Each sale is stamped at fixed stages; the time between two stages (a span)
+ * goes into a fixed bucket histogram per nozzle:
+ *
+ *   lift -> permit published -> approval received -> pump approved -> first live
+ *                                                     ... sale end -> Final published
+ *
+ *   permit     lift -> permit published            device: outbox, queue, broker write
+ *   server     permit published -> approval rx     broker + local server round trip
+ *   approve    approval rx -> pump approved        device: engine queue, dispenser command
+ *   dispenser  pump approved -> first live         dispenser start
+ *   flow       lift -> first live                  what the driver waits for
+ *   final      sale end -> Final published         device: outbox, broker write
+ *
+ * A stage keeps its first stamp of the sale, lift starts a new sale. Stamps
+ * may come from several tasks, but every span is closed by the task that
+ * marks its end stage, so each histogram has a single writer.
+ *
+ * Plain C++, no Arduino dependency, so it builds on the host as well.
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#ifndef _FMS_LATENCY_H_
+#define _FMS_LATENCY_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FMS_LAT_MAX_NOZZLES 8
+#define FMS_LAT_BUCKETS     12      // upper bounds in fms_latency::bound(), the last one is open
+
+enum fms_lat_stage_t : uint8_t {
+    LAT_LIFT = 0,
+    LAT_PERMIT_PUB,
+    LAT_APPROVAL_RX,
+    LAT_PUMP_APPROVED,
+    LAT_FIRST_LIVE,
+    LAT_SALE_END,
+    LAT_FINAL_PUB,
+    LAT_STAGE_COUNT
+};
+
+enum fms_lat_span_t : uint8_t {
+    LAT_SPAN_PERMIT = 0,
+    LAT_SPAN_SERVER,
+    LAT_SPAN_APPROVE,
+    LAT_SPAN_DISPENSER,
+    LAT_SPAN_FLOW,
+    LAT_SPAN_FINAL,
+    LAT_SPAN_COUNT
+};
+
+struct fms_lat_hist_t {
+    uint32_t count;
+    uint32_t sum_ms;
+    uint32_t max_ms;
+    uint32_t buckets[FMS_LAT_BUCKETS];
+};
+
+class fms_latency {
+public:
+    fms_latency();
+
+    bool begin(uint8_t count);
+
+    // Stamp a stage of the nozzle's current sale, closes the spans ending here
+    void mark(uint8_t noz, fms_lat_stage_t stage, uint32_t now);
+
+    const fms_lat_hist_t& hist(uint8_t noz, fms_lat_span_t span) const { return _hist[noz][span]; }
+
+    // Upper bound (ms) of the bucket holding the pct percentile, max_ms for the open bucket
+    uint32_t percentile(uint8_t noz, fms_lat_span_t span, uint8_t pct) const;
+
+    // {"n":..,"avg":..,"max":..,"p50":..,"p90":..[,"buckets":[..]]} , returns the length
+    size_t span_json(uint8_t noz, fms_lat_span_t span, bool buckets, char* out, size_t cap) const;
+
+    uint8_t count() const { return _count; }
+    void    reset();
+
+    static uint32_t    bound(uint8_t bucket);
+    static const char* span_name(fms_lat_span_t span);
+
+private:
+    uint8_t        _count;
+    uint32_t       _stamp[FMS_LAT_MAX_NOZZLES][LAT_STAGE_COUNT];   // 0 = not reached this sale
+    fms_lat_hist_t _hist[FMS_LAT_MAX_NOZZLES][LAT_SPAN_COUNT];
+};
+
+#endif // _FMS_LATENCY_H_
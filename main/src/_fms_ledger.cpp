@@ -0,0 +1,425 @@
+/*
+ * FMS Ledger - indexed sales ledger in daily segment files
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#include "_fms_ledger.h"
+#include <stdio.h>
+#include <string.h>
+
+#define SECONDS_PER_DAY   86400
+#define READ_BLOCK        8           // records per io read while scanning
+#define INDEX_BLOCK       16          // sparse index entries per io read
+
+// ---- record ----
+
+static void put_u32(uint8_t* out, uint32_t v) {
+    for (int i = 0; i < 4; i++) out[i] = (uint8_t)(v >> (8 * i));
+}
+
+static uint32_t get_u32(const uint8_t* in) {
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+// crc-16/ccitt-false over the record without its crc field
+static uint16_t rec_crc(const uint8_t* b) {
+    uint16_t crc = 0xFFFF;
+    for (int i = 0; i < FMS_LEDGER_REC_SIZE; i++) {
+        if (i == 10 || i == 11) continue;
+        crc ^= (uint16_t)b[i] << 8;
+        for (int k = 0; k < 8; k++) crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+static bool fits_u32(int64_t v) {
+    return v >= 0 && v <= 0xFFFFFFFFLL;
+}
+
+static bool pack(const fms_ledger_rec_t& r, uint8_t* b) {
+    if (!fits_u32(r.price.raw) || !fits_u32(r.volume.raw) || !fits_u32(r.amount.raw) || r.total.raw < 0) return false;
+    put_u32(b, r.id);
+    put_u32(b + 4, r.ts);
+    b[8] = r.pump;
+    b[9] = 0;
+    put_u32(b + 12, (uint32_t)r.price.raw);
+    put_u32(b + 16, (uint32_t)r.volume.raw);
+    put_u32(b + 20, (uint32_t)r.amount.raw);
+    put_u32(b + 24, (uint32_t)r.total.raw);
+    put_u32(b + 28, (uint32_t)((uint64_t)r.total.raw >> 32));
+    uint16_t crc = rec_crc(b);
+    b[10] = (uint8_t)crc;
+    b[11] = (uint8_t)(crc >> 8);
+    return true;
+}
+
+static bool unpack(const uint8_t* b, uint32_t id, fms_ledger_rec_t* r) {
+    if (rec_crc(b) != (uint16_t)(b[10] | (b[11] << 8)) || get_u32(b) != id) return false;
+    r->id     = id;
+    r->ts     = get_u32(b + 4);
+    r->pump   = b[8];
+    r->price  = fms_unit_price_t::from_raw(get_u32(b + 12));
+    r->volume = fms_volume_t::from_raw(get_u32(b + 16));
+    r->amount = fms_money_t::from_raw(get_u32(b + 20));
+    r->total  = fms_volume_t::from_raw((int64_t)((uint64_t)get_u32(b + 24) | ((uint64_t)get_u32(b + 28) << 32)));
+    return true;
+}
+
+// ---- calendar (days since 1970-01-01, proleptic gregorian) ----
+
+uint32_t fms_ledger::day_from_date(int y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const int era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = (unsigned)(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return (uint32_t)(era * 146097 + (int)doe - 719468);
+}
+
+void fms_ledger::date_of_day(uint32_t day, int* y, unsigned* m, unsigned* d) {
+    const uint32_t z = day + 719468;
+    const uint32_t era = z / 146097;
+    const unsigned doe = z - era * 146097;
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    *d = doy - (153 * mp + 2) / 5 + 1;
+    *m = mp < 10 ? mp + 3 : mp - 9;
+    *y = (int)(yoe + era * 400) + (*m <= 2);
+}
+
+bool fms_ledger::parse_date(const char* s, uint32_t* day) {
+    if (strlen(s) != 10 || s[4] != '-' || s[7] != '-') return false;
+    int v[3] = { 0, 0, 0 };
+    const int start[3] = { 0, 5, 8 }, len[3] = { 4, 2, 2 };
+    for (int f = 0; f < 3; f++) {
+        for (int i = start[f]; i < start[f] + len[f]; i++) {
+            if (s[i] < '0' || s[i] > '9') return false;
+            v[f] = v[f] * 10 + (s[i] - '0');
+        }
+    }
+    if (v[0] < 1970 || v[1] < 1 || v[1] > 12 || v[2] < 1 || v[2] > 31) return false;
+    uint32_t dd = day_from_date(v[0], (unsigned)v[1], (unsigned)v[2]);
+    int y;
+    unsigned m, d;
+    date_of_day(dd, &y, &m, &d);
+    if (y != v[0] || (int)m != v[1] || (int)d != v[2]) return false;   // 2025-02-30
+    *day = dd;
+    return true;
+}
+
+uint32_t fms_ledger::day_of(uint32_t ts) const {
+    int64_t t = (int64_t)ts + _tz;
+    return t > 0 ? (uint32_t)(t / SECONDS_PER_DAY) : 0;
+}
+
+uint32_t fms_ledger::day_start(uint32_t day) const {
+    int64_t t = (int64_t)day * SECONDS_PER_DAY - _tz;
+    return t < 0 ? 0 : t > 0xFFFFFFFFLL ? 0xFFFFFFFF : (uint32_t)t;
+}
+
+// ---- ledger ----
+
+fms_ledger::fms_ledger()
+    : _tz(0),
+      _ready(false),
+      _days(0),
+      _day(0),
+      _segFirst(1),
+      _segCount(0),
+      _lastId(0),
+      _lastTs(0) {
+    memset(&_io, 0, sizeof(_io));
+    _dir[0] = _daysPath[0] = '\0';
+    reset_stats();
+}
+
+void fms_ledger::reset_stats() {
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+void fms_ledger::seg_path(char* out, uint32_t day, const char* ext) const {
+    int y;
+    unsigned m, d;
+    date_of_day(day, &y, &m, &d);
+    snprintf(out, FMS_LEDGER_PATH_MAX, "%s/%04d%02u%02u.%s", _dir, y, m, d, ext);
+}
+
+// size in whole units, a torn tail is cut off
+uint32_t fms_ledger::whole(const char* path, uint32_t unit) {
+    uint32_t sz = _io.size(path, _io.ctx);
+    if (sz % unit) {
+        sz -= sz % unit;
+        _io.truncate(path, sz, _io.ctx);
+    }
+    return sz / unit;
+}
+
+bool fms_ledger::begin(const fms_ledger_io_t& io, const char* dir, int32_t tzOffset) {
+    if (strlen(dir) > FMS_LEDGER_DIR_MAX) return false;
+    _io = io;
+    _tz = tzOffset;
+    strcpy(_dir, dir);
+    snprintf(_daysPath, sizeof(_daysPath), "%s/days.idx", _dir);
+
+    _days = whole(_daysPath, 8);
+    _lastId = 0;
+    _lastTs = 0;
+    _segCount = 0;
+    _segFirst = 1;
+    if (_days > 0 && read_day(_days - 1, &_day, &_segFirst)) {
+        char p[FMS_LEDGER_PATH_MAX];
+        seg_path(p, _day, "dat");
+        _segCount = whole(p, FMS_LEDGER_REC_SIZE);
+        _lastId = _segFirst + _segCount - 1;
+        _lastTs = day_start(_day);
+        fms_ledger_rec_t r;
+        for (uint32_t n = _segCount; n > 0 && _segCount - n < READ_BLOCK; n--) {
+            if (read_rec(_day, _segFirst, n - 1, &r)) {
+                _lastTs = r.ts;
+                break;
+            }
+        }
+        rebuild_index();
+    }
+    _ready = true;
+    return true;
+}
+
+// the current segment's sparse index matches its records
+void fms_ledger::rebuild_index() {
+    char p[FMS_LEDGER_PATH_MAX];
+    seg_path(p, _day, "idx");
+    uint32_t have = whole(p, 4);
+    uint32_t want = (_segCount + FMS_LEDGER_INDEX_STRIDE - 1) / FMS_LEDGER_INDEX_STRIDE;
+    bool changed = false;
+    if (have > want) {
+        _io.truncate(p, want * 4, _io.ctx);
+        have = want;
+        changed = true;
+    }
+    uint32_t prev = day_start(_day);
+    uint8_t b[4];
+    if (have > 0 && _io.read(p, (have - 1) * 4, b, 4, _io.ctx) == 4) prev = get_u32(b);
+    for (uint32_t k = have; k < want; k++) {
+        fms_ledger_rec_t r;
+        if (read_rec(_day, _segFirst, k * FMS_LEDGER_INDEX_STRIDE, &r)) prev = r.ts;  // else an earlier ts, still a safe start
+        put_u32(b, prev);
+        if (!_io.append(p, b, 4, _io.ctx)) break;
+        changed = true;
+    }
+    if (changed) _stats.index_rebuilds++;
+}
+
+bool fms_ledger::append(fms_ledger_rec_t* rec) {
+    if (!_ready) return false;
+    uint32_t ts = rec->ts < _lastTs ? _lastTs : rec->ts;
+    uint32_t day = day_of(ts);
+    char p[FMS_LEDGER_PATH_MAX];
+
+    if (_days == 0 || day != _day) {
+        uint8_t e[8];
+        put_u32(e, day);
+        put_u32(e + 4, _lastId + 1);
+        if (!_io.append(_daysPath, e, sizeof(e), _io.ctx)) {
+            whole(_daysPath, 8);
+            _stats.append_errors++;
+            return false;
+        }
+        _days++;
+        _day = day;
+        _segFirst = _lastId + 1;
+        _segCount = 0;
+    }
+
+    rec->id = _segFirst + _segCount;
+    rec->ts = ts;
+    uint8_t b[FMS_LEDGER_REC_SIZE];
+    seg_path(p, _day, "dat");
+    if (!pack(*rec, b) || !_io.append(p, b, sizeof(b), _io.ctx)) {
+        _io.truncate(p, _segCount * FMS_LEDGER_REC_SIZE, _io.ctx);
+        _stats.append_errors++;
+        return false;
+    }
+    _segCount++;
+    _lastId = rec->id;
+    _lastTs = ts;
+    _stats.appended++;
+
+    if ((_segCount - 1) % FMS_LEDGER_INDEX_STRIDE == 0) {
+        put_u32(b, ts);
+        seg_path(p, _day, "idx");
+        if (!_io.append(p, b, 4, _io.ctx)) rebuild_index();
+    }
+    return true;
+}
+
+bool fms_ledger::read_day(uint32_t i, uint32_t* day, uint32_t* first) {
+    uint8_t e[8];
+    if (_io.read(_daysPath, i * 8, e, sizeof(e), _io.ctx) != sizeof(e)) return false;
+    *day = get_u32(e);
+    *first = get_u32(e + 4);
+    return true;
+}
+
+bool fms_ledger::read_rec(uint32_t day, uint32_t first, uint32_t n, fms_ledger_rec_t* out) {
+    char p[FMS_LEDGER_PATH_MAX];
+    uint8_t b[FMS_LEDGER_REC_SIZE];
+    seg_path(p, day, "dat");
+    if (_io.read(p, n * FMS_LEDGER_REC_SIZE, b, sizeof(b), _io.ctx) != sizeof(b)) return false;
+    if (unpack(b, first + n, out)) return true;
+    _stats.bad_records++;
+    return false;
+}
+
+// last segment whose first id is <= id
+uint32_t fms_ledger::find_id(uint32_t id) {
+    uint32_t lo = 0, hi = _days;
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2, day, first;
+        if (!read_day(mid, &day, &first)) return lo;
+        if (first <= id) lo = mid; else hi = mid;
+    }
+    return lo;
+}
+
+// first segment of day or later, _days if none
+uint32_t fms_ledger::find_day(uint32_t day) {
+    uint32_t lo = 0, hi = _days;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2, d, first;
+        if (!read_day(mid, &d, &first)) return _days;
+        if (d < day) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+// first record worth reading for stamps >= ts: start of the last stride stamped before ts
+uint32_t fms_ledger::index_pos(uint32_t day, uint32_t count, uint32_t ts) {
+    char p[FMS_LEDGER_PATH_MAX];
+    uint8_t b[INDEX_BLOCK * 4];
+    seg_path(p, day, "idx");
+    uint32_t entries = _io.size(p, _io.ctx) / 4, k = 0, pos = 0;
+    while (k < entries) {
+        size_t got = _io.read(p, k * 4, b, sizeof(b), _io.ctx) / 4;
+        if (got == 0) break;
+        for (size_t i = 0; i < got; i++, k++) {
+            if (get_u32(b + i * 4) >= ts) return pos;
+            pos = k * FMS_LEDGER_INDEX_STRIDE;
+        }
+    }
+    return pos < count ? pos : count;
+}
+
+bool fms_ledger::load_seg(fms_ledger_query_t* q) {
+    if (q->seg >= _days || !read_day(q->seg, &q->seg_day, &q->seg_first)) {
+        q->done = true;
+        return false;
+    }
+    if (q->seg == _days - 1) {
+        q->seg_count = _segCount;
+    } else {
+        char p[FMS_LEDGER_PATH_MAX];
+        seg_path(p, q->seg_day, "dat");
+        q->seg_count = _io.size(p, _io.ctx) / FMS_LEDGER_REC_SIZE;
+    }
+    return true;
+}
+
+bool fms_ledger::get(uint32_t id, fms_ledger_rec_t* out) {
+    if (!_ready || id == 0 || id > _lastId) return false;
+    uint32_t day, first;
+    if (!read_day(find_id(id), &day, &first) || id < first) return false;
+    return read_rec(day, first, id - first, out);
+}
+
+void fms_ledger::query_begin(fms_ledger_query_t* q) {
+    _stats.queries++;
+    q->done = false;
+    q->rec = 0;
+    q->seg = 0;
+    if (!_ready || _days == 0) {
+        q->done = true;
+        return;
+    }
+    if (q->from_id) q->seg = find_id(q->from_id);
+    if (q->from_ts) {
+        uint32_t s = find_day(day_of(q->from_ts));
+        if (s > q->seg) q->seg = s;
+    }
+    if (!load_seg(q)) return;
+
+    // both positions are safe starts, take the later one
+    if (q->from_id > q->seg_first) q->rec = q->from_id - q->seg_first;
+    if (q->from_ts) {
+        uint32_t r = index_pos(q->seg_day, q->seg_count, q->from_ts);
+        if (r > q->rec) q->rec = r;
+    }
+}
+
+size_t fms_ledger::query_next(fms_ledger_query_t* q, fms_ledger_rec_t* out, size_t max) {
+    size_t n = 0;
+    uint32_t looked = 0;
+    uint8_t buf[READ_BLOCK * FMS_LEDGER_REC_SIZE];
+    char p[FMS_LEDGER_PATH_MAX];
+
+    while (!q->done && n < max && looked < FMS_LEDGER_SCAN_MAX) {
+        if (q->rec >= q->seg_count) {
+            q->seg++;
+            q->rec = 0;
+            load_seg(q);
+            continue;
+        }
+        uint32_t want = q->seg_count - q->rec;
+        if (want > READ_BLOCK) want = READ_BLOCK;
+        seg_path(p, q->seg_day, "dat");
+        size_t got = _io.read(p, q->rec * FMS_LEDGER_REC_SIZE, buf, want * FMS_LEDGER_REC_SIZE, _io.ctx) /
+                     FMS_LEDGER_REC_SIZE;
+        if (got == 0) {
+            q->rec = q->seg_count;  // unreadable, go on with the next segment
+            continue;
+        }
+        for (size_t i = 0; i < got && n < max && looked < FMS_LEDGER_SCAN_MAX; i++) {
+            fms_ledger_rec_t r;
+            uint32_t id = q->seg_first + q->rec;
+            q->rec++;
+            looked++;
+            _stats.scanned++;
+            if (!unpack(buf + i * FMS_LEDGER_REC_SIZE, id, &r)) {
+                _stats.bad_records++;
+                continue;
+            }
+            if ((q->to_id && r.id > q->to_id) || (q->to_ts && r.ts >= q->to_ts)) {
+                q->done = true;  // ids and stamps only go up
+                break;
+            }
+            if (r.id < q->from_id || r.ts < q->from_ts || (q->pump && r.pump != q->pump)) continue;
+            out[n++] = r;
+        }
+    }
+    return n;
+}
+
+size_t fms_ledger::rec_json(const fms_ledger_rec_t& r, char* out, size_t cap) const {
+    char price[24], volume[24], amount[24], total[24];
+    r.price.format(price, sizeof(price));
+    r.volume.format(volume, sizeof(volume));
+    r.amount.format(amount, sizeof(amount));
+    r.total.format(total, sizeof(total));
+    int64_t local = (int64_t)r.ts + _tz;
+    if (local < 0) local = 0;
+    uint32_t secs = (uint32_t)(local % SECONDS_PER_DAY);
+    int y;
+    unsigned m, d;
+    date_of_day((uint32_t)(local / SECONDS_PER_DAY), &y, &m, &d);
+    int n = snprintf(out, cap,
+                     "{\"id\":%lu,\"ts\":%lu,\"time\":\"%04d-%02u-%02u %02lu:%02lu:%02lu\",\"pump\":%u,"
+                     "\"price\":%s,\"volume\":%s,\"amount\":%s,\"total\":%s}",
+                     (unsigned long)r.id, (unsigned long)r.ts, y, m, d, (unsigned long)(secs / 3600),
+                     (unsigned long)(secs / 60 % 60), (unsigned long)(secs % 60), (unsigned)r.pump, price, volume,
+                     amount, total);
+    return (n < 0 || (size_t)n >= cap) ? 0 : (size_t)n;
+}
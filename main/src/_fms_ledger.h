@@ -0,0 +1,150 @@
+/*
+ * FMS Ledger - indexed sales ledger in daily segment files
+ *
+ * Every Final is kept as a fixed size record, one segment file per local day,
+ * so audits work from the card alone:
+ *
+ *   <dir>/days.idx        per segment: day u32 | first id u32
+ *   <dir>/YYYYMMDD.dat    records, record n of the segment is id first + n
+ *   <dir>/YYYYMMDD.idx    sparse: ts of every FMS_LEDGER_INDEX_STRIDE'th record
+ *
+ *   record (32 bytes, little endian)
+ *     0 id u32   4 ts u32   8 pump   9 flags   10 crc16
+ *     12 price u32   16 volume u32   20 amount u32   24 total u64
+ *
+ * Ids are contiguous and time stamps never go back (a stamp earlier than the
+ * last one, or an unknown clock, takes the last one), so a query seeks:
+ * days.idx is binary searched by id or day, "transaction #N" is one read at
+ * (N - first) * 32, a time range starts from the sparse index and stops at the
+ * first record past it. crc16 covers the record; begin() cuts torn tails back
+ * to whole records and fills in sparse index entries that did not make it.
+ *
+ * Storage is reached through fms_ledger_io_t (path based), SD in the firmware,
+ * plain files on the host.
+ *
+ * Plain C++, no Arduino dependency, so it builds on the host as well.
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#ifndef _FMS_LEDGER_H_
+#define _FMS_LEDGER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "_fms_fixed.h"
+
+#define FMS_LEDGER_REC_SIZE      32
+#define FMS_LEDGER_INDEX_STRIDE  32      // records per sparse index entry
+#define FMS_LEDGER_SCAN_MAX      64      // records one query_next() looks at, keeps lock hold times short
+#define FMS_LEDGER_DIR_MAX       15
+#define FMS_LEDGER_PATH_MAX      (FMS_LEDGER_DIR_MAX + 38)   // "/%04d%02u%02u.ext" at the widest int / unsigned
+
+struct fms_ledger_io_t {
+    bool     (*append)(const char* path, const uint8_t* data, size_t len, void* ctx);          // create if missing
+    size_t   (*read)(const char* path, uint32_t offset, uint8_t* out, size_t len, void* ctx);  // bytes read
+    uint32_t (*size)(const char* path, void* ctx);                                             // 0 if missing
+    bool     (*truncate)(const char* path, uint32_t size, void* ctx);                          // drop a torn tail
+    void*    ctx;
+};
+
+struct fms_ledger_rec_t {
+    uint32_t         id;        // set by append()
+    uint32_t         ts;        // utc seconds, 0 = clock not set
+    uint8_t          pump;
+    fms_unit_price_t price;
+    fms_volume_t     volume;
+    fms_money_t      amount;
+    fms_volume_t     total;     // totalizer after the sale
+};
+
+// Filter (0 = open) and position of a running query
+struct fms_ledger_query_t {
+    uint32_t from_id;           // inclusive
+    uint32_t to_id;             // inclusive
+    uint32_t from_ts;           // inclusive
+    uint32_t to_ts;             // exclusive
+    uint8_t  pump;
+
+    uint32_t seg;               // days.idx entry
+    uint32_t seg_day;
+    uint32_t seg_first;         // id of the segment's first record
+    uint32_t seg_count;         // records in the segment
+    uint32_t rec;               // next record within the segment
+    bool     done;
+};
+
+struct fms_ledger_stats_t {
+    uint32_t appended;
+    uint32_t append_errors;
+    uint32_t queries;
+    uint32_t scanned;           // records read by queries
+    uint32_t bad_records;       // crc / id mismatch (torn writes)
+    uint32_t index_rebuilds;
+};
+
+class fms_ledger {
+public:
+    fms_ledger();
+
+    // dir without the trailing slash, tzOffset shifts the day boundary to local midnight
+    bool begin(const fms_ledger_io_t& io, const char* dir, int32_t tzOffset);
+    bool ready() const { return _ready; }
+
+    // Stamp (id, monotonic ts) and store rec
+    bool append(fms_ledger_rec_t* rec);
+
+    bool get(uint32_t id, fms_ledger_rec_t* out);
+
+    // Seek to the first candidate of q's filter, then read matches in order.
+    // query_next() returns how many it put in out, done is set at the end;
+    // a call can return 0 before the end when nothing matched in its scan.
+    void   query_begin(fms_ledger_query_t* q);
+    size_t query_next(fms_ledger_query_t* q, fms_ledger_rec_t* out, size_t max);
+
+    // {"id":..,"ts":..,"time":"YYYY-MM-DD hh:mm:ss","pump":..,"price":..,"volume":..,"amount":..,"total":..}
+    size_t rec_json(const fms_ledger_rec_t& rec, char* out, size_t cap) const;
+
+    uint32_t last_id() const   { return _lastId; }
+    uint32_t last_ts() const   { return _lastTs; }
+    uint32_t segments() const  { return _days; }
+
+    // Local days since 1970-01-01
+    uint32_t day_of(uint32_t ts) const;
+    uint32_t day_start(uint32_t day) const;   // utc ts of local midnight
+
+    static uint32_t day_from_date(int y, unsigned m, unsigned d);
+    static void     date_of_day(uint32_t day, int* y, unsigned* m, unsigned* d);
+    static bool     parse_date(const char* s, uint32_t* day);   // YYYY-MM-DD
+
+    const fms_ledger_stats_t& stats() const { return _stats; }
+    void reset_stats();
+
+private:
+    bool     read_day(uint32_t i, uint32_t* day, uint32_t* first);
+    uint32_t find_id(uint32_t id);
+    uint32_t find_day(uint32_t day);
+    bool     load_seg(fms_ledger_query_t* q);
+    uint32_t index_pos(uint32_t day, uint32_t count, uint32_t ts);
+    bool     read_rec(uint32_t day, uint32_t first, uint32_t n, fms_ledger_rec_t* out);
+    void     seg_path(char* out, uint32_t day, const char* ext) const;
+    uint32_t whole(const char* path, uint32_t unit);
+    void     rebuild_index();
+
+    fms_ledger_io_t    _io;
+    char               _dir[FMS_LEDGER_DIR_MAX + 1];
+    char               _daysPath[FMS_LEDGER_PATH_MAX];
+    int32_t            _tz;
+    bool               _ready;
+    uint32_t           _days;       // days.idx entries
+    uint32_t           _day;        // current segment
+    uint32_t           _segFirst;
+    uint32_t           _segCount;
+    uint32_t           _lastId;
+    uint32_t           _lastTs;
+    fms_ledger_stats_t _stats;
+};
+
+#endif // _FMS_LEDGER_H_
@@ -0,0 +1,103 @@
+/*
+ * FMS Live Publisher - coalescing rate limiter for live fuelling data
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#include "_fms_live.h"
+#include <string.h>
+
+fms_live_publisher::fms_live_publisher()
+    : _count(0),
+      _pendingMask(0),
+      _sentMask(0),
+      _intervalMs(0) {
+    memset(_volume, 0, sizeof(_volume));
+    memset(_amount, 0, sizeof(_amount));
+    memset(_sentVolume, 0, sizeof(_sentVolume));
+    memset(_sentAmount, 0, sizeof(_sentAmount));
+    memset(_sentAt, 0, sizeof(_sentAt));
+    reset_stats();
+}
+
+void fms_live_publisher::reset_stats() {
+    memset(_published, 0, sizeof(_published));
+    memset(_suppressed, 0, sizeof(_suppressed));
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+bool fms_live_publisher::begin(uint8_t count, uint32_t intervalMs) {
+    if (count == 0 || count > FMS_LIVE_MAX_NOZZLES) return false;
+    _count = count;
+    _intervalMs = intervalMs;
+    _pendingMask = 0;
+    _sentMask = 0;
+    return true;
+}
+
+bool fms_live_publisher::update(uint8_t noz, uint32_t volume, uint32_t amount) {
+    if (noz >= _count) return false;
+    uint8_t bit = 1U << noz;
+    _stats.samples++;
+
+    if (_pendingMask & bit) {
+        if (volume == _volume[noz] && amount == _amount[noz]) {  // same sample, still waiting
+            _stats.unchanged++;
+            _suppressed[noz]++;
+            return true;
+        }
+        _stats.coalesced++;
+        _suppressed[noz]++;
+    } else if ((_sentMask & bit) && volume == _sentVolume[noz] && amount == _sentAmount[noz]) {
+        _stats.unchanged++;
+        _suppressed[noz]++;
+        return false;
+    }
+    _volume[noz] = volume;
+    _amount[noz] = amount;
+    _pendingMask |= bit;
+    // went back to the published value before it was sent
+    if ((_sentMask & bit) && volume == _sentVolume[noz] && amount == _sentAmount[noz]) {
+        _pendingMask &= ~bit;
+        return false;
+    }
+    return true;
+}
+
+int8_t fms_live_publisher::next(uint32_t now, uint32_t* waitMs) const {
+    uint32_t wait = UINT32_MAX;
+    for (uint8_t i = 0; i < _count; i++) {
+        uint8_t bit = 1U << i;
+        if (!(_pendingMask & bit)) continue;
+        uint32_t elapsed = now - _sentAt[i];
+        if (!(_sentMask & bit) || elapsed >= _intervalMs) {
+            if (waitMs) *waitMs = 0;
+            return (int8_t)i;
+        }
+        if (_intervalMs - elapsed < wait) wait = _intervalMs - elapsed;
+    }
+    if (waitMs) *waitMs = wait;
+    return -1;
+}
+
+void fms_live_publisher::sent(uint8_t noz, uint32_t now, bool forced) {
+    if (noz >= _count) return;
+    uint8_t bit = 1U << noz;
+    _sentVolume[noz] = _volume[noz];
+    _sentAmount[noz] = _amount[noz];
+    _sentAt[noz] = now;
+    _sentMask |= bit;
+    _pendingMask &= ~bit;
+    _published[noz]++;
+    _stats.published++;
+    if (forced) _stats.forced++;
+}
+
+void fms_live_publisher::forget(uint8_t noz) {
+    if (noz >= _count) return;
+    uint8_t bit = 1U << noz;
+    _sentMask &= ~bit;
+    _pendingMask &= ~bit;
+}
@@ -0,0 +1,80 @@
+/*
+ * FMS Live Publisher - coalescing rate limiter for live fuelling data
+ *
+ * Keeps the latest live sample (volume, amount) of every nozzle and what was
+ * last published for it. A sample equal to the published one is dropped, a
+ * newer sample replaces one still waiting, and each nozzle publishes at most
+ * once per interval. The owner asks next() which nozzle may go out now and
+ * reports sent(); before a Final the pending sample is sent regardless of the
+ * interval so the last live value never trails the sale.
+ *
+ * Plain C++, no Arduino dependency, so it builds on the host as well.
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#ifndef _FMS_LIVE_H_
+#define _FMS_LIVE_H_
+
+#include <stdint.h>
+
+#define FMS_LIVE_MAX_NOZZLES    8
+
+struct fms_live_stats_t {
+    uint32_t samples;       // update() calls
+    uint32_t unchanged;     // samples equal to what was already published
+    uint32_t coalesced;     // pending samples replaced before they went out
+    uint32_t published;
+    uint32_t forced;        // published ahead of the interval (Final)
+};
+
+class fms_live_publisher {
+public:
+    fms_live_publisher();
+
+    bool begin(uint8_t count, uint32_t intervalMs);
+    void set_interval(uint32_t ms) { _intervalMs = ms; }
+    uint32_t interval() const      { return _intervalMs; }
+
+    // Latest sample of a nozzle, true if it differs from what was published
+    bool update(uint8_t noz, uint32_t volume, uint32_t amount);
+
+    // Nozzle with a pending sample whose interval has passed, or -1 with the
+    // time until the earliest one is due (UINT32_MAX if nothing is pending)
+    int8_t next(uint32_t now, uint32_t* waitMs) const;
+
+    // The pending sample of noz was published
+    void sent(uint8_t noz, uint32_t now, bool forced = false);
+
+    // Sale over: the next sample of this nozzle is published whatever its value
+    void forget(uint8_t noz);
+
+    bool     pending(uint8_t noz) const { return _pendingMask & (1U << noz); }
+    uint32_t volume(uint8_t noz) const  { return _volume[noz]; }
+    uint32_t amount(uint8_t noz) const  { return _amount[noz]; }
+
+    uint32_t published(uint8_t noz) const  { return _published[noz]; }
+    uint32_t suppressed(uint8_t noz) const { return _suppressed[noz]; }   // unchanged + coalesced
+
+    const fms_live_stats_t& stats() const { return _stats; }
+    void reset_stats();
+
+private:
+    uint8_t  _count;
+    uint8_t  _pendingMask;
+    uint8_t  _sentMask;         // nozzle has a published sample to compare with
+    uint32_t _intervalMs;
+    uint32_t _volume[FMS_LIVE_MAX_NOZZLES];
+    uint32_t _amount[FMS_LIVE_MAX_NOZZLES];
+    uint32_t _sentVolume[FMS_LIVE_MAX_NOZZLES];
+    uint32_t _sentAmount[FMS_LIVE_MAX_NOZZLES];
+    uint32_t _sentAt[FMS_LIVE_MAX_NOZZLES];
+    uint32_t _published[FMS_LIVE_MAX_NOZZLES];
+    uint32_t _suppressed[FMS_LIVE_MAX_NOZZLES];
+
+    fms_live_stats_t _stats;
+};
+
+#endif // _FMS_LIVE_H_
@@ -0,0 +1,243 @@
+/*
+ * FMS Log Ring - deferred formatting log records, lock free
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#include "_fms_log_ring.h"
+#include <stdio.h>
+#include <string.h>
+
+#define RING_MASK   (FMS_LOG_RING_SLOTS - 1)
+#define SPEC_MAX    24
+
+enum arg_kind_t { ARG_NONE, ARG_INT, ARG_LONG, ARG_LLONG, ARG_SIZE, ARG_PTR, ARG_DOUBLE, ARG_STR, ARG_END };
+
+// One conversion of a format string: where it ends and what it takes
+struct spec_t {
+    const char* end;            // one past the conversion letter
+    bool        star_w;
+    bool        star_p;
+    int         prec;           // -1 if none or '*'
+    arg_kind_t  kind;
+};
+
+static const char* parse_spec(const char* p, spec_t* s) {
+    // p is just past '%'
+    s->star_w = s->star_p = false;
+    s->prec = -1;
+    while (*p && strchr("-+ #0'", *p)) p++;
+    if (*p == '*') { s->star_w = true; p++; }
+    else while (*p >= '0' && *p <= '9') p++;
+    if (*p == '.') {
+        p++;
+        if (*p == '*') { s->star_p = true; p++; }
+        else for (s->prec = 0; *p >= '0' && *p <= '9'; p++) s->prec = s->prec * 10 + (*p - '0');
+    }
+    arg_kind_t ik = ARG_INT;
+    if (*p == 'h') { p++; if (*p == 'h') p++; }
+    else if (*p == 'l') { p++; if (*p == 'l') { p++; ik = ARG_LLONG; } else ik = ARG_LONG; }
+    else if (*p == 'j' || *p == 'q') { p++; ik = ARG_LLONG; }
+    else if (*p == 'z' || *p == 't') { p++; ik = ARG_SIZE; }
+    else if (*p == 'L') p++;
+
+    switch (*p) {
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+            s->kind = ik; break;
+        case 'p':
+            s->kind = ARG_PTR; break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            s->kind = ARG_DOUBLE; break;
+        case 's':
+            s->kind = ARG_STR; break;
+        default:
+            s->kind = ARG_END; return p;    // %n, bad or truncated spec: stop here
+    }
+    s->end = p + 1;
+    return s->end;
+}
+
+fms_log_ring::fms_log_ring()
+    : _head(0), _tail(0), _pushed(0), _drops(0), _highWater(0) {
+    for (uint32_t i = 0; i < FMS_LOG_RING_SLOTS; i++) {
+        _slots[i].seq.store(i, std::memory_order_relaxed);
+        memset(&_slots[i].rec, 0, sizeof(_slots[i].rec));
+    }
+}
+
+size_t fms_log_ring::capture(const char* fmt, va_list ap, uint8_t* out, size_t cap, bool* cut) {
+    size_t n = 0;
+    *cut = false;
+    for (const char* p = fmt; *p; ) {
+        if (*p++ != '%') continue;
+        if (*p == '%') { p++; continue; }
+        spec_t s;
+        p = parse_spec(p, &s);
+        if (s.kind == ARG_END) break;
+
+        int stars = (s.star_w ? 1 : 0) + (s.star_p ? 1 : 0);
+        for (int i = 0; i < stars; i++) {
+            int v = va_arg(ap, int);
+            if (n + sizeof(v) > cap) { *cut = true; return n; }
+            memcpy(out + n, &v, sizeof(v)); n += sizeof(v);
+            if (s.star_p && i == stars - 1) s.prec = v < 0 ? -1 : v;
+        }
+
+        switch (s.kind) {
+            case ARG_INT:    { int v = va_arg(ap, int);              if (n + sizeof(v) > cap) { *cut = true; return n; } memcpy(out + n, &v, sizeof(v)); n += sizeof(v); break; }
+            case ARG_LONG:   { long v = va_arg(ap, long);            if (n + sizeof(v) > cap) { *cut = true; return n; } memcpy(out + n, &v, sizeof(v)); n += sizeof(v); break; }
+            case ARG_LLONG:  { long long v = va_arg(ap, long long);  if (n + sizeof(v) > cap) { *cut = true; return n; } memcpy(out + n, &v, sizeof(v)); n += sizeof(v); break; }
+            case ARG_SIZE:   { size_t v = va_arg(ap, size_t);        if (n + sizeof(v) > cap) { *cut = true; return n; } memcpy(out + n, &v, sizeof(v)); n += sizeof(v); break; }
+            case ARG_PTR:    { void* v = va_arg(ap, void*);          if (n + sizeof(v) > cap) { *cut = true; return n; } memcpy(out + n, &v, sizeof(v)); n += sizeof(v); break; }
+            case ARG_DOUBLE: { double v = va_arg(ap, double);        if (n + sizeof(v) > cap) { *cut = true; return n; } memcpy(out + n, &v, sizeof(v)); n += sizeof(v); break; }
+            case ARG_STR: {
+                const char* v = va_arg(ap, const char*);
+                if (!v) v = "(null)";
+                if (n >= cap) { *cut = true; return n; }
+                // copied up to what is left, always terminated; a long string is shortened, not dropped.
+                // A precision bounds the read as well (%.*s of a buffer without a terminator)
+                size_t room = cap - n - 1;
+                if (s.prec >= 0 && (size_t)s.prec < room) room = (size_t)s.prec;
+                size_t len = strnlen(v, room);
+                memcpy(out + n, v, len);
+                out[n + len] = '\0';
+                n += len + 1;
+                break;
+            }
+            default: break;
+        }
+    }
+    return n;
+}
+
+bool fms_log_ring::push(uint32_t ts_ms, uint8_t level, const char* fmt, va_list ap) {
+    uint32_t pos = _head.load(std::memory_order_relaxed);
+    slot_t* s;
+    for (;;) {
+        s = &_slots[pos & RING_MASK];
+        uint32_t seq = s->seq.load(std::memory_order_acquire);
+        int32_t dif = (int32_t)(seq - pos);
+        if (dif == 0) {
+            if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (dif < 0) {
+            _drops.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = _head.load(std::memory_order_relaxed);
+        }
+    }
+
+    fms_log_rec_t& r = s->rec;
+    r.ts_ms = ts_ms;
+    r.fmt = fmt;
+    r.level = level;
+    va_list cp;
+    va_copy(cp, ap);
+    r.len = (uint8_t)capture(fmt, cp, r.args, sizeof(r.args), &r.cut);
+    va_end(cp);
+
+    s->seq.store(pos + 1, std::memory_order_release);
+    _pushed.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool fms_log_ring::pop(fms_log_rec_t* out) {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    slot_t& s = _slots[tail & RING_MASK];
+    uint32_t seq = s.seq.load(std::memory_order_acquire);
+    if ((int32_t)(seq - (tail + 1)) < 0) return false;      // empty, or the producer is still writing it
+
+    uint32_t depth = _head.load(std::memory_order_relaxed) - tail;
+    if (depth > _highWater) _highWater = depth;
+
+    *out = s.rec;
+    s.seq.store(tail + FMS_LOG_RING_SLOTS, std::memory_order_release);
+    _tail.store(tail + 1, std::memory_order_relaxed);
+    return true;
+}
+
+uint32_t fms_log_ring::pending() const {
+    uint32_t tail = _tail.load(std::memory_order_acquire);     // first, head can only be ahead of it
+    return _head.load(std::memory_order_relaxed) - tail;
+}
+
+void fms_log_ring::reset_stats() {
+    _pushed.store(0, std::memory_order_relaxed);
+    _drops.store(0, std::memory_order_relaxed);
+    _highWater = 0;
+}
+
+size_t fms_log_ring::format(const fms_log_rec_t& rec, char* out, size_t cap) {
+    if (cap == 0) return 0;
+    size_t n = 0;
+    size_t off = 0;                     // read position in rec.args
+    out[0] = '\0';
+
+#define PUT(expr) do { \
+        int w_ = (expr); \
+        if (w_ > 0) n += ((size_t)w_ < cap - n) ? (size_t)w_ : cap - n - 1; \
+    } while (0)
+#define TAKE(type, var) \
+        type var; \
+        if (off + sizeof(type) > rec.len) goto cut; \
+        memcpy(&var, rec.args + off, sizeof(type)); off += sizeof(type)
+
+    for (const char* p = rec.fmt; *p && n < cap - 1; ) {
+        if (*p != '%') { out[n++] = *p++; continue; }
+        if (p[1] == '%') { out[n++] = '%'; p += 2; continue; }
+
+        const char* start = p;
+        spec_t s;
+        const char* stop = parse_spec(p + 1, &s);
+        if (s.kind == ARG_END) {        // as written, nothing to take
+            while (p <= stop && *p && n < cap - 1) out[n++] = *p++;
+            break;
+        }
+        p = s.end;
+
+        // rebuild the conversion with '*' resolved and no length modifier 'L'
+        char spec[SPEC_MAX];
+        size_t k = 0;
+        for (const char* q = start; q < s.end && k < SPEC_MAX - 12; q++) {
+            if (*q == '*') {
+                TAKE(int, v);
+                k += snprintf(spec + k, SPEC_MAX - k, "%d", v);
+            } else if (*q == 'L') {
+                continue;
+            } else {
+                spec[k++] = *q;
+            }
+        }
+        spec[k] = '\0';
+
+        switch (s.kind) {
+            case ARG_INT:    { TAKE(int, v);       PUT(snprintf(out + n, cap - n, spec, v)); break; }
+            case ARG_LONG:   { TAKE(long, v);      PUT(snprintf(out + n, cap - n, spec, v)); break; }
+            case ARG_LLONG:  { TAKE(long long, v); PUT(snprintf(out + n, cap - n, spec, v)); break; }
+            case ARG_SIZE:   { TAKE(size_t, v);    PUT(snprintf(out + n, cap - n, spec, v)); break; }
+            case ARG_PTR:    { TAKE(void*, v);     PUT(snprintf(out + n, cap - n, spec, v)); break; }
+            case ARG_DOUBLE: { TAKE(double, v);    PUT(snprintf(out + n, cap - n, spec, v)); break; }
+            case ARG_STR: {
+                if (off >= rec.len) goto cut;
+                const char* v = (const char*)rec.args + off;
+                off += strnlen(v, rec.len - off) + 1;
+                PUT(snprintf(out + n, cap - n, spec, v));
+                break;
+            }
+            default: break;
+        }
+    }
+    out[n] = '\0';
+    return n;
+
+cut:
+    // the record ran out of argument room here: say so instead of guessing
+    PUT(snprintf(out + n, cap - n, "..."));
+    out[n] = '\0';
+    return n;
+
+#undef PUT
+#undef TAKE
+}
@@ -0,0 +1,78 @@
+/*
+ * FMS Log Ring - deferred formatting log records, lock free
+ *
+ * The logging call only stores what it was given: time stamp, level, the
+ * format string pointer and the raw argument bytes (walked by the format's
+ * conversions, %s copied since the caller's buffer will not live that long).
+ * Formatting happens later on the consumer, which turns a record back into
+ * text with the same format string.
+ *
+ * The ring is a bounded multi producer / single consumer queue (per slot
+ * sequence numbers, producers claim a slot with one compare and swap), so
+ * any task can log without a lock; a full ring drops the record and counts it.
+ * Format strings must be literals (they are kept by pointer).
+ *
+ * Plain C++, no Arduino dependency, so it builds on the host as well.
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#ifndef _FMS_LOG_RING_H_
+#define _FMS_LOG_RING_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <atomic>
+
+#define FMS_LOG_RING_SLOTS  64          // power of two
+#define FMS_LOG_ARG_BYTES   52          // raw arguments + copied strings per record
+
+struct fms_log_rec_t {
+    uint32_t    ts_ms;
+    const char* fmt;
+    uint8_t     level;
+    uint8_t     len;                    // argument bytes used
+    bool        cut;                    // the arguments did not all fit
+    uint8_t     args[FMS_LOG_ARG_BYTES];
+};
+
+class fms_log_ring {
+public:
+    fms_log_ring();
+
+    // Any task / core, never blocks; false (and counted) when the ring is full
+    bool push(uint32_t ts_ms, uint8_t level, const char* fmt, va_list ap);
+
+    // Consumer only: oldest record, false when empty
+    bool pop(fms_log_rec_t* out);
+
+    uint32_t pending() const;
+    uint32_t pushed() const   { return _pushed.load(std::memory_order_relaxed); }
+    uint32_t drops() const    { return _drops.load(std::memory_order_relaxed); }
+    uint32_t high_water() const { return _highWater; }
+    void     reset_stats();
+
+    // Message text of a record (what vsnprintf would have made of it), returns the length
+    static size_t format(const fms_log_rec_t& rec, char* out, size_t cap);
+
+    // Argument bytes of fmt / ap as push() stores them, for tools and tests
+    static size_t capture(const char* fmt, va_list ap, uint8_t* out, size_t cap, bool* cut);
+
+private:
+    struct slot_t {
+        std::atomic<uint32_t> seq;
+        fms_log_rec_t         rec;
+    };
+
+    slot_t                _slots[FMS_LOG_RING_SLOTS];
+    std::atomic<uint32_t> _head;
+    std::atomic<uint32_t> _tail;        // written by the consumer only
+    std::atomic<uint32_t> _pushed;
+    std::atomic<uint32_t> _drops;
+    uint32_t              _highWater;   // consumer side
+};
+
+#endif // _FMS_LOG_RING_H_
@@ -0,0 +1,156 @@
+/*
+ * FMS Modbus Poller - coalesced block reads for dispenser register maps
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#include "_fms_modbus_poller.h"
+#include <string.h>
+
+fms_modbus_poller::fms_modbus_poller()
+    : _table(NULL),
+      _count(0),
+      _read(NULL),
+      _ctx(NULL),
+      _clock(NULL),
+      _maxGap(FMS_MODBUS_DEFAULT_GAP),
+      _planMask(0),
+      _planCount(0) {
+    reset_stats();
+}
+
+bool fms_modbus_poller::begin(const fms_modbus_reg_t* table, uint8_t count,
+                              fms_modbus_read_fn read, void* ctx, fms_clock_us_fn clock,
+                              uint16_t maxGap) {
+    if (!table || !read || count == 0 || count > FMS_MODBUS_MAX_REGS) {
+        return false;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        if (table[i].words == 0 || table[i].words > 2) {
+            return false;
+        }
+    }
+
+    _table = table;
+    _count = count;
+    _read = read;
+    _ctx = ctx;
+    _clock = clock;
+    _maxGap = maxGap;
+
+    // Insertion sort by address, the table is tiny
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t j = i;
+        while (j > 0 && table[_order[j - 1]].addr > table[i].addr) {
+            _order[j] = _order[j - 1];
+            j--;
+        }
+        _order[j] = i;
+    }
+
+    _planMask = 0;
+    _planCount = 0;
+    reset_stats();
+    return true;
+}
+
+uint8_t fms_modbus_poller::plan(uint32_t mask, fms_modbus_block_t* blocks, uint8_t maxBlocks) const {
+    uint8_t n = 0;
+
+    for (uint8_t i = 0; i < _count; i++) {
+        uint8_t idx = _order[i];
+        if (!(mask & (1UL << idx))) {
+            continue;
+        }
+        const fms_modbus_reg_t& reg = _table[idx];
+        uint16_t end = reg.addr + reg.words;  // exclusive
+
+        if (n > 0) {
+            fms_modbus_block_t& last = blocks[n - 1];
+            uint16_t lastEnd = last.start + last.qty;
+            // Extend the open block when the hole is cheaper than a new round trip
+            if (reg.addr <= lastEnd + _maxGap && end - last.start <= FMS_MODBUS_MAX_READ_QTY) {
+                if (end > lastEnd) {
+                    last.qty = end - last.start;
+                }
+                continue;
+            }
+        }
+        if (n >= maxBlocks) {
+            return 0;
+        }
+        blocks[n].start = reg.addr;
+        blocks[n].qty = reg.words;
+        n++;
+    }
+    return n;
+}
+
+uint32_t fms_modbus_poller::mask_of(uint16_t addr) const {
+    for (uint8_t i = 0; i < _count; i++) {
+        if (_table[i].addr == addr) {
+            return 1UL << i;
+        }
+    }
+    return 0;
+}
+
+bool fms_modbus_poller::scan(uint8_t slave, uint32_t mask, uint32_t* out, size_t outLen) {
+    if (!_table) {
+        return false;
+    }
+    if (mask != _planMask || _planCount == 0) {
+        _planCount = plan(mask, _plan, FMS_MODBUS_MAX_BLOCKS);
+        _planMask = mask;
+    }
+
+    uint32_t t0 = _clock ? _clock() : 0;
+    bool ok = true;
+    uint8_t next = 0;  // position in _order, entries and blocks are both address ordered
+
+    for (uint8_t b = 0; b < _planCount; b++) {
+        const fms_modbus_block_t& blk = _plan[b];
+        _stats.transactions++;
+        if (!_read(slave, blk.start, blk.qty, _words, _ctx)) {
+            ok = false;
+            _stats.errors++;
+            break;
+        }
+        _stats.registers += blk.qty;
+
+        uint16_t blkEnd = blk.start + blk.qty;
+        for (; next < _count; next++) {
+            uint8_t idx = _order[next];
+            if (!(mask & (1UL << idx))) {
+                continue;
+            }
+            const fms_modbus_reg_t& reg = _table[idx];
+            if (reg.addr >= blkEnd) {
+                break;
+            }
+            if (reg.slot >= outLen) {
+                continue;
+            }
+            const uint16_t* w = &_words[reg.addr - blk.start];
+            out[reg.slot] = (reg.words == 2) ? ((uint32_t)w[0] << 16) | w[1] : w[0];
+        }
+    }
+
+    if (_clock) {
+        uint32_t dt = _clock() - t0;
+        _stats.last_scan_us = dt;
+        _stats.total_scan_us += dt;
+        if (dt < _stats.min_scan_us) _stats.min_scan_us = dt;
+        if (dt > _stats.max_scan_us) _stats.max_scan_us = dt;
+    }
+    _stats.last_blocks = _planCount;
+    _stats.scans++;
+    return ok;
+}
+
+void fms_modbus_poller::reset_stats() {
+    memset(&_stats, 0, sizeof(_stats));
+    _stats.min_scan_us = 0xFFFFFFFFUL;
+}
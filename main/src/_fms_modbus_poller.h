@@ -0,0 +1,95 @@
+/*
+ * FMS Modbus Poller - coalesced block reads for dispenser register maps
+ *
+ * A register table is declared once. Each scan reads the selected entries
+ * with as few function 03 (read holding registers) transactions as possible
+ * by merging neighbouring ranges, then decodes every entry into its slot.
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#ifndef _FMS_MODBUS_POLLER_H_
+#define _FMS_MODBUS_POLLER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FMS_MODBUS_MAX_REGS       16      // register table entries
+#define FMS_MODBUS_MAX_BLOCKS     FMS_MODBUS_MAX_REGS
+#define FMS_MODBUS_MAX_READ_QTY   64      // ModbusMaster response buffer size (ku8MaxBufferSize)
+#define FMS_MODBUS_DEFAULT_GAP    16      // read through holes up to this many registers
+#define FMS_MODBUS_ALL            0xFFFFFFFFUL
+
+// One register table entry, 32 bit values are high word first
+struct fms_modbus_reg_t {
+    const char* name;
+    uint16_t    addr;
+    uint8_t     words;      // 1 = 16 bit, 2 = 32 bit
+    uint8_t     slot;       // index in the decode output array
+};
+
+// One planned function 03 transaction
+struct fms_modbus_block_t {
+    uint16_t start;
+    uint16_t qty;
+};
+
+struct fms_modbus_stats_t {
+    uint32_t scans;
+    uint32_t errors;
+    uint32_t transactions;
+    uint32_t registers;
+    uint32_t last_scan_us;
+    uint32_t min_scan_us;
+    uint32_t max_scan_us;
+    uint64_t total_scan_us;
+    uint8_t  last_blocks;
+};
+
+// Transport: read qty holding registers from start into out, true on success
+typedef bool (*fms_modbus_read_fn)(uint8_t slave, uint16_t start, uint16_t qty, uint16_t* out, void* ctx);
+// Monotonic microsecond clock (micros() on the device)
+typedef uint32_t (*fms_clock_us_fn)();
+
+class fms_modbus_poller {
+public:
+    fms_modbus_poller();
+
+    // Attach a register table and transport, entries are indexed by table position in masks
+    bool begin(const fms_modbus_reg_t* table, uint8_t count,
+               fms_modbus_read_fn read, void* ctx, fms_clock_us_fn clock,
+               uint16_t maxGap = FMS_MODBUS_DEFAULT_GAP);
+
+    // Build the transaction list for the entries selected by mask
+    uint8_t plan(uint32_t mask, fms_modbus_block_t* blocks, uint8_t maxBlocks) const;
+
+    // Read and decode the entries selected by mask into out[slot]
+    bool scan(uint8_t slave, uint32_t mask, uint32_t* out, size_t outLen);
+
+    // Mask bit for a table entry by register address (0 if not in the table)
+    uint32_t mask_of(uint16_t addr) const;
+
+    const fms_modbus_stats_t& stats() const { return _stats; }
+    void reset_stats();
+
+private:
+    const fms_modbus_reg_t* _table;
+    uint8_t                 _count;
+    uint8_t                 _order[FMS_MODBUS_MAX_REGS];   // table indexes sorted by address
+    fms_modbus_read_fn      _read;
+    void*                   _ctx;
+    fms_clock_us_fn         _clock;
+    uint16_t                _maxGap;
+
+    // Last plan is cached, masks rarely change between scans
+    uint32_t                _planMask;
+    uint8_t                 _planCount;
+    fms_modbus_block_t      _plan[FMS_MODBUS_MAX_BLOCKS];
+
+    uint16_t                _words[FMS_MODBUS_MAX_READ_QTY];
+    fms_modbus_stats_t      _stats;
+};
+
+#endif // _FMS_MODBUS_POLLER_H_
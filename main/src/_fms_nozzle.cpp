@@ -0,0 +1,189 @@
+/*
+ * FMS Nozzle - per nozzle dispense state machine
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#include "_fms_nozzle.h"
+#include <string.h>
+
+fms_nozzle_engine::fms_nozzle_engine()
+    : _count(0),
+      _presetMask(0),
+      _rejected(0),
+      _onTransition(NULL),
+      _ctx(NULL) {
+    memset(_state, NOZ_IDLE, sizeof(_state));
+    memset(_pumpId, 0, sizeof(_pumpId));
+    memset(_liveVolume, 0, sizeof(_liveVolume));
+    memset(_liveAmount, 0, sizeof(_liveAmount));
+    memset(_saleVolume, 0, sizeof(_saleVolume));
+    memset(_saleAmount, 0, sizeof(_saleAmount));
+    memset(_totalVolume, 0, sizeof(_totalVolume));
+    memset(_totalAmount, 0, sizeof(_totalAmount));
+    memset(_price, 0, sizeof(_price));
+    memset(_preset, 0, sizeof(_preset));
+    memset(_presetKind, 0, sizeof(_presetKind));
+    memset(_transitions, 0, sizeof(_transitions));
+}
+
+bool fms_nozzle_engine::begin(uint8_t count, const uint8_t* pumpIds, fms_noz_transition_fn onTransition, void* ctx) {
+    if (count == 0 || count > FMS_MAX_NOZZLES) {
+        return false;
+    }
+    _count = count;
+    _onTransition = onTransition;
+    _ctx = ctx;
+    for (uint8_t i = 0; i < FMS_MAX_NOZZLES; i++) {
+        _pumpId[i] = (pumpIds && i < count && pumpIds[i]) ? pumpIds[i] : (uint8_t)(i + 1);
+        reset(i);
+    }
+    return true;
+}
+
+void fms_nozzle_engine::reset(uint8_t noz) {
+    if (noz >= FMS_MAX_NOZZLES) {
+        return;
+    }
+    _state[noz] = NOZ_IDLE;
+    _liveVolume[noz] = 0;
+    _liveAmount[noz] = 0;
+    _presetMask &= ~(1U << noz);
+}
+
+void fms_nozzle_engine::enter(uint8_t noz, fms_noz_state_t to) {
+    fms_noz_state_t from = (fms_noz_state_t)_state[noz];
+    _state[noz] = to;
+    _transitions[noz]++;
+    if (_onTransition) {
+        _onTransition(noz, from, to, _ctx);
+    }
+}
+
+// dispensers that do not report the amount get volume x unit price
+void fms_nozzle_engine::set_live(uint8_t noz, uint32_t volume, uint32_t amount) {
+    _liveVolume[noz] = volume;
+    if (amount == 0 && volume > 0 && _price[noz] > 0) {
+        fms_money_t m;
+        if (fms_amount_of(fms_volume_t::from_raw(volume), fms_unit_price_t::from_raw(_price[noz]), &m) && m.raw <= 0xFFFFFFFFLL) {
+            amount = (uint32_t)m.raw;
+        }
+    }
+    _liveAmount[noz] = amount;
+}
+
+bool fms_nozzle_engine::dispatch(const fms_noz_event_t& ev) {
+    if (ev.noz >= _count || ev.type >= NOZ_EV_COUNT) {
+        _rejected++;
+        return false;
+    }
+    const uint8_t n = ev.noz;
+    const fms_noz_state_t st = (fms_noz_state_t)_state[n];
+
+    switch (ev.type) {
+        case NOZ_EV_HANDLE_UP:
+            if (st == NOZ_IDLE) {
+                _liveVolume[n] = 0;
+                _liveAmount[n] = 0;
+                enter(n, NOZ_LIFTED);
+                return true;
+            }
+            return true;  // level triggered, repeats on every poll
+
+        case NOZ_EV_HANDLE_DOWN:
+        case NOZ_EV_PUMP_STOPPED:
+            if (st == NOZ_FUELLING) {
+                _saleVolume[n] = _liveVolume[n];
+                _saleAmount[n] = _liveAmount[n];
+                enter(n, NOZ_FINAL);
+                return true;
+            }
+            if (ev.type == NOZ_EV_HANDLE_DOWN && (st == NOZ_LIFTED || st == NOZ_PERMIT || st == NOZ_APPROVED)) {
+                _presetMask &= ~(1U << n);
+                enter(n, NOZ_IDLE);  // hung up before any product flowed
+                return true;
+            }
+            return true;
+
+        case NOZ_EV_PERMIT_SENT:
+            if (st == NOZ_LIFTED) {
+                enter(n, NOZ_PERMIT);
+                return true;
+            }
+            break;
+
+        case NOZ_EV_APPROVED:
+            if (st == NOZ_PERMIT) {
+                enter(n, NOZ_APPROVED);
+                return true;
+            }
+            break;
+
+        case NOZ_EV_PUMP_RUNNING:
+            if (st == NOZ_APPROVED) {
+                enter(n, NOZ_FUELLING);
+                return true;
+            }
+            return true;
+
+        case NOZ_EV_LIVE:
+            if (st == NOZ_APPROVED && ev.a > 0) {
+                set_live(n, ev.a, ev.b);
+                enter(n, NOZ_FUELLING);
+                return true;
+            }
+            if (st == NOZ_FUELLING) {
+                set_live(n, ev.a, ev.b);
+                return true;
+            }
+            break;
+
+        case NOZ_EV_TOTALIZER:
+            _totalVolume[n] = ev.a;
+            _totalAmount[n] = ev.b;
+            return true;
+
+        case NOZ_EV_PRESET:
+            if (st <= NOZ_APPROVED) {
+                _preset[n] = ev.a;
+                _presetKind[n] = (uint8_t)ev.b;
+                _presetMask |= (1U << n);
+                return true;
+            }
+            break;
+
+        case NOZ_EV_PRICE:
+            _price[n] = ev.a;
+            return true;
+
+        case NOZ_EV_FINAL_SENT:
+            if (st == NOZ_FINAL) {
+                _presetMask &= ~(1U << n);
+                enter(n, NOZ_IDLE);
+                return true;
+            }
+            break;
+    }
+
+    _rejected++;
+    return false;
+}
+
+uint8_t fms_nozzle_engine::mask_in(fms_noz_state_t st) const {
+    uint8_t mask = 0;
+    for (uint8_t i = 0; i < _count; i++) {
+        if (_state[i] == st) {
+            mask |= (1U << i);
+        }
+    }
+    return mask;
+}
+
+const char* fms_nozzle_engine::state_name(fms_noz_state_t st) {
+    static const char* const names[NOZ_STATE_COUNT] = {
+        "idle", "lifted", "permit", "approved", "fuelling", "final"
+    };
+    return st < NOZ_STATE_COUNT ? names[st] : "unknown";
+}
@@ -0,0 +1,128 @@
+/*
+ * FMS Nozzle - per nozzle dispense state machine
+ *
+ * Nozzle data is kept as struct-of-arrays so a scan over all nozzles touches
+ * one small array per field. The engine has a single owner task; other tasks
+ * hand it fms_noz_event_t records (register polls, MQTT messages) through a
+ * queue instead of sharing flags.
+ *
+ *   idle -> lifted -> permit -> approved -> fuelling -> final -> idle
+ *
+ * Volumes, amounts and prices are stored as raw fixed-point counts
+ * (_fms_fixed.h) and handed out typed.
+ *
+ * Plain C++, no Arduino dependency, so it builds on the host as well.
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#ifndef _FMS_NOZZLE_H_
+#define _FMS_NOZZLE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "_fms_fixed.h"
+
+#define FMS_MAX_NOZZLES 8   // matches DisConfig pumpids[8]
+
+enum fms_noz_state_t : uint8_t {
+    NOZ_IDLE = 0,
+    NOZ_LIFTED,         // handle up, permit not yet requested
+    NOZ_PERMIT,         // permit published, waiting for approval
+    NOZ_APPROVED,       // approval received, pump released
+    NOZ_FUELLING,       // product flowing
+    NOZ_FINAL,          // sale closed, Final not yet published
+    NOZ_STATE_COUNT
+};
+
+enum fms_noz_event_type_t : uint8_t {
+    NOZ_EV_HANDLE_UP = 0,   // polled: nozzle lifted
+    NOZ_EV_HANDLE_DOWN,     // polled: nozzle hung up
+    NOZ_EV_PUMP_RUNNING,    // polled: dispenser motor running
+    NOZ_EV_PUMP_STOPPED,    // polled: dispenser stopped
+    NOZ_EV_LIVE,            // polled: a = volume raw, b = amount raw
+    NOZ_EV_TOTALIZER,       // polled: a = volume raw, b = amount raw
+    NOZ_EV_PERMIT_SENT,     // permit message handed to MQTT
+    NOZ_EV_APPROVED,        // MQTT approval from local server
+    NOZ_EV_PRESET,          // MQTT preset: a = volume or amount raw, b = kind ('L' volume, 'P' amount)
+    NOZ_EV_PRICE,           // MQTT price change: a = unit price raw
+    NOZ_EV_FINAL_SENT,      // Final message handed to MQTT
+    NOZ_EV_COUNT
+};
+
+struct fms_noz_event_t {
+    uint8_t  type;
+    uint8_t  noz;           // nozzle index, 0 based
+    uint32_t a;
+    uint32_t b;
+};
+
+// Called on every state change, from the owner task
+typedef void (*fms_noz_transition_fn)(uint8_t noz, fms_noz_state_t from, fms_noz_state_t to, void* ctx);
+
+class fms_nozzle_engine {
+public:
+    fms_nozzle_engine();
+
+    // Configure active nozzles, pump ids come from DisConfig
+    bool begin(uint8_t count, const uint8_t* pumpIds, fms_noz_transition_fn onTransition = NULL, void* ctx = NULL);
+
+    // Apply one event, returns false if the event is invalid in the current state
+    bool dispatch(const fms_noz_event_t& ev);
+
+    // Force a nozzle back to idle (e.g. dispenser reset)
+    void reset(uint8_t noz);
+
+    uint8_t          count() const                { return _count; }
+    fms_noz_state_t  state(uint8_t noz) const     { return (fms_noz_state_t)_state[noz]; }
+    uint8_t          pump_id(uint8_t noz) const   { return _pumpId[noz]; }
+    fms_volume_t     live_volume(uint8_t noz) const  { return fms_volume_t::from_raw(_liveVolume[noz]); }
+    fms_money_t      live_amount(uint8_t noz) const  { return fms_money_t::from_raw(_liveAmount[noz]); }
+    fms_volume_t     sale_volume(uint8_t noz) const  { return fms_volume_t::from_raw(_saleVolume[noz]); }
+    fms_money_t      sale_amount(uint8_t noz) const  { return fms_money_t::from_raw(_saleAmount[noz]); }
+    fms_volume_t     total_volume(uint8_t noz) const { return fms_volume_t::from_raw(_totalVolume[noz]); }
+    fms_money_t      total_amount(uint8_t noz) const { return fms_money_t::from_raw(_totalAmount[noz]); }
+    fms_unit_price_t price(uint8_t noz) const        { return fms_unit_price_t::from_raw(_price[noz]); }
+    uint32_t         preset(uint8_t noz) const       { return _preset[noz]; }
+    uint8_t          preset_kind(uint8_t noz) const  { return _presetKind[noz]; }
+    bool             preset_pending(uint8_t noz) const { return _presetMask & (1U << noz); }
+    uint32_t         transitions(uint8_t noz) const { return _transitions[noz]; }
+    uint32_t         rejected() const             { return _rejected; }
+
+    // Bitmask of nozzles in a given state
+    uint8_t mask_in(fms_noz_state_t st) const;
+
+    // Memory cost of one nozzle slot
+    static constexpr size_t bytes_per_nozzle() {
+        return sizeof(uint8_t) * 3 + sizeof(uint32_t) * 9;
+    }
+
+    static const char* state_name(fms_noz_state_t st);
+
+private:
+    uint8_t  _count;
+    uint8_t  _presetMask;
+    uint8_t  _state[FMS_MAX_NOZZLES];
+    uint8_t  _pumpId[FMS_MAX_NOZZLES];
+    uint8_t  _presetKind[FMS_MAX_NOZZLES];
+    uint32_t _liveVolume[FMS_MAX_NOZZLES];
+    uint32_t _liveAmount[FMS_MAX_NOZZLES];
+    uint32_t _saleVolume[FMS_MAX_NOZZLES];
+    uint32_t _saleAmount[FMS_MAX_NOZZLES];
+    uint32_t _totalVolume[FMS_MAX_NOZZLES];
+    uint32_t _totalAmount[FMS_MAX_NOZZLES];
+    uint32_t _price[FMS_MAX_NOZZLES];
+    uint32_t _preset[FMS_MAX_NOZZLES];
+    uint32_t _transitions[FMS_MAX_NOZZLES];
+    uint32_t _rejected;
+
+    fms_noz_transition_fn _onTransition;
+    void*                 _ctx;
+
+    void enter(uint8_t noz, fms_noz_state_t to);
+    void set_live(uint8_t noz, uint32_t volume, uint32_t amount);
+};
+
+#endif // _FMS_NOZZLE_H_
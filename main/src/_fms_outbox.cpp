@@ -0,0 +1,163 @@
+/*
+ * FMS Outbox - store and forward record log
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#include "_fms_outbox.h"
+#include <string.h>
+
+fms_outbox::fms_outbox()
+    : _ready(false),
+      _cursor(0),
+      _readPos(0),
+      _size(0),
+      _compactBytes(0) {
+    memset(&_io, 0, sizeof(_io));
+    reset_stats();
+}
+
+void fms_outbox::reset_stats() {
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+// crc-32 (ieee, reflected), nibble table keeps it small
+uint32_t fms_outbox::crc32(const uint8_t* data, size_t len, uint32_t crc) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+bool fms_outbox::begin(const fms_outbox_io_t& io, uint32_t compactBytes) {
+    _io = io;
+    _compactBytes = compactBytes;
+    _size = _io.size(_io.ctx);
+    if (!_io.load_cursor(&_cursor, _io.ctx)) _cursor = 0;  // resend everything rather than lose it
+    if (_cursor > _size) _cursor = 0;                      // log was reset before the cursor was saved
+    _readPos = _cursor;
+    _ready = true;
+    return true;
+}
+
+bool fms_outbox::append(const char* topic, const uint8_t* payload, size_t pl, uint8_t flags) {
+    if (!_ready) return false;
+    size_t tl = strlen(topic);
+    if (tl > FMS_OUTBOX_MAX_TOPIC || pl > FMS_OUTBOX_MAX_PAYLOAD) {
+        _stats.append_errors++;
+        return false;
+    }
+    uint8_t rec[FMS_OUTBOX_MAX_RECORD];
+    rec[0] = FMS_OUTBOX_MAGIC;
+    rec[1] = (uint8_t)tl;
+    rec[2] = (uint8_t)pl;
+    rec[3] = flags;
+    memcpy(rec + FMS_OUTBOX_HEADER, topic, tl);
+    memcpy(rec + FMS_OUTBOX_HEADER + tl, payload, pl);
+    size_t n = FMS_OUTBOX_HEADER + tl + pl;
+    uint32_t crc = crc32(rec, n);
+    for (int i = 0; i < 4; i++) rec[n++] = (uint8_t)(crc >> (8 * i));
+
+    if (!_io.append(rec, n, _io.ctx)) {
+        _stats.append_errors++;
+        _size = _io.size(_io.ctx);  // a torn tail is skipped by the reader
+        return false;
+    }
+    _size += n;
+    _stats.appended++;
+    return true;
+}
+
+// 1 record decoded, 0 no valid record at pos, -1 read error
+int fms_outbox::decode_at(uint32_t pos, uint8_t* buf, fms_outbox_rec_t* rec, uint32_t* len) {
+    int got = _io.read(pos, buf, FMS_OUTBOX_HEADER, _io.ctx);
+    if (got < 0) return -1;
+    if (got != FMS_OUTBOX_HEADER) return 0;
+    uint8_t tl = buf[1], pl = buf[2];
+    if (buf[0] != FMS_OUTBOX_MAGIC || tl > FMS_OUTBOX_MAX_TOPIC || pl > FMS_OUTBOX_MAX_PAYLOAD) return 0;
+    int body = tl + pl + 4;
+    got = _io.read(pos + FMS_OUTBOX_HEADER, buf + FMS_OUTBOX_HEADER, body, _io.ctx);
+    if (got < 0) return -1;
+    if (got != body) return 0;
+    size_t n = FMS_OUTBOX_HEADER + tl + pl;
+    uint32_t crc = (uint32_t)buf[n] | ((uint32_t)buf[n + 1] << 8) | ((uint32_t)buf[n + 2] << 16) | ((uint32_t)buf[n + 3] << 24);
+    if (crc32(buf, n) != crc) return 0;
+
+    memcpy(rec->topic, buf + FMS_OUTBOX_HEADER, tl);
+    rec->topic[tl] = '\0';
+    memcpy(rec->payload, buf + FMS_OUTBOX_HEADER + tl, pl);
+    rec->payload[pl] = '\0';
+    rec->payload_len = pl;
+    rec->flags = buf[3];
+    *len = (uint32_t)(n + 4);
+    return 1;
+}
+
+bool fms_outbox::read_next(fms_outbox_rec_t* rec) {
+    if (!_ready) return false;
+    uint8_t buf[FMS_OUTBOX_MAX_RECORD];
+    while (_readPos < _size) {
+        uint32_t len;
+        int r = decode_at(_readPos, buf, rec, &len);
+        if (r > 0) {
+            _readPos += len;
+            rec->end = _readPos;
+            _stats.read++;
+            return true;
+        }
+        if (r < 0) {
+            _stats.read_errors++;  // not corruption, nothing is skipped or committed
+            return false;
+        }
+
+        // bad record, step to the next magic byte over data that was read
+        uint32_t from = _readPos;
+        uint32_t pos = _readPos + 1;
+        bool found = false;
+        while (!found && pos < _size) {
+            int got = _io.read(pos, buf, sizeof(buf), _io.ctx);
+            if (got < 0) {
+                _stats.read_errors++;  // scan again from the bad record next time
+                return false;
+            }
+            if (got == 0) break;   // log is shorter than _size, nothing left to read
+            const uint8_t* m = (const uint8_t*)memchr(buf, FMS_OUTBOX_MAGIC, got);
+            if (m) {
+                pos += (uint32_t)(m - buf);
+                found = true;
+            } else {
+                pos += (uint32_t)got;
+            }
+        }
+        if (!found) pos = _size;
+        _stats.skipped_bytes += pos - from;
+        _readPos = pos;
+        if (from == _cursor) commit(pos);  // nothing in flight before the gap, do not read it again
+    }
+    return false;
+}
+
+bool fms_outbox::commit(uint32_t end) {
+    if (!_ready || end <= _cursor || end > _size) return false;
+    _cursor = end;
+    bool ok = _io.save_cursor(_cursor, _io.ctx);
+    _stats.commits++;
+
+    // fully drained: start the log over, log first so a crash in between
+    // leaves a cursor past the end (clamped to 0 by begin)
+    if (_cursor == _size && _size >= _compactBytes && _io.reset(_io.ctx)) {
+        _cursor = _readPos = _size = 0;
+        _io.save_cursor(0, _io.ctx);
+        _stats.compactions++;
+    }
+    return ok;
+}
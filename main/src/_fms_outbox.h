@@ -0,0 +1,111 @@
+/*
+ * FMS Outbox - store and forward record log
+ *
+ * Messages that must survive a broker / Wi-Fi outage (Final, permit) are
+ * appended to a log before anything else happens to them. A drain stage
+ * reads them back in order, and only after they are published does the
+ * durable cursor move past them, so a sale is never lost; at worst it is
+ * sent twice after a power cut.
+ *
+ *   record: A5 | topic_len | payload_len | flags | topic | payload | crc32 (LE)
+ *
+ * crc32 covers everything before it. A torn or corrupted record is skipped
+ * by scanning for the next magic byte with a good crc. A read error is not
+ * corruption: reading stops where it is and the same spot is tried again on
+ * the next call. Once everything is drained and the log is larger than the
+ * compact threshold it is reset.
+ *
+ * Storage is reached through fms_outbox_io_t so the log runs on the SD card
+ * in the firmware and on plain files on the host.
+ *
+ * Plain C++, no Arduino dependency, so it builds on the host as well.
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#ifndef _FMS_OUTBOX_H_
+#define _FMS_OUTBOX_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FMS_OUTBOX_MAGIC        0xA5
+#define FMS_OUTBOX_HEADER       4
+#define FMS_OUTBOX_MAX_TOPIC    31
+#define FMS_OUTBOX_MAX_PAYLOAD  95
+#define FMS_OUTBOX_MAX_RECORD   (FMS_OUTBOX_HEADER + FMS_OUTBOX_MAX_TOPIC + FMS_OUTBOX_MAX_PAYLOAD + 4)
+
+struct fms_outbox_io_t {
+    bool     (*append)(const uint8_t* data, size_t len, void* ctx);             // write at the end and sync
+    int      (*read)(uint32_t offset, uint8_t* out, size_t len, void* ctx);     // bytes read, 0 past the end, -1 on error
+    uint32_t (*size)(void* ctx);
+    bool     (*reset)(void* ctx);                                               // empty the log
+    bool     (*save_cursor)(uint32_t cursor, void* ctx);
+    bool     (*load_cursor)(uint32_t* cursor, void* ctx);                       // false if never saved / unreadable
+    void*    ctx;
+};
+
+struct fms_outbox_rec_t {
+    char     topic[FMS_OUTBOX_MAX_TOPIC + 1];
+    uint8_t  payload[FMS_OUTBOX_MAX_PAYLOAD + 1];   // text payloads are NUL terminated
+    uint8_t  payload_len;
+    uint8_t  flags;
+    uint32_t end;           // log offset just past this record, commit() it once published
+};
+
+struct fms_outbox_stats_t {
+    uint32_t appended;
+    uint32_t append_errors;
+    uint32_t read;          // records handed to the drain stage
+    uint32_t commits;       // cursor saves
+    uint32_t skipped_bytes; // torn / corrupted data stepped over
+    uint32_t read_errors;   // reads the storage failed, retried from the same offset
+    uint32_t compactions;
+};
+
+class fms_outbox {
+public:
+    fms_outbox();
+
+    // Load the durable cursor and start reading from it
+    bool begin(const fms_outbox_io_t& io, uint32_t compactBytes);
+
+    // Payload is bytes, text or binary (_fms_payload.h)
+    bool append(const char* topic, const uint8_t* payload, size_t len, uint8_t flags = 0);
+
+    // Next record after the read position, false when the log is drained or
+    // a read failed (the read position stays, call again later)
+    bool read_next(fms_outbox_rec_t* rec);
+
+    // Everything up to end is published: move and save the durable cursor
+    bool commit(uint32_t end);
+
+    // Read again from the durable cursor (messages handed out were dropped)
+    void rewind() { _readPos = _cursor; }
+
+    uint32_t cursor() const        { return _cursor; }
+    uint32_t read_pos() const      { return _readPos; }
+    uint32_t size() const          { return _size; }
+    uint32_t backlog_bytes() const { return _size - _cursor; }
+    bool     ready() const         { return _ready; }
+
+    const fms_outbox_stats_t& stats() const { return _stats; }
+    void reset_stats();
+
+    static uint32_t crc32(const uint8_t* data, size_t len, uint32_t crc = 0);
+
+private:
+    fms_outbox_io_t    _io;
+    bool               _ready;
+    uint32_t           _cursor;     // durable, everything before it is published
+    uint32_t           _readPos;    // read ahead for the drain stage
+    uint32_t           _size;
+    uint32_t           _compactBytes;
+    fms_outbox_stats_t _stats;
+
+    int  decode_at(uint32_t pos, uint8_t* buf, fms_outbox_rec_t* rec, uint32_t* len);
+};
+
+#endif // _FMS_OUTBOX_H_
@@ -0,0 +1,170 @@
+/*
+ * FMS Payload - permit / live / Final message encoding
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#include "_fms_payload.h"
+#include <string.h>
+
+static const char* const format_names[PAYLOAD_FORMAT_COUNT] = { "text", "binary" };
+
+const char* fms_payload_format_name(fms_payload_format_t fmt) {
+    return fmt < PAYLOAD_FORMAT_COUNT ? format_names[fmt] : "?";
+}
+
+bool fms_payload_format_parse(const char* name, fms_payload_format_t* out) {
+    for (uint8_t i = 0; i < PAYLOAD_FORMAT_COUNT; i++) {
+        if (strcmp(name, format_names[i]) == 0) {
+            *out = (fms_payload_format_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// ---- binary ----
+
+static bool put_u32(uint8_t* out, int64_t v) {
+    if (v < 0 || v > 0xFFFFFFFFLL) return false;
+    for (int i = 0; i < 4; i++) out[i] = (uint8_t)(v >> (8 * i));
+    return true;
+}
+
+static bool put_u64(uint8_t* out, int64_t v) {
+    if (v < 0) return false;
+    for (int i = 0; i < 8; i++) out[i] = (uint8_t)((uint64_t)v >> (8 * i));
+    return true;
+}
+
+static uint32_t get_u32(const uint8_t* in) {
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+static uint64_t get_u64(const uint8_t* in) {
+    return (uint64_t)get_u32(in) | ((uint64_t)get_u32(in + 4) << 32);
+}
+
+static size_t encode_binary(const fms_payload_t& p, uint8_t* out, size_t cap) {
+    size_t need = p.kind == PAYLOAD_PERMIT ? 3 : p.kind == PAYLOAD_LIVE ? 11 : p.kind == PAYLOAD_FINAL ? 23 : 0;
+    if (need == 0 || cap < need) return 0;
+    out[0] = FMS_PAYLOAD_BIN_TAG;
+    out[1] = p.kind;
+    out[2] = p.pump;
+    bool ok = true;
+    if (p.kind == PAYLOAD_LIVE) {
+        ok = put_u32(out + 3, p.volume.raw) && put_u32(out + 7, p.amount.raw);
+    } else if (p.kind == PAYLOAD_FINAL) {
+        ok = put_u32(out + 3, p.price.raw) && put_u32(out + 7, p.volume.raw) && put_u32(out + 11, p.amount.raw) &&
+             put_u64(out + 15, p.total.raw);
+    }
+    return ok ? need : 0;
+}
+
+static bool decode_binary(const uint8_t* in, size_t len, fms_payload_t* out) {
+    if (len < 3 || in[0] != FMS_PAYLOAD_BIN_TAG) return false;
+    memset(out, 0, sizeof(*out));
+    out->kind = in[1];
+    out->pump = in[2];
+    switch (in[1]) {
+        case PAYLOAD_PERMIT:
+            return len == 3;
+        case PAYLOAD_LIVE:
+            if (len != 11) return false;
+            out->volume = fms_volume_t::from_raw(get_u32(in + 3));
+            out->amount = fms_money_t::from_raw(get_u32(in + 7));
+            return true;
+        case PAYLOAD_FINAL:
+            if (len != 23) return false;
+            out->price  = fms_unit_price_t::from_raw(get_u32(in + 3));
+            out->volume = fms_volume_t::from_raw(get_u32(in + 7));
+            out->amount = fms_money_t::from_raw(get_u32(in + 11));
+            out->total  = fms_volume_t::from_raw((int64_t)get_u64(in + 15));
+            return true;
+    }
+    return false;
+}
+
+// ---- text ----
+
+static size_t encode_text(const fms_payload_t& p, uint8_t* out, size_t cap) {
+    if (cap < FMS_PAYLOAD_MAX) return 0;
+    char* s = (char*)out;
+    size_t n = 0;
+    s[n++] = '0' + (p.pump / 10) % 10;
+    s[n++] = '0' + p.pump % 10;
+    switch (p.kind) {
+        case PAYLOAD_PERMIT:
+            memcpy(s + n, "permit", 6);
+            n += 6;
+            break;
+        case PAYLOAD_LIVE:
+            s[n++] = 'L';
+            n += p.volume.format(s + n);
+            s[n++] = 'P';
+            n += p.amount.format(s + n);
+            break;
+        case PAYLOAD_FINAL:
+            s[n++] = 'S';
+            n += p.price.format(s + n);
+            s[n++] = 'L';
+            n += p.volume.format(s + n);
+            s[n++] = 'P';
+            n += p.amount.format(s + n);
+            s[n++] = 'T';
+            n += p.total.format(s + n);
+            break;
+        default:
+            return 0;
+    }
+    s[n] = '\0';
+    return n;
+}
+
+// one <letter><decimal> field, returns the text past it
+static const char* text_field(const char* s, const char* end, char letter, const char** value, size_t* len) {
+    if (s >= end || *s != letter) return NULL;
+    const char* v = ++s;
+    while (s < end && ((*s >= '0' && *s <= '9') || *s == '.' || *s == '-')) s++;
+    *value = v;
+    *len = (size_t)(s - v);
+    return s;
+}
+
+static bool decode_text(const uint8_t* in, size_t len, fms_payload_t* out) {
+    const char* s = (const char*)in;
+    const char* end = s + len;
+    if (len < 3 || s[0] < '0' || s[0] > '9' || s[1] < '0' || s[1] > '9') return false;
+    memset(out, 0, sizeof(*out));
+    out->pump = (uint8_t)((s[0] - '0') * 10 + (s[1] - '0'));
+    s += 2;
+    if (end - s == 6 && memcmp(s, "permit", 6) == 0) {
+        out->kind = PAYLOAD_PERMIT;
+        return true;
+    }
+    const char* v;
+    size_t vl;
+    if (*s == 'S') {
+        out->kind = PAYLOAD_FINAL;
+        if (!(s = text_field(s, end, 'S', &v, &vl)) || !fms_unit_price_t::parse(v, vl, &out->price)) return false;
+    } else {
+        out->kind = PAYLOAD_LIVE;
+    }
+    if (!(s = text_field(s, end, 'L', &v, &vl)) || !fms_volume_t::parse(v, vl, &out->volume)) return false;
+    if (!(s = text_field(s, end, 'P', &v, &vl)) || !fms_money_t::parse(v, vl, &out->amount)) return false;
+    if (out->kind == PAYLOAD_FINAL) {
+        if (!(s = text_field(s, end, 'T', &v, &vl)) || !fms_volume_t::parse(v, vl, &out->total)) return false;
+    }
+    return s == end;
+}
+
+size_t fms_payload_encode(fms_payload_format_t fmt, const fms_payload_t& p, uint8_t* out, size_t cap) {
+    return fmt == PAYLOAD_BINARY ? encode_binary(p, out, cap) : encode_text(p, out, cap);
+}
+
+bool fms_payload_decode(const uint8_t* in, size_t len, fms_payload_t* out) {
+    if (len > 0 && (in[0] & 0x80)) return decode_binary(in, len, out);
+    return decode_text(in, len, out);
+}
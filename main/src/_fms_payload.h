@@ -0,0 +1,70 @@
+/*
+ * FMS Payload - permit / live / Final message encoding
+ *
+ * Two encodings of the same fields, picked per device (NVS "payload"):
+ *
+ *   text    01permit
+ *           01L10.000P30000
+ *           01S3000L10.000P30000T12345.678
+ *
+ *   binary  little endian, packed, schema versioned
+ *           0   tag     0x80 | schema (never ASCII, so a reader can tell the two apart)
+ *           1   kind    1 permit, 2 live, 3 final
+ *           2   pump
+ *           live    3 volume u32 (0.001 l)   7 amount u32                      = 11 bytes
+ *           final   3 price u32   7 volume u32   11 amount u32   15 total u64  = 23 bytes
+ *
+ * Scales are fixed by the schema: volume has fms_volume_t decimals, money and
+ * unit price are whole units. Encoders write straight into the caller's
+ * buffer, nothing is allocated.
+ *
+ * Plain C++, no Arduino dependency, so it builds on the host as well.
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#ifndef _FMS_PAYLOAD_H_
+#define _FMS_PAYLOAD_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "_fms_fixed.h"
+
+#define FMS_PAYLOAD_SCHEMA      1
+#define FMS_PAYLOAD_BIN_TAG     (0x80 | FMS_PAYLOAD_SCHEMA)
+#define FMS_PAYLOAD_MAX         (2 + 4 * 22 + 4 + 1)   // longest text Final, with NUL
+
+enum fms_payload_format_t : uint8_t {
+    PAYLOAD_TEXT = 0,
+    PAYLOAD_BINARY,
+    PAYLOAD_FORMAT_COUNT
+};
+
+enum fms_payload_kind_t : uint8_t {
+    PAYLOAD_PERMIT = 1,
+    PAYLOAD_LIVE,
+    PAYLOAD_FINAL
+};
+
+struct fms_payload_t {
+    uint8_t          kind;
+    uint8_t          pump;
+    fms_unit_price_t price;     // final
+    fms_volume_t     volume;    // live, final
+    fms_money_t      amount;    // live, final
+    fms_volume_t     total;     // final, totalizer
+};
+
+// Encode into out, returns the length or 0 if it does not fit / a value is
+// out of range for the format. Text output is NUL terminated (not counted).
+size_t fms_payload_encode(fms_payload_format_t fmt, const fms_payload_t& p, uint8_t* out, size_t cap);
+
+// Decode either format (told apart by the first byte)
+bool fms_payload_decode(const uint8_t* in, size_t len, fms_payload_t* out);
+
+const char* fms_payload_format_name(fms_payload_format_t fmt);
+bool        fms_payload_format_parse(const char* name, fms_payload_format_t* out);
+
+#endif // _FMS_PAYLOAD_H_
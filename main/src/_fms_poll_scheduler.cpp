@@ -0,0 +1,105 @@
+/*
+ * FMS Poll Scheduler - per nozzle polling deadlines
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#include "_fms_poll_scheduler.h"
+#include <string.h>
+
+// wrap safe "a is at or before b" for millisecond timestamps
+static inline bool time_reached(uint32_t deadline, uint32_t now) {
+    return (int32_t)(now - deadline) >= 0;
+}
+
+fms_poll_scheduler::fms_poll_scheduler()
+    : _count(0),
+      _activeMask(0),
+      _idleMs(500),
+      _activeMs(100) {
+    memset(_deadline, 0, sizeof(_deadline));
+    memset(_polls, 0, sizeof(_polls));
+    memset(_overruns, 0, sizeof(_overruns));
+    memset(_windowStart, 0, sizeof(_windowStart));
+    memset(_windowPolls, 0, sizeof(_windowPolls));
+    memset(_rateMhz, 0, sizeof(_rateMhz));
+}
+
+bool fms_poll_scheduler::begin(uint8_t count, uint16_t idleMs, uint16_t activeMs, uint32_t now) {
+    if (count == 0 || count > FMS_POLL_MAX_NOZZLES || idleMs == 0 || activeMs == 0) {
+        return false;
+    }
+    _count = count;
+    _idleMs = idleMs;
+    _activeMs = activeMs;
+    _activeMask = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        // spread the first idle polls so the nozzles do not queue up on the bus
+        _deadline[i] = now + (uint32_t)i * idleMs / count;
+        _windowStart[i] = now;
+        _windowPolls[i] = 0;
+    }
+    return true;
+}
+
+void fms_poll_scheduler::set_active(uint8_t noz, bool active, uint32_t now) {
+    if (noz >= _count || active == this->active(noz)) {
+        return;
+    }
+    if (active) {
+        _activeMask |= (1U << noz);
+        _deadline[noz] = now;  // first live poll right away
+    } else {
+        _activeMask &= ~(1U << noz);
+        _deadline[noz] = now + _idleMs;
+    }
+}
+
+int8_t fms_poll_scheduler::next(uint32_t now, uint32_t* waitMs) const {
+    int8_t best = -1;
+    int32_t bestLead = 0x7FFFFFFF;  // time until deadline, negative when late
+
+    for (uint8_t i = 0; i < _count; i++) {
+        int32_t lead = (int32_t)(_deadline[i] - now);
+        // earliest deadline wins, live polls win ties
+        if (lead < bestLead || (lead == bestLead && best >= 0 && active(i) && !active(best))) {
+            bestLead = lead;
+            best = i;
+        }
+    }
+    if (best < 0) {
+        if (waitMs) *waitMs = _idleMs;
+        return -1;
+    }
+    if (bestLead > 0) {
+        if (waitMs) *waitMs = (uint32_t)bestLead;
+        return -1;
+    }
+    if (waitMs) *waitMs = 0;
+    return best;
+}
+
+void fms_poll_scheduler::done(uint8_t noz, uint32_t now) {
+    if (noz >= _count) {
+        return;
+    }
+    uint32_t step = interval(noz);
+    uint32_t next = _deadline[noz] + step;
+    if (time_reached(next, now)) {
+        // fell behind a whole interval, do not burst to catch up
+        _overruns[noz]++;
+        next = now + step;
+    }
+    _deadline[noz] = next;
+    _polls[noz]++;
+    _windowPolls[noz]++;
+
+    uint32_t elapsed = now - _windowStart[noz];
+    if (elapsed >= FMS_POLL_RATE_WINDOW_MS) {
+        _rateMhz[noz] = (uint32_t)((uint64_t)_windowPolls[noz] * 1000000UL / elapsed);
+        _windowStart[noz] = now;
+        _windowPolls[noz] = 0;
+    }
+}
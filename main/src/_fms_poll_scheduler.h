@@ -0,0 +1,65 @@
+/*
+ * FMS Poll Scheduler - per nozzle polling deadlines
+ *
+ * Idle nozzles get a cheap status poll (handle / pump state) at a slow rate.
+ * A nozzle that is lifted or fuelling switches to a fast live data poll.
+ * Each nozzle keeps its own deadline, the owner task sleeps until the
+ * earliest one instead of waking on a fixed period.
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#ifndef _FMS_POLL_SCHEDULER_H_
+#define _FMS_POLL_SCHEDULER_H_
+
+#include <stdint.h>
+
+#define FMS_POLL_MAX_NOZZLES      8
+#define FMS_POLL_RATE_WINDOW_MS   1000    // achieved rate is measured over this window
+
+enum fms_poll_kind_t : uint8_t {
+    POLL_STATUS = 0,    // nozzle handle + pump state
+    POLL_LIVE           // live volume / amount + status
+};
+
+class fms_poll_scheduler {
+public:
+    fms_poll_scheduler();
+
+    bool begin(uint8_t count, uint16_t idleMs, uint16_t activeMs, uint32_t now);
+
+    // Switch a nozzle between idle and active rate, going active polls at once
+    void set_active(uint8_t noz, bool active, uint32_t now);
+
+    // Nozzle whose deadline has passed (earliest first), or -1 with the time to wait
+    int8_t next(uint32_t now, uint32_t* waitMs) const;
+
+    // Record a finished poll and set the next deadline
+    void done(uint8_t noz, uint32_t now);
+
+    fms_poll_kind_t kind(uint8_t noz) const     { return (_activeMask & (1U << noz)) ? POLL_LIVE : POLL_STATUS; }
+    bool            active(uint8_t noz) const   { return _activeMask & (1U << noz); }
+    uint16_t        interval(uint8_t noz) const { return active(noz) ? _activeMs : _idleMs; }
+
+    // Achieved polls per second over the last window, in milli-hertz
+    uint32_t        rate_mhz(uint8_t noz) const { return _rateMhz[noz]; }
+    uint32_t        polls(uint8_t noz) const    { return _polls[noz]; }
+    // Polls that started later than one interval past their deadline
+    uint32_t        overruns(uint8_t noz) const { return _overruns[noz]; }
+
+private:
+    uint8_t  _count;
+    uint8_t  _activeMask;
+    uint16_t _idleMs;
+    uint16_t _activeMs;
+    uint32_t _deadline[FMS_POLL_MAX_NOZZLES];
+    uint32_t _polls[FMS_POLL_MAX_NOZZLES];
+    uint32_t _overruns[FMS_POLL_MAX_NOZZLES];
+    uint32_t _windowStart[FMS_POLL_MAX_NOZZLES];
+    uint16_t _windowPolls[FMS_POLL_MAX_NOZZLES];
+    uint32_t _rateMhz[FMS_POLL_MAX_NOZZLES];
+};
+
+#endif // _FMS_POLL_SCHEDULER_H_
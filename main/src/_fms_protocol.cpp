@@ -0,0 +1,85 @@
+/*
+ * FMS Protocol - driver table
+ *
+ * gilbarco, redstar and haungyang have no wire decoder in this tree yet; they
+ * get the pass-through driver, which hands every rx burst up as one
+ * PROTO_EV_TEXT event so the link can be logged and captured.
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#include "_fms_protocol.h"
+#include "_fms_tatsuno.h"
+
+#define FMS_PASSTHROUGH_MAX 64
+
+// one PROTO_EV_TEXT per idle delimited burst, Brand only makes each instance distinct
+template <uint8_t Brand>
+class fms_passthrough_driver : public fms_protocol_driver<fms_passthrough_driver<Brand> > {
+    typedef fms_protocol_driver<fms_passthrough_driver<Brand> > base;
+
+public:
+    fms_passthrough_driver() : _len(0) {}
+
+    void reset() { _len = 0; }
+
+    void step(uint8_t b) {
+        if (_len < FMS_PASSTHROUGH_MAX) {
+            _buf[_len++] = b;
+        } else {
+            this->_stats.overflows++;
+        }
+    }
+
+    void on_idle() {
+        if (_len == 0) return;
+        fms_proto_event_t ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.type = PROTO_EV_TEXT;
+        ev.text = _buf;
+        ev.text_len = _len;
+        this->_stats.frames++;
+        _len = 0;
+        base::emit(ev);
+    }
+
+    size_t poll_frame(uint8_t, uint8_t*) { return 0; }
+    size_t ack_frame(uint8_t, uint8_t*) { return 0; }
+
+private:
+    uint8_t _len;
+    uint8_t _buf[FMS_PASSTHROUGH_MAX];
+};
+
+// names as accepted by protocol_config and stored in NVS "protocol"
+static const fms_protocol_ops_t fms_protocols[] = {
+    fms_protocol_ops_of<fms_tatsuno_driver>::ops("tatsuno"),
+    fms_protocol_ops_of<fms_passthrough_driver<1> >::ops("gilbarco"),
+    fms_protocol_ops_of<fms_passthrough_driver<2> >::ops("redstar"),
+    fms_protocol_ops_of<fms_passthrough_driver<3> >::ops("haungyang"),
+};
+
+const fms_protocol_ops_t* fms_protocol_find(const char* name) {
+    if (name == NULL) return NULL;
+    for (uint8_t i = 0; i < fms_protocol_count(); i++) {
+        if (strcmp(fms_protocols[i].name, name) == 0) return &fms_protocols[i];
+    }
+    return NULL;
+}
+
+const fms_protocol_ops_t* fms_protocol_at(uint8_t index) {
+    return index < fms_protocol_count() ? &fms_protocols[index] : NULL;
+}
+
+uint8_t fms_protocol_count() {
+    return sizeof(fms_protocols) / sizeof(fms_protocols[0]);
+}
+
+const char* fms_proto_event_name(uint8_t type) {
+    static const char* const names[PROTO_EV_COUNT] = {
+        "ack", "nak", "eot", "poll", "select", "nozzle_up", "nozzle_down", "live", "final", "text"
+    };
+    return type < PROTO_EV_COUNT ? names[type] : "unknown";
+}
@@ -0,0 +1,164 @@
+/*
+ * FMS Protocol - dispenser protocol driver interface
+ *
+ * A driver derives from fms_protocol_driver<Driver> (CRTP) and provides
+ *
+ *   void   step(uint8_t b);                      one received byte
+ *   void   on_idle();                            rx line went idle
+ *   size_t poll_frame(uint8_t pump, uint8_t* out);
+ *   size_t ack_frame(uint8_t seq, uint8_t* out);
+ *
+ * feed() calls step() directly, so the per byte path has no virtual or
+ * indirect call. Drivers report what they decode as fms_proto_event_t in
+ * engine units (_fms_fixed.h); the firmware maps those to nozzle events the
+ * same way for every brand.
+ *
+ * The firmware picks one driver at boot from the NVS "protocol" name through
+ * fms_protocol_table; that is one indirect call per received frame.
+ *
+ * Plain C++, no Arduino dependency, so it builds on the host as well.
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#ifndef _FMS_PROTOCOL_H_
+#define _FMS_PROTOCOL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "_fms_fixed.h"
+
+#define FMS_PROTO_MAX_FRAME 8       // longest poll / ack frame a driver builds
+
+enum fms_proto_event_type_t : uint8_t {
+    PROTO_EV_ACK = 0,       // seq = sequence bit
+    PROTO_EV_NAK,
+    PROTO_EV_EOT,           // no data / end of transmission
+    PROTO_EV_POLL,          // host poll seen on the bus
+    PROTO_EV_SELECT,        // host select seen on the bus
+    PROTO_EV_NOZZLE_UP,
+    PROTO_EV_NOZZLE_DOWN,
+    PROTO_EV_LIVE,          // volume, amount
+    PROTO_EV_FINAL,         // volume, amount, price, total
+    PROTO_EV_TEXT,          // good frame the driver does not map (text / text_len)
+    PROTO_EV_COUNT
+};
+
+struct fms_proto_event_t {
+    uint8_t          type;
+    uint8_t          pump;      // dispenser address
+    uint8_t          noz;       // nozzle on that dispenser, 1 based, 0 if not reported
+    uint8_t          seq;
+    fms_volume_t     volume;
+    fms_money_t      amount;
+    fms_unit_price_t price;
+    fms_volume_t     total;
+    const uint8_t*   text;      // valid during the callback only
+    uint8_t          text_len;
+};
+
+struct fms_proto_stats_t {
+    uint32_t bytes;
+    uint32_t frames;        // frames with a good check sum
+    uint32_t events;
+    uint32_t check_errors;  // BCC / CRC mismatch
+    uint32_t overflows;     // frame longer than the driver buffer
+    uint32_t resyncs;       // sequence broken, bytes skipped
+};
+
+typedef void (*fms_proto_event_fn)(const fms_proto_event_t& ev, void* ctx);
+
+const char* fms_proto_event_name(uint8_t type);
+
+template <class Driver>
+class fms_protocol_driver {
+public:
+    void begin(fms_proto_event_fn onEvent, void* ctx = NULL) {
+        _onEvent = onEvent;
+        _ctx = ctx;
+        self().reset();
+    }
+
+    // Feed any number of bytes, events are delivered from inside this call
+    void feed(const uint8_t* data, size_t len) {
+        _stats.bytes += len;
+        Driver& d = self();
+        for (size_t i = 0; i < len; i++) {
+            d.step(data[i]);
+        }
+    }
+
+    void idle() { self().on_idle(); }
+
+    const fms_proto_stats_t& stats() const { return _stats; }
+    void reset_stats() { memset(&_stats, 0, sizeof(_stats)); }
+
+protected:
+    fms_protocol_driver() : _onEvent(NULL), _ctx(NULL) { reset_stats(); }
+
+    void emit(const fms_proto_event_t& ev) {
+        _stats.events++;
+        if (_onEvent) {
+            _onEvent(ev, _ctx);
+        }
+    }
+
+    void emit_simple(uint8_t type, uint8_t pump, uint8_t seq) {
+        fms_proto_event_t ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.type = type;
+        ev.pump = pump;
+        ev.seq = seq;
+        emit(ev);
+    }
+
+    fms_proto_stats_t _stats;
+
+private:
+    fms_proto_event_fn _onEvent;
+    void*              _ctx;
+
+    Driver& self() { return *static_cast<Driver*>(this); }
+};
+
+// Boot time selection: one static driver instance per table entry
+struct fms_protocol_ops_t {
+    const char* name;
+    void   (*begin)(fms_proto_event_fn onEvent, void* ctx);
+    void   (*feed)(const uint8_t* data, size_t len);
+    void   (*idle)();
+    size_t (*poll_frame)(uint8_t pump, uint8_t* out);
+    size_t (*ack_frame)(uint8_t seq, uint8_t* out);
+    const fms_proto_stats_t& (*stats)();
+    void   (*reset_stats)();
+};
+
+template <class Driver>
+struct fms_protocol_ops_of {
+    static Driver driver;
+    static void   begin(fms_proto_event_fn onEvent, void* ctx) { driver.begin(onEvent, ctx); }
+    static void   feed(const uint8_t* data, size_t len)        { driver.feed(data, len); }
+    static void   idle()                                       { driver.idle(); }
+    static size_t poll_frame(uint8_t pump, uint8_t* out)       { return driver.poll_frame(pump, out); }
+    static size_t ack_frame(uint8_t seq, uint8_t* out)         { return driver.ack_frame(seq, out); }
+    static const fms_proto_stats_t& stats()                    { return driver.stats(); }
+    static void   reset_stats()                                { driver.reset_stats(); }
+
+    static fms_protocol_ops_t ops(const char* name) {
+        fms_protocol_ops_t o = { name, begin, feed, idle, poll_frame, ack_frame, stats, reset_stats };
+        return o;
+    }
+};
+
+template <class Driver>
+Driver fms_protocol_ops_of<Driver>::driver;
+
+// Drivers known to this build, NULL if the name is not one of them
+const fms_protocol_ops_t* fms_protocol_find(const char* name);
+const fms_protocol_ops_t* fms_protocol_at(uint8_t index);
+uint8_t fms_protocol_count();
+
+#endif // _FMS_PROTOCOL_H_
@@ -0,0 +1,157 @@
+/*
+ * FMS Ring Buffer - single producer / single consumer frame ring
+ *
+ * Bytes are written straight into the ring by the producer (uart rx event)
+ * and every frame is kept contiguous, so the consumer gets a pointer and a
+ * length into the ring without copying. A frame that does not fit at the
+ * end of the buffer starts again at offset 0 (the tail bytes are skipped).
+ *
+ *   producer:  p = reserve(n); fill p[0..n); commit(n);
+ *   consumer:  while (peek(&p, &n)) { use p[0..n); release(); }
+ *
+ * Lock free: one index is written by each side only.
+ *
+ * Plain C++, header only, builds on the host as well.
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#ifndef _FMS_RINGBUF_H_
+#define _FMS_RINGBUF_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+struct fms_ring_stats_t {
+    uint32_t frames;        // frames committed
+    uint32_t bytes;         // bytes committed
+    uint32_t overflows;     // frames dropped, no room (ring or frame slots)
+    uint32_t dropped_bytes; // bytes of the dropped frames
+    uint32_t high_water;    // most bytes in use at once (skipped tail included)
+    uint16_t max_frame;     // largest committed frame
+};
+
+template <size_t Size, size_t MaxFrames>
+class fms_frame_ring {
+    static_assert(Size > 1 && Size <= 65535, "ring size must fit uint16_t offsets");
+    static_assert((MaxFrames & (MaxFrames - 1)) == 0, "frame slots must be a power of two");
+
+public:
+    fms_frame_ring() { clear(); }
+
+    // Not thread safe, call while neither side is running
+    void clear() {
+        _write.store(0, std::memory_order_relaxed);
+        _read.store(0, std::memory_order_relaxed);
+        _head.store(0, std::memory_order_relaxed);
+        _tail.store(0, std::memory_order_relaxed);
+        _pending = 0;
+        _stats = fms_ring_stats_t();
+    }
+
+    // Producer: contiguous room for n bytes, NULL (and counted as overflow) when full
+    uint8_t* reserve(size_t n) {
+        _pending = 0;
+        if (n == 0 || n >= Size) return drop(n);
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) >= MaxFrames) return drop(n);
+
+        size_t w = _write.load(std::memory_order_relaxed);
+        size_t r = _read.load(std::memory_order_acquire);
+        size_t off;
+        if (w >= r) {
+            // free: [w, Size) and [0, r), keep one byte so w never catches r
+            size_t end = r == 0 ? Size - 1 : Size;
+            if (w + n <= end)  off = w;
+            else if (n < r)    off = 0;
+            else               return drop(n);
+        } else {
+            if (w + n < r)     off = w;
+            else               return drop(n);
+        }
+        _pendingOff = (uint16_t)off;
+        _pending = (uint16_t)n;
+        return _buf + off;
+    }
+
+    // Producer: publish the first n bytes (n <= reserved) of the last reserve()
+    void commit(size_t n) {
+        if (n > _pending) n = _pending;
+        _pending = 0;
+        if (n == 0) return;
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        _frames[head & (MaxFrames - 1)].off = _pendingOff;
+        _frames[head & (MaxFrames - 1)].len = (uint16_t)n;
+
+        size_t w = _pendingOff + n;
+        if (w == Size) w = 0;
+        _write.store(w, std::memory_order_relaxed);
+        _head.store(head + 1, std::memory_order_release);
+
+        _stats.frames++;
+        _stats.bytes += n;
+        if (n > _stats.max_frame) _stats.max_frame = (uint16_t)n;
+        size_t r = _read.load(std::memory_order_relaxed);
+        size_t used = w >= r ? w - r : Size - r + w;
+        if (used > _stats.high_water) _stats.high_water = used;
+    }
+
+    // Consumer: oldest frame, false when empty
+    bool peek(const uint8_t** data, size_t* len) const {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire)) return false;
+        const frame_t& f = _frames[tail & (MaxFrames - 1)];
+        *data = _buf + f.off;
+        *len = f.len;
+        return true;
+    }
+
+    // Consumer: done with the frame returned by peek()
+    void release() {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire)) return;
+        const frame_t& f = _frames[tail & (MaxFrames - 1)];
+        size_t r = f.off + f.len;
+        if (r == Size) r = 0;
+        _read.store(r, std::memory_order_release);
+        _tail.store(tail + 1, std::memory_order_release);
+    }
+
+    size_t frames_pending() const {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+    // Counters are written by the producer only, read them as a snapshot
+    const fms_ring_stats_t& stats() const { return _stats; }
+    void reset_stats() { _stats = fms_ring_stats_t(); }
+
+    static constexpr size_t capacity() { return Size; }
+    static constexpr size_t frame_slots() { return MaxFrames; }
+
+private:
+    struct frame_t {
+        uint16_t off;
+        uint16_t len;
+    };
+
+    uint8_t  _buf[Size];
+    frame_t  _frames[MaxFrames];
+    std::atomic<uint32_t> _head;    // frame slots, producer
+    std::atomic<uint32_t> _tail;    // frame slots, consumer
+    std::atomic<size_t>   _write;   // byte offset, producer
+    std::atomic<size_t>   _read;    // byte offset, consumer
+    uint16_t _pendingOff;
+    uint16_t _pending;
+    fms_ring_stats_t _stats;
+
+    uint8_t* drop(size_t n) {
+        _stats.overflows++;
+        _stats.dropped_bytes += n;
+        return NULL;
+    }
+};
+
+#endif // _FMS_RINGBUF_H_
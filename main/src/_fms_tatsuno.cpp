@@ -0,0 +1,205 @@
+/*
+ * FMS Tatsuno - protocol driver for the Tatsuno dispenser link
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#include "_fms_tatsuno.h"
+#include <string.h>
+
+// text layouts: code, total length (code included)
+#define TAT_STATUS_CODE   '1'
+#define TAT_STATUS_LEN    3
+#define TAT_LIVE_CODE     '6'
+#define TAT_LIVE_LEN      14
+#define TAT_FINAL_CODE    '2'
+#define TAT_FINAL_LEN     28
+
+template class fms_protocol_driver<fms_tatsuno_driver>;
+
+// fixed width ASCII digits, false on anything else
+static bool tat_digits(const uint8_t* p, uint8_t n, int64_t* out) {
+    int64_t v = 0;
+    for (uint8_t i = 0; i < n; i++) {
+        if (p[i] < '0' || p[i] > '9') return false;
+        v = v * 10 + (p[i] - '0');
+    }
+    *out = v;
+    return true;
+}
+
+fms_tatsuno_driver::fms_tatsuno_driver()
+    : _state(S_IDLE),
+      _addr(0),
+      _cmd(0),
+      _bcc(0),
+      _len(0) {
+}
+
+void fms_tatsuno_driver::reset() {
+    _state = S_IDLE;
+    _len = 0;
+}
+
+void fms_tatsuno_driver::step(uint8_t b) {
+    if (!consume(b)) {
+        consume(b);  // sequence broken, the byte may start the next one
+    }
+}
+
+void fms_tatsuno_driver::on_idle() {
+    if (_state == S_EOT) {
+        emit_simple(PROTO_EV_EOT, 0, 0);
+        _state = S_IDLE;
+    }
+}
+
+void fms_tatsuno_driver::resync() {
+    _stats.resyncs++;
+    _state = S_IDLE;
+    _len = 0;
+}
+
+// one byte, returns false if it was not consumed (state is back to idle)
+bool fms_tatsuno_driver::consume(uint8_t b) {
+    switch (_state) {
+        case S_IDLE:
+            switch (b) {
+                case TATSUNO_STX: _state = S_ADDR; break;
+                case TATSUNO_EOT: _state = S_EOT; break;
+                case TATSUNO_DLE: _state = S_DLE; break;
+                case TATSUNO_NAK: emit_simple(PROTO_EV_NAK, 0, 0); break;
+                default:          _stats.resyncs++; break;  // line noise
+            }
+            return true;
+
+        case S_EOT:
+            if (b >= TATSUNO_ADDR_BASE && b < TATSUNO_ADDR_BASE + 0x20) {
+                _addr = b;
+                _state = S_POLL_CMD;
+                return true;
+            }
+            emit_simple(PROTO_EV_EOT, 0, 0);
+            _state = S_IDLE;
+            return false;
+
+        case S_POLL_CMD:
+            if (b == 'Q' || b == 'A') {
+                _cmd = b;
+                _state = S_POLL_ENQ;
+                return true;
+            }
+            resync();
+            return false;
+
+        case S_POLL_ENQ:
+            if (b == TATSUNO_ENQ) {
+                emit_simple(_cmd == 'Q' ? PROTO_EV_POLL : PROTO_EV_SELECT, _addr - TATSUNO_ADDR_BASE, 0);
+                _state = S_IDLE;
+                return true;
+            }
+            resync();
+            return false;
+
+        case S_DLE:
+            if (b == '0' || b == '1') {
+                emit_simple(PROTO_EV_ACK, 0, b - '0');
+                _state = S_IDLE;
+                return true;
+            }
+            resync();
+            return false;
+
+        case S_ADDR:
+            if (b < TATSUNO_ADDR_BASE || b >= TATSUNO_ADDR_BASE + 0x20) {
+                resync();
+                return false;
+            }
+            _addr = b;
+            _bcc = b;
+            _len = 0;
+            _state = S_TEXT;
+            return true;
+
+        case S_TEXT:
+            if (b == TATSUNO_ETX) {
+                _bcc ^= b;
+                _state = S_BCC;
+                return true;
+            }
+            if (b == TATSUNO_STX) {
+                resync();  // frame cut short, restart on this STX
+                return false;
+            }
+            if (_len >= TATSUNO_MAX_TEXT) {
+                _stats.overflows++;
+                resync();
+                return true;
+            }
+            _text[_len++] = b;
+            _bcc ^= b;
+            return true;
+
+        case S_BCC:
+            _state = S_IDLE;
+            if (b != _bcc) {
+                _stats.check_errors++;
+                return true;
+            }
+            _stats.frames++;
+            decode_text();
+            return true;
+    }
+    resync();
+    return true;
+}
+
+void fms_tatsuno_driver::decode_text() {
+    fms_proto_event_t ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.type = PROTO_EV_TEXT;
+    ev.pump = _addr - TATSUNO_ADDR_BASE;
+    ev.text = _text;
+    ev.text_len = _len;
+
+    const uint8_t* t = _text;
+    int64_t noz, a, b, c, d;
+    if (_len >= 2 && tat_digits(t + 1, 1, &noz)) {
+        if (t[0] == TAT_STATUS_CODE && _len == TAT_STATUS_LEN && (t[2] == '0' || t[2] == '1')) {
+            ev.type = t[2] == '1' ? PROTO_EV_NOZZLE_UP : PROTO_EV_NOZZLE_DOWN;
+        } else if (t[0] == TAT_LIVE_CODE && _len == TAT_LIVE_LEN &&
+                   tat_digits(t + 2, 6, &a) && tat_digits(t + 8, 6, &b)) {
+            ev.type = PROTO_EV_LIVE;
+            ev.volume = fms_volume_t::from_scaled(a, TATSUNO_VOLUME_DECIMALS);
+            ev.amount = fms_money_t::from_scaled(b, TATSUNO_MONEY_DECIMALS);
+        } else if (t[0] == TAT_FINAL_CODE && _len == TAT_FINAL_LEN &&
+                   tat_digits(t + 2, 4, &c) && tat_digits(t + 6, 6, &a) &&
+                   tat_digits(t + 12, 6, &b) && tat_digits(t + 18, 10, &d)) {
+            ev.type = PROTO_EV_FINAL;
+            ev.price = fms_unit_price_t::from_scaled(c, TATSUNO_PRICE_DECIMALS);
+            ev.volume = fms_volume_t::from_scaled(a, TATSUNO_VOLUME_DECIMALS);
+            ev.amount = fms_money_t::from_scaled(b, TATSUNO_MONEY_DECIMALS);
+            ev.total = fms_volume_t::from_scaled(d, TATSUNO_VOLUME_DECIMALS);
+        }
+        if (ev.type != PROTO_EV_TEXT) {
+            ev.noz = (uint8_t)noz;
+        }
+    }
+    emit(ev);
+}
+
+size_t fms_tatsuno_driver::poll_frame(uint8_t pump, uint8_t* out) {
+    out[0] = TATSUNO_EOT;
+    out[1] = TATSUNO_ADDR_BASE + (pump & 0x1F);
+    out[2] = 'Q';
+    out[3] = TATSUNO_ENQ;
+    return 4;
+}
+
+size_t fms_tatsuno_driver::ack_frame(uint8_t seq, uint8_t* out) {
+    out[0] = TATSUNO_DLE;
+    out[1] = '0' + (seq & 1);
+    return 2;
+}
@@ -0,0 +1,88 @@
+/*
+ * FMS Tatsuno - protocol driver for the Tatsuno dispenser link
+ *
+ * Bytes are fed as they arrive, in any fragmentation; the parser keeps its
+ * position between calls and never allocates. Complete, BCC checked frames
+ * are turned into fms_proto_event_t (_fms_protocol.h).
+ *
+ *   poll      EOT addr 'Q' ENQ          select   EOT addr 'A' ENQ
+ *   text      STX addr text.. ETX BCC   (BCC = xor of addr .. ETX)
+ *   ack       DLE '0' | DLE '1'         nak      NAK      no data  EOT
+ *
+ * addr is 0x40 + pump number. The first text byte is the message code; the
+ * field layouts below are the ones our units are set up with, all numbers
+ * are fixed width ASCII digits:
+ *
+ *   '1' status  noz(1) handle(1, '0' down / '1' up)
+ *   '6' live    noz(1) volume(6) amount(6)
+ *   '2' final   noz(1) price(4) volume(6) amount(6) totalizer(10)
+ *
+ * Plain C++, no Arduino dependency, so it builds on the host as well.
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#ifndef _FMS_TATSUNO_H_
+#define _FMS_TATSUNO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "_fms_protocol.h"
+
+#define TATSUNO_STX             0x02
+#define TATSUNO_ETX             0x03
+#define TATSUNO_EOT             0x04
+#define TATSUNO_ENQ             0x05
+#define TATSUNO_DLE             0x10
+#define TATSUNO_NAK             0x15
+#define TATSUNO_ADDR_BASE       0x40
+
+#define TATSUNO_MAX_TEXT        64      // longest text accepted, longer frames are dropped
+#define TATSUNO_VOLUME_DECIMALS 2       // 0.01 liter on the wire
+#define TATSUNO_MONEY_DECIMALS  0
+#define TATSUNO_PRICE_DECIMALS  0
+
+class fms_tatsuno_driver : public fms_protocol_driver<fms_tatsuno_driver> {
+public:
+    fms_tatsuno_driver();
+
+    void reset();
+    void step(uint8_t b);
+
+    // Line went idle: a lone EOT is complete, a partial frame is kept
+    void on_idle();
+
+    // Host side frames, return the length written
+    size_t poll_frame(uint8_t pump, uint8_t* out);
+    size_t ack_frame(uint8_t seq, uint8_t* out);
+
+private:
+    enum state_t : uint8_t {
+        S_IDLE = 0,
+        S_EOT,          // EOT seen, poll/select or a lone EOT
+        S_POLL_CMD,
+        S_POLL_ENQ,
+        S_DLE,
+        S_ADDR,
+        S_TEXT,
+        S_BCC
+    };
+
+    uint8_t _state;
+    uint8_t _addr;
+    uint8_t _cmd;
+    uint8_t _bcc;
+    uint8_t _len;
+    uint8_t _text[TATSUNO_MAX_TEXT];
+
+    bool consume(uint8_t b);
+    void resync();
+    void decode_text();
+};
+
+// feed() is instantiated in _fms_tatsuno.cpp, next to step()
+extern template class fms_protocol_driver<fms_tatsuno_driver>;
+
+#endif // _FMS_TATSUNO_H_
@@ -0,0 +1,139 @@
+/*
+ * FMS Topic Router - MQTT topic to handler dispatch
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#include "_fms_topic_router.h"
+#include <string.h>
+
+fms_topic_router::fms_topic_router() {
+    clear();
+}
+
+void fms_topic_router::clear() {
+    _root = NONE;
+    _rootPrefix = -1;
+    _nodeCount = 0;
+    _routeCount = 0;
+    reset_stats();
+}
+
+void fms_topic_router::reset_stats() {
+    for (uint8_t i = 0; i < FMS_ROUTER_MAX_ROUTES; i++) {
+        _routes[i].hits = 0;
+    }
+    _unrouted = 0;
+}
+
+uint8_t fms_topic_router::find_child(uint8_t first, char c) const {
+    for (uint8_t n = first; n != NONE; n = _nodes[n].sibling) {
+        if (_nodes[n].label[0] == c) return n;
+    }
+    return NONE;
+}
+
+uint8_t fms_topic_router::new_node(const char* label, uint8_t len) {
+    if (_nodeCount >= FMS_ROUTER_MAX_NODES) {
+        return NONE;
+    }
+    node_t& n = _nodes[_nodeCount];
+    n.label = label;
+    n.len = len;
+    n.exact = -1;
+    n.prefix = -1;
+    n.child = NONE;
+    n.sibling = NONE;
+    return _nodeCount++;
+}
+
+int8_t fms_topic_router::add(const char* pattern, fms_topic_handler_fn handler, void* ctx) {
+    if (pattern == NULL || handler == NULL) {
+        return -1;
+    }
+    size_t len = strlen(pattern);
+    bool isPrefix = len > 0 && pattern[len - 1] == '#';
+    if (isPrefix) len--;
+    if (len > 255) return -1;
+
+    // walk / extend the trie, splitting an edge where the pattern leaves it
+    uint8_t* slot = &_root;
+    uint8_t node = NONE;
+    size_t pos = 0;
+    while (pos < len) {
+        uint8_t n = find_child(*slot, pattern[pos]);
+        if (n == NONE) {
+            n = new_node(pattern + pos, (uint8_t)(len - pos));
+            if (n == NONE) return -1;
+            _nodes[n].sibling = *slot;
+            *slot = n;
+            node = n;
+            break;
+        }
+        uint8_t common = 1;
+        while (common < _nodes[n].len && pos + common < len && _nodes[n].label[common] == pattern[pos + common]) {
+            common++;
+        }
+        if (common < _nodes[n].len) {
+            uint8_t tail = new_node(_nodes[n].label + common, _nodes[n].len - common);
+            if (tail == NONE) return -1;
+            node_t& t = _nodes[tail];
+            t.exact = _nodes[n].exact;
+            t.prefix = _nodes[n].prefix;
+            t.child = _nodes[n].child;
+            _nodes[n].len = common;
+            _nodes[n].exact = -1;
+            _nodes[n].prefix = -1;
+            _nodes[n].child = tail;
+        }
+        pos += common;
+        node = n;
+        slot = &_nodes[n].child;
+    }
+
+    int8_t* target = node == NONE ? (isPrefix ? &_rootPrefix : NULL)
+                                  : (isPrefix ? &_nodes[node].prefix : &_nodes[node].exact);
+    if (target == NULL) return -1;   // empty topic
+    if (*target >= 0) return *target;
+    if (_routeCount >= FMS_ROUTER_MAX_ROUTES) return -1;
+
+    int8_t id = (int8_t)_routeCount++;
+    _routes[id].pattern = pattern;
+    _routes[id].handler = handler;
+    _routes[id].ctx = ctx;
+    *target = id;
+    return id;
+}
+
+bool fms_topic_router::route(const char* topic, const uint8_t* payload, size_t len) {
+    int8_t best = _rootPrefix;
+    int8_t id = -1;
+    uint8_t list = _root;
+    const char* p = topic;
+    size_t rem = strlen(topic);
+    while (rem > 0) {
+        uint8_t n = find_child(list, *p);
+        if (n == NONE) break;
+        const node_t& nd = _nodes[n];
+        if (rem < nd.len || memcmp(p, nd.label, nd.len) != 0) break;
+        p += nd.len;
+        rem -= nd.len;
+        if (nd.prefix >= 0) best = nd.prefix;
+        if (rem == 0) {
+            id = nd.exact;
+            break;
+        }
+        list = nd.child;
+    }
+    if (id < 0) id = best;
+    if (id < 0) {
+        _unrouted++;
+        return false;
+    }
+    route_t& r = _routes[id];
+    r.hits++;
+    r.handler(topic, payload, len, r.ctx);
+    return true;
+}
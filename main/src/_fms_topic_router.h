@@ -0,0 +1,89 @@
+/*
+ * FMS Topic Router - MQTT topic to handler dispatch
+ *
+ * Topics are stored in a path compressed trie held in a fixed node pool
+ * (first child / next sibling links). Edge labels point into the route
+ * patterns, so a shared prefix such as "detpos/local_server/" is one node and
+ * one memcmp. Routing walks the topic once and never allocates. The payload
+ * reaches the handler as the broker client's own buffer, pointer and
+ * length, valid for the duration of the call.
+ *
+ * Routes are exact topics, or a prefix ending in "#" (MQTT multi level
+ * wildcard); an exact route wins over a prefix, the longest prefix wins
+ * among prefixes. Every route keeps a hit counter.
+ *
+ * With the firmware's handful of routes this is no faster than a strcmp
+ * chain (tools/mqtt_router_bench); it replaces one for the table of handlers
+ * and the counters, and its cost does not grow with the route count.
+ *
+ * Plain C++, no Arduino dependency, so it builds on the host as well.
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#ifndef _FMS_TOPIC_ROUTER_H_
+#define _FMS_TOPIC_ROUTER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FMS_ROUTER_MAX_ROUTES   16
+#define FMS_ROUTER_MAX_NODES    48      // at most two per route (one split + one leaf)
+
+typedef void (*fms_topic_handler_fn)(const char* topic, const uint8_t* payload, size_t len, void* ctx);
+
+class fms_topic_router {
+public:
+    fms_topic_router();
+
+    // Drop every route and counter (topic buffers changed)
+    void clear();
+
+    // Add a route, returns its id, the existing id if the same pattern is already
+    // routed, or -1 when the pool is full
+    int8_t add(const char* pattern, fms_topic_handler_fn handler, void* ctx = NULL);
+
+    // Dispatch one message, false if no route matched
+    bool route(const char* topic, const uint8_t* payload, size_t len);
+
+    uint8_t     route_count() const          { return _routeCount; }
+    uint8_t     node_count() const           { return _nodeCount; }
+    const char* pattern(uint8_t id) const    { return id < _routeCount ? _routes[id].pattern : NULL; }
+    uint32_t    hits(uint8_t id) const       { return id < _routeCount ? _routes[id].hits : 0; }
+    uint32_t    unrouted() const             { return _unrouted; }
+    void        reset_stats();
+
+private:
+    static const uint8_t NONE = 0xFF;
+
+    struct node_t {
+        const char* label;   // edge text, points into a route pattern
+        uint8_t     len;
+        int8_t      exact;   // route id ending on this node, -1 if none
+        int8_t      prefix;  // route id for "<path to here>#", -1 if none
+        uint8_t     child;
+        uint8_t     sibling;
+    };
+
+    struct route_t {
+        const char*          pattern;   // not copied, the caller keeps it alive
+        fms_topic_handler_fn handler;
+        void*                ctx;
+        uint32_t             hits;
+    };
+
+    node_t   _nodes[FMS_ROUTER_MAX_NODES];
+    route_t  _routes[FMS_ROUTER_MAX_ROUTES];
+    uint8_t  _root;          // first child of the (implicit) root
+    int8_t   _rootPrefix;    // route id of a bare "#"
+    uint8_t  _nodeCount;
+    uint8_t  _routeCount;
+    uint32_t _unrouted;
+
+    uint8_t find_child(uint8_t first, char c) const;
+    uint8_t new_node(const char* label, uint8_t len);
+};
+
+#endif // _FMS_TOPIC_ROUTER_H_
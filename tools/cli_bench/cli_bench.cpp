@@ -0,0 +1,281 @@
+/*
+ * cli_bench - commands per second and heap allocations per command of the CLI
+ *
+ * "before" is the old fms_cli path with std::string in place of the Arduino
+ * String: trim and substring the line into a vector of args, look the name
+ * up in a std::map, and answer through format_json (a map of fields turned
+ * into one string). "after" is the path in main/src/_fms_cli.cpp now: the
+ * line split in place by fms_cli_tokenize, the name found in the sorted
+ * fms_cli_table and the answer streamed by fms_json_writer. Both register
+ * the firmware's command names and run the same lines; the handlers only
+ * respond, so what is measured is the CLI around them. Allocations are
+ * counted through operator new, the serial port is a memory sink.
+ *
+ *   g++ -O2 -std=gnu++17 -I../../main/src -o cli_bench cli_bench.cpp ../../main/src/_fms_cli_core.cpp
+ *   ./cli_bench [--lines 1000000]
+ *
+ * @copyright 2025 FMS Project
+ */
+
+#include "_fms_cli_core.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <functional>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+static uint64_t clock_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// ---- allocation counter ----------------------------------------------------
+
+static unsigned long allocs;
+
+void* operator new(size_t n) {
+    allocs++;
+    void* p = malloc(n ? n : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// ---- serial sink -----------------------------------------------------------
+
+static char     serial_sink[256];
+static volatile uint32_t serial_pos;
+
+static void serial_write(const char* data, size_t len) {
+    for (size_t i = 0; i < len; i++) serial_sink[serial_pos++ & (sizeof(serial_sink) - 1)] = data[i];
+}
+
+static const char* names[] = {
+    "help", "echo", "logout", "wifi", "wifi_connect", "restart", "wifiscan_safe", "wifiread",
+    "wifi_test", "uuid_change", "protocol", "protocol_config", "mqtt_config", "noz_config",
+    "mqtt_stats", "mqtt_routes", "live_stats", "live_rate", "payload_format", "latency", "ledger",
+    "log_level", "log_stats", "boot_stats", "outbox_stats", "uart2_stats", "protocol_stats",
+};
+#define NAMES (sizeof(names) / sizeof(names[0]))
+
+// What comes in over the serial port, a configuration session and some status polling
+static const char* lines[] = {
+    "wifi \"Station 5 Office\" secret123",
+    "mqtt_stats",
+    "log_level MQTT debug",
+    "noz_config 92 2500 95 2700 97 2900 92 2500 95 2700 97 2900 92 2500 95 2700",
+    "live_rate 500",
+    "ledger day 2025-06-01 3",
+    "protocol_config tatsuno 1 2 1 2 3 4 5 6 7 8",
+    "nosuchcommand",
+};
+#define LINES (sizeof(lines) / sizeof(lines[0]))
+
+// ---- before: String parsing, std::map, format_json -------------------------
+
+namespace before {
+
+typedef std::function<void(const std::vector<std::string>&)> callback_t;
+struct command_t {
+    std::string name;
+    std::string description;
+    callback_t  callback;
+    uint8_t     minArgs;
+    uint8_t     maxArgs;
+};
+static std::map<std::string, command_t> commands;
+
+static std::string trim(const std::string& s) {
+    size_t a = s.find_first_not_of(" \t\r\n");
+    if (a == std::string::npos) return "";
+    size_t b = s.find_last_not_of(" \t\r\n");
+    return s.substr(a, b - a + 1);
+}
+
+static void parse_command(const std::string& cmdLine, std::string& command, std::vector<std::string>& args) {
+    std::string trimmed = trim(cmdLine);
+    size_t idx = trimmed.find(' ');
+    if (idx == std::string::npos) {
+        command = trimmed;
+        return;
+    }
+    command = trimmed.substr(0, idx);
+    size_t lastIdx = idx + 1;
+    while (lastIdx < trimmed.length()) {
+        while (lastIdx < trimmed.length() && trimmed[lastIdx] == ' ') lastIdx++;
+        if (lastIdx >= trimmed.length()) break;
+        if (trimmed[lastIdx] == '"') {
+            lastIdx++;
+            idx = trimmed.find('"', lastIdx);
+            if (idx == std::string::npos) {
+                args.push_back(trimmed.substr(lastIdx));
+                break;
+            }
+            args.push_back(trimmed.substr(lastIdx, idx - lastIdx));
+            lastIdx = idx + 1;
+        } else {
+            idx = trimmed.find(' ', lastIdx);
+            if (idx == std::string::npos) {
+                args.push_back(trimmed.substr(lastIdx));
+                break;
+            }
+            args.push_back(trimmed.substr(lastIdx, idx - lastIdx));
+            lastIdx = idx + 1;
+        }
+    }
+}
+
+static std::string escape_json(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+static std::string format_json(const std::map<std::string, std::string>& fields) {
+    std::string json = "{";
+    bool first = true;
+    for (const auto& field : fields) {
+        if (!first) json += ",";
+        first = false;
+        json += "\"" + field.first + "\":";
+        if (field.second == "true" || field.second == "false" || field.second == "null" ||
+            (field.second.length() > 0 && ((field.second[0] >= '0' && field.second[0] <= '9') || field.second[0] == '-'))) {
+            json += field.second;
+        } else {
+            json += "\"" + escape_json(field.second) + "\"";
+        }
+    }
+    json += "}";
+    return json;
+}
+
+static void respond(const std::string& command, const std::string& result, bool success = true) {
+    std::map<std::string, std::string> fields;
+    fields["command"] = command;
+    fields["result"] = result;
+    fields["success"] = success ? "true" : "false";
+    std::string response = format_json(fields) + "\r\n";
+    serial_write(response.c_str(), response.length());
+}
+
+static void setup() {
+    for (size_t i = 0; i < NAMES; i++) {
+        std::string name = names[i];
+        commands[name] = command_t{name, "description", [name](const std::vector<std::string>& args) {
+            respond(name, args.empty() ? "done" : args[0]);
+        }, 0, 16};
+    }
+}
+
+static void run(const char* line) {
+    std::string buffer = line;          // _buffer += c, one character at a time on the device
+    std::string command;
+    std::vector<std::string> args;
+    parse_command(buffer, command, args);
+    auto it = commands.find(command);
+    if (it == commands.end()) {
+        respond(command, "Command not found", false);
+        return;
+    }
+    it->second.callback(args);
+}
+
+} // namespace before
+
+// ---- after: in place tokens, flat table, streamed JSON ---------------------
+
+namespace after {
+
+typedef std::function<void(const fms_cli_args&)> callback_t;
+struct command_t {
+    const char* name;
+    const char* description;
+    callback_t  callback;
+    uint8_t     minArgs;
+    uint8_t     maxArgs;
+};
+static command_t       commands[FMS_CLI_MAX_COMMANDS];
+static fms_cli_table   table;
+
+static void sink(void*, const char* data, size_t len) { serial_write(data, len); }
+static fms_json_writer json(sink, nullptr);
+
+static void respond(const char* command, const char* result, bool success = true) {
+    json.begin_object();
+    json.field("command", command);
+    json.field("result", result);
+    json.field_bool("success", success);
+    json.end_object();
+    json.raw("\r\n");
+    json.flush();
+}
+
+static void setup() {
+    for (size_t i = 0; i < NAMES; i++) {
+        const char* name = names[i];
+        commands[i] = command_t{name, "description", [name](const fms_cli_args& args) {
+            respond(name, args.empty() ? "done" : args[0].c_str());
+        }, 0, 16};
+        table.add(name, (uint16_t)i);
+    }
+}
+
+static void run(const char* line) {
+    char buffer[FMS_CLI_LINE_MAX + 1];
+    size_t len = strlen(line);
+    memcpy(buffer, line, len);          // the characters land in _buffer as they arrive
+    fms_cli_arg tokens[FMS_CLI_MAX_ARGS];
+    bool overflow;
+    size_t n = fms_cli_tokenize(buffer, len, tokens, FMS_CLI_MAX_ARGS, &overflow);
+    if (n == 0) return;
+    int id = table.find(tokens[0].s);
+    if (id < 0) {
+        respond(tokens[0].s, "Command not found", false);
+        return;
+    }
+    commands[id].callback(fms_cli_args(tokens + 1, n - 1));
+}
+
+} // namespace after
+
+int main(int argc, char** argv) {
+    long count = 1000000;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--lines") && i + 1 < argc) count = atol(argv[++i]);
+        else { fprintf(stderr, "usage: %s [--lines n]\n", argv[0]); return 2; }
+    }
+
+    before::setup();
+    after::setup();
+
+    uint64_t t0 = clock_ns();
+    unsigned long a0 = allocs;
+    for (long i = 0; i < count; i++) before::run(lines[i % LINES]);
+    uint64_t before_ns = clock_ns() - t0;
+    unsigned long before_allocs = allocs - a0;
+
+    t0 = clock_ns();
+    a0 = allocs;
+    for (long i = 0; i < count; i++) after::run(lines[i % LINES]);
+    uint64_t after_ns = clock_ns() - t0;
+    unsigned long after_allocs = allocs - a0;
+
+    printf("lines            %ld\n", count);
+    printf("before           %10.0f commands/s  %6.1f ns/command  %5.1f allocs/command\n",
+           count * 1e9 / before_ns, (double)before_ns / count, (double)before_allocs / count);
+    printf("after            %10.0f commands/s  %6.1f ns/command  %5.1f allocs/command\n",
+           count * 1e9 / after_ns, (double)after_ns / count, (double)after_allocs / count);
+    printf("speedup          %10.1fx\n", (double)before_ns / (double)after_ns);
+    return 0;
+}
@@ -0,0 +1,91 @@
+/*
+ * fixed_test - rounding parity of the fixed-point amount path (main/src/_fms_fixed.h)
+ *
+ * liters x unit price -> amount through fms_amount_of against the float path
+ * the firmware used before (float liters, float product, lroundf), for every
+ * 0.001 L step up to 200 L at a spread of prices. The two must agree except
+ * where the exact product lies within float's rounding error of a half unit;
+ * there fixed-point rounds the exact value half away from zero and float may
+ * land one unit either side. Run by ctest from the host build.
+ *
+ * @copyright 2025 FMS Project
+ */
+
+#include "_fms_fixed.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+static long float_amount(int64_t volume_raw, int64_t price_raw) {
+    float liters = (float)volume_raw / (float)fms_volume_t::scale;
+    return lroundf(liters * (float)price_raw);
+}
+
+static void test_parity() {
+    static const int64_t prices[] = { 1, 7, 99, 1250, 2500, 2990, 3000, 3333, 4150, 9999 };
+    static_assert(FMS_MONEY_DECIMALS == 0 && FMS_PRICE_DECIMALS == 0, "float_amount assumes whole units");
+    long checked = 0, differ = 0, far = 0, ties = 0;
+    for (int64_t price : prices) {
+        for (int64_t v = 0; v <= 200000; v++) {
+            fms_money_t m = {};
+            CHECK(fms_amount_of(fms_volume_t::from_raw(v), fms_unit_price_t::from_raw(price), &m));
+            int64_t exact = v * price;                          // in 0.001 units
+            int64_t rest = exact % fms_volume_t::scale;
+            CHECK(m.raw == exact / fms_volume_t::scale + (rest * 2 >= fms_volume_t::scale));
+            if (rest * 2 == fms_volume_t::scale) ties++;
+            checked++;
+            long f = float_amount(v, price);
+            if (f == m.raw) continue;
+            differ++;
+            double from_half = fabs((double)rest / fms_volume_t::scale - 0.5);
+            double float_err = ((double)exact / fms_volume_t::scale) * ldexp(1.0, -22);
+            if (labs(f - (long)m.raw) > 1 || from_half > float_err) {
+                if (far++ < 5) printf("  %lld mL x %lld: fixed %lld float %ld\n", (long long)v, (long long)price, (long long)m.raw, f);
+            }
+        }
+    }
+    CHECK(far == 0);
+    printf("parity: %ld products, %ld differ from float (all within float error of a half unit), %ld exact ties\n",
+           checked, differ, ties);
+}
+
+static void test_known_values() {
+    fms_volume_t v;
+    fms_unit_price_t p;
+    fms_money_t m;
+    CHECK(fms_volume_t::parse("12.345", 6, &v) && v.raw == 12345);
+    CHECK(fms_unit_price_t::parse("3000", 4, &p) && p.raw == 3000);
+    CHECK(fms_amount_of(v, p, &m) && m.raw == 37035);
+    CHECK(fms_amount_of(fms_volume_t::from_raw(500), fms_unit_price_t::from_raw(1), &m) && m.raw == 1);   // 0.5 up
+    CHECK(fms_amount_of(fms_volume_t::from_raw(499), fms_unit_price_t::from_raw(1), &m) && m.raw == 0);
+    CHECK(fms_amount_of(fms_volume_t::from_raw(-500), fms_unit_price_t::from_raw(1), &m) && m.raw == -1);  // away from zero
+    CHECK(!fms_amount_of(fms_volume_t::from_raw(INT64_MAX / 2), fms_unit_price_t::from_raw(3), &m));
+
+    char text[24];
+    CHECK(fms_volume_t::from_raw(12345).format(text, sizeof(text)) == 6 && strcmp(text, "12.345") == 0);
+    CHECK(fms_volume_t::from_raw(-5).format(text, sizeof(text)) == 6 && strcmp(text, "-0.005") == 0);
+    CHECK(fms_volume_t::parse("1.2345", 6, &v) && v.raw == 1235);  // extra decimals rounded
+    CHECK(!fms_volume_t::parse("1.2x", 4, &v));
+}
+
+int main() {
+    test_known_values();
+    test_parity();
+    if (failures) {
+        printf("fixed_test: %d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("fixed_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,394 @@
+/*
+ * host_bench - ns/op and heap allocations/op of the core libraries on the host
+ *
+ * Built against the Arduino / FreeRTOS shim in shim/ (see CMakeLists.txt),
+ * so fms_cli, JsonBuilder, fmsLog / log_printfv and the file manager helpers
+ * run unchanged. "allocs/op" counts malloc / calloc / realloc of the firmware
+ * code and operator new, averaged over the iterations. The serial port is a
+ * memory sink, so the times leave out the wire. The nozzle engine cases also
+ * report transitions per sale and bytes_per_nozzle, the amount cases set the
+ * fixed-point path against the old float one.
+ *
+ *   cmake -S tools/host -B build-host && cmake --build build-host
+ *   build-host/host_bench [--benchmark_filter=Cli] [--benchmark_format=json]
+ *
+ * @copyright 2025 FMS Project
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "Arduino.h"
+#include "fms_host.h"
+
+#include "_fms_cli.h"
+#include "_fms_cli_core.h"
+#include "_fms_debug.h"
+#include "_fms_filemanager.h"
+#include "_fms_fixed.h"
+#include "_fms_json_helper.h"
+#include "_fms_log_ring.h"
+#include "_fms_nozzle.h"
+
+int log_printfv(const char* format, va_list arg);
+
+// Sets allocs/op from the heap allocations between here and the end of the scope
+class alloc_meter {
+public:
+    explicit alloc_meter(benchmark::State& state) : _state(state), _start(fms_host_allocs()) {}
+    ~alloc_meter() {
+        _state.counters["allocs/op"] =
+            benchmark::Counter((double)(fms_host_allocs() - _start), benchmark::Counter::kAvgIterations);
+    }
+
+private:
+    benchmark::State& _state;
+    uint64_t          _start;
+};
+
+// ---- CLI -------------------------------------------------------------------
+
+static const char noz_line[] =
+    "noz_config 92 2500 95 2700 97 2900 92 2500 95 2700 97 2900 92 2500 95 2700";
+static const char profile_request[] =
+    "{\"id\":7,\"cmd\":\"config_apply\",\"args\":[\"wifi\",\"Station 5 Office\",\"secret123\","
+    "\"mqtt_config\",\"10.0.0.2\",1883,\"protocol_config\",\"tatsuno\",1,2,1,2,3,4,5,6,7,8]}";
+
+static void BM_CliTokenize(benchmark::State& state) {
+    char line[FMS_CLI_LINE_MAX + 1];
+    fms_cli_arg tokens[FMS_CLI_MAX_ARGS];
+    bool overflow;
+    alloc_meter m(state);
+    for (auto _ : state) {
+        memcpy(line, noz_line, sizeof(noz_line));
+        benchmark::DoNotOptimize(fms_cli_tokenize(line, sizeof(noz_line) - 1, tokens, FMS_CLI_MAX_ARGS, &overflow));
+    }
+}
+BENCHMARK(BM_CliTokenize);
+
+static void BM_CliParseRequest(benchmark::State& state) {
+    char line[FMS_CLI_LINE_MAX + 1];
+    fms_cli_arg tokens[FMS_CLI_MAX_ARGS];
+    long id;
+    bool overflow;
+    alloc_meter m(state);
+    for (auto _ : state) {
+        memcpy(line, profile_request, sizeof(profile_request));
+        benchmark::DoNotOptimize(
+            fms_cli_parse_request(line, sizeof(profile_request) - 1, &id, tokens, FMS_CLI_MAX_ARGS, &overflow));
+    }
+}
+BENCHMARK(BM_CliParseRequest);
+
+static fms_cli* host_cli() {
+    static fms_cli* cli = nullptr;
+    if (!cli) {
+        cli = new fms_cli(Serial);
+        cli->begin(115200);
+        cli->register_command("mqtt_config", "Configure Mqtt settings", [](const fms_cli_args& args) {
+            host_cli()->respond("mqtt_config", args[0].c_str());
+        }, 2, 2);
+    }
+    return cli;
+}
+
+// Lookup, argument check, handler and a respond() to the serial port
+static void BM_CliExecute(benchmark::State& state) {
+    fms_cli* cli = host_cli();
+    alloc_meter m(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cli->execute_test_command("mqtt_config 10.0.0.2 1883"));
+    }
+}
+BENCHMARK(BM_CliExecute);
+
+// Bytes in through the receive callback, the line through the queue, run by run_pending
+// (0: typed, with echo and prompt, 1: machine mode JSON request)
+static void BM_CliSerialLine(benchmark::State& state) {
+    fms_cli* cli = host_cli();
+    bool machine = state.range(0) != 0;
+    const char* line = machine ? "{\"id\":1,\"cmd\":\"mqtt_config\",\"args\":[\"10.0.0.2\",1883]}\n"
+                               : "mqtt_config 10.0.0.2 1883\r\n";
+    size_t len = strlen(line);
+    cli->set_machine(machine);
+    {
+        alloc_meter m(state);
+        for (auto _ : state) {
+            Serial.feed(line, len);
+            cli->process_input();
+            benchmark::DoNotOptimize(cli->run_pending(0));
+        }
+    }
+    cli->set_machine(false);
+    state.SetBytesProcessed((int64_t)state.iterations() * len);
+}
+BENCHMARK(BM_CliSerialLine)->Arg(0)->Arg(1);
+
+// ---- JSON ------------------------------------------------------------------
+
+static const String deviceName = "ultm_25505v01_";
+static const String firmwareVersion = "3.0.0.0";
+static const String ipAddress = "192.168.100.23";
+static const String macAddress = "24:6F:28:AA:BB:CC";
+
+// The object fms_info_response builds for the OTA page
+static void BM_JsonBuilder(benchmark::State& state) {
+    alloc_meter m(state);
+    for (auto _ : state) {
+        JsonBuilder json;
+        json.addString("deviceName", deviceName);
+        json.addString("firmwareVersion", firmwareVersion);
+        json.addString("ipAddress", ipAddress);
+        json.addString("macAddress", macAddress);
+        json.addInt("rssi", -61);
+        json.addLong("uptime", 123456);
+        json.addInt("freeHeap", 182340);
+        json.addInt("totalHeap", 327680);
+        json.addInt("cpuFreqMHz", 240);
+        json.addString("sdkVersion", "v4.4.7");
+        json.addString("status", "Idle");
+        json.addInt("progress", 0);
+        json.addBool("otaInProgress", false);
+        String out = json.toString();
+        benchmark::DoNotOptimize(out.c_str());
+    }
+}
+BENCHMARK(BM_JsonBuilder);
+
+static void serial_sink(void*, const char* data, size_t len) {
+    Serial.write((const uint8_t*)data, len);
+}
+
+// The same object streamed by fms_json_writer to the serial port
+static void BM_JsonWriter(benchmark::State& state) {
+    fms_json_writer json(serial_sink, nullptr);
+    alloc_meter m(state);
+    for (auto _ : state) {
+        json.begin_object();
+        json.field("deviceName", deviceName.c_str());
+        json.field("firmwareVersion", firmwareVersion.c_str());
+        json.field("ipAddress", ipAddress.c_str());
+        json.field("macAddress", macAddress.c_str());
+        json.field("rssi", -61L);
+        json.field("uptime", 123456L);
+        json.field("freeHeap", 182340L);
+        json.field("totalHeap", 327680L);
+        json.field("cpuFreqMHz", 240L);
+        json.field("sdkVersion", "v4.4.7");
+        json.field("status", "Idle");
+        json.field("progress", 0L);
+        json.field_bool("otaInProgress", false);
+        json.end_object();
+        json.flush();
+    }
+}
+BENCHMARK(BM_JsonWriter);
+
+// ---- log -------------------------------------------------------------------
+
+static int host_printf(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int n = log_printfv(format, args);
+    va_end(args);
+    return n;
+}
+
+// 0: fits log_printfv's 64 byte buffer, 1: longer, formatted into a malloc'd one
+static void BM_LogPrintfv(benchmark::State& state) {
+    bool longer = state.range(0) != 0;
+    alloc_meter m(state);
+    for (auto _ : state) {
+        if (longer) {
+            host_printf("[OUTBOX] SD write failed, publishing %s directly (%u bytes)",
+                        "detpos/local_server/Final/1", 184u);
+        } else {
+            host_printf("[MQTT] published %s (%u bytes)", "detpos/local_server/3", 42u);
+        }
+    }
+}
+BENCHMARK(BM_LogPrintfv)->Arg(0)->Arg(1);
+
+// fmsLog formatting and printing in the caller (before log_task starts)
+static void BM_FmsLogDirect(benchmark::State& state) {
+    fmsSetLogLevel(FMS_LOG_INFO);
+    alloc_meter m(state);
+    for (auto _ : state) {
+        FMS_LOG_INFO("[NOZZLE] %d: %s -> %s", 3, "APPROVED", "FUELLING");
+    }
+}
+BENCHMARK(BM_FmsLogDirect);
+
+// A call below the module's runtime level
+static void BM_FmsLogFiltered(benchmark::State& state) {
+    fmsSetLogLevel(FMS_LOG_INFO);
+    alloc_meter m(state);
+    for (auto _ : state) {
+        benchmark::ClobberMemory();     // the level is read every call, as with other tasks changing it
+        FMS_LOG_DEBUG("[NOZZLE] %d: %s -> %s", 3, "APPROVED", "FUELLING");
+    }
+}
+BENCHMARK(BM_FmsLogFiltered);
+
+// Deferred (0: what the caller pays, the push; 1: push plus its share of the
+// drain that log_task does)
+static void BM_FmsLogDeferred(benchmark::State& state) {
+    bool drain = state.range(0) != 0;
+    fmsSetLogLevel(FMS_LOG_INFO);
+    fmsLogDeferredBegin((TaskHandle_t)1);
+    {
+        alloc_meter m(state);
+        uint32_t n = 0;
+        for (auto _ : state) {
+            FMS_LOG_INFO("[NOZZLE] %d: %s -> %s", 3, "APPROVED", "FUELLING");
+            if (++n % (FMS_LOG_RING_SLOTS / 2) == 0) {
+                if (!drain) state.PauseTiming();
+                fmsLogDrain(0);
+                if (!drain) state.ResumeTiming();
+            }
+        }
+        fmsLogDrain(0);
+    }
+    fmsLogDeferredBegin(NULL);
+}
+BENCHMARK(BM_FmsLogDeferred)->Arg(0)->Arg(1);
+
+// ---- fixed point -----------------------------------------------------------
+
+// liters x unit price -> amount, 0: raw counts in, amount out; 1: register /
+// payload text in, amount text out. BM_AmountFloat is the float path the
+// firmware used before _fms_fixed.h; fixed_test checks the two round alike.
+static const char* const amount_volumes[] = { "12.345", "0.501", "47.999", "3.000", "120.250", "8.768", "0.001", "65.432" };
+static const char* const amount_prices[] = { "3000", "2990", "4150", "3333" };
+
+static void BM_AmountFixed(benchmark::State& state) {
+    bool text = state.range(0) != 0;
+    int64_t volumes[8], prices[4];
+    for (int i = 0; i < 8; i++) volumes[i] = atol(amount_volumes[i]) * 1000 + i * 37;
+    for (int i = 0; i < 4; i++) prices[i] = atol(amount_prices[i]);
+    char out[24];
+    size_t i = 0;
+    alloc_meter m(state);
+    for (auto _ : state) {
+        fms_volume_t v;
+        fms_unit_price_t p;
+        fms_money_t a = {};
+        if (text) {
+            const char* vs = amount_volumes[i & 7];
+            const char* ps = amount_prices[i & 3];
+            fms_volume_t::parse(vs, strlen(vs), &v);
+            fms_unit_price_t::parse(ps, strlen(ps), &p);
+            fms_amount_of(v, p, &a);
+            benchmark::DoNotOptimize(a.format(out, sizeof(out)));
+        } else {
+            v = fms_volume_t::from_raw(volumes[i & 7]);
+            p = fms_unit_price_t::from_raw(prices[i & 3]);
+            fms_amount_of(v, p, &a);
+            benchmark::DoNotOptimize(a.raw);
+        }
+        i++;
+    }
+}
+BENCHMARK(BM_AmountFixed)->Arg(0)->Arg(1);
+
+static void BM_AmountFloat(benchmark::State& state) {
+    bool text = state.range(0) != 0;
+    float volumes[8], prices[4];
+    for (int i = 0; i < 8; i++) volumes[i] = (float)(atol(amount_volumes[i]) * 1000 + i * 37) / 1000.0f;
+    for (int i = 0; i < 4; i++) prices[i] = (float)atol(amount_prices[i]);
+    char out[24];
+    size_t i = 0;
+    alloc_meter m(state);
+    for (auto _ : state) {
+        if (text) {
+            float v = strtof(amount_volumes[i & 7], NULL);
+            float p = strtof(amount_prices[i & 3], NULL);
+            benchmark::DoNotOptimize(snprintf(out, sizeof(out), "%ld", lroundf(v * p)));
+        } else {
+            benchmark::DoNotOptimize(lroundf(volumes[i & 7] * prices[i & 3]));
+        }
+        i++;
+    }
+}
+BENCHMARK(BM_AmountFloat)->Arg(0)->Arg(1);
+
+// ---- nozzle engine ---------------------------------------------------------
+
+static const uint8_t noz_pump_ids[FMS_MAX_NOZZLES] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+
+// One sale per iteration, idle -> lifted -> permit -> approved -> fuelling ->
+// final -> idle on a nozzle of its own, "transitions/op" = 6; time / 6 is the
+// cost of one transition including the level triggered repeats in between
+static void BM_NozzleSale(benchmark::State& state) {
+    static const fms_noz_event_t sale[] = {
+        { NOZ_EV_HANDLE_UP, 0, 0, 0 },
+        { NOZ_EV_HANDLE_UP, 0, 0, 0 },
+        { NOZ_EV_PERMIT_SENT, 0, 0, 0 },
+        { NOZ_EV_APPROVED, 0, 0, 0 },
+        { NOZ_EV_LIVE, 0, 5000, 0 },
+        { NOZ_EV_LIVE, 0, 10000, 0 },
+        { NOZ_EV_HANDLE_DOWN, 0, 0, 0 },
+        { NOZ_EV_FINAL_SENT, 0, 0, 0 },
+    };
+    fms_nozzle_engine e;
+    e.begin(FMS_MAX_NOZZLES, noz_pump_ids);
+    for (uint8_t i = 0; i < FMS_MAX_NOZZLES; i++) e.dispatch({ NOZ_EV_PRICE, i, 3000, 0 });
+    uint32_t before = e.transitions(0);
+    uint8_t noz = 0;
+    alloc_meter m(state);
+    for (auto _ : state) {
+        for (fms_noz_event_t ev : sale) {
+            ev.noz = noz;
+            benchmark::DoNotOptimize(e.dispatch(ev));
+        }
+        noz = (noz + 1) % FMS_MAX_NOZZLES;
+    }
+    uint64_t total = 0;
+    for (uint8_t i = 0; i < FMS_MAX_NOZZLES; i++) total += e.transitions(i);
+    state.counters["transitions/op"] =
+        benchmark::Counter((double)(total - before), benchmark::Counter::kAvgIterations);
+    state.counters["bytes_per_nozzle"] = (double)fms_nozzle_engine::bytes_per_nozzle();
+    state.counters["engine_bytes"] = (double)sizeof(fms_nozzle_engine);
+}
+BENCHMARK(BM_NozzleSale);
+
+// Steady state of a sale, one live sample per poll while fuelling (amount from price)
+static void BM_NozzleLive(benchmark::State& state) {
+    fms_nozzle_engine e;
+    e.begin(1, noz_pump_ids);
+    e.dispatch({ NOZ_EV_PRICE, 0, 3000, 0 });
+    e.dispatch({ NOZ_EV_HANDLE_UP, 0, 0, 0 });
+    e.dispatch({ NOZ_EV_PERMIT_SENT, 0, 0, 0 });
+    e.dispatch({ NOZ_EV_APPROVED, 0, 0, 0 });
+    uint32_t volume = 1;
+    alloc_meter m(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(e.dispatch({ NOZ_EV_LIVE, 0, volume++, 0 }));
+    }
+    benchmark::DoNotOptimize(e.live_amount(0).raw);
+}
+BENCHMARK(BM_NozzleLive);
+
+// ---- file manager ----------------------------------------------------------
+
+static void BM_FormatBytes(benchmark::State& state) {
+    size_t bytes = (size_t)state.range(0);
+    alloc_meter m(state);
+    for (auto _ : state) {
+        String text = FMS_FileManager::formatBytes(bytes);
+        benchmark::DoNotOptimize(text.c_str());
+    }
+}
+BENCHMARK(BM_FormatBytes)->Arg(512)->Arg(150000)->Arg(3 << 20);
+
+static void BM_GetContentType(benchmark::State& state) {
+    static const String names[] = {"/index.html", "/script.js", "/logs/fms.log", "/update.bin"};
+    alloc_meter m(state);
+    size_t i = 0;
+    for (auto _ : state) {
+        String type = FMS_FileManager::getContentType(names[i++ & 3]);
+        benchmark::DoNotOptimize(type.c_str());
+    }
+}
+BENCHMARK(BM_GetContentType);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,219 @@
+/*
+ * nozzle_test - state table of the dispense engine (main/src/_fms_nozzle.cpp)
+ *
+ * Walks idle -> lifted -> permit -> approved -> fuelling -> final -> idle, both
+ * ways into fuelling and both ways out of it, checks that events invalid in a
+ * state are rejected and leave it alone, and applies HANDLE_UP / HANDLE_DOWN in
+ * every state. Run by ctest from the host build (tools/host/CMakeLists.txt).
+ *
+ * @copyright 2025 FMS Project
+ */
+
+#include "_fms_nozzle.h"
+
+#include <stdio.h>
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+struct transition_log {
+    int n;
+    fms_noz_state_t from[16];
+    fms_noz_state_t to[16];
+};
+
+static void on_transition(uint8_t, fms_noz_state_t from, fms_noz_state_t to, void* ctx) {
+    transition_log* log = (transition_log*)ctx;
+    if (log->n < 16) {
+        log->from[log->n] = from;
+        log->to[log->n] = to;
+    }
+    log->n++;
+}
+
+static bool ev(fms_nozzle_engine& e, uint8_t type, uint8_t noz = 0, uint32_t a = 0, uint32_t b = 0) {
+    return e.dispatch({ type, noz, a, b });
+}
+
+// fresh engine with nozzle 0 brought into st along the normal sale path
+static void drive_to(fms_nozzle_engine& e, fms_noz_state_t st, transition_log* log = NULL) {
+    static const uint8_t pump_ids[2] = { 1, 2 };
+    e = fms_nozzle_engine();
+    e.begin(2, pump_ids, log ? on_transition : NULL, log);
+    e.dispatch({ NOZ_EV_PRICE, 0, 3000, 0 });
+    static const fms_noz_event_t path[] = {
+        { NOZ_EV_HANDLE_UP, 0, 0, 0 },
+        { NOZ_EV_PERMIT_SENT, 0, 0, 0 },
+        { NOZ_EV_APPROVED, 0, 0, 0 },
+        { NOZ_EV_LIVE, 0, 10000, 30000 },
+        { NOZ_EV_HANDLE_DOWN, 0, 0, 0 },
+    };
+    for (int i = 0; i < (int)(sizeof(path) / sizeof(path[0])) && e.state(0) != st; i++) {
+        e.dispatch(path[i]);
+    }
+}
+
+static void test_sale_path() {
+    fms_nozzle_engine e;
+    transition_log log = {};
+    drive_to(e, NOZ_IDLE, &log);
+    CHECK(e.state(0) == NOZ_IDLE);
+
+    CHECK(ev(e, NOZ_EV_HANDLE_UP));
+    CHECK(e.state(0) == NOZ_LIFTED);
+    CHECK(ev(e, NOZ_EV_PERMIT_SENT));
+    CHECK(e.state(0) == NOZ_PERMIT);
+    CHECK(ev(e, NOZ_EV_APPROVED));
+    CHECK(e.state(0) == NOZ_APPROVED);
+    CHECK(ev(e, NOZ_EV_LIVE, 0, 5000, 15000));
+    CHECK(e.state(0) == NOZ_FUELLING);
+    CHECK(ev(e, NOZ_EV_LIVE, 0, 10000, 30000));
+    CHECK(e.live_volume(0).raw == 10000);
+    CHECK(ev(e, NOZ_EV_HANDLE_DOWN));
+    CHECK(e.state(0) == NOZ_FINAL);
+    CHECK(e.sale_volume(0).raw == 10000);
+    CHECK(e.sale_amount(0).raw == 30000);
+    CHECK(ev(e, NOZ_EV_FINAL_SENT));
+    CHECK(e.state(0) == NOZ_IDLE);
+    CHECK(e.sale_volume(0).raw == 10000);  // kept for the ledger / Final until the next sale
+
+    static const fms_noz_state_t want[] = { NOZ_LIFTED, NOZ_PERMIT, NOZ_APPROVED, NOZ_FUELLING, NOZ_FINAL, NOZ_IDLE };
+    CHECK(log.n == 6);
+    for (int i = 0; i < 6 && i < log.n; i++) {
+        CHECK(log.to[i] == want[i]);
+        CHECK(log.from[i] == (i ? want[i - 1] : NOZ_IDLE));
+    }
+    CHECK(e.transitions(0) == 6);
+    CHECK(e.transitions(1) == 0);
+    CHECK(e.rejected() == 0);
+}
+
+// pump motor start / stop instead of live data and hang up
+static void test_pump_running_path() {
+    fms_nozzle_engine e;
+    drive_to(e, NOZ_APPROVED);
+    CHECK(ev(e, NOZ_EV_PUMP_RUNNING));
+    CHECK(e.state(0) == NOZ_FUELLING);
+    CHECK(ev(e, NOZ_EV_LIVE, 0, 2500, 0));
+    CHECK(e.live_amount(0).raw == 7500);  // no amount from the dispenser, volume x price
+    CHECK(ev(e, NOZ_EV_PUMP_STOPPED));
+    CHECK(e.state(0) == NOZ_FINAL);
+    CHECK(e.sale_amount(0).raw == 7500);
+}
+
+static void test_bad_events() {
+    fms_nozzle_engine e;
+    drive_to(e, NOZ_IDLE);
+    uint32_t rejected = e.rejected();
+    CHECK(!ev(e, NOZ_EV_PERMIT_SENT));
+    CHECK(!ev(e, NOZ_EV_APPROVED));
+    CHECK(!ev(e, NOZ_EV_FINAL_SENT));
+    CHECK(!ev(e, NOZ_EV_LIVE, 0, 100, 300));
+    CHECK(e.state(0) == NOZ_IDLE);
+    CHECK(e.rejected() == rejected + 4);
+
+    CHECK(!ev(e, NOZ_EV_HANDLE_UP, 2));    // only two nozzles configured
+    CHECK(!ev(e, NOZ_EV_COUNT));
+    CHECK(e.rejected() == rejected + 6);
+
+    drive_to(e, NOZ_LIFTED);
+    CHECK(!ev(e, NOZ_EV_APPROVED));        // approval before the permit went out
+    CHECK(e.state(0) == NOZ_LIFTED);
+
+    drive_to(e, NOZ_PERMIT);
+    CHECK(!ev(e, NOZ_EV_PERMIT_SENT));
+    CHECK(ev(e, NOZ_EV_PUMP_RUNNING));     // polled motor state, ignored until approved
+    CHECK(e.state(0) == NOZ_PERMIT);
+
+    drive_to(e, NOZ_APPROVED);
+    CHECK(!ev(e, NOZ_EV_LIVE, 0, 0, 0));   // zero volume does not start the sale
+    CHECK(e.state(0) == NOZ_APPROVED);
+
+    drive_to(e, NOZ_FUELLING);
+    CHECK(!ev(e, NOZ_EV_FINAL_SENT));
+    CHECK(!ev(e, NOZ_EV_PRESET, 0, 5000, 'P'));
+    CHECK(e.state(0) == NOZ_FUELLING);
+
+    drive_to(e, NOZ_FINAL);
+    CHECK(!ev(e, NOZ_EV_APPROVED));
+    CHECK(!ev(e, NOZ_EV_LIVE, 0, 20000, 60000));
+    CHECK(e.sale_volume(0).raw == 10000);
+    CHECK(e.state(0) == NOZ_FINAL);
+}
+
+// level triggered poll events, repeated in every state
+static void test_handle_every_state() {
+    static const fms_noz_state_t up_next[NOZ_STATE_COUNT] = {
+        NOZ_LIFTED, NOZ_LIFTED, NOZ_PERMIT, NOZ_APPROVED, NOZ_FUELLING, NOZ_FINAL
+    };
+    static const fms_noz_state_t down_next[NOZ_STATE_COUNT] = {
+        NOZ_IDLE, NOZ_IDLE, NOZ_IDLE, NOZ_IDLE, NOZ_FINAL, NOZ_FINAL
+    };
+    for (int s = 0; s < NOZ_STATE_COUNT; s++) {
+        fms_nozzle_engine e;
+        drive_to(e, (fms_noz_state_t)s);
+        CHECK(e.state(0) == s);
+        uint32_t rejected = e.rejected();
+        CHECK(ev(e, NOZ_EV_HANDLE_UP));
+        CHECK(ev(e, NOZ_EV_HANDLE_UP));
+        CHECK(e.state(0) == up_next[s]);
+
+        drive_to(e, (fms_noz_state_t)s);
+        CHECK(ev(e, NOZ_EV_HANDLE_DOWN));
+        CHECK(ev(e, NOZ_EV_HANDLE_DOWN));
+        CHECK(e.state(0) == down_next[s]);
+        CHECK(e.rejected() == rejected);
+        CHECK(e.state(1) == NOZ_IDLE);
+    }
+}
+
+static void test_preset() {
+    fms_nozzle_engine e;
+    drive_to(e, NOZ_PERMIT);
+    CHECK(ev(e, NOZ_EV_PRESET, 0, 20000, 'L'));
+    CHECK(e.preset_pending(0));
+    CHECK(e.preset(0) == 20000);
+    CHECK(e.preset_kind(0) == 'L');
+    CHECK(ev(e, NOZ_EV_HANDLE_DOWN));      // hang up drops the preset
+    CHECK(!e.preset_pending(0));
+
+    drive_to(e, NOZ_FINAL);
+    CHECK(!e.preset_pending(0));
+}
+
+static void test_mask_and_reset() {
+    fms_nozzle_engine e;
+    drive_to(e, NOZ_FUELLING);
+    CHECK(ev(e, NOZ_EV_HANDLE_UP, 1));
+    CHECK(e.mask_in(NOZ_FUELLING) == 0x01);
+    CHECK(e.mask_in(NOZ_LIFTED) == 0x02);
+    CHECK(e.mask_in(NOZ_IDLE) == 0x00);
+    e.reset(0);
+    CHECK(e.state(0) == NOZ_IDLE);
+    CHECK(e.live_volume(0).raw == 0);
+    CHECK(e.mask_in(NOZ_IDLE) == 0x01);
+    CHECK(e.pump_id(1) == 2);
+    CHECK(fms_nozzle_engine::state_name(NOZ_FINAL)[0] == 'f');
+    CHECK(fms_nozzle_engine::state_name(NOZ_STATE_COUNT)[0] == 'u');
+}
+
+int main() {
+    test_sale_path();
+    test_pump_running_path();
+    test_bad_events();
+    test_handle_every_state();
+    test_preset();
+    test_mask_and_reset();
+    if (failures) {
+        printf("nozzle_test: %d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("nozzle_test: ok\n");
+    return 0;
+}
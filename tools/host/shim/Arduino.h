@@ -0,0 +1,155 @@
+/*
+ * Arduino.h for the host build - the parts of the ESP32 core main/src uses
+ *
+ * String keeps the heap behaviour of the ESP32 WString (up to 11 characters
+ * inline, longer ones malloc / realloc to the length needed), so allocation
+ * counts on the host are those of the device. HardwareSerial writes to a counted memory sink and reads what a
+ * test fed it. The FreeRTOS calls run in one thread: queues copy like the
+ * real ones but never block, notifications and critical sections do nothing.
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#ifndef FMS_HOST_ARDUINO_H
+#define FMS_HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <math.h>
+#include <functional>
+
+// ---- String ----------------------------------------------------------------
+
+class String {
+public:
+    String(const char* cstr = "");
+    String(const String& other);
+    String(String&& other) noexcept;
+    explicit String(char c);
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(double value, unsigned int decimals = 2);
+    ~String();
+
+    String& operator=(const String& rhs);
+    String& operator=(String&& rhs) noexcept;
+    String& operator=(const char* cstr);
+
+    bool concat(const char* cstr, size_t len);
+    String& operator+=(const String& rhs) { concat(rhs.c_str(), rhs._len); return *this; }
+    String& operator+=(const char* cstr)  { concat(cstr, strlen(cstr)); return *this; }
+    String& operator+=(char c)            { concat(&c, 1); return *this; }
+    String& operator+=(int v)             { return *this += String(v); }
+    String& operator+=(unsigned int v)    { return *this += String(v); }
+    String& operator+=(long v)            { return *this += String(v); }
+    String& operator+=(unsigned long v)   { return *this += String(v); }
+
+    friend String operator+(const String& a, const String& b) { String s(a); s += b; return s; }
+    friend String operator+(const String& a, const char* b)   { String s(a); s += b; return s; }
+    friend String operator+(const char* a, const String& b)   { String s(a); s += b; return s; }
+
+    bool operator==(const String& rhs) const { return _len == rhs._len && strcmp(c_str(), rhs.c_str()) == 0; }
+    bool operator==(const char* cstr) const  { return strcmp(c_str(), cstr) == 0; }
+    bool operator!=(const String& rhs) const { return !(*this == rhs); }
+    bool operator!=(const char* cstr) const  { return !(*this == cstr); }
+    char operator[](size_t i) const          { return i < _len ? _buf[i] : 0; }
+
+    const char* c_str() const { return _buf; }
+    size_t length() const     { return _len; }
+    bool startsWith(const char* prefix) const;
+    bool endsWith(const char* suffix) const;
+    bool endsWith(const String& suffix) const { return endsWith(suffix.c_str()); }
+    long toInt() const        { return atol(c_str()); }
+
+private:
+    enum { SSO_SIZE = 11 };
+    char*  _buf;                        // _sso or the heap
+    size_t _cap;
+    size_t _len;
+    char   _sso[SSO_SIZE + 1];
+
+    void init() { _buf = _sso; _cap = SSO_SIZE; _len = 0; _sso[0] = '\0'; }
+    bool reserve(size_t len);
+};
+
+// ---- HardwareSerial --------------------------------------------------------
+
+class HardwareSerial {
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    explicit operator bool() const { return true; }
+    void onReceive(std::function<void()> cb) { _onReceive = cb; }
+
+    // input: what the test fed, read back by the code under test
+    void feed(const char* data, size_t len);
+    int  available() const { return (int)(_inLen - _inPos); }
+    int  read()            { return _inPos < _inLen ? (uint8_t)_in[_inPos++] : -1; }
+    int  peek() const      { return _inPos < _inLen ? (uint8_t)_in[_inPos] : -1; }
+
+    // output: counted, the last bytes kept in a small ring
+    size_t write(uint8_t c);
+    size_t write(const uint8_t* data, size_t len);
+    size_t print(const char* s)         { return write((const uint8_t*)s, strlen(s)); }
+    size_t print(const String& s)       { return print(s.c_str()); }
+    size_t print(long v);
+    size_t println(const char* s = "")  { size_t n = print(s); return n + print("\r\n"); }
+    size_t println(const String& s)     { return println(s.c_str()); }
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+    uint64_t bytesOut() const { return _outBytes; }
+    bool     echo = false;              // copy output to stdout too
+
+private:
+    char     _in[4096];
+    size_t   _inLen = 0;
+    size_t   _inPos = 0;
+    char     _out[256];
+    uint64_t _outBytes = 0;
+    std::function<void()> _onReceive;
+};
+
+extern HardwareSerial Serial;
+
+// ---- core ------------------------------------------------------------------
+
+unsigned long millis();
+void delay(unsigned long ms);
+void yield();
+int  log_printf(const char* format, ...) __attribute__((format(printf, 1, 2)));
+void ets_write_char_uart(char c);
+
+// ---- FreeRTOS --------------------------------------------------------------
+
+typedef int           BaseType_t;
+typedef unsigned int  UBaseType_t;
+typedef uint32_t      TickType_t;
+typedef void*         TaskHandle_t;
+typedef struct fms_host_queue* QueueHandle_t;
+typedef int           portMUX_TYPE;
+
+#define pdFALSE                     0
+#define pdTRUE                      1
+#define pdPASS                      1
+#define portMAX_DELAY               0xFFFFFFFFu
+#define pdMS_TO_TICKS(ms)           ((TickType_t)(ms))
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux)     ((void)(mux))
+#define portEXIT_CRITICAL(mux)      ((void)(mux))
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+BaseType_t    xQueueSend(QueueHandle_t q, const void* item, TickType_t wait);
+BaseType_t    xQueueReceive(QueueHandle_t q, void* item, TickType_t wait);   // never waits
+void          vTaskDelay(TickType_t ticks);
+void          xTaskNotifyGive(TaskHandle_t task);
+uint32_t      ulTaskNotifyTake(BaseType_t clear, TickType_t wait);           // never waits
+
+#endif // FMS_HOST_ARDUINO_H
@@ -0,0 +1,4 @@
+// FS for the host build: nothing, the file handlers are not built
+#ifndef FMS_HOST_FS_H
+#define FMS_HOST_FS_H
+#endif
@@ -0,0 +1,6 @@
+// WebServer for the host build: the type name only, the handlers are not built
+#ifndef FMS_HOST_WEBSERVER_H
+#define FMS_HOST_WEBSERVER_H
+#include "Arduino.h"
+class WebServer;
+#endif
@@ -0,0 +1,18 @@
+/*
+ * FMS host shim extras - what the host build adds to the Arduino API
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#ifndef FMS_HOST_H
+#define FMS_HOST_H
+
+#include <stdint.h>
+
+// Heap allocations so far: malloc / calloc / realloc of the code built here
+// (linked with --wrap, see CMakeLists.txt) and operator new
+uint64_t fms_host_allocs();
+
+#endif // FMS_HOST_H
@@ -0,0 +1,314 @@
+/*
+ * Arduino / FreeRTOS shim for the host build
+ *
+ * @copyright 2025 FMS Project
+ * @date 2025
+ * @version 0.1.0
+ */
+
+#include "Arduino.h"
+#include "fms_host.h"
+
+#include <time.h>
+#include <new>
+
+// ---- allocation count ------------------------------------------------------
+
+static uint64_t allocs;
+
+uint64_t fms_host_allocs() {
+    return allocs;
+}
+
+#ifdef FMS_HOST_WRAP_MALLOC
+extern "C" {
+void* __real_malloc(size_t n);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* p, size_t n);
+
+void* __wrap_malloc(size_t n) {
+    allocs++;
+    return __real_malloc(n);
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+    allocs++;
+    return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* p, size_t n) {
+    allocs++;
+    return __real_realloc(p, n);
+}
+}
+#endif
+
+void* operator new(size_t n) {
+#ifndef FMS_HOST_WRAP_MALLOC
+    allocs++;
+#endif
+    void* p = malloc(n ? n : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// ---- String ----------------------------------------------------------------
+
+String::String(const char* cstr) {
+    init();
+    if (cstr) concat(cstr, strlen(cstr));
+}
+
+String::String(const String& other) {
+    init();
+    concat(other.c_str(), other._len);
+}
+
+String::String(String&& other) noexcept {
+    init();
+    *this = static_cast<String&&>(other);
+}
+
+String::String(char c) {
+    init();
+    concat(&c, 1);
+}
+
+static void to_base(char* out, size_t cap, unsigned long v, bool neg, unsigned char base) {
+    char tmp[72];
+    size_t n = 0;
+    do {
+        unsigned d = v % base;
+        tmp[n++] = (char)(d < 10 ? '0' + d : 'a' + d - 10);
+        v /= base;
+    } while (v && n < sizeof(tmp) - 1);
+    size_t i = 0;
+    if (neg && i < cap - 1) out[i++] = '-';
+    while (n && i < cap - 1) out[i++] = tmp[--n];
+    out[i] = '\0';
+}
+
+String::String(int value, unsigned char base) : String((long)value, base) {}
+
+String::String(unsigned int value, unsigned char base) : String((unsigned long)value, base) {}
+
+String::String(long value, unsigned char base) {
+    char num[72];
+    bool neg = value < 0 && base == 10;
+    init();
+    to_base(num, sizeof(num), neg ? 0UL - (unsigned long)value : (unsigned long)value, neg, base);
+    concat(num, strlen(num));
+}
+
+String::String(unsigned long value, unsigned char base) {
+    char num[72];
+    init();
+    to_base(num, sizeof(num), value, false, base);
+    concat(num, strlen(num));
+}
+
+String::String(double value, unsigned int decimals) {
+    char num[40];
+    init();
+    snprintf(num, sizeof(num), "%.*f", (int)decimals, value);
+    concat(num, strlen(num));
+}
+
+String::~String() {
+    if (_buf != _sso) free(_buf);
+}
+
+String& String::operator=(const String& rhs) {
+    if (this != &rhs) {
+        _len = 0;
+        concat(rhs.c_str(), rhs._len);
+    }
+    return *this;
+}
+
+String& String::operator=(String&& rhs) noexcept {
+    if (this == &rhs) return *this;
+    if (rhs._buf == rhs._sso) {
+        _len = 0;
+        concat(rhs._sso, rhs._len);
+    } else {
+        if (_buf != _sso) free(_buf);
+        _buf = rhs._buf;
+        _cap = rhs._cap;
+        _len = rhs._len;
+        rhs.init();
+    }
+    return *this;
+}
+
+String& String::operator=(const char* cstr) {
+    _len = 0;
+    concat(cstr, strlen(cstr));
+    return *this;
+}
+
+// like WString: inline up to SSO_SIZE, then the heap, grown to the exact size asked for
+bool String::reserve(size_t len) {
+    if (len <= _cap) return true;
+    char* p;
+    if (_buf == _sso) {
+        p = (char*)malloc(len + 1);
+        if (!p) return false;
+        memcpy(p, _sso, _len + 1);
+    } else {
+        p = (char*)realloc(_buf, len + 1);
+        if (!p) return false;
+    }
+    _buf = p;
+    _cap = len;
+    return true;
+}
+
+bool String::concat(const char* cstr, size_t len) {
+    if (!reserve(_len + len)) return false;
+    memmove(_buf + _len, cstr, len);
+    _len += len;
+    _buf[_len] = '\0';
+    return true;
+}
+
+bool String::startsWith(const char* prefix) const {
+    size_t n = strlen(prefix);
+    return n <= _len && memcmp(_buf, prefix, n) == 0;
+}
+
+bool String::endsWith(const char* suffix) const {
+    size_t n = strlen(suffix);
+    return n <= _len && memcmp(_buf + _len - n, suffix, n) == 0;
+}
+
+// ---- HardwareSerial --------------------------------------------------------
+
+HardwareSerial Serial;
+
+void HardwareSerial::feed(const char* data, size_t len) {
+    if (_inPos == _inLen) _inPos = _inLen = 0;
+    if (len > sizeof(_in) - _inLen) len = sizeof(_in) - _inLen;
+    memcpy(_in + _inLen, data, len);
+    _inLen += len;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    _out[_outBytes++ & (sizeof(_out) - 1)] = (char)c;
+    if (echo) putchar(c);
+    return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) _out[(_outBytes + i) & (sizeof(_out) - 1)] = (char)data[i];
+    _outBytes += len;
+    if (echo) fwrite(data, 1, len, stdout);
+    return len;
+}
+
+size_t HardwareSerial::print(long v) {
+    char num[24];
+    snprintf(num, sizeof(num), "%ld", v);
+    return print(num);
+}
+
+size_t HardwareSerial::printf(const char* format, ...) {
+    char loc[128];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(loc, sizeof(loc), format, args);
+    va_end(args);
+    if (n < 0) return 0;
+    if ((size_t)n < sizeof(loc)) return write((const uint8_t*)loc, n);
+    char* big = (char*)malloc(n + 1);       // the core's printf does the same
+    if (!big) return 0;
+    va_start(args, format);
+    vsnprintf(big, n + 1, format, args);
+    va_end(args);
+    write((const uint8_t*)big, n);
+    free(big);
+    return n;
+}
+
+// ---- core ------------------------------------------------------------------
+
+unsigned long millis() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+void delay(unsigned long ms) {
+    struct timespec ts = {(time_t)(ms / 1000), (long)(ms % 1000) * 1000000};
+    nanosleep(&ts, NULL);
+}
+
+void yield() {
+}
+
+// the ROM UART writer under log_printfv: into Serial's sink
+void ets_write_char_uart(char c) {
+    Serial.write((uint8_t)c);
+}
+
+int log_printf(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    extern int log_printfv(const char* format, va_list arg);
+    int n = log_printfv(format, args);
+    va_end(args);
+    return n;
+}
+
+// ---- FreeRTOS --------------------------------------------------------------
+
+struct fms_host_queue {
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    UBaseType_t head;
+    UBaseType_t count;
+    uint8_t     items[1];
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    QueueHandle_t q = (QueueHandle_t)malloc(sizeof(fms_host_queue) + (size_t)length * itemSize);
+    if (!q) return NULL;
+    q->length = length;
+    q->itemSize = itemSize;
+    q->head = q->count = 0;
+    return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t wait) {
+    (void)wait;
+    if (q->count == q->length) return pdFALSE;
+    memcpy(q->items + (size_t)((q->head + q->count) % q->length) * q->itemSize, item, q->itemSize);
+    q->count++;
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t wait) {
+    (void)wait;
+    if (q->count == 0) return pdFALSE;
+    memcpy(item, q->items + (size_t)q->head * q->itemSize, q->itemSize);
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+    return pdTRUE;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    delay(ticks);
+}
+
+void xTaskNotifyGive(TaskHandle_t task) {
+    (void)task;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait) {
+    (void)clear;
+    (void)wait;
+    return 0;
+}
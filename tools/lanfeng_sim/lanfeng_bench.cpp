@@ -0,0 +1,195 @@
+/*
+ * lanfeng_bench - bus throughput benchmark for the firmware poller
+ *
+ * Runs main/src/_fms_modbus_poller.cpp against a serial port (normally the
+ * lanfeng_sim pty) with a small RTU master in place of ModbusMaster, and
+ * reports transactions per second and scan latency.
+ *
+ *   g++ -O2 -std=gnu++17 -I../../main/src -o lanfeng_bench lanfeng_bench.cpp ../../main/src/_fms_modbus_poller.cpp
+ *   ./lanfeng_bench /dev/pts/N [--slave 1] [--scans 500] [--timeout-ms 200] [--mode both|coalesced|single|status|live]
+ *
+ * modes:
+ *   coalesced   full register map with the default merge gap (firmware default)
+ *   single      full register map, one transaction per register (old behaviour)
+ *   status      idle nozzle poll (handle + pump state)
+ *   live        fuelling nozzle poll (status + live data + totalizers)
+ *
+ * @copyright 2025 FMS Project
+ */
+
+#include "lanfeng_rtu.h"
+#include "_fms_modbus_poller.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+// mirrors lanfeng_reg_table in main/fms_lanfeng.ino
+static const fms_modbus_reg_t bench_reg_table[] = {
+    { "totalizer_liter",  LANFENG_TOTALIZER_LITER,  2, 0 },
+    { "totalizer_amount", LANFENG_TOTALIZER_AMOUNT, 2, 1 },
+    { "live_data",        LANFENG_LIVE_DATA,        2, 2 },
+    { "live_price",       LANFENG_LIVE_PRICE,       2, 3 },
+    { "sell_liter",       LANFENG_SELL_LITER,       2, 4 },
+    { "price",            LANFENG_PRICE,            2, 5 },
+    { "pump_state",       LANFENG_PUMP_STATE,       1, 6 },
+    { "noz_handle",       LANFENG_NOZ_HANDLE,       1, 7 },
+};
+static const uint8_t bench_reg_count = sizeof(bench_reg_table) / sizeof(bench_reg_table[0]);
+
+struct bench_port_t {
+    int      fd;
+    uint32_t timeout_ms;
+    uint32_t crc_errors;
+    uint32_t timeouts;
+    uint32_t exceptions;
+};
+
+static uint32_t clock_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+static int open_port(const char* path) {
+    int fd = open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    tcflush(fd, TCIOFLUSH);
+    return fd;
+}
+
+// read exactly n bytes or time out
+static bool read_exact(bench_port_t* port, uint8_t* buf, size_t n, uint32_t deadline_us) {
+    size_t got = 0;
+    while (got < n) {
+        int32_t left_us = (int32_t)(deadline_us - clock_us());
+        if (left_us <= 0) return false;
+        struct pollfd pfd = { port->fd, POLLIN, 0 };
+        if (poll(&pfd, 1, (left_us + 999) / 1000) <= 0) continue;
+        ssize_t r = read(port->fd, buf + got, n - got);
+        if (r > 0) got += (size_t)r;
+        else if (r < 0 && errno != EINTR && errno != EAGAIN) return false;
+    }
+    return true;
+}
+
+// function 03 transaction, same contract as ModbusMaster::readHoldingRegisters
+static bool rtu_read(uint8_t slave, uint16_t start, uint16_t qty, uint16_t* out, void* ctx) {
+    bench_port_t* port = (bench_port_t*)ctx;
+    uint8_t req[8] = { slave, RTU_FN_READ_HOLDING, (uint8_t)(start >> 8), (uint8_t)start, (uint8_t)(qty >> 8), (uint8_t)qty };
+    rtu_seal(req, 6);
+    tcflush(port->fd, TCIFLUSH);
+    if (write(port->fd, req, sizeof(req)) != (ssize_t)sizeof(req)) return false;
+
+    uint32_t deadline = clock_us() + port->timeout_ms * 1000;
+    uint8_t resp[RTU_MAX_FRAME];
+    if (!read_exact(port, resp, 3, deadline)) {
+        port->timeouts++;
+        return false;
+    }
+    if (resp[1] & 0x80) {
+        read_exact(port, resp + 3, 2, deadline);
+        port->exceptions++;
+        return false;
+    }
+    size_t len = 3 + resp[2] + 2;
+    if (resp[2] != qty * 2 || !read_exact(port, resp + 3, len - 3, deadline)) {
+        port->timeouts++;
+        return false;
+    }
+    if (!rtu_check(resp, len)) {
+        port->crc_errors++;
+        return false;
+    }
+    for (uint16_t i = 0; i < qty; i++) {
+        out[i] = (resp[3 + i * 2] << 8) | resp[4 + i * 2];
+    }
+    return true;
+}
+
+static void run_mode(const char* name, bench_port_t* port, uint8_t slave, uint32_t scans, uint16_t gap, uint32_t mask) {
+    fms_modbus_poller poller;
+    if (!poller.begin(bench_reg_table, bench_reg_count, rtu_read, port, clock_us, gap)) {
+        fprintf(stderr, "register table rejected\n");
+        return;
+    }
+    port->crc_errors = port->timeouts = port->exceptions = 0;
+
+    std::vector<uint32_t> lat;
+    lat.reserve(scans);
+    uint32_t out[16] = { 0 };
+    uint32_t ok = 0;
+    uint32_t t0 = clock_us();
+    for (uint32_t i = 0; i < scans; i++) {
+        if (poller.scan(slave, mask, out, 16)) {
+            ok++;
+            lat.push_back(poller.stats().last_scan_us);
+        }
+    }
+    double secs = (clock_us() - t0) / 1e6;
+    const fms_modbus_stats_t& st = poller.stats();
+
+    std::sort(lat.begin(), lat.end());
+    uint32_t p50 = lat.empty() ? 0 : lat[lat.size() / 2];
+    uint32_t p99 = lat.empty() ? 0 : lat[std::min(lat.size() - 1, lat.size() * 99 / 100)];
+    uint32_t avg = st.scans ? (uint32_t)(st.total_scan_us / st.scans) : 0;
+
+    printf("%-10s blocks/scan %u  scans %u ok %u  tx/s %.1f  scans/s %.1f  scan us avg %u p50 %u p99 %u max %u"
+           "  timeouts %u crc %u exc %u\n",
+           name, st.last_blocks, st.scans, ok, st.transactions / secs, st.scans / secs,
+           avg, p50, p99, st.max_scan_us, port->timeouts, port->crc_errors, port->exceptions);
+    printf("%-10s live %u ml  amount %u  handle %u  pump %u\n", "", out[2], out[3], out[7], out[6]);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <tty> [--slave N] [--scans N] [--timeout-ms N] [--mode both|coalesced|single|status|live]\n", argv[0]);
+        return 2;
+    }
+    uint8_t slave = 1;
+    uint32_t scans = 500;
+    std::string mode = "both";
+    bench_port_t port = { -1, 200, 0, 0, 0 };
+
+    for (int i = 2; i < argc; i++) {
+        std::string a = argv[i];
+        bool more = i + 1 < argc;
+        if (a == "--slave" && more) slave = (uint8_t)atoi(argv[++i]);
+        else if (a == "--scans" && more) scans = atoi(argv[++i]);
+        else if (a == "--timeout-ms" && more) port.timeout_ms = atoi(argv[++i]);
+        else if (a == "--mode" && more) mode = argv[++i];
+    }
+
+    port.fd = open_port(argv[1]);
+    if (port.fd < 0) return 1;
+
+    // masks by table position, see bench_reg_table
+    const uint32_t status_mask = (1UL << 6) | (1UL << 7);
+    const uint32_t live_mask = status_mask | (1UL << 0) | (1UL << 1) | (1UL << 2) | (1UL << 3);
+
+    if (mode == "both" || mode == "coalesced") run_mode("coalesced", &port, slave, scans, FMS_MODBUS_DEFAULT_GAP, FMS_MODBUS_ALL);
+    if (mode == "both" || mode == "single")    run_mode("single", &port, slave, scans, 0, FMS_MODBUS_ALL);
+    if (mode == "status")                      run_mode("status", &port, slave, scans, FMS_MODBUS_DEFAULT_GAP, status_mask);
+    if (mode == "live")                        run_mode("live", &port, slave, scans, FMS_MODBUS_DEFAULT_GAP, live_mask);
+
+    close(port.fd);
+    return 0;
+}
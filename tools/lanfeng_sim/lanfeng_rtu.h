@@ -0,0 +1,57 @@
+/*
+ * lanfeng_rtu.h - Modbus RTU helpers shared by the host simulator and bench
+ *
+ * Register window mirrors main/main.h (0x02BC - 0x02E0).
+ *
+ * @copyright 2025 FMS Project
+ */
+
+#ifndef _LANFENG_RTU_H_
+#define _LANFENG_RTU_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LANFENG_WINDOW_START    0x02BC
+#define LANFENG_WINDOW_END      0x02E0    // inclusive
+#define LANFENG_WINDOW_WORDS    (LANFENG_WINDOW_END - LANFENG_WINDOW_START + 1)
+
+#define LANFENG_TOTALIZER_LITER   0x02BC
+#define LANFENG_TOTALIZER_AMOUNT  0x02C0
+#define LANFENG_LIVE_DATA         0x02C4
+#define LANFENG_LIVE_PRICE        0x02C8
+#define LANFENG_SELL_LITER        0x02D4
+#define LANFENG_PRICE             0x02D8
+#define LANFENG_PUMP_STATE        0x02DE
+#define LANFENG_NOZ_HANDLE        0x02E0
+
+#define RTU_FN_READ_HOLDING     0x03
+#define RTU_FN_WRITE_SINGLE     0x06
+#define RTU_MAX_FRAME           256
+
+static inline uint16_t rtu_crc16(const uint8_t* p, size_t n) {
+    uint16_t crc = 0xFFFF;
+    while (n--) {
+        crc ^= *p++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+// append crc (low byte first), returns the new frame length
+static inline size_t rtu_seal(uint8_t* frame, size_t n) {
+    uint16_t crc = rtu_crc16(frame, n);
+    frame[n] = crc & 0xFF;
+    frame[n + 1] = crc >> 8;
+    return n + 2;
+}
+
+static inline bool rtu_check(const uint8_t* frame, size_t n) {
+    if (n < 4) return false;
+    uint16_t crc = rtu_crc16(frame, n - 2);
+    return frame[n - 2] == (crc & 0xFF) && frame[n - 1] == (crc >> 8);
+}
+
+#endif // _LANFENG_RTU_H_
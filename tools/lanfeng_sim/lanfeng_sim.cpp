@@ -0,0 +1,391 @@
+/*
+ * lanfeng_sim - LANFENG Modbus RTU dispenser simulator for Linux
+ *
+ * Serves the firmware register map (main/main.h) on a pseudo-terminal so the
+ * ModbusMaster path and the poller can run without a dispenser.
+ *
+ *   g++ -O2 -std=gnu++17 -o lanfeng_sim lanfeng_sim.cpp
+ *   ./lanfeng_sim [options]            # prints the pty path to connect to
+ *
+ * options:
+ *   --slaves 1,2,3       slave ids (one per nozzle), default 1
+ *   --latency-ms N       response delay after a complete request, default 5
+ *   --baud N             add wire time for every byte at this baud rate, 0 = off
+ *   --crc-error P        probability [0..1] of a corrupted response crc
+ *   --script FILE        fuelling session script (see below)
+ *   --auto-approve       release the pump on nozzle lift (no MQTT round trip)
+ *   --loop               restart the script when it ends
+ *   --link PATH          symlink the pty slave to PATH
+ *
+ * script lines, time in ms from start:
+ *   <ms> <slave> lift | hang | approve | price <p> | rate <ml_per_s> | preset <ml>
+ *   <ms> 0 quit
+ *
+ * Register units: volume in ml, amount and price in whole currency units.
+ * Writing 1 to PUMP_STATE (function 06) approves a lifted nozzle.
+ *
+ * @copyright 2025 FMS Project
+ */
+
+#include "lanfeng_rtu.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#define SIM_MAX_SLAVES  8
+#define SIM_TICK_MS     20
+
+struct sim_nozzle_t {
+    uint8_t  id;
+    bool     handle;
+    bool     approved;
+    uint32_t price;         // per liter
+    uint32_t rate_mlps;     // flow rate
+    uint32_t preset_ml;     // 0 = none
+    uint64_t volume_um;     // live volume in micro liters (keeps sub ml flow)
+    uint32_t amount;
+    uint32_t sell_ml;
+    uint32_t total_ml;
+    uint32_t total_amount;
+};
+
+struct sim_step_t {
+    uint32_t    at_ms;
+    uint8_t     slave;
+    std::string action;
+    uint32_t    arg;
+};
+
+struct sim_stats_t {
+    uint32_t requests;
+    uint32_t responses;
+    uint32_t crc_injected;
+    uint32_t bad_requests;
+    uint32_t exceptions;
+};
+
+static sim_nozzle_t  nozzles[SIM_MAX_SLAVES];
+static int           nozzle_count = 0;
+static uint32_t      latency_ms = 5;
+static uint32_t      baud = 0;
+static double        crc_error_rate = 0.0;
+static bool          auto_approve = false;
+static bool          loop_script = false;
+static sim_stats_t   stats;
+static volatile bool running = true;
+
+static uint64_t now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void sleep_us(uint64_t us) {
+    struct timespec ts = { (time_t)(us / 1000000), (long)(us % 1000000) * 1000 };
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {}
+}
+
+static sim_nozzle_t* find_nozzle(uint8_t id) {
+    for (int i = 0; i < nozzle_count; i++) {
+        if (nozzles[i].id == id) return &nozzles[i];
+    }
+    return NULL;
+}
+
+static uint32_t live_ml(const sim_nozzle_t& n) {
+    return (uint32_t)(n.volume_um / 1000);
+}
+
+// register value at addr, 32 bit values are high word first
+static uint16_t read_register(const sim_nozzle_t& n, uint16_t addr) {
+    uint32_t v32;
+    switch (addr & ~1u) {
+        case LANFENG_TOTALIZER_LITER:  v32 = n.total_ml; break;
+        case LANFENG_TOTALIZER_AMOUNT: v32 = n.total_amount; break;
+        case LANFENG_LIVE_DATA:        v32 = live_ml(n); break;
+        case LANFENG_LIVE_PRICE:       v32 = n.amount; break;
+        case LANFENG_SELL_LITER:       v32 = n.sell_ml; break;
+        case LANFENG_PRICE:            v32 = n.price; break;
+        case LANFENG_PUMP_STATE:       return (addr == LANFENG_PUMP_STATE) ? (n.approved && n.handle) : 0;
+        case LANFENG_NOZ_HANDLE:       return (addr == LANFENG_NOZ_HANDLE) ? n.handle : 0;
+        default:                       return 0;
+    }
+    return (addr & 1) ? (v32 & 0xFFFF) : (v32 >> 16);
+}
+
+static void close_sale(sim_nozzle_t& n) {
+    if (n.approved && live_ml(n) > 0) {
+        n.sell_ml = live_ml(n);
+        n.total_ml += n.sell_ml;
+        n.total_amount += n.amount;
+        printf("[sim] slave %d sale closed: %u ml, amount %u, totalizer %u ml\n", n.id, n.sell_ml, n.amount, n.total_ml);
+    }
+    n.approved = false;
+}
+
+static void apply_action(uint8_t slave, const std::string& action, uint32_t arg) {
+    if (action == "quit") {
+        running = false;
+        return;
+    }
+    sim_nozzle_t* n = find_nozzle(slave);
+    if (!n) {
+        fprintf(stderr, "[sim] script: unknown slave %d\n", slave);
+        return;
+    }
+    if (action == "lift") {
+        n->handle = true;
+        n->volume_um = 0;
+        n->amount = 0;
+        if (auto_approve) n->approved = true;
+    } else if (action == "hang") {
+        close_sale(*n);
+        n->handle = false;
+    } else if (action == "approve") {
+        if (n->handle) n->approved = true;
+    } else if (action == "price") {
+        n->price = arg;
+    } else if (action == "rate") {
+        n->rate_mlps = arg;
+    } else if (action == "preset") {
+        n->preset_ml = arg;
+    } else {
+        fprintf(stderr, "[sim] script: unknown action %s\n", action.c_str());
+        return;
+    }
+    printf("[sim] slave %d %s %u\n", slave, action.c_str(), arg);
+}
+
+static void flow_tick(uint32_t dt_ms) {
+    for (int i = 0; i < nozzle_count; i++) {
+        sim_nozzle_t& n = nozzles[i];
+        if (!n.handle || !n.approved) continue;
+        if (n.preset_ml && live_ml(n) >= n.preset_ml) continue;
+        n.volume_um += (uint64_t)n.rate_mlps * dt_ms;  // ml/s * ms = ul
+        if (n.preset_ml && live_ml(n) > n.preset_ml) n.volume_um = (uint64_t)n.preset_ml * 1000;
+        n.amount = (uint32_t)((uint64_t)live_ml(n) * n.price / 1000);
+    }
+}
+
+static void send_frame(int fd, uint8_t* frame, size_t len) {
+    if (crc_error_rate > 0 && (double)rand() / RAND_MAX < crc_error_rate) {
+        frame[len - 1] ^= 0x5A;
+        stats.crc_injected++;
+    }
+    if (latency_ms) sleep_us((uint64_t)latency_ms * 1000);
+    if (baud) sleep_us((uint64_t)len * 10 * 1000000 / baud);  // 8N1 wire time
+    size_t off = 0;
+    while (off < len) {
+        ssize_t w = write(fd, frame + off, len - off);
+        if (w < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            return;
+        }
+        off += (size_t)w;
+    }
+    stats.responses++;
+}
+
+static void send_exception(int fd, uint8_t slave, uint8_t fn, uint8_t code) {
+    uint8_t frame[8] = { slave, (uint8_t)(fn | 0x80), code };
+    stats.exceptions++;
+    send_frame(fd, frame, rtu_seal(frame, 3));
+}
+
+// handle one complete request frame
+static void serve(int fd, const uint8_t* req) {
+    stats.requests++;
+    uint8_t slave = req[0];
+    uint8_t fn = req[1];
+    sim_nozzle_t* n = find_nozzle(slave);
+    if (!n) return;  // not on the bus, master times out
+
+    uint16_t addr = (req[2] << 8) | req[3];
+    uint16_t val = (req[4] << 8) | req[5];
+    uint8_t frame[RTU_MAX_FRAME];
+
+    if (fn == RTU_FN_READ_HOLDING) {
+        if (val == 0 || val > 125) {
+            send_exception(fd, slave, fn, 0x03);
+            return;
+        }
+        if (addr < LANFENG_WINDOW_START || addr + val - 1 > LANFENG_WINDOW_END) {
+            send_exception(fd, slave, fn, 0x02);
+            return;
+        }
+        frame[0] = slave;
+        frame[1] = fn;
+        frame[2] = (uint8_t)(val * 2);
+        for (uint16_t i = 0; i < val; i++) {
+            uint16_t w = read_register(*n, addr + i);
+            frame[3 + i * 2] = w >> 8;
+            frame[4 + i * 2] = w & 0xFF;
+        }
+        send_frame(fd, frame, rtu_seal(frame, 3 + val * 2));
+    } else if (fn == RTU_FN_WRITE_SINGLE) {
+        if (addr != LANFENG_PUMP_STATE) {
+            send_exception(fd, slave, fn, 0x02);
+            return;
+        }
+        if (val) {
+            if (n->handle) n->approved = true;
+        } else {
+            n->approved = false;
+        }
+        memcpy(frame, req, 6);  // echo
+        send_frame(fd, frame, rtu_seal(frame, 6));
+    } else {
+        send_exception(fd, slave, fn, 0x01);
+    }
+}
+
+// pull complete frames out of the receive buffer, resync on crc errors
+static void process_rx(int fd, std::vector<uint8_t>& rx) {
+    while (rx.size() >= 8) {
+        const size_t need = 8;  // 03 and 06 requests are fixed size, others get an exception
+        if (!rtu_check(rx.data(), need)) {
+            stats.bad_requests++;
+            rx.erase(rx.begin());
+            continue;
+        }
+        serve(fd, rx.data());
+        rx.erase(rx.begin(), rx.begin() + need);
+    }
+}
+
+static bool load_script(const char* path, std::vector<sim_step_t>& steps) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        char* hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        unsigned at, slave, arg = 0;
+        char action[32];
+        int n = sscanf(line, "%u %u %31s %u", &at, &slave, action, &arg);
+        if (n < 3) continue;
+        steps.push_back({ at, (uint8_t)slave, action, arg });
+    }
+    fclose(f);
+    return true;
+}
+
+static void on_signal(int) {
+    running = false;
+}
+
+static int open_pty(const char* link) {
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0 || grantpt(fd) < 0 || unlockpt(fd) < 0) {
+        perror("pty");
+        return -1;
+    }
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    const char* name = ptsname(fd);
+    printf("[sim] serving on %s\n", name);
+    if (link) {
+        unlink(link);
+        if (symlink(name, link) == 0) printf("[sim] linked %s\n", link);
+        else perror(link);
+    }
+    fflush(stdout);
+    return fd;
+}
+
+int main(int argc, char** argv) {
+    const char* script = NULL;
+    const char* link = NULL;
+    std::string slaves = "1";
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool more = i + 1 < argc;
+        if (a == "--slaves" && more) slaves = argv[++i];
+        else if (a == "--latency-ms" && more) latency_ms = atoi(argv[++i]);
+        else if (a == "--baud" && more) baud = atoi(argv[++i]);
+        else if (a == "--crc-error" && more) crc_error_rate = atof(argv[++i]);
+        else if (a == "--script" && more) script = argv[++i];
+        else if (a == "--link" && more) link = argv[++i];
+        else if (a == "--auto-approve") auto_approve = true;
+        else if (a == "--loop") loop_script = true;
+        else {
+            fprintf(stderr, "usage: %s [--slaves 1,2] [--latency-ms N] [--baud N] [--crc-error P]\n"
+                            "          [--script FILE] [--auto-approve] [--loop] [--link PATH]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    for (char* tok = strtok(&slaves[0], ","); tok && nozzle_count < SIM_MAX_SLAVES; tok = strtok(NULL, ",")) {
+        sim_nozzle_t& n = nozzles[nozzle_count++];
+        memset(&n, 0, sizeof(n));
+        n.id = (uint8_t)atoi(tok);
+        n.price = 3000;
+        n.rate_mlps = 500;
+    }
+
+    std::vector<sim_step_t> steps;
+    if (script && !load_script(script, steps)) return 1;
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    srand((unsigned)time(NULL));
+
+    int fd = open_pty(link);
+    if (fd < 0) return 1;
+
+    std::vector<uint8_t> rx;
+    uint64_t start = now_ms();
+    uint64_t last_tick = start;
+    size_t next_step = 0;
+
+    while (running) {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        int rc = poll(&pfd, 1, SIM_TICK_MS);
+        if (rc > 0 && (pfd.revents & POLLIN)) {
+            uint8_t buf[RTU_MAX_FRAME];
+            ssize_t r = read(fd, buf, sizeof(buf));
+            if (r > 0) {
+                rx.insert(rx.end(), buf, buf + r);
+                process_rx(fd, rx);
+            }
+        } else if (rc > 0 && (pfd.revents & POLLHUP)) {
+            usleep(SIM_TICK_MS * 1000);  // no master attached yet
+        }
+
+        uint64_t now = now_ms();
+        while (next_step < steps.size() && now - start >= steps[next_step].at_ms) {
+            apply_action(steps[next_step].slave, steps[next_step].action, steps[next_step].arg);
+            next_step++;
+        }
+        if (loop_script && next_step == steps.size() && !steps.empty()) {
+            next_step = 0;
+            start = now;
+        }
+        flow_tick((uint32_t)(now - last_tick));
+        last_tick = now;
+    }
+
+    printf("[sim] requests %u responses %u exceptions %u bad %u crc_injected %u\n",
+           stats.requests, stats.responses, stats.exceptions, stats.bad_requests, stats.crc_injected);
+    if (link) unlink(link);
+    close(fd);
+    return 0;
+}
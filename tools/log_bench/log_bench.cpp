@@ -0,0 +1,204 @@
+/*
+ * log_bench - per call cost of fmsLog, formatting in the caller against the deferred ring
+ *
+ * "direct" is what fmsLog did in the calling task before the ring: time stamp
+ * and prefix snprintf, then the message through log_printfv (a vsnprintf to
+ * size it and one to format it), every byte handed to the UART writer. The
+ * UART itself is a memory sink here, so the real direct cost on the device
+ * is higher by the wire time of the line. "deferred" is fms_log_ring::push
+ * (main/src/_fms_log_ring.cpp) with the same calls, and "drain" the consumer
+ * side that now runs in log_task. Last, several threads push at once while
+ * one drains (a producer that finds the ring full yields and tries again,
+ * so every record gets through), for the end to end rate under contention.
+ *
+ *   g++ -O2 -std=gnu++17 -pthread -I../../main/src -o log_bench log_bench.cpp ../../main/src/_fms_log_ring.cpp
+ *   ./log_bench [--calls 2000000] [--threads 4]
+ *
+ * @copyright 2025 FMS Project
+ */
+
+#include "_fms_log_ring.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+static uint64_t clock_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// ---- direct path, as fmsLog / log_printfv format in the caller ------------
+
+static char     uart_sink[256];
+static volatile uint32_t uart_pos;
+
+static void uart_write_char(char c) {
+    uart_sink[uart_pos++ & (sizeof(uart_sink) - 1)] = c;
+}
+
+static int bench_printfv(const char* format, va_list arg) {
+    static char loc_buf[64];
+    char* temp = loc_buf;
+    va_list copy;
+    va_copy(copy, arg);
+    uint32_t len = vsnprintf(NULL, 0, format, copy);
+    va_end(copy);
+    if (len >= sizeof(loc_buf)) {
+        temp = (char*)malloc(len + 1);
+        if (!temp) return 0;
+    }
+    int wlen = vsnprintf(temp, len + 1, format, arg);
+    for (int i = 0; i < wlen; i++) uart_write_char(temp[i]);
+    if (len >= sizeof(loc_buf)) free(temp);
+    return len;
+}
+
+static int bench_printf(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int n = bench_printfv(format, args);
+    va_end(args);
+    return n;
+}
+
+static bool direct_log(uint32_t ms, int level, const char* format, ...) {
+    static const char* names[] = {"NONE", "ERROR", "WARN", "INFO", "DEBUG", "VERB", "TASK"};
+    char timeStr[20];
+    unsigned long seconds = ms / 1000;
+    unsigned long minutes = seconds / 60;
+    unsigned long hours = minutes / 60;
+    snprintf(timeStr, sizeof(timeStr), "%02lu:%02lu:%02lu.%03lu", hours, minutes % 60, seconds % 60,
+             (unsigned long)(ms % 1000));
+    char prefix[64];
+    snprintf(prefix, sizeof(prefix), "[%s] [%s] ", timeStr, names[level]);
+    bench_printf("%s", prefix);
+    va_list args;
+    va_start(args, format);
+    bench_printfv(format, args);
+    va_end(args);
+    bench_printf("\n");
+    return true;
+}
+
+// ---- deferred path ---------------------------------------------------------
+
+static fms_log_ring ring;
+
+static bool ring_log(uint32_t ms, int level, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    bool ok = ring.push(ms, (uint8_t)level, format, args);
+    va_end(args);
+    return ok;
+}
+
+// The call mix: lines the firmware logs while a nozzle is fuelling
+#define MIX 6
+#define CALL(ok, fn, i, ms) do { \
+        switch ((i) % MIX) { \
+            case 0: ok = fn(ms, 4, "[NOZZLE] %d: %s -> %s", 3, "APPROVED", "FUELLING"); break; \
+            case 1: ok = fn(ms, 3, "[MQTT] published %s (%u bytes)", "detpos/local_server/3", 42u); break; \
+            case 2: ok = fn(ms, 4, "[UART2] poll %d ok, %lu ms", 2, 18ul); break; \
+            case 3: ok = fn(ms, 3, "[LIVE] pump %d vol %.3f amt %.2f", 1, 12.345, 370.35); break; \
+            case 4: ok = fn(ms, 2, "[OUTBOX] SD write failed, publishing %s directly", "detpos/local_server/Final/1"); break; \
+            default: ok = fn(ms, 3, "[TASK] %s task created done", "webserver"); break; \
+        } \
+    } while (0)
+
+static size_t drain_all() {
+    fms_log_rec_t rec;
+    char line[FMS_LOG_ARG_BYTES * 4 + 64];
+    size_t n = 0;
+    while (ring.pop(&rec)) {
+        fms_log_ring::format(rec, line, sizeof(line));
+        n++;
+    }
+    return n;
+}
+
+int main(int argc, char** argv) {
+    long calls = 2000000;
+    int threads = 4;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--calls") && i + 1 < argc) calls = atol(argv[++i]);
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc) threads = atoi(argv[++i]);
+        else { fprintf(stderr, "usage: %s [--calls n] [--threads n]\n", argv[0]); return 2; }
+    }
+
+    // sanity: the deferred text is the direct text
+    ring_log(0, 3, "[LIVE] pump %d vol %.3f amt %.2f", 1, 12.345, 370.35);
+    fms_log_rec_t rec;
+    char text[128];
+    ring.pop(&rec);
+    fms_log_ring::format(rec, text, sizeof(text));
+    if (strcmp(text, "[LIVE] pump 1 vol 12.345 amt 370.35") != 0) {
+        fprintf(stderr, "format mismatch: %s\n", text);
+        return 1;
+    }
+
+    // direct
+    uint64_t t0 = clock_ns();
+    bool ok;
+    for (long i = 0; i < calls; i++) CALL(ok, direct_log, i, (uint32_t)i);
+    uint64_t direct_ns = clock_ns() - t0;
+
+    // deferred: push in batches of half the ring, drain timed apart
+    uint64_t push_ns = 0, drain_ns = 0;
+    long done = 0;
+    const long batch = FMS_LOG_RING_SLOTS / 2;
+    while (done < calls) {
+        long b = calls - done < batch ? calls - done : batch;
+        t0 = clock_ns();
+        for (long i = 0; i < b; i++) CALL(ok, ring_log, done + i, (uint32_t)(done + i));
+        uint64_t t1 = clock_ns();
+        drain_all();
+        drain_ns += clock_ns() - t1;
+        push_ns += t1 - t0;
+        done += b;
+    }
+
+    (void)ok;
+    printf("calls            %ld\n", calls);
+    printf("direct           %8.1f ns/call   (formatting in the caller, UART excluded)\n", (double)direct_ns / calls);
+    printf("deferred push    %8.1f ns/call   (%.1fx less in the caller)\n", (double)push_ns / calls,
+           (double)direct_ns / (double)push_ns);
+    printf("drain (log_task) %8.1f ns/record\n", (double)drain_ns / calls);
+    printf("ring drops       %u\n", ring.drops());
+
+    // contention: producers push as fast as they can, one consumer drains
+    ring.reset_stats();
+    std::atomic<long> retries(0);
+    std::atomic<int> running(threads);
+    std::vector<std::thread> th;
+    long per = calls / threads;
+    t0 = clock_ns();
+    for (int t = 0; t < threads; t++) {
+        th.emplace_back([t, per, &running, &retries] {
+            for (long i = 0; i < per; i++) {
+                bool pushed;
+                CALL(pushed, ring_log, i + t, (uint32_t)i);
+                if (!pushed) { retries++; i--; std::this_thread::yield(); }
+            }
+            running--;
+        });
+    }
+    long drained = 0;
+    while (running.load() || ring.pending()) {
+        drained += drain_all();
+        std::this_thread::yield();
+    }
+    for (auto& x : th) x.join();
+    drained += drain_all();
+    uint64_t mp_ns = clock_ns() - t0;
+    printf("%d producers      %8.1f ns/record end to end, %ld drained, %ld retried on a full ring, high water %u\n",
+           threads, (double)mp_ns / (per * threads), drained, retries.load(), ring.high_water());
+    return 0;
+}
@@ -0,0 +1,107 @@
+/*
+ * router_bench - messages per second through the firmware MQTT topic router
+ *
+ * Builds the same route table as fms_mqtt_routes_begin (main/fms_mqtt.ino)
+ * and routes a station traffic mix through main/src/_fms_topic_router.cpp,
+ * next to the strcmp chain it replaced.
+ *
+ *   g++ -O2 -std=gnu++17 -I../../main/src -o router_bench router_bench.cpp ../../main/src/_fms_topic_router.cpp
+ *   ./router_bench [--messages 5000000] [--devn 1]
+ *
+ * @copyright 2025 FMS Project
+ */
+
+#include "_fms_topic_router.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+
+static uint32_t handled[4];
+
+static void on_approve(const char*, const uint8_t*, size_t, void*) { handled[0]++; }
+static void on_preset(const char*, const uint8_t*, size_t, void*)  { handled[1]++; }
+static void on_price(const char*, const uint8_t*, size_t, void*)   { handled[2]++; }
+static void on_reload(const char*, const uint8_t*, size_t, void*)  { handled[3]++; }
+
+static uint64_t clock_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// the old callback: one strcmp per known topic
+static bool route_strcmp(const char* topic, const char* approve, const char* preset, const char* price, const char* reload,
+                         const uint8_t* payload, size_t len) {
+    if (strcmp(topic, approve) == 0)      on_approve(topic, payload, len, NULL);
+    else if (strcmp(topic, preset) == 0)  on_preset(topic, payload, len, NULL);
+    else if (strcmp(topic, price) == 0)   on_price(topic, payload, len, NULL);
+    else if (strcmp(topic, reload) == 0)  on_reload(topic, payload, len, NULL);
+    else return false;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    uint32_t messages = 5000000;
+    int devn = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool more = i + 1 < argc;
+        if (a == "--messages" && more) messages = atoi(argv[++i]);
+        else if (a == "--devn" && more) devn = atoi(argv[++i]);
+    }
+
+    char approve[32], reload[32];
+    snprintf(approve, sizeof(approve), "detpos/local_server/%d", devn);
+    snprintf(reload, sizeof(reload), "detpos/local_server/reload/%d", devn);
+    const char* preset = "detpos/local_server/preset";
+    const char* price = "detpos/local_server/price";
+
+    fms_topic_router router;
+    router.add(approve, on_approve);
+    router.add(preset, on_preset);
+    router.add(price, on_price);
+    router.add(reload, on_reload);
+
+    // what a touch build subscribed to detpos/# sees: other devices' traffic dominates
+    static const char* const mix[] = {
+        "detpos/device/livedata/2", "detpos/device/livedata/3", "detpos/device/Final/2",
+        "detpos/device/permit/4", "detpos/local_server/2", "detpos/local_server/3",
+        "detpos/device/livedata/2", "detpos/device/whreq",
+        NULL, NULL, NULL, NULL,  // own topics, filled below
+    };
+    const char* topics[12];
+    memcpy(topics, mix, sizeof(topics));
+    topics[8] = approve;
+    topics[9] = preset;
+    topics[10] = price;
+    topics[11] = reload;
+    const size_t topic_count = sizeof(topics) / sizeof(topics[0]);
+    const uint8_t payload[] = "01P5000";
+
+    uint64_t t0 = clock_ns();
+    uint32_t routed = 0;
+    for (uint32_t i = 0; i < messages; i++) {
+        routed += router.route(topics[i % topic_count], payload, sizeof(payload) - 1);
+    }
+    double trie = (clock_ns() - t0) / 1e9;
+
+    t0 = clock_ns();
+    uint32_t routed_cmp = 0;
+    for (uint32_t i = 0; i < messages; i++) {
+        routed_cmp += route_strcmp(topics[i % topic_count], approve, preset, price, reload, payload, sizeof(payload) - 1);
+    }
+    double chain = (clock_ns() - t0) / 1e9;
+
+    printf("routes %u  trie nodes %u (%zu bytes)  unrouted %u\n",
+           router.route_count(), router.node_count(), sizeof(router), router.unrouted());
+    for (uint8_t i = 0; i < router.route_count(); i++) {
+        printf("  %-32s hits %u\n", router.pattern(i), router.hits(i));
+    }
+    printf("trie      %.2f M msg/s  %.0f ns/msg  routed %u\n", messages / trie / 1e6, trie * 1e9 / messages, routed);
+    printf("strcmp    %.2f M msg/s  %.0f ns/msg  routed %u\n", messages / chain / 1e6, chain * 1e9 / messages, routed_cmp);
+    return routed == routed_cmp ? 0 : 1;
+}
@@ -0,0 +1,200 @@
+/*
+ * payload_codec - host encoder / decoder for permit, live and Final payloads
+ *
+ * Uses main/src/_fms_payload.cpp, the same code the firmware publishes with,
+ * so a local server developer can produce and read either encoding, and
+ * benchmarks encode / decode time and payload size of text against binary.
+ *
+ *   g++ -O2 -std=gnu++17 -I../../main/src -o payload_codec payload_codec.cpp ../../main/src/_fms_payload.cpp
+ *   ./payload_codec encode binary final 1 3000 10.000 30000 12345.678
+ *   ./payload_codec decode 8102011027000030750000   (hex = binary, anything else = text)
+ *   ./payload_codec bench [--messages 2000000]
+ *
+ * @copyright 2025 FMS Project
+ */
+
+#include "_fms_payload.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+
+static uint64_t clock_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static const char* kind_name(uint8_t kind) {
+    return kind == PAYLOAD_PERMIT ? "permit" : kind == PAYLOAD_LIVE ? "live" : kind == PAYLOAD_FINAL ? "final" : "?";
+}
+
+static void print_payload(const fms_payload_t& p) {
+    char price[24], vol[24], amt[24], total[24];
+    p.price.format(price, sizeof(price));
+    p.volume.format(vol, sizeof(vol));
+    p.amount.format(amt, sizeof(amt));
+    p.total.format(total, sizeof(total));
+    printf("kind %s  pump %u", kind_name(p.kind), p.pump);
+    if (p.kind == PAYLOAD_FINAL) printf("  price %s", price);
+    if (p.kind != PAYLOAD_PERMIT) printf("  volume %s  amount %s", vol, amt);
+    if (p.kind == PAYLOAD_FINAL) printf("  total %s", total);
+    printf("\n");
+}
+
+static void print_encoded(fms_payload_format_t fmt, const uint8_t* buf, size_t n) {
+    if (fmt == PAYLOAD_TEXT) {
+        printf("%.*s\n", (int)n, (const char*)buf);
+        return;
+    }
+    for (size_t i = 0; i < n; i++) printf("%02x", buf[i]);
+    printf("\n");
+}
+
+static bool parse_fixed_args(int argc, char** argv, int i, fms_payload_t* p) {
+    const char* v[4] = { "0", "0", "0", "0" };  // price volume amount total
+    if (p->kind == PAYLOAD_LIVE) {
+        if (argc < i + 2) return false;
+        v[1] = argv[i];
+        v[2] = argv[i + 1];
+    } else if (p->kind == PAYLOAD_FINAL) {
+        if (argc < i + 4) return false;
+        for (int k = 0; k < 4; k++) v[k] = argv[i + k];
+    }
+    return fms_unit_price_t::parse(v[0], strlen(v[0]), &p->price) && fms_volume_t::parse(v[1], strlen(v[1]), &p->volume) &&
+           fms_money_t::parse(v[2], strlen(v[2]), &p->amount) && fms_volume_t::parse(v[3], strlen(v[3]), &p->total);
+}
+
+static int cmd_encode(int argc, char** argv) {
+    fms_payload_format_t fmt;
+    fms_payload_t p = {};
+    if (argc < 5 || !fms_payload_format_parse(argv[2], &fmt)) return -1;
+    std::string kind = argv[3];
+    p.kind = kind == "permit" ? PAYLOAD_PERMIT : kind == "live" ? PAYLOAD_LIVE : kind == "final" ? PAYLOAD_FINAL : 0;
+    p.pump = (uint8_t)atoi(argv[4]);
+    if (p.kind == 0 || !parse_fixed_args(argc, argv, 5, &p)) return -1;
+    uint8_t buf[FMS_PAYLOAD_MAX];
+    size_t n = fms_payload_encode(fmt, p, buf, sizeof(buf));
+    if (n == 0) {
+        fprintf(stderr, "value out of range for %s\n", fms_payload_format_name(fmt));
+        return 1;
+    }
+    print_encoded(fmt, buf, n);
+    return 0;
+}
+
+static int cmd_decode(int argc, char** argv) {
+    if (argc < 3) return -1;
+    const char* in = argv[2];
+    size_t len = strlen(in);
+    uint8_t buf[128];
+    size_t n = 0;
+    bool hex = len % 2 == 0 && len <= 2 * sizeof(buf) && strspn(in, "0123456789abcdefABCDEF") == len &&
+               strtoul(std::string(in, 2).c_str(), NULL, 16) >= 0x80;
+    if (hex) {
+        for (size_t i = 0; i < len; i += 2) buf[n++] = (uint8_t)strtoul(std::string(in + i, 2).c_str(), NULL, 16);
+    } else {
+        n = len < sizeof(buf) ? len : sizeof(buf);
+        memcpy(buf, in, n);
+    }
+    fms_payload_t p;
+    if (!fms_payload_decode(buf, n, &p)) {
+        fprintf(stderr, "not a valid payload\n");
+        return 1;
+    }
+    if (hex) printf("binary schema %u  ", buf[0] & 0x7F);
+    else printf("text  ");
+    print_payload(p);
+    return 0;
+}
+
+static int cmd_bench(int argc, char** argv) {
+    uint32_t messages = 2000000;
+    for (int i = 2; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "--messages" && i + 1 < argc) messages = atoi(argv[++i]);
+    }
+
+    // a sale in progress: live samples climbing, then its Final
+    static fms_payload_t samples[256];
+    for (int i = 0; i < 256; i++) {
+        fms_payload_t& p = samples[i];
+        p.pump = 1 + i % 8;
+        p.kind = i % 64 == 63 ? PAYLOAD_FINAL : i % 64 == 0 ? PAYLOAD_PERMIT : PAYLOAD_LIVE;
+        p.price = fms_unit_price_t::from_units(3000 + 50 * (i % 3));
+        p.volume = fms_volume_t::from_raw(137 * (int64_t)(i % 64 + 1) * 11);
+        fms_amount_of(p.volume, p.price, &p.amount);
+        p.total = fms_volume_t::from_raw(123456789 + 1000 * (int64_t)i);
+    }
+
+    printf("%-7s %-6s %9s %9s %9s\n", "format", "kind", "bytes", "enc ns", "dec ns");
+    for (uint8_t f = 0; f < PAYLOAD_FORMAT_COUNT; f++) {
+        fms_payload_format_t fmt = (fms_payload_format_t)f;
+        for (uint8_t kind = PAYLOAD_PERMIT; kind <= PAYLOAD_FINAL; kind++) {
+            fms_payload_t p = samples[kind == PAYLOAD_PERMIT ? 0 : kind == PAYLOAD_LIVE ? 10 : 63];
+            uint8_t buf[FMS_PAYLOAD_MAX];
+            size_t n = 0;
+            uint64_t t0 = clock_ns();
+            for (uint32_t i = 0; i < messages; i++) {
+                p.pump = 1 + (i & 7);  // keep the compiler from hoisting the encode
+                n = fms_payload_encode(fmt, p, buf, sizeof(buf));
+            }
+            double enc = (double)(clock_ns() - t0) / messages;
+
+            fms_payload_t out;
+            uint32_t ok = 0;
+            size_t pump_at = fmt == PAYLOAD_TEXT ? 1 : 2;  // second pump digit / pump byte
+            t0 = clock_ns();
+            for (uint32_t i = 0; i < messages; i++) {
+                buf[pump_at] ^= (uint8_t)(i & 1);
+                ok += fms_payload_decode(buf, n, &out);
+                buf[pump_at] ^= (uint8_t)(i & 1);
+            }
+            double dec = (double)(clock_ns() - t0) / messages;
+            printf("%-7s %-6s %9zu %9.1f %9.1f%s\n", fms_payload_format_name(fmt), kind_name(kind), n, enc, dec,
+                   ok == messages ? "" : "  (decode failures)");
+        }
+    }
+
+    // station mix: bytes on the wire per message
+    uint8_t buf[FMS_PAYLOAD_MAX];
+    fms_payload_t out;
+    for (uint8_t f = 0; f < PAYLOAD_FORMAT_COUNT; f++) {
+        fms_payload_format_t fmt = (fms_payload_format_t)f;
+        size_t bytes = 0;
+        uint32_t mismatches = 0;
+        for (int i = 0; i < 256; i++) {
+            size_t n = fms_payload_encode(fmt, samples[i], buf, sizeof(buf));
+            bytes += n;
+            if (!fms_payload_decode(buf, n, &out) || out.kind != samples[i].kind || out.pump != samples[i].pump ||
+                (out.kind != PAYLOAD_PERMIT && (out.volume != samples[i].volume || out.amount != samples[i].amount)) ||
+                (out.kind == PAYLOAD_FINAL && (out.price != samples[i].price || out.total != samples[i].total))) {
+                mismatches++;
+            }
+        }
+        printf("mix %-7s %.1f bytes/msg  round trip mismatches %u\n", fms_payload_format_name(fmt), bytes / 256.0, mismatches);
+        if (mismatches) return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    std::string cmd = argc > 1 ? argv[1] : "";
+    int rc = -1;
+    if (cmd == "encode") rc = cmd_encode(argc, argv);
+    else if (cmd == "decode") rc = cmd_decode(argc, argv);
+    else if (cmd == "bench") rc = cmd_bench(argc, argv);
+    if (rc < 0) {
+        fprintf(stderr,
+                "usage: payload_codec encode <text|binary> permit <pump>\n"
+                "       payload_codec encode <text|binary> live <pump> <volume> <amount>\n"
+                "       payload_codec encode <text|binary> final <pump> <price> <volume> <amount> <total>\n"
+                "       payload_codec decode <hex|text>\n"
+                "       payload_codec bench [--messages N]\n");
+        return 2;
+    }
+    return rc;
+}
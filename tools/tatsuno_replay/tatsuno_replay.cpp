@@ -0,0 +1,182 @@
+/*
+ * tatsuno_replay - feed a captured Tatsuno wire log through the firmware parser
+ *
+ * Replays main/src/_fms_tatsuno.cpp over a capture, then checks that random
+ * fragmentation gives exactly the same events, fuzzes the parser with
+ * corrupted copies of the capture, and reports decode throughput.
+ *
+ *   g++ -O2 -std=gnu++17 -I../../main/src -o tatsuno_replay tatsuno_replay.cpp ../../main/src/_fms_tatsuno.cpp ../../main/src/_fms_protocol.cpp
+ *   ./tatsuno_replay sample_capture.txt [--events] [--splits 2000] [--fuzz 2000] [--seed 1] [--mb 32]
+ *
+ * capture format: one direction tag (tx / rx) and hex bytes per line, '#' comments
+ *
+ * @copyright 2025 FMS Project
+ */
+
+#include "_fms_tatsuno.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+struct replay_log_t {
+    std::vector<std::string> lines;
+};
+
+static uint64_t clock_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static bool load_capture(const char* path, std::vector<uint8_t>* out) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    char line[1024];
+    while (fgets(line, sizeof(line), f)) {
+        char* p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '#' || *p == '\n' || *p == '\0') continue;
+        if (strncmp(p, "tx", 2) == 0 || strncmp(p, "rx", 2) == 0) p += 2;
+        char* end;
+        for (;;) {
+            long v = strtol(p, &end, 16);
+            if (end == p) break;
+            out->push_back((uint8_t)v);
+            p = end;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+// one printable line per event, used to compare runs
+static void on_event(const fms_proto_event_t& ev, void* ctx) {
+    replay_log_t* log = (replay_log_t*)ctx;
+    if (!log) return;
+    char buf[160];
+    int n = snprintf(buf, sizeof(buf), "%-11s pump %2u noz %u seq %u", fms_proto_event_name(ev.type), ev.pump, ev.noz, ev.seq);
+    if (ev.type == PROTO_EV_LIVE || ev.type == PROTO_EV_FINAL) {
+        char v[24], a[24], p[24], t[24];
+        v[ev.volume.format(v)] = '\0';
+        a[ev.amount.format(a)] = '\0';
+        p[ev.price.format(p)] = '\0';
+        t[ev.total.format(t)] = '\0';
+        snprintf(buf + n, sizeof(buf) - n, "  volume %s amount %s price %s total %s", v, a, p, t);
+    } else if (ev.type == PROTO_EV_TEXT) {
+        snprintf(buf + n, sizeof(buf) - n, "  text %.*s", ev.text_len, (const char*)ev.text);
+    }
+    log->lines.push_back(buf);
+}
+
+static void run(fms_tatsuno_driver* parser, const std::vector<uint8_t>& bytes, replay_log_t* log, uint32_t maxChunk) {
+    parser->begin(on_event, log);
+    size_t i = 0;
+    while (i < bytes.size()) {
+        size_t n = maxChunk ? 1 + rand() % maxChunk : bytes.size();
+        if (n > bytes.size() - i) n = bytes.size() - i;
+        parser->feed(bytes.data() + i, n);
+        i += n;
+    }
+    parser->idle();
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <capture> [--events] [--splits N] [--fuzz N] [--seed N] [--mb N]\n", argv[0]);
+        return 2;
+    }
+    bool print = false;
+    uint32_t splits = 2000, fuzz = 2000, seed = 1, mb = 32;
+    for (int i = 2; i < argc; i++) {
+        std::string a = argv[i];
+        bool more = i + 1 < argc;
+        if (a == "--events") print = true;
+        else if (a == "--splits" && more) splits = atoi(argv[++i]);
+        else if (a == "--fuzz" && more) fuzz = atoi(argv[++i]);
+        else if (a == "--seed" && more) seed = atoi(argv[++i]);
+        else if (a == "--mb" && more) mb = atoi(argv[++i]);
+    }
+    srand(seed);
+
+    std::vector<uint8_t> bytes;
+    if (!load_capture(argv[1], &bytes) || bytes.empty()) {
+        fprintf(stderr, "empty capture\n");
+        return 1;
+    }
+
+    // reference run, whole capture in one feed
+    fms_tatsuno_driver parser;
+    replay_log_t ref;
+    run(&parser, bytes, &ref, 0);
+    const fms_proto_stats_t st = parser.stats();
+    if (print) {
+        for (size_t i = 0; i < ref.lines.size(); i++) printf("%s\n", ref.lines[i].c_str());
+    }
+    printf("capture   bytes %u frames %u events %u check_errors %u overflows %u resyncs %u\n",
+           st.bytes, st.frames, st.events, st.check_errors, st.overflows, st.resyncs);
+
+    // fragmented runs must decode identically
+    uint32_t mismatches = 0;
+    for (uint32_t i = 0; i < splits; i++) {
+        replay_log_t log;
+        run(&parser, bytes, &log, 1 + i % 16);
+        if (log.lines != ref.lines) mismatches++;
+    }
+    printf("splits    runs %u mismatches %u\n", splits, mismatches);
+
+    // corrupted copies: flips, drops and inserted bytes, must not crash or stall
+    uint32_t fuzzEvents = 0, fuzzBcc = 0;
+    parser.reset_stats();
+    for (uint32_t i = 0; i < fuzz; i++) {
+        std::vector<uint8_t> mut = bytes;
+        uint32_t edits = 1 + rand() % 8;
+        for (uint32_t e = 0; e < edits && !mut.empty(); e++) {
+            size_t at = rand() % mut.size();
+            switch (rand() % 3) {
+                case 0: mut[at] ^= (uint8_t)(1 << (rand() % 8)); break;
+                case 1: mut.erase(mut.begin() + at); break;
+                case 2: mut.insert(mut.begin() + at, (uint8_t)rand()); break;
+            }
+        }
+        run(&parser, mut, NULL, 1 + rand() % 32);
+        fuzzEvents += parser.stats().events;
+        fuzzBcc += parser.stats().check_errors;
+        parser.reset_stats();
+    }
+    printf("fuzz      runs %u events %u check_errors %u\n", fuzz, fuzzEvents, fuzzBcc);
+
+    // throughput, capture repeated back to back
+    std::vector<uint8_t> big;
+    while (big.size() < (size_t)mb * 1024 * 1024) big.insert(big.end(), bytes.begin(), bytes.end());
+    parser.begin(NULL, NULL);
+    parser.reset_stats();
+    uint64_t t0 = clock_ns();
+    for (size_t i = 0; i < big.size(); i += 64) {
+        parser.feed(big.data() + i, big.size() - i < 64 ? big.size() - i : 64);
+    }
+    double secs = (clock_ns() - t0) / 1e9;
+    printf("speed     %.1f MB/s  %.0f ns/byte  %.2f Mframes/s\n",
+           big.size() / secs / 1e6, secs * 1e9 / big.size(), parser.stats().frames / secs / 1e6);
+
+    // same bytes through the boot time driver table (one indirect call per feed)
+    const fms_protocol_ops_t* ops = fms_protocol_find("tatsuno");
+    ops->begin(NULL, NULL);
+    ops->reset_stats();
+    t0 = clock_ns();
+    for (size_t i = 0; i < big.size(); i += 64) {
+        ops->feed(big.data() + i, big.size() - i < 64 ? big.size() - i : 64);
+    }
+    secs = (clock_ns() - t0) / 1e9;
+    printf("table     %.1f MB/s  %.0f ns/byte  %.2f Mframes/s\n",
+           big.size() / secs / 1e6, secs * 1e9 / big.size(), ops->stats().frames / secs / 1e6);
+
+    return mismatches ? 1 : 0;
+}